@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// ABI v2 version of so_plugin_test.c, reuse its dns parser, build with:
+// gcc -shared -fPIC -I src/plugin/shared_obj -o so_plugin_v2_test so_plugin_v2_test.c
+#include "so_plugin_test.c"
+
+// the state counts the payloads of the connection
+struct conn_state {
+    int calls;
+};
+
+static struct arena_str arena_put(struct parse_arena *arena, const void *buf,
+                                  unsigned int len) {
+    struct arena_str s = {0};
+    if (len == 0 || arena->used + len > arena->cap) {
+        return s;
+    }
+    memcpy(&arena->buf[arena->used], buf, len);
+    s.off = arena->used;
+    s.len = len;
+    arena->used += len;
+    return s;
+}
+
+static struct arena_str arena_put_str(struct parse_arena *arena,
+                                      unsigned char *str) {
+    return arena_put(arena, str, strlen((char *)str));
+}
+
+void on_check_payload_batch(struct parse_ctx_v2 *ctxs, int n,
+                            struct check_result *results) {
+    for (int i = 0; i < n; i++) {
+        results[i] = on_check_payload(&ctxs[i].ctx);
+        if (results[i].proto != 0) {
+            results[i].direction = 1;
+        }
+    }
+}
+
+void on_parse_payload_batch(struct parse_ctx_v2 *ctxs, int n,
+                            struct parse_result *results,
+                            struct parse_info_v2 *infos, int infos_len,
+                            struct parse_arena *arena) {
+    static struct parse_info info;
+    int used = 0;
+
+    for (int i = 0; i < n; i++) {
+        struct parse_ctx_v2 *ctx = &ctxs[i];
+        struct conn_state *state = ctx->state;
+
+        if (state == NULL) {
+            state = calloc(1, sizeof(*state));
+            ctx->state = state;
+        }
+        state->calls++;
+
+        memset(&info, 0, sizeof(info));
+        results[i] = on_parse_payload(&ctx->ctx, &info, 1);
+        if (results[i].action != ACTION_OK || results[i].len == 0) {
+            continue;
+        }
+        if (used >= infos_len) {
+            results[i].action = ACTION_ERROR;
+            continue;
+        }
+
+        struct parse_info_v2 *v2 = &infos[used++];
+        memset(v2, 0, sizeof(*v2));
+        v2->msg_type = info.msg_type;
+        v2->has_request_id = info.has_request_id;
+        v2->request_id = info.request_id;
+        v2->req_len = info.req_len;
+        v2->resp_len = info.resp_len;
+        v2->trace_id = arena_put_str(arena, info.trace.trace_id);
+        v2->span_id = arena_put_str(arena, info.trace.span_id);
+        v2->parent_span_id = arena_put_str(arena, info.trace.parent_span_id);
+        if (info.msg_type == MSG_TYPE_REQ) {
+            v2->req_type = arena_put_str(arena, info.req_resp.req.req_type);
+            v2->domain = arena_put_str(arena, info.req_resp.req.domain);
+            v2->code = RESP_CODE_NULL;
+        } else {
+            v2->status = info.req_resp.resp.status;
+            v2->code = info.req_resp.resp.code;
+            v2->result = arena_put_str(arena, info.req_resp.resp.result);
+        }
+
+        // the attributes of the v1 parser, then the call count
+        unsigned int attr_bytes = 0;
+        for (unsigned int j = 0; j < info.attr_len * 2; j++) {
+            attr_bytes += strlen(&info.attributes[attr_bytes]) + 1;
+        }
+        char calls[32];
+        int calls_len = snprintf(calls, sizeof(calls), "calls%c%d",
+                                 '\0', state->calls) + 1;
+        // arena_put() returns {0, 0} for no attributes, take the offset
+        // before appending so it points at the call count in that case
+        unsigned int attr_off = arena->used;
+        struct arena_str attrs = arena_put(arena, info.attributes, attr_bytes);
+        if (attrs.len != attr_bytes) {
+            continue;
+        }
+        v2->attributes = attrs;
+        v2->attr_len = info.attr_len;
+        if (arena_put(arena, calls, calls_len).len == 0) {
+            continue;
+        }
+        v2->attributes.off = attr_off;
+        v2->attributes.len = attr_bytes + calls_len;
+        v2->attr_len = info.attr_len + 1;
+    }
+}
+
+void on_free_state(void *state) { free(state); }
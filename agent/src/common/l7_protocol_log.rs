@@ -320,6 +320,18 @@ pub struct EbpfParam<'a> {
     pub is_req_end: bool,
     pub is_resp_end: bool,
     pub process_kname: &'a str,
+    // Only for the HTTP/1.x payload starting with the indexed eBPF message
+    pub http1_index: Option<Http1Index>,
+}
+
+// HTTP/1.x request or status line and header block located by eBPF (see
+// set_http1_header_extract()), offsets in the payload.
+#[cfg(feature = "libtrace")]
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct Http1Index {
+    pub start_line_off: u16,
+    pub start_line_len: u16, // Without the line end
+    pub header_len: u16,     // Including the empty line, 0 if the end was not captured
 }
 
 #[derive(Default)]
@@ -769,6 +781,14 @@ impl<'a> ParseParam<'a> {
                     process_kname: std::str::from_utf8(&packet.process_kname[..]).unwrap_or(""),
                     #[cfg(windows)]
                     process_kname: "",
+                    #[cfg(unix)]
+                    http1_index: if packet.raw_from_ebpf_offset == 0 {
+                        packet.http1_index
+                    } else {
+                        None
+                    },
+                    #[cfg(windows)]
+                    http1_index: None,
                 })
             } else {
                 None
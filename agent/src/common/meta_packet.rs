@@ -45,11 +45,14 @@ use super::{
 use crate::error;
 #[cfg(all(unix, feature = "libtrace"))]
 use crate::{
-    common::ebpf::{GO_HTTP2_UPROBE, GO_HTTP2_UPROBE_DATA},
+    common::{
+        ebpf::{GO_HTTP2_UPROBE, GO_HTTP2_UPROBE_DATA},
+        l7_protocol_log::Http1Index,
+    },
     ebpf::{
-        MSG_CLOSE, MSG_REASM_SEG, MSG_REASM_START, MSG_REQUEST_END, MSG_RESPONSE_END,
-        PACKET_KNAME_MAX_PADDING, SK_BPF_DATA, SOCK_DATA_HTTP2, SOCK_DATA_TLS_HTTP2, SOCK_DIR_RCV,
-        SOCK_DIR_SND,
+        MSG_CLOSE, MSG_METADATA_ONLY, MSG_REASM_SEG, MSG_REASM_START, MSG_REQUEST_END,
+        MSG_RESPONSE_END, PACKET_KNAME_MAX_PADDING, SK_BPF_DATA, SOCK_DATA_HTTP2,
+        SOCK_DATA_TLS_HTTP2, SOCK_DIR_RCV, SOCK_DIR_SND,
     },
 };
 use crate::{
@@ -241,6 +244,8 @@ pub struct MetaPacket<'a> {
     pub sub_packet_index: usize,
     pub sub_packets: Vec<SubPacket>,
     pub is_socket_closed: bool,
+    // Sent without the payload (metadata only ports), only the timing is usable
+    pub is_metadata_only: bool,
 
     pub socket_id: u64,
     pub cap_start_seq: u64,
@@ -252,6 +257,8 @@ pub struct MetaPacket<'a> {
     pub ebpf_flags: ApplicationFlags,
     #[cfg(all(unix, feature = "libtrace"))]
     pub segment_flags: SegmentFlags,
+    #[cfg(all(unix, feature = "libtrace"))]
+    pub http1_index: Option<Http1Index>,
 
     pub process_id: u32,
     pub pod_id: u32,
@@ -1177,6 +1184,16 @@ impl<'a> MetaPacket<'a> {
         };
         packet.segment_flags = SegmentFlags::from(data.msg_type);
         packet.is_socket_closed = data.msg_type == MSG_CLOSE;
+        packet.is_metadata_only = data.msg_type == MSG_METADATA_ONLY;
+        let l7_index = data.l7_index;
+        let start_line = l7_index.start_line;
+        if start_line.len > 0 {
+            packet.http1_index = Some(Http1Index {
+                start_line_off: start_line.off,
+                start_line_len: start_line.len,
+                header_len: l7_index.hdr_len,
+            });
+        }
 
         // 目前只有 go uprobe http2 的方向判断能确保准确
         if data.source == GO_HTTP2_UPROBE || data.source == GO_HTTP2_UPROBE_DATA {
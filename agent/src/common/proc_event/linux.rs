@@ -17,6 +17,7 @@
 use std::{
     fmt::{self, Debug, Formatter},
     slice, str,
+    time::{Duration, SystemTime, UNIX_EPOCH},
 };
 
 use prost::Message;
@@ -30,7 +31,7 @@ use crate::common::{
     ebpf::IO_EVENT,
     error::Error::{self, ParseEventData},
 };
-use crate::ebpf::SK_BPF_DATA;
+use crate::ebpf::{IO_LATENCY_HIST, SK_BPF_DATA};
 
 const IO_OPERATION_OFFSET: usize = 4;
 const IO_LATENCY_OFFSET: usize = 8;
@@ -202,6 +203,46 @@ impl ProcEvent {
 
         Ok(BoxedProcEvents(Box::new(proc_event)))
     }
+
+    // The histogram buckets are not in the IoEventData message, a drained histogram is
+    // sent as one IoEvent with the total bytes and the mean latency of the period.
+    pub fn from_io_latency_hist(hist: &IO_LATENCY_HIST, period: Duration) -> BoxedProcEvents {
+        fn parse_cstring_slice(slice: &[u8]) -> Vec<u8> {
+            match slice.iter().position(|&b| b == b'\0') {
+                Some(index) => slice[..index].to_vec(),
+                None => slice.to_vec(),
+            }
+        }
+        let (count, bytes, latency_sum) = (hist.count, hist.bytes, hist.latency_sum);
+        let (mount_point, dir_name) = (hist.mount_point, hist.dir_name);
+        let end_time = SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .unwrap_or_default()
+            .as_nanos() as u64;
+        let io_event_data = IoEventData {
+            bytes_count: bytes.min(u32::MAX as u64) as u32,
+            operation: hist.operation,
+            latency: latency_sum / count.max(1),
+            off_bytes: 0,
+            file_type: 0,
+            filename: vec![],
+            mount_source: vec![],
+            mount_point: parse_cstring_slice(&mount_point),
+            file_dir: parse_cstring_slice(&dir_name),
+        };
+
+        BoxedProcEvents(Box::new(ProcEvent {
+            pid: hist.pid,
+            pod_id: 0,
+            thread_id: 0,
+            coroutine_id: 0,
+            process_kname: vec![],
+            start_time: end_time.saturating_sub(period.as_nanos() as u64),
+            end_time,
+            event_type: EventType::IoEvent,
+            event_data: EventData::IoEvent(io_event_data),
+        }))
+    }
 }
 
 #[derive(Debug)]
@@ -987,6 +987,7 @@ pub struct EbpfSocketUprobeGolang {
     pub enabled: bool,
     #[serde(with = "humantime_serde")]
     pub tracing_timeout: Duration,
+    pub lazy_goid: bool,
 }
 
 impl Default for EbpfSocketUprobeGolang {
@@ -994,6 +995,7 @@ impl Default for EbpfSocketUprobeGolang {
         Self {
             enabled: false,
             tracing_timeout: Duration::from_secs(120),
+            lazy_goid: false,
         }
     }
 }
@@ -1035,6 +1037,7 @@ pub struct EbpfSocketKprobe {
     pub enable_unix_socket: bool,
     pub blacklist: EbpfSocketKprobePorts,
     pub whitelist: EbpfSocketKprobePorts,
+    pub metadata_only: EbpfSocketKprobePorts,
 }
 
 #[derive(Clone, Default, Debug, Deserialize, PartialEq, Eq)]
@@ -1044,6 +1047,7 @@ pub struct EbpfSocketTunning {
     pub syscall_trace_id_disabled: bool,
     pub map_prealloc_disabled: bool,
     pub fentry_enabled: bool,
+    pub socket_key_by_sk: bool,
 }
 
 #[derive(Clone, Default, Debug, Deserialize, PartialEq, Eq)]
@@ -1093,6 +1097,9 @@ pub struct EbpfFileIoEvent {
     #[serde(with = "humantime_serde")]
     pub minimal_duration: Duration,
     pub enable_virtual_file_collect: bool,
+    pub latency_histogram_enabled: bool,
+    #[serde(with = "humantime_serde")]
+    pub outlier_duration: Duration,
 }
 
 impl Default for EbpfFileIoEvent {
@@ -1101,6 +1108,8 @@ impl Default for EbpfFileIoEvent {
             collect_mode: 1,
             minimal_duration: Duration::from_millis(1),
             enable_virtual_file_collect: false,
+            latency_histogram_enabled: false,
+            outlier_duration: Duration::from_millis(100),
         }
     }
 }
@@ -1237,6 +1246,27 @@ pub struct EbpfProfile {
     pub languages: EbpfProfileLanguages,
 }
 
+// Lower values are shed first, see set_bpf_memory_shed_priority() in ebpf/mod.rs
+#[derive(Clone, Copy, Debug, Deserialize, PartialEq, Eq)]
+#[serde(default)]
+pub struct EbpfMemoryShedPriority {
+    pub symbol_cache: i32,
+    pub stack_str: i32,
+    pub profiler_freq: i32,
+    pub socket_data: i32,
+}
+
+impl Default for EbpfMemoryShedPriority {
+    fn default() -> Self {
+        Self {
+            symbol_cache: 10,
+            stack_str: 20,
+            profiler_freq: 30,
+            socket_data: 40,
+        }
+    }
+}
+
 #[derive(Clone, Copy, Debug, Deserialize, PartialEq, Eq)]
 #[serde(default)]
 pub struct EbpfTunning {
@@ -1248,6 +1278,9 @@ pub struct EbpfTunning {
     pub max_socket_entries: u32,
     pub socket_map_reclaim_threshold: u32,
     pub max_trace_entries: u32,
+    pub memory_budget: u64, // MiB, 0 disables the memory governor
+    pub memory_shed_priority: EbpfMemoryShedPriority,
+    pub hugepage_mode: i32, // 0: default, 1: transparent, 2: explicit
 }
 
 impl Default for EbpfTunning {
@@ -1261,6 +1294,9 @@ impl Default for EbpfTunning {
             max_socket_entries: 131072,
             socket_map_reclaim_threshold: 120000,
             max_trace_entries: 131072,
+            memory_budget: 0,
+            memory_shed_priority: EbpfMemoryShedPriority::default(),
+            hugepage_mode: 0,
         }
     }
 }
@@ -1395,6 +1431,10 @@ pub struct EbpfSocketPreprocess {
     pub out_of_order_reassembly_protocols: Vec<String>,
     pub out_of_order_reassembly_timeout: Duration,
     pub segmentation_reassembly_protocols: Vec<String>,
+    pub http1_header_index: EbpfHttp1HeaderIndex,
+    pub socket_data_reorder_enabled: bool,
+    #[serde(with = "humantime_serde")]
+    pub socket_data_reorder_max_hold: Duration,
 }
 
 impl Default for EbpfSocketPreprocess {
@@ -1404,10 +1444,21 @@ impl Default for EbpfSocketPreprocess {
             out_of_order_reassembly_protocols: vec![],
             out_of_order_reassembly_timeout: Duration::from_millis(100),
             segmentation_reassembly_protocols: vec![],
+            http1_header_index: EbpfHttp1HeaderIndex::default(),
+            socket_data_reorder_enabled: false,
+            socket_data_reorder_max_hold: Duration::from_millis(5),
         }
     }
 }
 
+#[derive(Clone, Default, Debug, Deserialize, PartialEq, Eq)]
+#[serde(default)]
+pub struct EbpfHttp1HeaderIndex {
+    pub enabled: bool,
+    pub header_names: Vec<String>,
+    pub headers_only: bool,
+}
+
 impl EbpfSocketPreprocess {
     fn adjust_http2(protocols: &mut Vec<String>) {
         let bitmap = L7ProtocolBitmap::from(protocols.as_slice());
@@ -3535,6 +3535,22 @@ impl ConfigHandler {
             io_event.enable_virtual_file_collect = new_io_event.enable_virtual_file_collect;
             restart_agent = !first_run;
         }
+        if io_event.latency_histogram_enabled != new_io_event.latency_histogram_enabled {
+            info!(
+                "Update inputs.ebpf.file.io_event.latency_histogram_enabled from {:?} to {:?}.",
+                io_event.latency_histogram_enabled, new_io_event.latency_histogram_enabled
+            );
+            io_event.latency_histogram_enabled = new_io_event.latency_histogram_enabled;
+            restart_agent = !first_run;
+        }
+        if io_event.outlier_duration != new_io_event.outlier_duration {
+            info!(
+                "Update inputs.ebpf.file.io_event.outlier_duration from {:?} to {:?}.",
+                io_event.outlier_duration, new_io_event.outlier_duration
+            );
+            io_event.outlier_duration = new_io_event.outlier_duration;
+            restart_agent = !first_run;
+        }
         if ebpf.java_symbol_file_refresh_defer_interval
             != new_ebpf.java_symbol_file_refresh_defer_interval
         {
@@ -3717,6 +3733,14 @@ impl ConfigHandler {
             kprobe.whitelist.ports = new_kprobe.whitelist.ports.clone();
             restart_agent = !first_run;
         }
+        if kprobe.metadata_only.ports != new_kprobe.metadata_only.ports {
+            info!(
+                "Update inputs.ebpf.socket.kprobe.metadata_only.ports from {:?} to {:?}.",
+                kprobe.metadata_only.ports, new_kprobe.metadata_only.ports
+            );
+            kprobe.metadata_only.ports = new_kprobe.metadata_only.ports.clone();
+            restart_agent = !first_run;
+        }
 
         let sock_ops = &mut ebpf.socket.sock_ops;
         let new_sock_ops = &mut new_ebpf.socket.sock_ops;
@@ -3767,6 +3791,14 @@ impl ConfigHandler {
             golang_uprobe.tracing_timeout = new_golang_uprobe.tracing_timeout;
             restart_agent = !first_run;
         }
+        if golang_uprobe.lazy_goid != new_golang_uprobe.lazy_goid {
+            info!(
+                "Update inputs.ebpf.socket.uprobe.golang.lazy_goid from {:?} to {:?}.",
+                golang_uprobe.lazy_goid, new_golang_uprobe.lazy_goid
+            );
+            golang_uprobe.lazy_goid = new_golang_uprobe.lazy_goid;
+            restart_agent = !first_run;
+        }
 
         let dpdk_uprobe = &mut uprobe.dpdk;
         let new_dpdk_uprobe = &mut new_uprobe.dpdk;
@@ -3845,6 +3877,31 @@ impl ConfigHandler {
                 new_preprocess.segmentation_reassembly_protocols.clone();
             restart_agent = !first_run;
         }
+        if preprocess.http1_header_index != new_preprocess.http1_header_index {
+            info!(
+                "Update inputs.ebpf.socket.preprocess.http1_header_index from {:?} to {:?}.",
+                preprocess.http1_header_index, new_preprocess.http1_header_index
+            );
+            preprocess.http1_header_index = new_preprocess.http1_header_index.clone();
+            restart_agent = !first_run;
+        }
+        if preprocess.socket_data_reorder_enabled != new_preprocess.socket_data_reorder_enabled {
+            info!(
+                "Update inputs.ebpf.socket.preprocess.socket_data_reorder_enabled from {:?} to {:?}.",
+                preprocess.socket_data_reorder_enabled, new_preprocess.socket_data_reorder_enabled
+            );
+            preprocess.socket_data_reorder_enabled = new_preprocess.socket_data_reorder_enabled;
+            restart_agent = !first_run;
+        }
+        if preprocess.socket_data_reorder_max_hold != new_preprocess.socket_data_reorder_max_hold {
+            info!(
+                "Update inputs.ebpf.socket.preprocess.socket_data_reorder_max_hold from {:?} to {:?}.",
+                preprocess.socket_data_reorder_max_hold,
+                new_preprocess.socket_data_reorder_max_hold
+            );
+            preprocess.socket_data_reorder_max_hold = new_preprocess.socket_data_reorder_max_hold;
+            restart_agent = !first_run;
+        }
 
         let tunning = &mut ebpf.socket.tunning;
         let new_tunning = &mut new_ebpf.socket.tunning;
@@ -3856,6 +3913,14 @@ impl ConfigHandler {
             tunning.fentry_enabled = new_tunning.fentry_enabled;
             restart_agent = !first_run;
         }
+        if tunning.socket_key_by_sk != new_tunning.socket_key_by_sk {
+            info!(
+                "Update inputs.ebpf.socket.tunning.socket_key_by_sk from {:?} to {:?}.",
+                tunning.socket_key_by_sk, new_tunning.socket_key_by_sk
+            );
+            tunning.socket_key_by_sk = new_tunning.socket_key_by_sk;
+            restart_agent = !first_run;
+        }
         if tunning.map_prealloc_disabled != new_tunning.map_prealloc_disabled {
             info!(
                 "Update inputs.ebpf.socket.tunning.map_prealloc_disabled from {:?} to {:?}.",
@@ -3907,6 +3972,30 @@ impl ConfigHandler {
             tunning.kick_kern_nice = new_tunning.kick_kern_nice;
             restart_agent = !first_run;
         }
+        if tunning.memory_budget != new_tunning.memory_budget {
+            info!(
+                "Update inputs.ebpf.tunning.memory_budget from {:?} to {:?}.",
+                tunning.memory_budget, new_tunning.memory_budget
+            );
+            tunning.memory_budget = new_tunning.memory_budget;
+            restart_agent = !first_run;
+        }
+        if tunning.memory_shed_priority != new_tunning.memory_shed_priority {
+            info!(
+                "Update inputs.ebpf.tunning.memory_shed_priority from {:?} to {:?}.",
+                tunning.memory_shed_priority, new_tunning.memory_shed_priority
+            );
+            tunning.memory_shed_priority = new_tunning.memory_shed_priority;
+            restart_agent = !first_run;
+        }
+        if tunning.hugepage_mode != new_tunning.hugepage_mode {
+            info!(
+                "Update inputs.ebpf.tunning.hugepage_mode from {:?} to {:?}.",
+                tunning.hugepage_mode, new_tunning.hugepage_mode
+            );
+            tunning.hugepage_mode = new_tunning.hugepage_mode;
+            restart_agent = !first_run;
+        }
         if tunning.max_socket_entries != new_tunning.max_socket_entries {
             info!(
                 "Update inputs.ebpf.tunning.max_socket_entries from {:?} to {:?}.",
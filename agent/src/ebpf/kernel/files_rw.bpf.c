@@ -112,20 +112,19 @@ static __inline void *get_mount_ptr(void *file,
 	return (vfsmount - off_ptr->struct_mount_mnt_offset);
 }
 
-static __inline void get_mount_ids(void *file,
-				   struct __io_event_buffer *buffer,
+static __inline void get_mount_ids(void *file, int *mnt_id, __u32 *mntns_id,
 				   struct member_fields_offset *off_ptr)
 {
 	void *mount, *mnt_ns = NULL;
-	buffer->mntns_id = 0;
-	buffer->mnt_id = -1;
+	*mntns_id = 0;
+	*mnt_id = -1;
 	mount = get_mount_ptr(file, off_ptr);
 	if (mount == NULL)
 		return;
 
 	//bpf_debug("mount_mnt_id_offset 0x%x\n", off_ptr->struct_mount_mnt_id_offset);
 	if (off_ptr->struct_mount_mnt_id_offset != INVALID_OFFSET) {
-		bpf_probe_read_kernel(&buffer->mnt_id, sizeof(buffer->mnt_id),
+		bpf_probe_read_kernel(mnt_id, sizeof(*mnt_id),
 				      mount +
 				      off_ptr->struct_mount_mnt_id_offset);
 	}
@@ -139,7 +138,7 @@ static __inline void get_mount_ids(void *file,
 		return;
 
 	// mnt_namespace -> ns_common -> inum
-	bpf_probe_read_kernel(&buffer->mntns_id, sizeof(buffer->mntns_id),
+	bpf_probe_read_kernel(mntns_id, sizeof(*mntns_id),
 			      mnt_ns + off_ptr->struct_mnt_namespace_ns_offset +
 			      off_ptr->struct_ns_common_inum_offset);
 }
@@ -287,7 +286,7 @@ static __inline void set_file_metric_data(struct __io_event_buffer *buffer,
 	void *dentry = NULL, *parent;
 	bpf_probe_read_kernel(&dentry, sizeof(dentry),
 			      file + offset->struct_file_dentry_offset);
-	get_mount_ids(file, buffer, offset);
+	get_mount_ids(file, &buffer->mnt_id, &buffer->mntns_id, offset);
 	//bpf_debug("buffer->mnt_id %d\n", buffer->mnt_id);
 	buffer->len = 0;
 #pragma unroll
@@ -314,6 +313,112 @@ static __inline void set_file_metric_data(struct __io_event_buffer *buffer,
 	}
 }
 
+static __inline __u32 io_hist_slot(__u64 latency)
+{
+	__u64 v = latency / 1000;
+	__u32 slot = 0;
+
+	if (v >> 16) {
+		v >>= 16;
+		slot += 16;
+	}
+	if (v >> 8) {
+		v >>= 8;
+		slot += 8;
+	}
+	if (v >> 4) {
+		v >>= 4;
+		slot += 4;
+	}
+	if (v >> 2) {
+		v >>= 2;
+		slot += 2;
+	}
+	if (v >> 1)
+		slot += 1;
+
+	return slot < IO_HIST_SLOTS ? slot : IO_HIST_SLOTS - 1;
+}
+
+static __inline struct io_hist_value *io_hist_lookup(__u32 idx,
+						     struct io_hist_key *key)
+{
+	if (idx)
+		return io_hist_map_1__lookup(key);
+	return io_hist_map_0__lookup(key);
+}
+
+static __inline int io_hist_create(__u32 idx, struct io_hist_key *key,
+				   struct io_hist_value *zero)
+{
+	if (idx)
+		return bpf_map_update_elem(&__io_hist_map_1, key, zero,
+					   BPF_NOEXIST);
+	return bpf_map_update_elem(&__io_hist_map_0, key, zero, BPF_NOEXIST);
+}
+
+static __inline void update_io_hist(int fd, __u32 tgid,
+				    enum traffic_direction direction,
+				    __u64 bytes, __u64 latency,
+				    struct member_fields_offset *off_ptr)
+{
+	__u32 k0 = 0;
+	struct member_fields_offset *offset = off_ptr;
+	if (offset == NULL) {
+		offset = members_offset__lookup(&k0);
+		if (offset == NULL)
+			return;
+	}
+
+	void *file = fd_to_file(fd, offset);
+	if (file == NULL)
+		return;
+
+	struct io_hist_key key = {.tgid = tgid,.operation = direction };
+	void *dentry = NULL;
+	get_mount_ids(file, &key.mnt_id, &key.mntns_id, offset);
+	bpf_probe_read_kernel(&dentry, sizeof(dentry),
+			      file + offset->struct_file_dentry_offset);
+	if (dentry)
+		bpf_probe_read_kernel(&key.dir_id, sizeof(key.dir_id),
+				      dentry +
+				      offset->struct_dentry_d_parent_offset);
+
+	__u32 *ctl = io_hist_ctl__lookup(&k0);
+	__u32 idx = ctl ? *ctl & 1 : 0;
+	struct io_hist_value *v = io_hist_lookup(idx, &key);
+	if (v == NULL) {
+		struct io_hist_value *zero = io_hist_zero__lookup(&k0);
+		if (zero == NULL)
+			return;
+		if (io_hist_create(idx, &key, zero) == 0 && key.dir_id) {
+			struct io_hist_dir dir = {};
+			char *name = NULL;
+			bpf_probe_read_kernel(&name, sizeof(name),
+					      (void *)key.dir_id +
+					      offset->struct_dentry_name_offset);
+			bpf_probe_read_kernel_str(dir.name, sizeof(dir.name),
+						  name);
+			bpf_map_update_elem(&__io_hist_dir_map, &key.dir_id,
+					    &dir, BPF_ANY);
+		}
+		v = io_hist_lookup(idx, &key);
+		if (v == NULL) {
+			// The map is full until the next drain.
+			struct tracer_ctx_s *tracer_ctx =
+			    tracer_ctx_map__lookup(&k0);
+			if (tracer_ctx)
+				tracer_ctx->io_hist_overflow_count++;
+			return;
+		}
+	}
+
+	v->slots[io_hist_slot(latency)]++;
+	v->count++;
+	v->bytes += bytes;
+	v->latency_sum += latency;
+}
+
 static __inline int trace_io_event_common(void *ctx,
 					  struct member_fields_offset *offset,
 					  struct data_args_t *data_args,
@@ -340,7 +445,8 @@ static __inline int trace_io_event_common(void *ctx,
 
 	__u32 timeout = tracer_ctx->go_tracing_timeout;
 	struct trace_key_t trace_key = get_trace_key(timeout, false);
-	struct trace_info_t *trace_info_ptr = trace_map__lookup(&trace_key);
+	struct trace_info_t *trace_info_ptr =
+	    trace_info_lookup(tracer_ctx, &trace_key);
 	if (trace_info_ptr) {
 		trace_id = trace_info_ptr->thread_trace_id;
 	}
@@ -370,7 +476,16 @@ static __inline int trace_io_event_common(void *ctx,
 		latency = TIME_ROLLBACK_DEFAULT_LATENCY_NS;
 	}
 
-	if (latency < tracer_ctx->io_event_minimal_duration) {
+	/*
+	 * With histograms, every IO is aggregated and only the outliers are
+	 * emitted as individual events.
+	 */
+	if (tracer_ctx->io_hist_enabled) {
+		update_io_hist(data_args->fd, tgid, direction,
+			       data_args->bytes_count, latency, offset);
+		if (latency < tracer_ctx->io_event_outlier_duration)
+			return -1;
+	} else if (latency < tracer_ctx->io_event_minimal_duration) {
 		return -1;
 	}
 
@@ -401,6 +516,7 @@ static __inline int trace_io_event_common(void *ctx,
 	v->fd = data_args->fd;
 	v->tgid = tgid;
 	v->pid = (__u32) pid_tgid;
+	v->cgroup_id = get_current_cgroup_id();
 	v->coroutine_id = trace_key.goid;
 	v->timestamp = data_args->enter_ts;
 	v->cap_timestamp = bpf_ktime_get_ns();
@@ -450,7 +566,7 @@ static __inline int do_sys_enter_pread(int fd, enum syscall_src_func fn)
 	read_args.source_fn = fn;
 	read_args.fd = fd;
 	read_args.enter_ts = bpf_ktime_get_ns();
-	active_read_args_map__update(&id, &read_args);
+	active_args_update(ACTIVE_ARGS_READ, &id, &read_args);
 	return 0;
 }
 
@@ -500,13 +616,13 @@ static __inline int do_sys_exit_pread(void *ctx, ssize_t bytes_count)
 
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *read_args = active_read_args_map__lookup(&id);
+	struct data_args_t *read_args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	if (read_args != NULL) {
 		read_args->bytes_count = bytes_count;
 		trace_io_event_common(ctx, offset, read_args, T_INGRESS, id);
 	}
 
-	active_read_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
 	return 0;
 }
 
@@ -550,7 +666,7 @@ static __inline int do_sys_enter_pwrite(int fd, enum syscall_src_func fn)
 	write_args.source_fn = fn;
 	write_args.fd = fd;
 	write_args.enter_ts = bpf_ktime_get_ns();
-	active_write_args_map__update(&id, &write_args);
+	active_args_update(ACTIVE_ARGS_WRITE, &id, &write_args);
 	return 0;
 }
 
@@ -601,13 +717,13 @@ static __inline int do_sys_exit_pwrite(void *ctx, ssize_t bytes_count)
 
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *write_args = active_write_args_map__lookup(&id);
+	struct data_args_t *write_args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 	if (write_args != NULL) {
 		write_args->bytes_count = bytes_count;
 		trace_io_event_common(ctx, offset, write_args, T_EGRESS, id);
 	}
 
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return 0;
 }
 
@@ -647,17 +763,17 @@ PROGKP(io_event) (void *ctx) {
 
 	struct data_args_t *data_args = NULL;
 
-	data_args = active_read_args_map__lookup(&id);
+	data_args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	if (data_args) {
 		trace_io_event_common(ctx, NULL, data_args, T_INGRESS, id);
-		active_read_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_READ, &id);
 		return 0;
 	}
 
-	data_args = active_write_args_map__lookup(&id);
+	data_args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 	if (data_args) {
 		trace_io_event_common(ctx, NULL, data_args, T_EGRESS, id);
-		active_write_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_WRITE, &id);
 		return 0;
 	}
 
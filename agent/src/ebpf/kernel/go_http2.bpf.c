@@ -313,6 +313,7 @@ http2_fill_common_socket_1(struct http2_header_data *data,
 		send_buffer->tuple.addr_len = 16;
 	}
 	send_buffer->tgid = tgid;
+	send_buffer->cgroup_id = get_current_cgroup_id();
 	return true;
 }
 
@@ -336,7 +337,7 @@ http2_fill_common_socket_2(struct http2_header_data *data,
 	// Update and get socket_id
 	__u64 conn_key;
 	struct socket_info_s *socket_info_ptr;
-	conn_key = gen_conn_key_id((__u64) tgid, (__u64) data->fd);
+	conn_key = socket_info_key((__u64) tgid, (__u64) data->fd, NULL);
 	socket_info_ptr = socket_info_map__lookup(&conn_key);
 	if (is_socket_info_valid(socket_info_ptr)) {
 		send_buffer->socket_id = socket_info_ptr->uid;
@@ -356,7 +357,8 @@ http2_fill_common_socket_2(struct http2_header_data *data,
 
 	__u32 timeout = tracer_ctx->go_tracing_timeout;
 	struct trace_key_t trace_key = get_trace_key(timeout, true);
-	struct trace_info_t *trace_info_ptr = trace_map__lookup(&trace_key);
+	struct trace_info_t *trace_info_ptr =
+	    trace_info_lookup(tracer_ctx, &trace_key);
 
 	struct conn_info_s conn_info = {
 		.direction = send_buffer->direction,
@@ -444,6 +446,72 @@ http2_fill_buffer_and_send(struct http2_header_data *data,
 	report_http2_header(data->ctx);
 }
 
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+/*
+ * Packed HEADERS record (see HTTP2_HEADERS_PACKED), all the fields of a
+ * frame in one event. The end of the headers is given by the
+ * MSG_REQUEST_END/MSG_RESPONSE_END message type of the event.
+ */
+
+static __inline void http2_send_packed(struct __http2_buffer *buffer,
+				       struct __socket_data *send_buffer,
+				       __u32 count, __u32 len,
+				       enum message_type message_type,
+				       struct pt_regs *ctx)
+{
+	static const int BUF_OFFSET =
+	    offsetof(typeof(struct __http2_buffer), info);
+
+	// Check if pid is a valid value
+	if (!send_buffer->pid)
+		return;
+
+	buffer->header_len = HTTP2_HEADERS_PACKED | count;
+	buffer->value_len = len;
+	send_buffer->msg_type = message_type;
+	send_buffer->syscall_len = BUF_OFFSET + len;
+	send_buffer->data_len = BUF_OFFSET + len;
+	report_http2_header(ctx);
+}
+
+/*
+ * Append a field at 'off' in buffer->info, return the new offset, or 'off'
+ * if the field does not fit.
+ */
+static __inline __u32 http2_pack_field(struct __http2_buffer *buffer,
+				       __u32 off, struct go_string *name,
+				       struct go_string *value)
+{
+	__u32 name_len = name->len & 0x03FF;
+	__u32 value_len = value->len & 0x03FF;
+	__u32 value_off;
+
+	if (off + HTTP2_PACKED_FIELD_HDR + name_len + value_len >
+	    HTTP2_BUFFER_INFO_SIZE)
+		return off;
+
+	// Useless range checking. Make the eBPF validator happy
+	if (off > HTTP2_BUFFER_INFO_SIZE - HTTP2_PACKED_FIELD_HDR)
+		return off;
+
+	buffer->info[off] = name_len & 0xff;
+	buffer->info[off + 1] = name_len >> 8;
+	buffer->info[off + 2] = value_len & 0xff;
+	buffer->info[off + 3] = value_len >> 8;
+	off += HTTP2_PACKED_FIELD_HDR;
+	bpf_probe_read_user(buffer->info + off, 1 + name_len, name->ptr);
+
+	value_off = off + name_len;
+	// Useless range checking. Make the eBPF validator happy
+	if (value_off >= HTTP2_BUFFER_INFO_SIZE)
+		return off - HTTP2_PACKED_FIELD_HDR;
+	bpf_probe_read_user(buffer->info + value_off, 1 + value_len,
+			    value->ptr);
+
+	return value_off + value_len;
+}
+#endif
+
 struct http2_headers_data {
 	bool read:1;
 	int fd;
@@ -453,7 +521,7 @@ struct http2_headers_data {
 	struct pt_regs *ctx;
 };
 
-// Send multiple header messages and add an end marker message at the end
+// Send the header fields of a frame, followed by the end marker
 static __inline int submit_http2_headers(struct http2_headers_data *headers,
 					 struct member_fields_offset *offset)
 {
@@ -478,6 +546,43 @@ static __inline int submit_http2_headers(struct http2_headers_data *headers,
 	struct go_http2_header_field *tmp;
 	struct go_http2_header_field field;
 
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	/*
+	 * One event per frame, a field that does not fit flushes the fields
+	 * packed so far (without the end mark) and starts a new record.
+	 */
+	__u32 count = 0, off = 0, next;
+
+	buffer->fd = data.fd;
+	buffer->stream_id = data.stream;
+
+#pragma unroll
+	for (idx = 0; idx < 9; ++idx) {
+		if (idx >= headers->fields->len)
+			break;
+
+		tmp = headers->fields->ptr;
+		bpf_probe_read_user(&field, sizeof(field), tmp + idx);
+		next = http2_pack_field(buffer, off, &field.name, &field.value);
+		if (next == off && count > 0) {
+			http2_send_packed(buffer, send_buffer, count, off,
+					  data.message_type, data.ctx);
+			count = off = 0;
+			next = http2_pack_field(buffer, off, &field.name,
+						&field.value);
+		}
+		if (next != off) {
+			count++;
+			off = next;
+		}
+	}
+
+	// MSG_REQUEST -> MSG_REQUEST_END
+	// MSG_RESPONSE -> MSG_RESPONSE_END
+	http2_send_packed(buffer, send_buffer, count, off,
+			  data.message_type + 2, data.ctx);
+	return 0;
+#else
 #pragma unroll
 	for (idx = 0; idx < 9; ++idx) {
 		if (idx >= headers->fields->len)
@@ -499,6 +604,7 @@ static __inline int submit_http2_headers(struct http2_headers_data *headers,
 
 	http2_fill_buffer_and_send(&data, buffer, send_buffer);
 	return 0;
+#endif
 }
 
 static __inline __u32
@@ -1042,7 +1148,7 @@ static __inline int fill_http2_dataframe_base(struct __http2_stack *stack,
 	// Update and get socket_id
 	__u64 conn_key;
 	struct socket_info_s *socket_info_ptr;
-	conn_key = gen_conn_key_id((__u64) tgid, (__u64) fd);
+	conn_key = socket_info_key((__u64) tgid, (__u64) fd, sk);
 	socket_info_ptr = socket_info_map__lookup(&conn_key);
 	if (is_socket_info_valid(socket_info_ptr)) {
 		send_buffer->socket_id = socket_info_ptr->uid;
@@ -170,7 +170,7 @@ UPROG(go_tls_write_exit) (struct pt_regs *ctx)
 
 	submit_debug_str(2, 4, c->buffer);
 	bpf_map_delete_elem(&tls_conn_map, &key);
-	active_write_args_map__update(&id, &write_args);
+	active_args_update(ACTIVE_ARGS_WRITE, &id, &write_args);
 
 	if (!process_data((struct pt_regs *)ctx, id, T_EGRESS, &write_args,
 			  bytes_count, &extra)) {
@@ -180,7 +180,7 @@ UPROG(go_tls_write_exit) (struct pt_regs *ctx)
 			      PROG_DATA_SUBMIT_KP_IDX);
 #endif
 	}
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return 0;
 }
 
@@ -306,7 +306,7 @@ UPROG(go_tls_read_exit) (struct pt_regs *ctx)
 
 	submit_debug_str(4, 4, c->buffer);
 	bpf_map_delete_elem(&tls_conn_map, &key);
-	active_read_args_map__update(&id, &read_args);
+	active_args_update(ACTIVE_ARGS_READ, &id, &read_args);
 	if (!process_data((struct pt_regs *)ctx, id, T_INGRESS, &read_args,
 			  bytes_count, &extra)) {
 		submit_debug(4, 5, 0);
@@ -315,6 +315,6 @@ UPROG(go_tls_read_exit) (struct pt_regs *ctx)
 			      PROG_DATA_SUBMIT_KP_IDX);
 #endif
 	}
-	active_read_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
 	return 0;
 }
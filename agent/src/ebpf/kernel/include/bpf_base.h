@@ -41,6 +41,17 @@ struct task_struct;
 // Helper ID for bpf_get_current_task_btf (introduced in Linux 5.11).
 #define BPF_FUNC_get_current_task_btf 158
 #endif
+#ifndef BPF_FUNC_task_storage_get
+// Helper IDs for bpf_task_storage_{get,delete} (introduced in Linux 5.11).
+#define BPF_FUNC_task_storage_get 156
+#define BPF_FUNC_task_storage_delete 157
+#endif
+#ifndef BPF_MAP_TYPE_TASK_STORAGE
+#define BPF_MAP_TYPE_TASK_STORAGE 29
+#endif
+#ifndef BPF_LOCAL_STORAGE_GET_F_CREATE
+#define BPF_LOCAL_STORAGE_GET_F_CREATE 1
+#endif
 
 /*
  * bpf helpers
@@ -87,9 +98,21 @@ static long
     (void *)16;
 static __u64 __attribute__ ((__unused__)) (*bpf_get_current_task) (void) =
     (void *)35;
+static __u64 __attribute__ ((__unused__)) (*bpf_get_current_cgroup_id) (void) =
+    (void *)80;
 static struct task_struct
     __attribute__ ((__unused__)) * (*bpf_get_current_task_btf) (void) =
     (void *)BPF_FUNC_get_current_task_btf;
+static void
+    __attribute__ ((__unused__)) * (*bpf_task_storage_get) (void *map,
+							    struct task_struct *task,
+							    void *value,
+							    __u64 flags) =
+    (void *)BPF_FUNC_task_storage_get;
+static long
+    __attribute__ ((__unused__)) (*bpf_task_storage_delete) (void *map,
+							     struct task_struct *task) =
+    (void *)BPF_FUNC_task_storage_delete;
 static struct pt_regs
     __attribute__ ((__unused__)) * (*bpf_task_pt_regs) (struct task_struct *task) =
     (void *)BPF_FUNC_task_pt_regs;
@@ -474,6 +497,26 @@ static_always_inline __attribute__((unused)) int name ## __delete(key_type *key)
     return bpf_map_delete_elem(& __##name, (const void *)key); \
 }
 
+// BPF_MAP_TYPE_PERCPU_HASH define
+#define MAP_PERHASH(name, key_type, value_type, max_entries, feat) \
+struct bpf_map_def SEC("maps") __##name = \
+{   \
+    .type = BPF_MAP_TYPE_PERCPU_HASH, \
+    __BPF_MAP_DEF(key_type, value_type, max_entries, feat), \
+}; \
+static_always_inline __attribute__((unused)) value_type * name ## __lookup(key_type *key) \
+{ \
+    return (value_type *) bpf_map_lookup_elem(& __##name, (const void *)key); \
+} \
+static_always_inline __attribute__((unused)) int name ## __update(key_type *key, value_type *value) \
+{ \
+    return bpf_map_update_elem(& __##name, (const void *)key, (const void *)value, BPF_ANY); \
+} \
+static_always_inline __attribute__((unused)) int name ## __delete(key_type *key) \
+{ \
+    return bpf_map_delete_elem(& __##name, (const void *)key); \
+}
+
 #define MAP_PERF_EVENT(name, key_type, value_type, max_entries, feat) \
 struct bpf_map_def SEC("maps") __ ## name = \
 {   \
@@ -516,6 +559,26 @@ static_always_inline __attribute__((unused)) int name ## __delete(key_type *key)
     return bpf_map_delete_elem(& __##name, (const void *)key); \
 }
 
+/*
+ * Task local storage of the current task, the value is freed along with
+ * the task. The map has no max_entries, the loader creates it with the
+ * BTF it requires.
+ */
+#define MAP_TASK_STORAGE(name, value_type, feat) \
+struct bpf_map_def SEC("maps") __##name = \
+{   \
+    .type = BPF_MAP_TYPE_TASK_STORAGE, \
+    __BPF_MAP_DEF(int, value_type, 0, feat), \
+}; \
+static_always_inline __attribute__((unused)) value_type * name ## __get(__u64 flags) \
+{ \
+    return (value_type *) bpf_task_storage_get(& __##name, bpf_get_current_task_btf(), NULL, flags); \
+} \
+static_always_inline __attribute__((unused)) int name ## __delete(void) \
+{ \
+    return bpf_task_storage_delete(& __##name, bpf_get_current_task_btf()); \
+}
+
 #define BPF_HASH3(_name, _key_type, _leaf_type) \
   MAP_HASH(_name, _key_type, _leaf_type, MAP_MAX_ENTRIES_DEF, 0)
 
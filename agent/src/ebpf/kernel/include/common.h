@@ -55,7 +55,9 @@ enum message_type {
 	// Indicates a socket close event
 	MSG_CLOSE,
 	// 用于信息相关清理，一般用于socket信息清除
-	MSG_CLEAR
+	MSG_CLEAR,
+	// Metadata only message, pushed without the payload
+	MSG_METADATA_ONLY
 };
 
 // 数据流方向
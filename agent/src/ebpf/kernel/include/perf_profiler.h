@@ -59,6 +59,8 @@ typedef enum {
 				   0: disable sampling; 1: enable sampling. */
 	MINBLOCK_TIME_IDX,	/* The minimum blocking time, applied in the profiler extension.*/
 	RT_KERN,                /* Indicates whether it is a real-time kernel.*/
+	SAMPLE_SHIFT_IDX,	/* Keep one in 2^n on-CPU samples, 0 keeps all.
+				   Set by the memory governor. */
 	PROFILER_CNT
 } profiler_idx;
 
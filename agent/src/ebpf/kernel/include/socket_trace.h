@@ -439,6 +439,19 @@ struct syscall_comm_exit_ctx {
 #endif
 };
 
+/*
+ * cgroup v2 ID of the current task, the user space looks up the container
+ * ID by it. 0 if the helper is not available (Linux < 4.18).
+ */
+static __inline __u64 get_current_cgroup_id(void)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	return bpf_get_current_cgroup_id();
+#else
+	return 0;
+#endif
+}
+
 static __inline __u64 gen_conn_key_id(__u64 param_1, __u64 param_2)
 {
 	/*
@@ -51,11 +51,59 @@ struct __tuple_t {
 	__u16 num;
 };
 
+/*
+ * HTTP/1.x header index (see set_http1_header_extract()).
+ *
+ * HTTP1_HDR_NAMES_MAX: header names indexed at most.
+ * HTTP1_HDR_SCAN_MAX: data bytes scanned, a power of 2.
+ * The header names are matched by the FNV-1a hash of their lowercase form.
+ */
+#define HTTP1_HDR_NAMES_MAX	4
+#define HTTP1_HDR_SCAN_MAX	1024
+#define HTTP1_HDR_HASH_INIT	2166136261U
+#define HTTP1_HDR_HASH_PRIME	16777619U
+
+struct l7_field {
+	__u16 off;		// Offset from the start of the data
+	__u16 len;		// 0 if not found
+} __attribute__ ((packed));
+
+struct http1_hdr_index {
+	// Header block length including the empty line, 0 if not in the scanned bytes.
+	__u16 hdr_len;
+	// Request or status line, without the line end.
+	struct l7_field start_line;
+	// Values of the configured headers, in the configuration order.
+	struct l7_field headers[HTTP1_HDR_NAMES_MAX];
+} __attribute__ ((packed));
+
+// State of the HTTP/1.x header scan, kept in the per-CPU tracer_ctx.
+struct http1_hdr_scan {
+	__u32 hash;		// FNV-1a hash of the header name being read
+	__u32 line_start;
+	__u32 value_start;
+	__u32 line_no;
+	__s32 field;		// Index of the header in the names, -1 if not indexed
+	__u32 in_name;		// Reading the header name
+	struct http1_hdr_index idx;
+};
+
+/*
+ * Go HTTP/2 uprobe header payload (DATA_SOURCE_GO_HTTP2_UPROBE):
+ * fd, stream_id, header_len, value_len (__u32 each), then the data.
+ * With HTTP2_HEADERS_PACKED set in header_len, the low 16 bits are the
+ * number of fields and value_len the size of the fields area, each field
+ * being name_len, value_len (__u16 LE), name and value.
+ */
+#define HTTP2_HEADERS_PACKED	0x80000000
+#define HTTP2_PACKED_FIELD_HDR	4
+
 struct __socket_data {
 	/* 进程/线程信息 */
 	__u32 pid;		// 表示线程号 如果'pid == tgid'表示一个进程, 否则是线程
 	__u32 tgid;		// 进程号
 	__u64 coroutine_id;	// CoroutineID, i.e., golang goroutine id
+	__u64 cgroup_id;	// cgroup v2 ID, 0 if unknown
 	__u8 source;		// SYSCALL,GO_TLS_UPROBE,GO_HTTP2_UPROBE
 	__u8 comm[TASK_COMM_LEN];	// 进程或线程名
 
@@ -129,6 +177,7 @@ struct __socket_data {
 	__u16 data_type;	// HTTP, DNS, MySQL ...
 	__u16 data_len;		// 数据长度
 	__u8 socket_role;	// this message is created by: 0:unkonwn 1:client(connect) 2:server(accept)
+	__u8 l7_index_len;	// Bytes of the index (struct http1_hdr_index) following the data
 	char data[BURST_DATA_BUF_SIZE];
 } __attribute__ ((packed));
 
@@ -245,6 +294,24 @@ struct tracer_ctx_s {
 	__u64 last_period_timestamp; /**< Record the timestamp of the last periodic check of the push buffer. */
 	__u64 period_timestamp;	/**< Record the timestamp of the periodic check of the push buffer. */
 	bool disable_tracing;  /**< Disable tracing feature. */
+	bool io_hist_enabled;	/**< Aggregate file IO latency into histograms */
+	__u64 io_event_outlier_duration; /**< With histograms, minimum duration for IO events */
+	__u64 go_lazy_goid_count; /**< Goroutine IDs read from the g pointer */
+	__u64 go_ancestor_truncated_count; /**< Ancestor walks cut by the depth limit */
+	bool trace_task_storage; /**< Thread keyed trace information in the task local storage */
+	__u64 trace_lookup_count; /**< Trace information lookups, one per traced event */
+	__u64 trace_map_ops;	/**< Lookups, updates and deletes on trace_map */
+	__u64 trace_task_ops;	/**< Gets and deletes on the task local storage */
+	__u64 args_hash_ops_avoided; /**< Syscall arguments map updates and deletes avoided */
+	bool socket_key_sk;	/**< socket_info_map keyed by the sk pointer */
+	__u64 sk_free_reclaim_count; /**< socket_info_map entries freed along with their socket */
+	__u64 metadata_only_count; /**< Socket data pushed without the payload (metadata only ports) */
+	bool http1_hdr_extract;	/**< Index the HTTP/1.x start line and headers */
+	bool http1_hdr_only;	/**< With the index, push the HTTP/1.x header block only */
+	__u32 http1_hdr_hash[HTTP1_HDR_NAMES_MAX]; /**< Hashes of the header names to index, 0 if unused */
+	__u64 http1_hdr_index_count; /**< HTTP/1.x data pushed with the index */
+	struct http1_hdr_scan http1_scan; /**< HTTP/1.x header scan state, see http1_hdr_index_build() */
+	__u64 io_hist_overflow_count; /**< File IO not counted, io_hist_map full */
 	struct socket_info_s sk_info; /**< Prevent stack overflow; this option is used as an alternative to stack allocation. */
 };
 
@@ -297,6 +364,37 @@ struct __io_event_buffer {
 	char filename[FILE_PATH_SZ];
 } __attribute__ ((packed));
 
+/*
+ * File IO latency histograms, aggregated in kernel per (process, mount,
+ * directory, operation) and drained periodically by user space. Slot i
+ * counts the latencies in [2^i, 2^(i+1)) microseconds, the last slot
+ * everything above.
+ */
+#define IO_HIST_SLOTS 24
+#define IO_HIST_ENTRIES_MAX 1024
+#define IO_HIST_DIR_NAME_SZ 64
+
+struct io_hist_key {
+	__u32 tgid;
+	int mnt_id;
+	__u32 mntns_id;
+	__u32 operation;	// 0: write, 1: read
+	__u64 dir_id;		// address of the parent dentry
+} __attribute__ ((packed));
+
+struct io_hist_value {
+	__u32 slots[IO_HIST_SLOTS];
+	__u32 count;
+	// Per-CPU values are copied at an 8-byte stride, keep the size aligned.
+	__u32 pad;
+	__u64 bytes;
+	__u64 latency_sum;	// nanosecond
+} __attribute__ ((packed));
+
+struct io_hist_dir {
+	char name[IO_HIST_DIR_NAME_SZ];
+};
+
 struct user_io_event_buffer {
 	__u32 bytes_count;
 
@@ -356,6 +454,9 @@ struct ebpf_proc_info {
 	__u64 net_TCPConn_itab;
 	__u64 crypto_tls_Conn_itab;	// TLS_HTTP1,TLS_HTTP2
 	__u64 credentials_syscallConn_itab;	// gRPC
+	// Offset of the current g pointer from the thread pointer, used when
+	// the goroutine ID is read lazily instead of by runtime.execute.
+	__s32 g_tls_offset;
 };
 
 enum {
@@ -404,7 +505,8 @@ struct member_fields_offset {
 	__u8 enable_unix_socket:1;		// Enable flag for Unix socket tracing
 	__u8 files_infer_done:1;		// 0: file-related structure offset inference not completed
 						// 1: file-related structure offset inference completed
-	__u8 reserved:5;
+	__u8 go_lazy_goid:1;			// Read the goroutine ID from the g pointer when needed
+	__u8 reserved:4;
 	__u16 struct_dentry_d_parent_offset;    // offsetof(struct dentry, d_parent)
 	__u32 task__files_offset;
 	__u32 sock__flags_offset;
@@ -442,6 +544,8 @@ struct member_fields_offset {
 	__u16 struct_mnt_namespace_ns_offset; // offsetof(struct mnt_namespace, ns)
 	__u16 struct_ns_common_inum_offset;   // offsetof(struct mnt_common, inum)
 	__u16 struct_mount_mnt_id_offset;     // offsetof(struct mount, mnt_id)
+
+	__u32 task__tpbase_offset;	      // offsetof(struct task_struct, thread.fsbase)
 };
 
 typedef struct member_fields_offset bpf_offset_param_t;
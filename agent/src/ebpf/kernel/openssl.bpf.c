@@ -171,7 +171,7 @@ UPROG(openssl_write_exit) (struct pt_regs *ctx)
 	};
 
 	ssl_ctx_map__delete(&id);
-	active_write_args_map__update(&id, &write_args);
+	active_args_update(ACTIVE_ARGS_WRITE, &id, &write_args);
 	if (!process_data((struct pt_regs *)ctx, id, T_EGRESS, &write_args,
 			  size, &extra)) {
 #if !defined(LINUX_VER_KFUNC) && !defined(LINUX_VER_5_2_PLUS)
@@ -179,7 +179,7 @@ UPROG(openssl_write_exit) (struct pt_regs *ctx)
 			      PROG_DATA_SUBMIT_KP_IDX);
 #endif
 	}
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return 0;
 }
 
@@ -228,7 +228,7 @@ UPROG(openssl_read_exit) (struct pt_regs *ctx)
 	};
 
 	ssl_ctx_map__delete(&id);
-	active_read_args_map__update(&id, &read_args);
+	active_args_update(ACTIVE_ARGS_READ, &id, &read_args);
 	if (!process_data((struct pt_regs *)ctx, id, T_INGRESS, &read_args,
 			  size, &extra)) {
 #if !defined(LINUX_VER_KFUNC) && !defined(LINUX_VER_5_2_PLUS)
@@ -236,6 +236,6 @@ UPROG(openssl_read_exit) (struct pt_regs *ctx)
 			      PROG_DATA_SUBMIT_KP_IDX);
 #endif
 	}
-	active_read_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
 	return 0;
 }
@@ -703,6 +703,14 @@ PERF_EVENT_PROG(oncpu_profile) (struct bpf_perf_event_data * ctx) {
 		return 0;
 	}
 
+	count_idx = SAMPLE_SHIFT_IDX;
+	__u64 *shift_ptr = profiler_state_map__lookup(&count_idx);
+	if (shift_ptr != NULL && *shift_ptr > 0) {
+		__u32 shift = *shift_ptr & 0x7;
+		if (bpf_get_prandom_u32() & ((1U << shift) - 1))
+			return 0;
+	}
+
 #ifdef LINUX_VER_5_2_PLUS
 	__u32 zero = 0;
 	unwind_state_t *state = heap__lookup(&zero);
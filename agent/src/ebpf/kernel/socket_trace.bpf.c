@@ -114,8 +114,8 @@ MAP_ARRAY(protocol_filter, int, int, PROTO_NUM, FEATURE_FLAG_SOCKET_TRACER)
  */
 MAP_ARRAY(allow_reasm_protos_map, int, bool, PROTO_NUM, FEATURE_FLAG_SOCKET_TRACER)
 
-// 0: allow bitmap; 1: bypass bitmap
-MAP_ARRAY(kprobe_port_bitmap, __u32, struct kprobe_port_bitmap, 2, FEATURE_FLAG_SOCKET_TRACER)
+// 0: allow bitmap; 1: bypass bitmap; 2: metadata only bitmap
+MAP_ARRAY(kprobe_port_bitmap, __u32, struct kprobe_port_bitmap, 3, FEATURE_FLAG_SOCKET_TRACER)
 
 /*
  * l7-protocol-ports
@@ -134,18 +134,42 @@ BPF_HASH(active_write_args_map, __u64, struct data_args_t, MAP_MAX_ENTRIES_DEF,
 BPF_HASH(active_read_args_map, __u64, struct data_args_t, MAP_MAX_ENTRIES_DEF, FEATURE_FLAG_SOCKET_TRACER)
 
 // socket_info_map, 这是个hash表，用于记录socket信息，
-// Key is {pid + fd}. value is struct socket_info_s
+// Key is {pid + fd}, or the sk pointer (see socket_info_key()).
+// value is struct socket_info_s
 BPF_HASH(socket_info_map, __u64, struct socket_info_s, MAP_MAX_ENTRIES_DEF, FEATURE_FLAG_SOCKET_TRACER)
 
 // socket_info lifecycle is inconsistent with socket. If the role information
 // is saved to the socket_info_map, it will affect the generation of syscall
 // trace id. Create an independent map to save role information
-// Key is {pid + fd}. value is role type
+// Key is the socket_info_map key. value is role type
 BPF_HASH(socket_role_map, __u64, __u32, MAP_MAX_ENTRIES_DEF, FEATURE_FLAG_SOCKET_TRACER);
 
 // Key is struct trace_key_t. value is trace_info_t
 BPF_HASH(trace_map, struct trace_key_t, struct trace_info_t, MAP_MAX_ENTRIES_DEF, FEATURE_FLAG_SOCKET_TRACER)
 
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+/*
+ * Thread keyed trace information, used instead of trace_map when the
+ * kernel supports task local storage in tracing programs (tracer_ctx
+ * 'trace_task_storage'). No hash bucket lock is taken on the syscall
+ * path and the entry is freed along with the thread. Otherwise the
+ * loader turns the helper calls into 'r0 = 0'.
+ */
+MAP_TASK_STORAGE(trace_task_map, struct trace_info_t, FEATURE_FLAG_SOCKET_TRACER)
+
+/*
+ * active_{write,read}_args_map in the task local storage, indexed by
+ * ACTIVE_ARGS_{WRITE,READ}. The entries stay with the thread, 'active'
+ * tells whether the arguments are stashed.
+ */
+struct active_args_s {
+	struct data_args_t args[2];
+	__u8 active[2];
+};
+
+MAP_TASK_STORAGE(active_args_task_map, struct active_args_s, FEATURE_FLAG_SOCKET_TRACER)
+#endif
+
 // Stores the identity used to fit the kernel, key: 0, vlaue: struct adapt_kern_data
 MAP_ARRAY(adapt_kern_data_map, __u32, struct adapt_kern_data, 1, FEATURE_FLAG_SOCKET_TRACER)
 
@@ -163,6 +187,21 @@ MAP_ARRAY(proto_infer_cache_map, __u32, struct proto_infer_cache_t, PROTO_INFER_
 #endif
 // Store IO event information
 MAP_PERARRAY(io_event_buffer, __u32, struct __io_event_buffer, 1, FEATURE_FLAG_SOCKET_TRACER)
+// File IO latency histograms, see struct io_hist_key. The two maps are
+// written in turn, user space drains the one io_hist_ctl does not select.
+MAP_PERHASH(io_hist_map_0, struct io_hist_key, struct io_hist_value, IO_HIST_ENTRIES_MAX, FEATURE_FLAG_SOCKET_TRACER)
+MAP_PERHASH(io_hist_map_1, struct io_hist_key, struct io_hist_value, IO_HIST_ENTRIES_MAX, FEATURE_FLAG_SOCKET_TRACER)
+// Index of the io_hist_map written by the kernel, set by user space.
+MAP_ARRAY(io_hist_ctl, __u32, __u32, 1, FEATURE_FLAG_SOCKET_TRACER)
+// Never written, the initial value of new io_hist_map entries.
+MAP_PERARRAY(io_hist_zero, __u32, struct io_hist_value, 1, FEATURE_FLAG_SOCKET_TRACER)
+// key: struct io_hist_key.dir_id, value: name of the directory, written
+// when a histogram is created.
+struct bpf_map_def SEC("maps") __io_hist_dir_map = {
+	.type = BPF_MAP_TYPE_LRU_HASH,
+	__BPF_MAP_DEF(__u64, struct io_hist_dir, 2 * IO_HIST_ENTRIES_MAX,
+		      FEATURE_FLAG_SOCKET_TRACER),
+};
 /* *INDENT-ON* */
 
 static __inline bool is_protocol_enabled(int protocol)
@@ -200,6 +239,31 @@ static __inline bool is_socket_info_valid(struct socket_info_s *sk_info)
 	return (sk_info != NULL && sk_info->uid != 0);
 }
 
+/*
+ * The sockets on the metadata only ports (kprobe_port_bitmap[2]) push
+ * their first METADATA_ONLY_PAYLOAD_MSGS messages (the inferred request
+ * and response) as usual, then only the fixed size part of struct
+ * __socket_data (tuple, direction, syscall_len, seqs, timestamps, trace
+ * id) as MSG_METADATA_ONLY, packed back to back in the push buffer;
+ * the agent keeps only their timing. 'seq' is the data sequence number
+ * of the message in its socket. Linux 5.2+ builds only, for the
+ * instruction count of the older ones.
+ */
+static __inline bool is_metadata_only(struct conn_info_s *conn_info,
+				      __u64 seq)
+{
+	if (seq < METADATA_ONLY_PAYLOAD_MSGS)
+		return false;
+
+	__u32 k2 = 2;
+	struct kprobe_port_bitmap *meta = kprobe_port_bitmap__lookup(&k2);
+	if (meta == NULL)
+		return false;
+
+	return is_set_bitmap(meta->bitmap, conn_info->tuple.dport) ||
+	    is_set_bitmap(meta->bitmap, conn_info->tuple.num);
+}
+
 
 static __inline void extract_network_address_info(struct data_args_t *args, void *ptr)
 {
@@ -219,6 +283,62 @@ static __inline void extract_network_address_info(struct data_args_t *args, void
 	}
 }
 
+/*
+ * Key of socket_info_map and socket_role_map. With tracer_ctx
+ * 'socket_key_sk' (Linux 5.2+ builds only) the sk pointer is used, so
+ * the dup()ed and inherited fds share the socket state and the entry is
+ * freed along with the socket (security_sk_free()). 'sk' is looked up
+ * from the fd if not given, and {tgid + fd} is used if there is none,
+ * the two can't collide (kernel addresses vs. tgid < 2^22).
+ */
+static __inline bool socket_key_by_sk(void)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	__u32 k0 = 0;
+	struct tracer_ctx_s *tracer_ctx = tracer_ctx_map__lookup(&k0);
+	return tracer_ctx != NULL && tracer_ctx->socket_key_sk;
+#else
+	return false;
+#endif
+}
+
+static __inline __u64 socket_info_key(__u64 tgid, __u64 fd, void *sk)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	if (socket_key_by_sk()) {
+		if (sk == NULL) {
+#ifdef LINUX_VER_KFUNC
+			sk = get_socket_from_fd((int)fd, NULL);
+#else
+			__u32 k0 = 0;
+			struct member_fields_offset *offset =
+			    members_offset__lookup(&k0);
+			if (offset)
+				sk = get_socket_from_fd((int)fd, offset);
+#endif
+		}
+		if (sk != NULL)
+			return (__u64) sk;
+	}
+#endif
+	return gen_conn_key_id(tgid, fd);
+}
+
+/*
+ * socket_info of the fd on the syscall entry, only used for the sk
+ * saved by the kfunc programs. Keyed by the sk, the lookup would need
+ * the fd walk it is meant to save, skip it.
+ */
+static __inline struct socket_info_s *enter_socket_info_lookup(__u64 id,
+								int fd)
+{
+	if (socket_key_by_sk())
+		return NULL;
+
+	__u64 conn_key = gen_conn_key_id(id >> 32, (__u64) fd);
+	return socket_info_map__lookup(&conn_key);
+}
+
 /* *INDENT-OFF* */
 static __u32 __inline get_tcp_write_seq_from_fd(int fd, void **sk,
 						struct socket_info_s *socket_info_ptr)
@@ -236,9 +356,9 @@ static __u32 __inline get_tcp_write_seq_from_fd(int fd, void **sk,
 		sock = socket_info_ptr->sk;
 	else
 		sock = get_socket_from_fd(fd, NULL);
+#endif
 	if (sk)
 		*sk = sock;
-#endif
 	if (sock == NULL)
 		return 0;
 
@@ -270,9 +390,9 @@ static __u32 __inline get_tcp_read_seq_from_fd(int fd, void **sk,
 		sock = socket_info_ptr->sk;
 	else
 		sock = get_socket_from_fd(fd, NULL);
+#endif
 	if (sk)
 		*sk = sock;
-#endif
 	if (sock == NULL)
 		return 0;
 
@@ -298,8 +418,9 @@ static bool __inline check_socket_valid(struct socket_info_s *socket_info_ptr, i
 				      socket_info_ptr->sk + sk_off);
 		if (unlikely(check_socket != socket_info_ptr->socket)) {
 			__u32 tgid = (__u32) (bpf_get_current_pid_tgid() >> 32);
-			__u64 conn_key = gen_conn_key_id((__u64) tgid,
-							 (__u64) fd);
+			__u64 conn_key = socket_info_key((__u64) tgid,
+							 (__u64) fd,
+							 socket_info_ptr->sk);
 			delete_socket_info(conn_key, socket_info_ptr);
 			return false;
 		}
@@ -486,6 +607,169 @@ static __inline struct trace_key_t get_trace_key(__u64 timeout,
 	return key;
 }
 
+/*
+ * Access to the trace information: the goroutine keyed one is always in
+ * trace_map, the thread keyed one in trace_task_map if enabled. The map
+ * operations are counted per CPU on the Linux 5.2+ builds only, to keep
+ * the instruction count of the older ones.
+ */
+static __inline bool trace_key_in_task(struct tracer_ctx_s *tracer_ctx,
+				       struct trace_key_t *key)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	return tracer_ctx->trace_task_storage && key->goid == 0;
+#else
+	return false;
+#endif
+}
+
+static __inline struct trace_info_t *trace_info_lookup(struct tracer_ctx_s
+						       *tracer_ctx,
+						       struct trace_key_t *key)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	tracer_ctx->trace_lookup_count++;
+	if (trace_key_in_task(tracer_ctx, key)) {
+		tracer_ctx->trace_task_ops++;
+		return trace_task_map__get(0);
+	}
+	tracer_ctx->trace_map_ops++;
+#endif
+	return trace_map__lookup(key);
+}
+
+static __inline int trace_info_update(struct tracer_ctx_s *tracer_ctx,
+				      struct trace_key_t *key,
+				      struct trace_info_t *info)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	if (trace_key_in_task(tracer_ctx, key)) {
+		tracer_ctx->trace_task_ops++;
+		struct trace_info_t *task_info =
+		    trace_task_map__get(BPF_LOCAL_STORAGE_GET_F_CREATE);
+		if (task_info == NULL)
+			return -1;
+		*task_info = *info;
+		return 0;
+	}
+	tracer_ctx->trace_map_ops++;
+#endif
+	return trace_map__update(key, info);
+}
+
+static __inline int trace_info_delete(struct tracer_ctx_s *tracer_ctx,
+				      struct trace_key_t *key)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	if (trace_key_in_task(tracer_ctx, key)) {
+		tracer_ctx->trace_task_ops++;
+		return trace_task_map__delete();
+	}
+	tracer_ctx->trace_map_ops++;
+#endif
+	return trace_map__delete(key);
+}
+
+#define ACTIVE_ARGS_WRITE 0
+#define ACTIVE_ARGS_READ  1
+
+/*
+ * Access to the stashed syscall (or SSL/Go TLS call) arguments of the
+ * current thread. The task local storage is used if available, it is
+ * created by the first stash of the thread. The hash map updates and
+ * deletes avoided this way are counted on the Linux 5.2+ builds.
+ */
+static __inline void count_args_hash_ops_avoided(void)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	__u32 k0 = 0;
+	struct tracer_ctx_s *tracer_ctx = tracer_ctx_map__lookup(&k0);
+	if (tracer_ctx)
+		tracer_ctx->args_hash_ops_avoided++;
+#endif
+}
+
+static __inline struct data_args_t *active_args_lookup(int idx, __u64 * id)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	struct active_args_s *a = active_args_task_map__get(0);
+	if (a)
+		return a->active[idx] ? &a->args[idx] : NULL;
+#endif
+	if (idx == ACTIVE_ARGS_READ)
+		return active_read_args_map__lookup(id);
+	return active_write_args_map__lookup(id);
+}
+
+static __inline void active_args_update(int idx, __u64 * id,
+					struct data_args_t *args)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	struct active_args_s *a =
+	    active_args_task_map__get(BPF_LOCAL_STORAGE_GET_F_CREATE);
+	if (a) {
+		a->args[idx] = *args;
+		a->active[idx] = 1;
+		count_args_hash_ops_avoided();
+		return;
+	}
+#endif
+	if (idx == ACTIVE_ARGS_READ)
+		active_read_args_map__update(id, args);
+	else
+		active_write_args_map__update(id, args);
+}
+
+static __inline void active_args_delete(int idx, __u64 * id)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	struct active_args_s *a = active_args_task_map__get(0);
+	if (a) {
+		a->active[idx] = 0;
+		count_args_hash_ops_avoided();
+		return;
+	}
+
+	// Nothing stashed is common, the lookup takes no bucket lock.
+	if (active_args_lookup(idx, id) == NULL) {
+		count_args_hash_ops_avoided();
+		return;
+	}
+#endif
+	if (idx == ACTIVE_ARGS_READ)
+		active_read_args_map__delete(id);
+	else
+		active_write_args_map__delete(id);
+}
+
+/*
+ * Stash the arguments at a syscall entry. The ones of a non-socket fd
+ * only matter to the IO events, they are not stashed if those are not
+ * collected. Arguments left over (e.g. by an SSL uprobe) are dropped,
+ * as the stash would have replaced them.
+ */
+static __inline void stash_syscall_args(int idx, __u64 * id,
+					struct data_args_t *args)
+{
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	if (args->sk == NULL) {
+		__u32 k0 = 0;
+		struct member_fields_offset *offset =
+		    members_offset__lookup(&k0);
+		struct tracer_ctx_s *tracer_ctx = tracer_ctx_map__lookup(&k0);
+		// Until the offsets are ready sockets are not recognized.
+		if (offset && offset->ready && tracer_ctx &&
+		    tracer_ctx->io_event_collect_mode == 0) {
+			tracer_ctx->args_hash_ops_avoided++;
+			if (active_args_lookup(idx, id))
+				active_args_delete(idx, id);
+			return;
+		}
+	}
+#endif
+	active_args_update(idx, id, args);
+}
+
 static __inline unsigned int __retry_get_sock_flags(void *sk, int offset)
 {
 	unsigned int flags = 0;
@@ -674,7 +958,8 @@ static __inline void init_conn_info(__u32 tgid, __u32 fd,
 	conn_info->correlation_id = -1;	// Currently used for Kafka and OpenWire protocol inference
 	conn_info->fd = fd;
 	conn_info->sk = sk;
-	__u64 conn_key = gen_conn_key_id((__u64) tgid, (__u64) conn_info->fd);
+	__u64 conn_key = socket_info_key((__u64) tgid, (__u64) conn_info->fd,
+					 sk);
 	conn_info->socket_info_ptr = socket_info_map__lookup(&conn_key);
 	if (is_socket_info_valid(conn_info->socket_info_ptr)) {
 		conn_info->no_trace = conn_info->socket_info_ptr->no_trace;
@@ -1271,8 +1556,10 @@ static __inline void trace_process(struct socket_info_s *socket_info_ptr,
 		}
 		trace_info.update_time = time_stamp / NS_PER_SEC;
 		trace_info.socket_id = socket_id;
-		ret = trace_map__update(trace_key, &trace_info);
-		if (!trace_info_ptr) {
+		ret = trace_info_update(tracer_ctx, trace_key, &trace_info);
+		// Only trace_map entries are counted and reclaimed.
+		if (!trace_info_ptr &&
+		    !trace_key_in_task(tracer_ctx, trace_key)) {
 			if (ret == 0) {
 				__sync_fetch_and_add
 				    (&trace_stats->trace_map_count, 1);
@@ -1302,7 +1589,8 @@ static __inline void trace_process(struct socket_info_s *socket_info_ptr,
 			if (conn_info->keep_trace)
 				return;
 
-			if (!trace_map__delete(trace_key)) {
+			if (!trace_info_delete(tracer_ctx, trace_key) &&
+			    !trace_key_in_task(tracer_ctx, trace_key)) {
 				__sync_fetch_and_add
 				    (&trace_stats->trace_map_count, -1);
 			}
@@ -1339,7 +1627,8 @@ __data_submit(struct pt_regs *ctx, struct conn_info_s *conn_info,
 		return SUBMIT_INVALID;
 
 	__u32 tgid = (__u32) (bpf_get_current_pid_tgid() >> 32);
-	__u64 conn_key = gen_conn_key_id((__u64) tgid, (__u64) conn_info->fd);
+	__u64 conn_key = socket_info_key((__u64) tgid, (__u64) conn_info->fd,
+					 conn_info->sk);
 	if (conn_info->message_type == MSG_CLEAR) {
 		delete_socket_info(conn_key, conn_info->socket_info_ptr);
 		return SUBMIT_INVALID;
@@ -1374,13 +1663,14 @@ __data_submit(struct pt_regs *ctx, struct conn_info_s *conn_info,
 	struct trace_info_t *trace_info_ptr = NULL;
 	if (!conn_info->no_trace) {
 		trace_key = get_trace_key(tracer_ctx->go_tracing_timeout, true);
-		trace_info_ptr = trace_map__lookup(&trace_key);
+		trace_info_ptr = trace_info_lookup(tracer_ctx, &trace_key);
 	}
 #else
 	struct trace_key_t trace_key =
 	    get_trace_key(tracer_ctx->go_tracing_timeout,
 			  true);
-	struct trace_info_t *trace_info_ptr = trace_map__lookup(&trace_key);
+	struct trace_info_t *trace_info_ptr =
+	    trace_info_lookup(tracer_ctx, &trace_key);
 #endif
 	struct socket_info_s *socket_info_ptr = conn_info->socket_info_ptr;
 	// 'socket_id' used to resolve non-tracing between the same socket
@@ -1554,9 +1844,10 @@ __data_submit(struct pt_regs *ctx, struct conn_info_s *conn_info,
 		 */
 		if (socket_info_ptr->peer_fd != 0
 		    && conn_info->direction == T_INGRESS) {
-			__u64 peer_conn_key = gen_conn_key_id((__u64) tgid,
+			__u64 peer_conn_key = socket_info_key((__u64) tgid,
 							      (__u64)
-							      socket_info_ptr->peer_fd);
+							      socket_info_ptr->peer_fd,
+							      NULL);
 			/*
 			 * Query the socket information of the NGINX frontend and modify the
 			 * traceID of the data returned by the frontend.
@@ -1631,6 +1922,7 @@ __data_submit(struct pt_regs *ctx, struct conn_info_s *conn_info,
 	v->socket_id = sk_info->uid;
 	v->data_seq = sk_info->seq;
 	v->tgid = tgid;
+	v->cgroup_id = get_current_cgroup_id();
 	v->is_tls = false;
 	v->pid = (__u32) bpf_get_current_pid_tgid();
 	v->fd = args->fd; 
@@ -1654,6 +1946,16 @@ __data_submit(struct pt_regs *ctx, struct conn_info_s *conn_info,
 		else
 			send_reasm_bytes = 0;
 	}
+
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+	// 'data_max_sz' 0 tells the output to skip the payload.
+	if (is_metadata_only(conn_info, sk_info->seq)) {
+		data_max_sz = 0;
+		send_reasm_bytes = 0;
+		v->msg_type = MSG_METADATA_ONLY;
+		tracer_ctx->metadata_only_count++;
+	}
+#endif
 	v->tcp_seq = 0;
 
 	if ((extra->source == DATA_SOURCE_GO_TLS_UPROBE ||
@@ -1708,8 +2010,7 @@ __data_submit(struct pt_regs *ctx, struct conn_info_s *conn_info,
 
 	return __output_data_common(ctx, tracer_ctx, v_buff, args,
 				    conn_info->direction, (bool) vecs,
-				    tracer_ctx->data_limit_max, false,
-				    send_reasm_bytes);
+				    data_max_sz, false, send_reasm_bytes);
 #else
 	struct tail_calls_context *context =
 	    (struct tail_calls_context *)v->data;
@@ -2010,12 +2311,11 @@ static __inline int do_sys_enter_write(int fd, const char *buf)
 	write_args.fd = fd;
 	write_args.buf = buf;
 	write_args.enter_ts = bpf_ktime_get_ns();
-	__u64 conn_key = gen_conn_key_id((__u64) (id >> 32), (__u64) fd);
 	struct socket_info_s *socket_info_ptr =
-	    socket_info_map__lookup(&conn_key);
+	    enter_socket_info_lookup(id, fd);
 	write_args.tcp_seq =
 	    get_tcp_write_seq(fd, &write_args.sk, socket_info_ptr);
-	active_write_args_map__update(&id, &write_args);
+	stash_syscall_args(ACTIVE_ARGS_WRITE, &id, &write_args);
 	return 0;
 }
 
@@ -2050,14 +2350,14 @@ static __inline int do_sys_exit_write(void *ctx, ssize_t bytes_count)
 {
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *write_args = active_write_args_map__lookup(&id);
+	struct data_args_t *write_args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 	if (write_args != NULL) {
 		write_args->bytes_count = bytes_count;
 		process_syscall_data((struct pt_regs *)ctx, id, T_EGRESS,
 				     write_args, bytes_count);
 	}
 
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return 0;
 }
 
@@ -2096,12 +2396,11 @@ static __inline int do_sys_enter_read(int fd, const char *buf)
 	read_args.fd = fd;
 	read_args.buf = buf;
 	read_args.enter_ts = bpf_ktime_get_ns();
-	__u64 conn_key = gen_conn_key_id((__u64) (id >> 32), (__u64) fd);
 	struct socket_info_s *socket_info_ptr =
-	    socket_info_map__lookup(&conn_key);
+	    enter_socket_info_lookup(id, fd);
 	read_args.tcp_seq =
 	    get_tcp_read_seq(fd, &read_args.sk, socket_info_ptr);
-	active_read_args_map__update(&id, &read_args);
+	stash_syscall_args(ACTIVE_ARGS_READ, &id, &read_args);
 	return 0;
 }
 
@@ -2137,14 +2436,14 @@ static __inline int do_sys_exit_read(void *ctx, ssize_t bytes_count)
 {
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *read_args = active_read_args_map__lookup(&id);
+	struct data_args_t *read_args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	if (read_args != NULL) {
 		read_args->bytes_count = bytes_count;
 		process_syscall_data((struct pt_regs *)ctx, id, T_INGRESS,
 				     read_args, bytes_count);
 	}
 
-	active_read_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
 	return 0;
 }
 
@@ -2210,9 +2509,8 @@ static __inline int do_sys_enter_sendto(void *ctx, int sockfd, char *buf,
 	write_args.fd = sockfd;
 	write_args.buf = buf;
 	write_args.enter_ts = bpf_ktime_get_ns();
-	__u64 conn_key = gen_conn_key_id((__u64) (id >> 32), (__u64) sockfd);
 	struct socket_info_s *socket_info_ptr =
-	    socket_info_map__lookup(&conn_key);
+	    enter_socket_info_lookup(id, sockfd);
 	write_args.tcp_seq =
 	    get_tcp_write_seq(sockfd, &write_args.sk, socket_info_ptr);
 
@@ -2227,7 +2525,7 @@ static __inline int do_sys_enter_sendto(void *ctx, int sockfd, char *buf,
 	if (ptr)
 		extract_network_address_info(&write_args, ptr);
 
-	active_write_args_map__update(&id, &write_args);
+	stash_syscall_args(ACTIVE_ARGS_WRITE, &id, &write_args);
 	return 0;
 }
 
@@ -2267,12 +2565,12 @@ static __inline int do_sys_exit_sendto(void *ctx, ssize_t bytes_count)
 {
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *write_args = active_write_args_map__lookup(&id);
+	struct data_args_t *write_args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 	if (write_args != NULL) {
 		write_args->bytes_count = bytes_count;
 		process_syscall_data((struct pt_regs *)ctx, id, T_EGRESS,
 				     write_args, bytes_count);
-		active_write_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	}
 	return 0;
 }
@@ -2312,15 +2610,14 @@ static __inline int do_sys_enter_recvfrom(int sockfd, const char *buf, struct so
 	read_args.fd = sockfd;
 	read_args.buf = buf;
 	read_args.enter_ts = bpf_ktime_get_ns();
-	__u64 conn_key = gen_conn_key_id((__u64) (id >> 32), (__u64) sockfd);
 	struct socket_info_s *socket_info_ptr =
-	    socket_info_map__lookup(&conn_key);
+	    enter_socket_info_lookup(id, sockfd);
 	read_args.tcp_seq =
 	    get_tcp_read_seq(sockfd, &read_args.sk, socket_info_ptr);
 	if (u_addr) {
 		read_args.ipaddr_ptr = (void *)u_addr;
 	}
-	active_read_args_map__update(&id, &read_args);
+	stash_syscall_args(ACTIVE_ARGS_READ, &id, &read_args);
 	return 0;
 }
 
@@ -2364,7 +2661,7 @@ TP_SYSCALL_PROG(enter_recvfrom) (struct syscall_comm_enter_ctx *ctx) {
 static __inline int do_sys_exit_recvfrom(void *ctx, ssize_t bytes_count) {
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *read_args = active_read_args_map__lookup(&id);
+	struct data_args_t *read_args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	if (read_args != NULL) {
 		read_args->bytes_count = bytes_count;
 		if (read_args->ipaddr_ptr) {
@@ -2374,7 +2671,7 @@ static __inline int do_sys_exit_recvfrom(void *ctx, ssize_t bytes_count) {
 		}
 		process_syscall_data((struct pt_regs *)ctx, id, T_INGRESS,
 				     read_args, bytes_count);
-		active_read_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_READ, &id);
 	}
 	return 0;
 }
@@ -2425,14 +2722,12 @@ KFUNC_PROG(__sys_sendmsg, int fd, struct user_msghdr __user * msg,
 		write_args.iov = msghdr->msg_iov;
 		write_args.iovlen = msghdr->msg_iovlen;
 		write_args.enter_ts = bpf_ktime_get_ns();
-		__u64 conn_key =
-		    gen_conn_key_id((__u64) (id >> 32), (__u64) sockfd);
 		struct socket_info_s *socket_info_ptr =
-		    socket_info_map__lookup(&conn_key);
+		    enter_socket_info_lookup(id, sockfd);
 		write_args.tcp_seq =
 		    get_tcp_write_seq(sockfd, &write_args.sk, socket_info_ptr);
 		write_args.ipaddr_ptr = (void *)msghdr->msg_name;
-		active_write_args_map__update(&id, &write_args);
+		stash_syscall_args(ACTIVE_ARGS_WRITE, &id, &write_args);
 	}
 
 	return 0;
@@ -2455,7 +2750,7 @@ KRETFUNC_PROG(__sys_sendmsg, int sockfd, const struct msghdr * msg, int flags,
 #endif
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *write_args = active_write_args_map__lookup(&id);
+	struct data_args_t *write_args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 	if (write_args != NULL) {
 		write_args->bytes_count = bytes_count;
 		/*
@@ -2473,7 +2768,7 @@ KRETFUNC_PROG(__sys_sendmsg, int sockfd, const struct msghdr * msg, int flags,
 		}
 		process_syscall_data_vecs((struct pt_regs *)ctx, id, T_EGRESS,
 					  write_args, bytes_count);
-		active_write_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	}
 
 	return 0;
@@ -2508,10 +2803,8 @@ KFUNC_PROG(__sys_sendmmsg, int fd, struct mmsghdr __user * mmsg,
 		write_args.iovlen = msgvec[0].msg_hdr.msg_iovlen;
 		write_args.msg_len = (void *)msgvec_ptr + offsetof(typeof(struct mmsghdr), msg_len);	//&msgvec[0].msg_len;
 		write_args.enter_ts = bpf_ktime_get_ns();
-		__u64 conn_key =
-		    gen_conn_key_id((__u64) (id >> 32), (__u64) sockfd);
 		struct socket_info_s *socket_info_ptr =
-		    socket_info_map__lookup(&conn_key);
+		    enter_socket_info_lookup(id, sockfd);
 		write_args.tcp_seq =
 		    get_tcp_write_seq(sockfd, &write_args.sk, socket_info_ptr);
 		if (vlen >= 2) {
@@ -2526,7 +2819,7 @@ KFUNC_PROG(__sys_sendmmsg, int fd, struct mmsghdr __user * mmsg,
 			write_args.extra_iovlen = msgvec[0].msg_hdr.msg_iovlen;
 		}
 			
-		active_write_args_map__update(&id, &write_args);
+		stash_syscall_args(ACTIVE_ARGS_WRITE, &id, &write_args);
 	}
 
 	return 0;
@@ -2550,7 +2843,7 @@ KRETFUNC_PROG(__sys_sendmmsg, int fd, struct mmsghdr __user * mmsg,
 #endif
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *write_args = active_write_args_map__lookup(&id);
+	struct data_args_t *write_args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 	if (write_args != NULL && num_msgs > 0) {
 		ssize_t bytes_count;
 		bpf_probe_read_user(&bytes_count, sizeof(write_args->msg_len),
@@ -2558,7 +2851,7 @@ KRETFUNC_PROG(__sys_sendmmsg, int fd, struct mmsghdr __user * mmsg,
 		process_syscall_data_vecs((struct pt_regs *)ctx, id, T_EGRESS,
 					  write_args, bytes_count);
 	}
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 
 	return 0;
 }
@@ -2596,14 +2889,12 @@ KFUNC_PROG(__sys_recvmsg, int fd, struct user_msghdr __user * msg,
 		read_args.iov = msghdr->msg_iov;
 		read_args.iovlen = msghdr->msg_iovlen;
 		read_args.enter_ts = bpf_ktime_get_ns();
-		__u64 conn_key =
-		    gen_conn_key_id((__u64) (id >> 32), (__u64) sockfd);
 		struct socket_info_s *socket_info_ptr =
-		    socket_info_map__lookup(&conn_key);
+		    enter_socket_info_lookup(id, sockfd);
 		read_args.tcp_seq =
 		    get_tcp_read_seq(sockfd, &read_args.sk, socket_info_ptr);
 		read_args.ipaddr_ptr = (void *)msghdr->msg_name;
-		active_read_args_map__update(&id, &read_args);
+		stash_syscall_args(ACTIVE_ARGS_READ, &id, &read_args);
 	}
 
 	return 0;
@@ -2626,7 +2917,7 @@ KRETFUNC_PROG(__sys_recvmsg, int fd, struct user_msghdr __user * msg,
 #endif
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *read_args = active_read_args_map__lookup(&id);
+	struct data_args_t *read_args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	if (read_args != NULL) {
 		read_args->bytes_count = bytes_count;
 		// Extract the remote address carried by `recvmsg()`.
@@ -2637,7 +2928,7 @@ KRETFUNC_PROG(__sys_recvmsg, int fd, struct user_msghdr __user * msg,
 		}
 		process_syscall_data_vecs((struct pt_regs *)ctx, id, T_INGRESS,
 					  read_args, bytes_count);
-		active_read_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_READ, &id);
 	}
 
 	return 0;
@@ -2687,13 +2978,11 @@ TP_SYSCALL_PROG(enter_recvmmsg) (struct syscall_comm_enter_ctx * ctx) {
 
 		read_args.msg_len =
 		    (void *)msgvec + offsetof(typeof(struct mmsghdr), msg_len);
-		__u64 conn_key =
-		    gen_conn_key_id((__u64) (id >> 32), (__u64) sockfd);
 		struct socket_info_s *socket_info_ptr =
-		    socket_info_map__lookup(&conn_key);
+		    enter_socket_info_lookup(id, sockfd);
 		read_args.tcp_seq =
 		    get_tcp_read_seq(sockfd, &read_args.sk, socket_info_ptr);
-		active_read_args_map__update(&id, &read_args);
+		stash_syscall_args(ACTIVE_ARGS_READ, &id, &read_args);
 	}
 
 	return 0;
@@ -2709,7 +2998,7 @@ TP_SYSCALL_PROG(exit_recvmmsg) (struct syscall_comm_exit_ctx *ctx) {
 #endif
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *read_args = active_read_args_map__lookup(&id);
+	struct data_args_t *read_args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	if (read_args != NULL && num_msgs > 0) {
 		ssize_t bytes_count;
 		bpf_probe_read_user(&bytes_count, sizeof(read_args->msg_len),
@@ -2717,7 +3006,7 @@ TP_SYSCALL_PROG(exit_recvmmsg) (struct syscall_comm_exit_ctx *ctx) {
 		process_syscall_data_vecs((struct pt_regs *)ctx, id, T_INGRESS,
 					  read_args, bytes_count);
 	}
-	active_read_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
 
 	return 0;
 }
@@ -2750,12 +3039,11 @@ KFUNC_PROG(do_writev, unsigned long fd, const struct iovec __user * vec,
 	write_args.iov = iov;
 	write_args.iovlen = iovlen;
 	write_args.enter_ts = bpf_ktime_get_ns();
-	__u64 conn_key = gen_conn_key_id((__u64) (id >> 32), (__u64) fd);
 	struct socket_info_s *socket_info_ptr =
-	    socket_info_map__lookup(&conn_key);
+	    enter_socket_info_lookup(id, fd);
 	write_args.tcp_seq =
 	    get_tcp_write_seq(fd, &write_args.sk, socket_info_ptr);
-	active_write_args_map__update(&id, &write_args);
+	stash_syscall_args(ACTIVE_ARGS_WRITE, &id, &write_args);
 	return 0;
 }
 
@@ -2780,14 +3068,14 @@ KRETFUNC_PROG(do_writev, unsigned long fd, const struct iovec __user * vec,
 #endif
 	__u64 id = bpf_get_current_pid_tgid();
 	// Unstash arguments, and process syscall.
-	struct data_args_t *write_args = active_write_args_map__lookup(&id);
+	struct data_args_t *write_args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 	if (write_args != NULL) {
 		write_args->bytes_count = bytes_count;
 		process_syscall_data_vecs((struct pt_regs *)ctx, id, T_EGRESS,
 					  write_args, bytes_count);
 	}
 
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return 0;
 }
 
@@ -2818,12 +3106,11 @@ KFUNC_PROG(do_readv, unsigned long fd, const struct iovec __user * vec,
 	read_args.iov = iov;
 	read_args.iovlen = iovlen;
 	read_args.enter_ts = bpf_ktime_get_ns();
-	__u64 conn_key = gen_conn_key_id((__u64) (id >> 32), (__u64) fd);
 	struct socket_info_s *socket_info_ptr =
-	    socket_info_map__lookup(&conn_key);
+	    enter_socket_info_lookup(id, fd);
 	read_args.tcp_seq =
 	    get_tcp_read_seq(fd, &read_args.sk, socket_info_ptr);
-	active_read_args_map__update(&id, &read_args);
+	stash_syscall_args(ACTIVE_ARGS_READ, &id, &read_args);
 
 	return 0;
 }
@@ -2848,14 +3135,14 @@ KRETFUNC_PROG(do_readv, unsigned long fd, const struct iovec __user * vec,
 #endif
 #endif
 	__u64 id = bpf_get_current_pid_tgid();
-	struct data_args_t *read_args = active_read_args_map__lookup(&id);
+	struct data_args_t *read_args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	if (read_args != NULL) {
 		read_args->bytes_count = bytes_count;
 		process_syscall_data_vecs((struct pt_regs *)ctx, id, T_INGRESS,
 					  read_args, bytes_count);
 	}
 
-	active_read_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
 	return 0;
 }
 
@@ -2887,6 +3174,7 @@ static __inline void __push_close_event(__u64 pid_tgid, __u64 uid, __u64 seq,
 	v->socket_id = uid;
 	v->tgid = (__u32) (pid_tgid >> 32);
 	v->pid = (__u32) pid_tgid;
+	v->cgroup_id = get_current_cgroup_id();
 	v->timestamp = bpf_ktime_get_ns();
 	v->cap_timestamp = v->timestamp;
 	v->source = source;
@@ -2952,7 +3240,7 @@ KFUNC_PROG(__arm64_sys_close, const struct pt_regs *regs)
 	INFER_OFFSET_PHASE_2(fd);
 
 	__u64 id = bpf_get_current_pid_tgid();
-	__u64 conn_key = gen_conn_key_id(id >> 32, (__u64) fd);
+	__u64 conn_key = socket_info_key(id >> 32, (__u64) fd, NULL);
 	enum process_data_extra_source source = 0;
 	struct socket_info_s *socket_info_ptr =
 	    socket_info_map__lookup(&conn_key);
@@ -2973,6 +3261,32 @@ KFUNC_PROG(__arm64_sys_close, const struct pt_regs *regs)
 	return 0;
 }
 
+#if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
+/*
+ * With the sk keyed socket_info_map the entries of the sockets not
+ * closed through close() (leaked, shared or exited fds) are freed here
+ * instead of by the userspace reclaim, the address may be reused by the
+ * next socket. Attached only in that mode.
+ */
+// void security_sk_free(struct sock *sk)
+KPROG(security_sk_free) (struct pt_regs *ctx) {
+	__u64 conn_key = (__u64) PT_REGS_PARM1(ctx);
+	struct socket_info_s *socket_info_ptr =
+	    socket_info_map__lookup(&conn_key);
+	if (socket_info_ptr == NULL) {
+		socket_role_map__delete(&conn_key);
+		return 0;
+	}
+
+	delete_socket_info(conn_key, socket_info_ptr);
+	__u32 k0 = 0;
+	struct tracer_ctx_s *tracer_ctx = tracer_ctx_map__lookup(&k0);
+	if (tracer_ctx)
+		tracer_ctx->sk_free_reclaim_count++;
+	return 0;
+}
+#endif
+
 //int __sys_socket(int family, int type, int protocol)
 // /sys/kernel/debug/tracing/events/syscalls/sys_exit_socket/format
 #ifdef SUPPORTS_KPROBE_ONLY
@@ -2997,9 +3311,14 @@ KRETFUNC_PROG(__sys_socket, int family, int type, int protocol, int ret)
 	      comm[3] == 'n' && comm[4] == 'x' && comm[5] == '\0'))
 		return 0;
 
+	__u32 k0 = 0;
+	struct tracer_ctx_s *tracer_ctx = tracer_ctx_map__lookup(&k0);
+	if (tracer_ctx == NULL)
+		return 0;
+
 	// nginx is not a go process, disable go tracking
 	struct trace_key_t key = get_trace_key(0, true);
-	struct trace_info_t *trace = trace_map__lookup(&key);
+	struct trace_info_t *trace = trace_info_lookup(tracer_ctx, &key);
 	if (trace && trace->peer_fd != 0 && trace->peer_fd != (__u32) fd) {
 		struct socket_info_s sk_info = { 0 };
 		/*
@@ -3012,9 +3331,8 @@ KRETFUNC_PROG(__sys_socket, int family, int type, int protocol, int ret)
 		 */
 		sk_info.peer_fd = trace->peer_fd;
 		sk_info.trace_id = trace->thread_trace_id;
-		__u64 conn_key = gen_conn_key_id(id >> 32, fd);
+		__u64 conn_key = socket_info_key(id >> 32, fd, NULL);
 		int ret = socket_info_map__update(&conn_key, &sk_info);
-		__u32 k0 = 0;
 		struct trace_stats *trace_stats = trace_stats_map__lookup(&k0);
 		if (trace_stats == NULL)
 			return 0;
@@ -3048,7 +3366,7 @@ KRETFUNC_PROG(__sys_accept4, int fd, struct sockaddr __user * upeer_sockaddr,
 #endif
 	__u64 pid_tgid = bpf_get_current_pid_tgid();
 	__u32 tgid = (__u32) (pid_tgid >> 32);
-	__u64 conn_key = gen_conn_key_id((__u64) tgid, (__u64) sockfd);
+	__u64 conn_key = socket_info_key((__u64) tgid, (__u64) sockfd, NULL);
 	__u32 role = ROLE_SERVER;
 	socket_role_map__update(&conn_key, &role);
 	return 0;
@@ -3059,7 +3377,7 @@ TP_SYSCALL_PROG(exit_accept4) (struct syscall_comm_exit_ctx *ctx) {
 	int sockfd = ctx->ret;
 	__u64 pid_tgid = bpf_get_current_pid_tgid();
 	__u32 tgid = (__u32) (pid_tgid >> 32);
-	__u64 conn_key = gen_conn_key_id((__u64) tgid, (__u64) sockfd);
+	__u64 conn_key = socket_info_key((__u64) tgid, (__u64) sockfd, NULL);
 	__u32 role = ROLE_SERVER;
 	socket_role_map__update(&conn_key, &role);
 	return 0;
@@ -3083,7 +3401,7 @@ KFUNC_PROG(__sys_connect, int fd, struct sockaddr __user * uservaddr,
 #endif
 	__u64 pid_tgid = bpf_get_current_pid_tgid();
 	__u32 tgid = (__u32) (pid_tgid >> 32);
-	__u64 conn_key = gen_conn_key_id((__u64) tgid, (__u64) sockfd);
+	__u64 conn_key = socket_info_key((__u64) tgid, (__u64) sockfd, NULL);
 	__u32 role = ROLE_CLIENT;
 	socket_role_map__update(&conn_key, &role);
 	return 0;
@@ -3242,7 +3560,7 @@ static __inline int output_extra_data_common(struct data_args_t *args, struct __
 
 	// Limit handling to UDP and DNS protocols only
 	if (head->data_type != PROTO_DNS ||
-	    head->tuple.l4_protocol != IPPROTO_UDP)
+	    head->tuple.l4_protocol != IPPROTO_UDP || max_size == 0)
 		return -1;
 
 	args->iov = args->extra_iov;
@@ -3256,6 +3574,7 @@ static __inline int output_extra_data_common(struct data_args_t *args, struct __
 			      offsetof(typeof(struct __socket_data),
 				       data), head);
 	extra_v->data_seq += 1;
+	extra_v->l7_index_len = 0;
 	int copy_bytes = output_iov_data_copy(args, v_buff, extra_v, max_size,
 					      reassembly_bytes);
 	if (copy_bytes < 0)
@@ -3269,6 +3588,120 @@ static __inline int output_extra_data_common(struct data_args_t *args, struct __
 	return 0;
 }
 
+#ifdef LINUX_VER_KFUNC
+/*
+ * HTTP/1.x header index (tracer_ctx 'http1_hdr_extract'), kfunc builds
+ * only as the scan is a bounded loop. The start line and the values of
+ * the configured headers are located in the first HTTP1_HDR_SCAN_MAX
+ * bytes of the data, in a single pass hashing the header names, and
+ * struct http1_hdr_index is appended to the data. With 'http1_hdr_only'
+ * the data is cut at the end of the header block.
+ */
+static __inline int http1_hdr_field(struct tracer_ctx_s *tracer_ctx,
+				    __u32 hash)
+{
+	int k;
+#pragma unroll
+	for (k = 0; k < HTTP1_HDR_NAMES_MAX; k++) {
+		if (tracer_ctx->http1_hdr_hash[k] != 0 &&
+		    tracer_ctx->http1_hdr_hash[k] == hash)
+			return k;
+	}
+
+	return -1;
+}
+
+static __inline void http1_hdr_index_build(struct tracer_ctx_s *tracer_ctx,
+					   struct __socket_data *v)
+{
+	/*
+	 * The scan state is kept in the map value instead of the stack: the
+	 * verifier does not track the map contents, so all the paths of an
+	 * iteration reach the loop head in the same state and get pruned,
+	 * the loop costs about HTTP1_HDR_SCAN_MAX times its body instead of
+	 * growing with the branches taken in the previous iterations.
+	 */
+	struct http1_hdr_scan *s = &tracer_ctx->http1_scan;
+	__u32 i, end;
+	int k;
+	char c;
+
+	__builtin_memset(s, 0, sizeof(*s));
+	s->hash = HTTP1_HDR_HASH_INIT;
+	s->field = -1;
+	s->in_name = 1;
+
+#pragma clang loop unroll(disable)
+	for (i = 0; i < HTTP1_HDR_SCAN_MAX; i++) {
+		if (i >= v->data_len)
+			break;
+		c = v->data[i & (HTTP1_HDR_SCAN_MAX - 1)];
+		if (c == '\n') {
+			end = i;
+			if (end > s->line_start &&
+			    v->data[(end - 1) & (HTTP1_HDR_SCAN_MAX - 1)] == '\r')
+				end--;
+			if (s->line_no == 0) {
+				s->idx.start_line.off = s->line_start;
+				s->idx.start_line.len = end - s->line_start;
+			} else if (end == s->line_start) {
+				s->idx.hdr_len = i + 1;
+				break;
+			} else if (s->field >= 0 && end >= s->value_start) {
+#pragma unroll
+				for (k = 0; k < HTTP1_HDR_NAMES_MAX; k++) {
+					if (s->field == k) {
+						s->idx.headers[k].off =
+						    s->value_start;
+						s->idx.headers[k].len =
+						    end - s->value_start;
+					}
+				}
+			}
+			s->line_no++;
+			s->line_start = i + 1;
+			s->hash = HTTP1_HDR_HASH_INIT;
+			s->in_name = 1;
+			s->field = -1;
+			continue;
+		}
+
+		if (s->line_no == 0)
+			continue;
+
+		if (s->in_name) {
+			if (c == ':') {
+				s->in_name = 0;
+				s->field = http1_hdr_field(tracer_ctx, s->hash);
+				s->value_start = i + 1;
+			} else {
+				if (c >= 'A' && c <= 'Z')
+					c += 'a' - 'A';
+				s->hash = (s->hash ^ (__u8) c) *
+				    HTTP1_HDR_HASH_PRIME;
+			}
+		} else if (s->value_start == i && (c == ' ' || c == '\t')) {
+			s->value_start = i + 1;
+		}
+	}
+
+	if (s->idx.start_line.len == 0)
+		return;
+
+	if (tracer_ctx->http1_hdr_only && s->idx.hdr_len > 0 &&
+	    s->idx.hdr_len < v->data_len)
+		v->data_len = s->idx.hdr_len;
+
+	__u32 off = v->data_len;
+	if (off > sizeof(v->data) - sizeof(s->idx))
+		return;
+
+	bpf_probe_read_kernel(v->data + off, sizeof(s->idx), &s->idx);
+	v->l7_index_len = sizeof(s->idx);
+	tracer_ctx->http1_hdr_index_count++;
+}
+#endif
+
 #if defined(LINUX_VER_KFUNC) || defined(LINUX_VER_5_2_PLUS)
 static __inline int __output_data_common(void *ctx,
 					 struct tracer_ctx_s *tracer_ctx,
@@ -3294,7 +3727,9 @@ static __inline int __output_data_common(void *ctx,
 	if (v_buff->len > (sizeof(v_buff->data) - sizeof(*v)))
 		goto exit;
 
-	if (is_close) {
+	v->l7_index_len = 0;
+	// A close event or a metadata only record, no payload.
+	if (is_close || max_size == 0) {
 		v->data_len = 0;
 		goto skip_copy;
 	}
@@ -3317,10 +3752,15 @@ static __inline int __output_data_common(void *ctx,
 		goto exit;
 
 	v->data_len = copy_bytes;
+#ifdef LINUX_VER_KFUNC
+	if (v->data_type == PROTO_HTTP1 && tracer_ctx->http1_hdr_extract)
+		http1_hdr_index_build(tracer_ctx, v);
+#endif
 
 skip_copy:
 	v_buff->len +=
-	    offsetof(typeof(struct __socket_data), data) + v->data_len;
+	    offsetof(typeof(struct __socket_data), data) + v->data_len +
+	    v->l7_index_len;
 	v_buff->events_num++;
 
 	/*
@@ -3390,16 +3830,18 @@ static __inline int output_data_common(void *ctx)
 
 	struct data_args_t *args;
 	if (dir == T_INGRESS)
-		args = active_read_args_map__lookup(&id);
+		args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	else
-		args = active_write_args_map__lookup(&id);
+		args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 
 	struct __socket_data *v =
 	    (struct __socket_data *)(v_buff->data + v_buff->len);
 	if (v_buff->len > (sizeof(v_buff->data) - sizeof(*v)))
 		goto clear_args_map_1;
 
-	if (is_close) {
+	v->l7_index_len = 0;
+	// A close event or a metadata only record, no payload.
+	if (is_close || max_size == 0) {
 		v->data_len = 0;
 		goto skip_copy;
 	}
@@ -3447,16 +3889,16 @@ skip_copy:
 clear_args_map_1:
 	__sync_fetch_and_add(&tracer_ctx->push_buffer_refcnt, -1);
 	if (dir == T_INGRESS)
-		active_read_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_READ, &id);
 	else
-		active_write_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_WRITE, &id);
 
 	return 0;
 
 clear_args_map_2:
 	__sync_fetch_and_add(&tracer_ctx->push_buffer_refcnt, -1);
-	active_read_args_map__delete(&id);
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return 0;
 }
 
@@ -3480,13 +3922,14 @@ static __inline int data_submit(void *ctx)
 	struct conn_info_s *conn_info;
 	struct conn_info_s __conn_info = ctx_map->tail_call.conn_info;
 	conn_info = &__conn_info;
-	__u64 conn_key = gen_conn_key_id(id >> 32, (__u64) conn_info->fd);
+	__u64 conn_key = socket_info_key(id >> 32, (__u64) conn_info->fd,
+					 conn_info->sk);
 	conn_info->socket_info_ptr = socket_info_map__lookup(&conn_key);
 	struct data_args_t *args;
 	if (conn_info->direction == T_INGRESS)
-		args = active_read_args_map__lookup(&id);
+		args = active_args_lookup(ACTIVE_ARGS_READ, &id);
 	else
-		args = active_write_args_map__lookup(&id);
+		args = active_args_lookup(ACTIVE_ARGS_WRITE, &id);
 
 	if (args == NULL)
 		return SUBMIT_ABORT;
@@ -3521,7 +3964,8 @@ static __inline int __proto_infer_2(void *ctx)
 	struct conn_info_s *conn_info, __conn_info;
 	__conn_info = ctx_map->tail_call.conn_info;
 	conn_info = &__conn_info;
-	__u64 conn_key = gen_conn_key_id(id >> 32, (__u64) conn_info->fd);
+	__u64 conn_key = socket_info_key(id >> 32, (__u64) conn_info->fd,
+					 conn_info->sk);
 	conn_info->socket_info_ptr = socket_info_map__lookup(&conn_key);
 	int act;
 	act = infer_l7_class_2(&ctx_map->tail_call, conn_info);
@@ -3538,8 +3982,8 @@ static __inline int __proto_infer_2(void *ctx)
 	}
 
 clear_args_map:
-	active_read_args_map__delete(&id);
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return INFER_TERMINATE;
 }
 
@@ -3561,7 +4005,8 @@ static __inline int __proto_infer_3(void *ctx)
 	struct conn_info_s *conn_info, __conn_info;
 	__conn_info = ctx_map->tail_call.conn_info;
 	conn_info = &__conn_info;
-	__u64 conn_key = gen_conn_key_id(id >> 32, (__u64) conn_info->fd);
+	__u64 conn_key = socket_info_key(id >> 32, (__u64) conn_info->fd,
+					 conn_info->sk);
 	conn_info->socket_info_ptr = socket_info_map__lookup(&conn_key);
 	int act;
 	act = infer_l7_class_3(&ctx_map->tail_call, conn_info);
@@ -3583,13 +4028,13 @@ static __inline int __proto_infer_3(void *ctx)
 
 clear_args_map_1:
 	if (dir == T_INGRESS)
-		active_read_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_READ, &id);
 	else
-		active_write_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return INFER_TERMINATE;
 clear_args_map_2:
-	active_read_args_map__delete(&id);
-	active_write_args_map__delete(&id);
+	active_args_delete(ACTIVE_ARGS_READ, &id);
+	active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	return INFER_TERMINATE;
 }
 
@@ -3655,8 +4100,8 @@ PROGKP(data_submit) (void *ctx) {
 		return 0;
 	} else {
 		__u64 id = bpf_get_current_pid_tgid();
-		active_read_args_map__delete(&id);
-		active_write_args_map__delete(&id);
+		active_args_delete(ACTIVE_ARGS_READ, &id);
+		active_args_delete(ACTIVE_ARGS_WRITE, &id);
 	}
 
 	return 0;
@@ -64,26 +64,31 @@ struct go_key {
 	__u64 goid;
 } __attribute__((packed));
 
+// Maximum number of entries walked when the representative ancestor
+// has to be resolved again.
+#define GO_ANCESTOR_DEPTH_MAX 6
+
+// Ancestry of a coroutine. The representative ancestor is stored directly
+// in the entry (path compression) when the coroutine is created, and
+// resolved again through the parents once its timestamp has expired.
+struct go_ancestor {
+	__u64 parent;		// parent goid
+	__u64 ancestor;		// representative ancestor goid, 0 if none
+	__u64 ancestor_ts;	// last socket read/write time of 'ancestor'
+	__u64 rw_ts;		// last socket read/write time of this coroutine
+} __attribute__((packed));
+
 // The mapping of coroutines to ancestors, the map is updated when a new
-// coroutine is created
+// coroutine is created or does socket read/write
 // key : current gorouting (struct go_key)
-// value : ancerstor goid
+// value : struct go_ancestor
+// It also replaces go_rw_ts_map, so coroutines that only have a parent or
+// only do socket read/write now share HASH_ENTRIES_MAX entries instead of
+// having twice that across two maps.
 struct bpf_map_def SEC("maps") go_ancerstor_map = {
 	.type = BPF_MAP_TYPE_LRU_HASH,
 	.key_size = sizeof(struct go_key),
-	.value_size = sizeof(__u64),
-	.max_entries = HASH_ENTRIES_MAX,
-	.feat_flags = FEATURE_FLAG_UPROBE_GOLANG,
-};
-
-// Used to determine the timeout, as a termination condition for finding
-// ancestors.
-// key : current gorouting (struct go_key)
-// value: timestamp when the data was inserted into the map
-struct bpf_map_def SEC("maps") go_rw_ts_map = {
-	.type = BPF_MAP_TYPE_LRU_HASH,
-	.key_size = sizeof(struct go_key),
-	.value_size = sizeof(__u64),
+	.value_size = sizeof(struct go_ancestor),
 	.max_entries = HASH_ENTRIES_MAX,
 	.feat_flags = FEATURE_FLAG_UPROBE_GOLANG,
 };
@@ -221,8 +226,58 @@ static __inline bool skip_http2_kprobe(void)
 	return false;
 }
 
+#if defined(__x86_64__)
+static __inline void go_lazy_goid_inc(void)
+{
+	__u32 k0 = 0;
+	struct tracer_ctx_s *tracer_ctx = tracer_ctx_map__lookup(&k0);
+	if (tracer_ctx)
+		tracer_ctx->go_lazy_goid_count++;
+}
+
+/*
+ * The Go runtime keeps the current g pointer in a TLS slot, at
+ * 'g_tls_offset' from the thread pointer (fsbase). Reading it when the
+ * goroutine ID is needed replaces the runtime.execute uprobe, which fires
+ * on every goroutine schedule.
+ */
+static __inline __u64 get_goid_from_g(struct member_fields_offset *offset)
+{
+	__u32 tgid = bpf_get_current_pid_tgid() >> 32;
+	struct ebpf_proc_info *info;
+	void *task, *fsbase = NULL, *g_ptr = NULL;
+	__s64 goid = 0;
+
+	info = bpf_map_lookup_elem(&proc_info_map, &tgid);
+	if (!info)
+		return 0;
+
+	task = (void *)bpf_get_current_task();
+	bpf_probe_read_kernel(&fsbase, sizeof(fsbase),
+			      task + offset->task__tpbase_offset);
+	if (fsbase == NULL)
+		return 0;
+
+	bpf_probe_read_user(&g_ptr, sizeof(g_ptr),
+			    fsbase + info->g_tls_offset);
+	if (g_ptr == NULL)
+		return 0;
+
+	bpf_probe_read_user(&goid, sizeof(goid),
+			    g_ptr + info->offsets[OFFSET_IDX_GOID_RUNTIME_G]);
+	go_lazy_goid_inc();
+	return goid;
+}
+#endif
+
 static __inline __u64 get_current_goroutine(void)
 {
+#if defined(__x86_64__)
+	struct member_fields_offset *offset = retrieve_ready_kern_offset();
+	if (offset && offset->go_lazy_goid)
+		return get_goid_from_g(offset);
+#endif
+
 	__u64 current_thread = bpf_get_current_pid_tgid();
 	__u64 *goid_ptr = bpf_map_lookup_elem(&goroutines_map, &current_thread);
 	if (goid_ptr) {
@@ -232,17 +287,44 @@ static __inline __u64 get_current_goroutine(void)
 	return 0;
 }
 
-static __inline bool is_final_ancestor(__u32 tgid, __u64 goid, __u64 now,
-				       __u64 timeout)
+static __inline void go_ancestor_truncated_inc(void)
 {
-	struct go_key key = {.tgid = tgid,.goid = goid };
+	__u32 k0 = 0;
+	struct tracer_ctx_s *tracer_ctx = tracer_ctx_map__lookup(&k0);
+	if (tracer_ctx)
+		tracer_ctx->go_ancestor_truncated_count++;
+}
 
-	__u64 *ts = bpf_map_lookup_elem(&go_rw_ts_map, &key);
-	if (!ts) {
-		return false;
+// Walk up from 'goid' to the first coroutine with recent socket
+// read/write, following the compressed ancestors where still valid.
+static __inline __u64 resolve_go_ancestor(__u32 tgid, __u64 goid, __u64 now,
+					  __u64 timeout, __u64 * rw_ts)
+{
+	struct go_key key = {.tgid = tgid };
+	struct go_ancestor *a;
+	int idx;
+
+#pragma unroll
+	for (idx = 0; idx < GO_ANCESTOR_DEPTH_MAX; ++idx) {
+		key.goid = goid;
+		a = bpf_map_lookup_elem(&go_ancerstor_map, &key);
+		if (!a)
+			return 0;
+		if (a->rw_ts && now < a->rw_ts + timeout) {
+			*rw_ts = a->rw_ts;
+			return goid;
+		}
+		if (a->ancestor && now < a->ancestor_ts + timeout) {
+			*rw_ts = a->ancestor_ts;
+			return a->ancestor;
+		}
+		if (!a->parent)
+			return 0;
+		goid = a->parent;
 	}
 
-	return now < *ts + timeout;
+	go_ancestor_truncated_inc();
+	return 0;
 }
 
 // Try to find an ancestor coroutine that can represent this request.
@@ -250,6 +332,16 @@ static __inline bool is_final_ancestor(__u32 tgid, __u64 goid, __u64 now,
 //  1. There have been socket read or write operations in the recent period of time
 //  2. All of its ancestor coroutines do not satisfy condition 1
 // If no such coroutine exists, mark itself as a coroutine that can represent the request and return.
+//
+// The representative ancestor is kept in the coroutine's own entry, so this
+// is a single lookup unless the stored timestamp has expired. While it is
+// valid, the stored ancestor is returned without looking at the nearer
+// ancestors again. This matches the nearest ancestor walk, since a nearer
+// ancestor does not mark itself while a farther one is still valid. The
+// exception is a nearer ancestor that could not reach that one (an entry
+// evicted from the LRU map, or the walk cut by GO_ANCESTOR_DEPTH_MAX) and
+// marked itself. Its descendants keep the farther ancestor until the
+// stored timestamp expires.
 static __inline __u64 get_rw_goid(__u64 timeout, bool is_socket_io)
 {
 	__u32 tgid = (__u32) (bpf_get_current_pid_tgid() >> 32);
@@ -259,29 +351,36 @@ static __inline __u64 get_rw_goid(__u64 timeout, bool is_socket_io)
 		return 0;
 	}
 
-	__u64 ancestor = goid;
-
-	int idx = 0;
-#pragma unroll
-	for (idx = 0; idx < 6; ++idx) {
-		if (is_final_ancestor(tgid, ancestor, ts, timeout)) {
+	struct go_key key = {.tgid = tgid,.goid = goid };
+	struct go_ancestor *a = bpf_map_lookup_elem(&go_ancerstor_map, &key);
+	if (a) {
+		if (a->rw_ts && ts < a->rw_ts + timeout)
+			return goid;
+		if (a->ancestor && ts < a->ancestor_ts + timeout)
+			return a->ancestor;
+
+		__u64 rw_ts = 0;
+		__u64 ancestor = 0;
+		if (a->parent)
+			ancestor = resolve_go_ancestor(tgid, a->parent, ts,
+						       timeout, &rw_ts);
+		if (ancestor) {
+			a->ancestor = ancestor;
+			a->ancestor_ts = rw_ts;
 			return ancestor;
 		}
-		struct go_key key = {.tgid = tgid,.goid = ancestor };
-		__u64 *newancestor =
-		    bpf_map_lookup_elem(&go_ancerstor_map, &key);
-		if (!newancestor) {
-			break;
-		}
-		ancestor = *newancestor;
 	}
 
 	if (!is_socket_io) {
 		return 0;
 	}
 
-	struct go_key key = {.tgid = tgid,.goid = goid };
-	bpf_map_update_elem(&go_rw_ts_map, &key, &ts, BPF_ANY);
+	if (a) {
+		a->rw_ts = ts;
+	} else {
+		struct go_ancestor new_a = {.rw_ts = ts };
+		bpf_map_update_elem(&go_ancerstor_map, &key, &new_a, BPF_ANY);
+	}
 	return goid;
 }
 
@@ -606,9 +705,24 @@ UPROG(exit_runtime_newproc1) (struct pt_regs *ctx)
 		return 0;
 	}
 
-	struct go_key key = {.tgid = tgid,.goid = goid };
-	goid = caller->goid;
-	bpf_map_update_elem(&go_ancerstor_map, &key, &goid, BPF_ANY);
+	// Inherit the parent's representative ancestor (path compression):
+	// the parent itself if it did socket read/write, else its own one.
+	struct go_key key = {.tgid = tgid,.goid = caller->goid };
+	struct go_ancestor child = {.parent = caller->goid };
+	struct go_ancestor *parent =
+	    bpf_map_lookup_elem(&go_ancerstor_map, &key);
+	if (parent) {
+		if (parent->rw_ts) {
+			child.ancestor = caller->goid;
+			child.ancestor_ts = parent->rw_ts;
+		} else {
+			child.ancestor = parent->ancestor;
+			child.ancestor_ts = parent->ancestor_ts;
+		}
+	}
+
+	key.goid = goid;
+	bpf_map_update_elem(&go_ancerstor_map, &key, &child, BPF_ANY);
 
 	bpf_map_delete_elem(&pid_tgid_callerid_map, &pid_tgid);
 	return 0;
@@ -35,6 +35,10 @@ pub const CAP_LEN_MAX: usize = 16384;
 pub const PACKET_KNAME_MAX_PADDING: usize = 15;
 pub const CONTAINER_ID_SIZE: usize = 65;
 
+pub const HUGEPAGE_MODE_DEFAULT: c_int = 0;
+pub const HUGEPAGE_MODE_TRANSPARENT: c_int = 1;
+pub const HUGEPAGE_MODE_EXPLICIT: c_int = 2;
+
 //方向
 #[allow(dead_code)]
 pub const SOCK_DIR_SND: u8 = 0;
@@ -206,6 +210,9 @@ pub const MSG_COMMON: u8 = 7;
 // the close event's SOURCE is identified as uprobe.
 #[allow(dead_code)]
 pub const MSG_CLOSE: u8 = 10;
+// Sent without the payload by the sockets on the metadata only ports
+// (set_metadata_port_bitmap()), only the timing of the message is usable.
+pub const MSG_METADATA_ONLY: u8 = 12;
 
 //Register event types
 #[allow(dead_code)]
@@ -259,6 +266,25 @@ pub struct tuple_t {
     pub lport: u16,           // 本地端口
 }
 
+pub const HTTP1_HDR_NAMES_MAX: usize = 4;
+
+// Offset and length in cap_data
+#[repr(C, packed)]
+#[derive(Debug, Copy, Clone, Default)]
+pub struct L7_FIELD {
+    pub off: u16,
+    pub len: u16,
+}
+
+// HTTP/1.x start line and header values located in the kernel, see set_http1_header_extract()
+#[repr(C, packed)]
+#[derive(Debug, Copy, Clone, Default)]
+pub struct HTTP1_HDR_INDEX {
+    pub hdr_len: u16, // Header block length including the empty line, 0 if not found
+    pub start_line: L7_FIELD,
+    pub headers: [L7_FIELD; HTTP1_HDR_NAMES_MAX], // In the order of the configured names
+}
+
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
 pub struct SK_BPF_DATA {
@@ -366,6 +392,7 @@ pub struct SK_BPF_DATA {
     pub cap_seq: u64, // cap_data在Socket中的相对顺序号，在所在socket下从0开始自增，用于数据乱序排序
     pub socket_role: u8, // this message is created by: 0:unkonwn 1:client(connect) 2:server(accept)
     pub fd: u32,      // File descriptor for an open file or socket.
+    pub l7_index: HTTP1_HDR_INDEX, // All zero if not indexed
     pub cap_data: *mut c_char, // 内核送到用户空间的数据地址
 }
 
@@ -503,6 +530,50 @@ pub struct SK_TRACE_STATS {
     pub dropped_packets: u64,
     pub kern_missed_packets: u64,
     pub invalid_packets: u64,
+
+    // Socket data reorder stage
+    pub reorder_reordered_count: u64, // Data emitted after being held back for the missing sequence numbers.
+    pub reorder_late_count: u64, // Data arriving after a later sequence number of its socket was emitted.
+    pub reorder_gap_count: u64,  // Missing sequence numbers given up after the maximum hold time.
+
+    // Goroutine ID tracking
+    pub go_lazy_goid_lookups: u64, // Goroutine IDs read from the g pointer in lazy mode.
+    pub go_ancestor_truncations: u64, // Goroutine ancestor resolutions given up at the depth limit.
+
+    // Trace information accesses
+    pub trace_task_storage: bool, // Thread keyed trace information kept in the task local storage.
+    pub trace_events: u64,        // Trace information lookups, one per traced event.
+    pub trace_map_ops: u64,       // Lookups, updates and deletes on the trace map.
+    pub trace_task_ops: u64,      // Gets and deletes on the task local storage.
+    pub args_hash_ops_avoided: u64, // Syscall arguments hash map updates and deletes avoided.
+
+    // Socket information keyed by the sk pointer
+    pub socket_key_sk: bool,     // socket_info_map keyed by the sk pointer instead of {tgid + fd}.
+    pub sk_free_reclaims: u64,   // socket_info_map entries freed along with their socket.
+    pub metadata_only_events: u64, // Socket data pushed without the payload (metadata only ports).
+    pub http1_hdr_indexed: u64, // HTTP/1.x data pushed with the header index.
+    pub io_hist_overflows: u64, // File IO left out of the latency histograms, the map was full.
+}
+
+pub const IO_HIST_SLOTS: usize = 24;
+pub const IO_HIST_DIR_NAME_SZ: usize = 64;
+pub const MOUNT_POINT_SZ: usize = 256;
+
+// File IO latency histogram of a (process, mount, directory, operation)
+// over a drain period, see set_io_latency_hist().
+#[repr(C, packed)]
+#[derive(Copy, Clone)]
+pub struct IO_LATENCY_HIST {
+    pub pid: u32,
+    pub mnt_id: i32,
+    pub mntns_id: u32,
+    pub operation: u32, // 0: write, 1: read
+    pub mount_point: [u8; MOUNT_POINT_SZ],
+    pub dir_name: [u8; IO_HIST_DIR_NAME_SZ], // Last component of the directory, may be empty.
+    pub count: u64,
+    pub bytes: u64,
+    pub latency_sum: u64, // nanosecond
+    pub slots: [u64; IO_HIST_SLOTS], // slots[i]: latencies in [2^i, 2^(i+1)) microseconds, the last one everything above.
 }
 
 #[repr(C)]
@@ -571,8 +642,30 @@ extern "C" {
     pub fn set_go_tracing_timeout(timeout: c_int) -> c_int;
     pub fn set_io_event_collect_mode(mode: c_int) -> c_int;
     pub fn set_io_event_minimal_duration(duration: c_ulonglong) -> c_int;
+    /*
+     * Aggregate the file IO latency into log2 histograms in kernel, drained
+     * to the callback every 10 seconds. Only the IO slower than
+     * outlier_duration (nanoseconds) is still sent as individual events.
+     */
+    pub fn set_io_latency_hist(
+        enabled: bool,
+        outlier_duration: c_ulonglong,
+        callback: extern "C" fn(hist: *mut IO_LATENCY_HIST),
+    ) -> c_int;
+    /*
+     * Emit socket data in per-socket sequence order in each dispatch queue.
+     * @max_hold_us : Maximum time data waits for the missing sequence
+     *                numbers of its socket, 0 means the default (5ms).
+     */
+    pub fn set_socket_data_reorder(enable: bool, max_hold_us: c_uint) -> c_int;
     pub fn set_allow_port_bitmap(bitmap: *const c_uchar) -> c_int;
     pub fn set_bypass_port_bitmap(bitmap: *const c_uchar) -> c_int;
+    /*
+     * Sockets on these ports push their first request and response with the
+     * payload, then only the metadata (tuple, direction, syscall_len, seqs,
+     * timestamps, trace id). Linux 5.2+ only, set before running_socket_tracer().
+     */
+    pub fn set_metadata_port_bitmap(bitmap: *const c_uchar) -> c_int;
     pub fn enable_ebpf_protocol(protocol: c_int) -> c_int;
     pub fn enable_ebpf_seg_reasm_protocol(protocol: c_int) -> c_int;
     pub fn set_feature_regex(idx: c_int, pattern: *const c_char) -> c_int;
@@ -629,6 +722,9 @@ extern "C" {
     pub fn bpf_tracer_finish();
 
     pub fn set_uprobe_golang_enabled(enabled: bool) -> c_void;
+    // Read the goroutine ID from the g pointer instead of the runtime.execute
+    // uprobe (x86_64 only), must be called before running_socket_tracer().
+    pub fn set_go_lazy_goid_enabled(enabled: bool) -> c_void;
     pub fn set_uprobe_openssl_enabled(enabled: bool) -> c_void;
 
     // 获取socket_tracer的这种统计数据的接口
@@ -650,6 +746,26 @@ extern "C" {
 
     pub fn set_kick_kern_nice(nice: c_int) -> c_int;
 
+    // Page backing of the hash table arenas, call it before bpf_tracer_init().
+    // @mode : HUGEPAGE_MODE_DEFAULT   try locked hugetlb pages, fall back to normal pages
+    //         HUGEPAGE_MODE_TRANSPARENT  transparent hugepages (MADV_HUGEPAGE)
+    //         HUGEPAGE_MODE_EXPLICIT  hugetlb pages from a memfd, fall back to
+    //                                 transparent hugepages, then normal pages
+    // The page backing actually used is written to the log.
+    pub fn set_bpf_hugepage_mode(mode: c_int) -> c_int;
+
+    // Memory budget (process RSS) in bytes, 0 disables the memory governor.
+    // Close to the budget, the shedding actions are applied one at a time
+    // in priority order, and reverted once the usage is back down.
+    pub fn set_bpf_memory_budget(bytes: u64) -> c_int;
+
+    // Priority of a shedding action, lower values are shed first.
+    // @name : "symbol-cache"  evict the symbol caches not used recently (10)
+    //         "stack-str"     flush the stack string caches (20)
+    //         "profiler-freq" keep one in four on-CPU samples (30)
+    //         "socket-data"   cap the socket data queued for the workers (40)
+    pub fn set_bpf_memory_shed_priority(name: *const c_char, priority: c_int) -> c_int;
+
     // Parameter descriptions:
     // callback: Callback interface from Rust to C; return values refer to definitions of TRACER_CALLBACK_FLAG_*.
     // thread_nr: Number of worker threads, indicating how many user-space threads participate in data processing.
@@ -799,6 +915,15 @@ extern "C" {
     pub fn disable_oncpu_profiler() -> c_int;
     pub fn show_collect_pool();
     pub fn disable_syscall_trace_id() -> c_int;
+    // Keys the socket information by the kernel socket, set before running_socket_tracer().
+    pub fn set_socket_key_by_sk(enabled: bool) -> c_int;
+    /*
+     * Index the HTTP/1.x start line and the values of up to HTTP1_HDR_NAMES_MAX
+     * headers (comma separated names) in the kernel, kfunc eBPF programs only.
+     * An empty string indexes the start line and the header block only, NULL
+     * disables it, `headers_only` drops the body.
+     */
+    pub fn set_http1_header_extract(names: *const c_char, headers_only: bool) -> c_int;
 
     pub fn dwarf_available() -> bool;
     /*
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../user/utils.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+#include "../user/types.h"
+#include "../user/clib.h"
+
+int main(void)
+{
+	clib_mem_init();
+	clib_mem_arena_t arena;
+	int i;
+
+	clib_mem_arena_init(&arena, "test_arena", 4096);
+
+	/* Small allocations share a block and are 8-byte aligned. */
+	char *a = clib_mem_arena_alloc(&arena, 3);
+	char *b = clib_mem_arena_alloc(&arena, 5);
+	if (a == NULL || b == NULL || b - a != 8) {
+		printf("arena small alloc failed\n");
+		return (-1);
+	}
+
+	if (arena.block_count != 1 || arena.alloc_count != 2) {
+		printf("arena stats error, blocks %lu allocs %lu\n",
+		       arena.block_count, arena.alloc_count);
+		return (-1);
+	}
+
+	/* Oversized request gets a dedicated block. */
+	char *big = clib_mem_arena_alloc(&arena, 10000);
+	if (big == NULL || arena.block_count != 2) {
+		printf("arena big alloc failed\n");
+		return (-1);
+	}
+	memset(big, 0xff, 10000);
+
+	for (i = 0; i < 1000; i++) {
+		if (clib_mem_arena_alloc(&arena, 64) == NULL) {
+			printf("arena alloc failed\n");
+			return (-1);
+		}
+	}
+
+	u64 alloc_b, free_b;
+	get_mem_stat(&alloc_b, &free_b);
+	printf("before reset: blocks %lu allocs %lu alloc_b %lu free_b %lu\n",
+	       arena.block_count, arena.alloc_count, alloc_b, free_b);
+
+	/* Only the first regular block is kept for reuse. */
+	clib_mem_arena_reset(&arena);
+	if (arena.head == NULL || arena.head->next != NULL ||
+	    arena.head->used != 0 || arena.alloc_count != 0) {
+		printf("arena reset failed\n");
+		return (-1);
+	}
+
+	char *c = clib_mem_arena_alloc(&arena, 16);
+	if (c != (char *)arena.head->data || arena.block_count != 0) {
+		printf("arena reuse failed\n");
+		return (-1);
+	}
+
+	clib_mem_arena_free(&arena);
+	get_mem_stat(&alloc_b, &free_b);
+	printf("after free: alloc_b %lu free_b %lu\n", alloc_b, free_b);
+	if (alloc_b != free_b) {
+		printf("arena memory leak\n");
+		return (-1);
+	}
+
+	printf("[OK]\n");
+	return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../user/utils.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+#include "../user/types.h"
+#include "../user/config.h"
+#include "../user/mem_governor.h"
+
+static int shed_a, shed_b, restore_b;
+static char order[8];
+static int order_nr;
+
+static void a_shed(void)
+{
+	if (shed_a++ == 0)
+		order[order_nr++] = 'a';
+}
+
+static void b_shed(void)
+{
+	if (shed_b++ == 0)
+		order[order_nr++] = 'b';
+}
+
+static void b_restore(void)
+{
+	restore_b++;
+	shed_b = 0;
+}
+
+static void settle(u64 usage)
+{
+	int i;
+	for (i = 0; i < MEM_GOVERNOR_SETTLE_CHECKS; i++)
+		mem_governor_check_usage(usage);
+}
+
+int main(void)
+{
+	const u64 budget = 1000000;
+	const u64 high = budget / 100 * MEM_GOVERNOR_HIGH_PCT;
+	const u64 low = budget / 100 * MEM_GOVERNOR_LOW_PCT;
+
+	clib_mem_init();
+
+	/* The priority set before the registration is kept. */
+	mem_governor_set_priority("a", 5);
+	mem_governor_register("b", 1, b_shed, b_restore);
+	mem_governor_register("a", 100, a_shed, NULL);
+
+	/* No budget, nothing to do. */
+	settle(budget * 2);
+	if (shed_a || shed_b) {
+		printf("shed without budget\n");
+		return (-1);
+	}
+
+	mem_governor_set_budget(budget);
+
+	/* Under the high threshold. */
+	settle(high - 1);
+	if (shed_a || shed_b) {
+		printf("shed under the high threshold\n");
+		return (-1);
+	}
+
+	/* One action at a time, in priority order. */
+	mem_governor_check_usage(high);
+	if (shed_b != 1 || shed_a != 0) {
+		printf("first action error, a %d b %d\n", shed_a, shed_b);
+		return (-1);
+	}
+	mem_governor_check_usage(high);
+	if (shed_a != 0 || shed_b != 2) {
+		printf("action applied before settling\n");
+		return (-1);
+	}
+	settle(high);
+	if (shed_a == 0 || order[0] != 'b' || order[1] != 'a') {
+		printf("second action error, order %s\n", order);
+		return (-1);
+	}
+
+	/* Between the thresholds, the state is kept. */
+	settle(low);
+	struct {
+		struct mem_governor_stat stat;
+		struct mem_shed_stat actions[MEM_GOVERNOR_ACTIONS_MAX];
+	} s;
+	mem_governor_stats(&s.stat);
+	if (s.stat.count != 2 || !s.actions[0].active || !s.actions[1].active
+	    || s.actions[0].activate_count != 1 || s.stat.usage != low) {
+		printf("stats error\n");
+		return (-1);
+	}
+
+	/* Reverted in the reverse order. */
+	mem_governor_check_usage(low - 1);
+	mem_governor_stats(&s.stat);
+	if (restore_b != 0 || s.actions[1].active || !s.actions[0].active) {
+		printf("first revert error\n");
+		return (-1);
+	}
+	settle(low - 1);
+	mem_governor_stats(&s.stat);
+	if (restore_b != 1 || s.actions[0].active) {
+		printf("second revert error\n");
+		return (-1);
+	}
+
+	/* Removing the budget reverts everything. */
+	settle(high);
+	settle(high);
+	mem_governor_set_budget(0);
+	mem_governor_check_usage(high);
+	mem_governor_stats(&s.stat);
+	if (s.actions[0].active || s.actions[1].active || restore_b != 2) {
+		printf("budget removal error\n");
+		return (-1);
+	}
+
+	printf("[OK]\n");
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/mman.h>
+#include "../user/utils.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+#include "../user/types.h"
+#include "../user/clib.h"
+#include "../user/bihash_8_8.h"
+
+#define ARENA_SZ (8ULL << 20)
+
+static int map_and_check(clib_mem_hugepage_mode_t mode)
+{
+	clib_mem_vm_backing_t backing;
+	u64 hugetlb_b, thp_b, normal_b, before;
+	u64 *stats[CLIB_MEM_VM_BACKING_MAX] = { &normal_b, &thp_b, &hugetlb_b };
+
+	clib_mem_set_hugepage_mode(mode);
+	uword base = clib_mem_vm_reserve(ARENA_SZ, CLIB_MEM_PAGE_SZ_2M);
+	if (base == ~0) {
+		printf("mode %d: reserve failed\n", mode);
+		return -1;
+	}
+
+	get_mem_vm_stat(&hugetlb_b, &thp_b, &normal_b);
+	before = hugetlb_b + thp_b + normal_b;
+
+	/* Whatever the backing, the memory must be usable. */
+	void *p = clib_mem_vm_map_fixed((void *)base, ARENA_SZ,
+					CLIB_MEM_PAGE_SZ_2M, &backing);
+	if (p != (void *)base) {
+		printf("mode %d: map failed\n", mode);
+		return -1;
+	}
+	memset(p, 0x5a, ARENA_SZ);
+
+	get_mem_vm_stat(&hugetlb_b, &thp_b, &normal_b);
+	if (hugetlb_b + thp_b + normal_b - before != ARENA_SZ ||
+	    *stats[backing] < ARENA_SZ) {
+		printf("mode %d: mapped bytes not accounted\n", mode);
+		return -1;
+	}
+
+	/* Without hugetlb pages the explicit mode falls back. */
+	if (mode == CLIB_MEM_HUGEPAGE_TRANSPARENT &&
+	    backing == CLIB_MEM_VM_HUGETLB) {
+		printf("mode %d: unexpected hugetlb backing\n", mode);
+		return -1;
+	}
+
+	printf("mode %d: %s\n", mode, clib_mem_vm_backing_str(backing));
+	clib_mem_vm_free((void *)base, ARENA_SZ);
+	return 0;
+}
+
+int main(void)
+{
+	clib_mem_init();
+
+	if (map_and_check(CLIB_MEM_HUGEPAGE_DEFAULT) ||
+	    map_and_check(CLIB_MEM_HUGEPAGE_TRANSPARENT) ||
+	    map_and_check(CLIB_MEM_HUGEPAGE_EXPLICIT))
+		return (-1);
+
+	/* A hash table grows its arena with the selected mode. */
+	clib_bihash_8_8_t h;
+	clib_bihash_kv_8_8_t kv;
+	u64 i;
+	clib_mem_set_hugepage_mode(CLIB_MEM_HUGEPAGE_EXPLICIT);
+	clib_bihash_init_8_8(&h, "test_hugepage", 1024, 1ULL << 26);
+	for (i = 1; i <= 100000; i++) {
+		kv.key = i;
+		kv.value = i * 2;
+		if (clib_bihash_add_del_8_8(&h, &kv, 1)) {
+			printf("bihash add failed\n");
+			return (-1);
+		}
+	}
+
+	kv.key = 4242;
+	if (clib_bihash_search_8_8(&h, &kv, &kv) || kv.value != 8484) {
+		printf("bihash search failed\n");
+		return (-1);
+	}
+
+	print_bihash_8_8(&h);
+	clib_bihash_free_8_8(&h);
+	printf("[OK]\n");
+	return 0;
+}
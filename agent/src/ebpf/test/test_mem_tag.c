@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include "../user/utils.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+#include "../user/types.h"
+#include "../user/clib.h"
+
+#define NR_PTRS 100
+
+static void *ptrs[NR_PTRS];
+
+static struct mem_tag_stat *find_tag(struct mem_tag_stat *stats, int count,
+				     const char *name)
+{
+	int i;
+	for (i = 0; i < count; i++) {
+		if (strcmp(stats[i].name, name) == 0)
+			return &stats[i];
+	}
+	return NULL;
+}
+
+/* Allocate in another thread, which exits before the memory is freed. */
+static void *alloc_thread(void *arg)
+{
+	int i;
+	for (i = 0; i < NR_PTRS; i++)
+		ptrs[i] = clib_mem_alloc_aligned("test_thread", 1000, 0, NULL);
+	return NULL;
+}
+
+int main(void)
+{
+	struct mem_tag_stat stats[CLIB_MEM_TAGS_MAX];
+	struct mem_tag_stat *s;
+	pthread_t thread;
+	int i, count;
+
+	clib_mem_init();
+
+	pthread_create(&thread, NULL, alloc_thread, NULL);
+	pthread_join(thread, NULL);
+
+	count = clib_mem_tag_stats(stats);
+	s = find_tag(stats, count, "test_thread");
+	if (s == NULL || s->alloc_count != NR_PTRS || s->in_use < NR_PTRS * 1000) {
+		printf("thread alloc not accounted\n");
+		return (-1);
+	}
+	u64 peak = s->in_use;
+
+	/* Freed by another thread. */
+	for (i = 0; i < NR_PTRS; i++)
+		clib_mem_free(ptrs[i]);
+
+	count = clib_mem_tag_stats(stats);
+	s = find_tag(stats, count, "test_thread");
+	if (s->in_use != 0 || s->free_count != NR_PTRS ||
+	    s->high_watermark != peak) {
+		printf("thread free error, in_use %lu hwm %lu\n", s->in_use,
+		       s->high_watermark);
+		return (-1);
+	}
+
+	/* The name is compared, not only its address. */
+	char name[CLIB_MEM_TAG_NAME_LEN];
+	snprintf(name, sizeof(name), "tag_a");
+	void *a = clib_mem_alloc_aligned(name, 64, 0, NULL);
+	snprintf(name, sizeof(name), "tag_b");
+	uword sz;
+	void *b = clib_mem_alloc_aligned(name, 64, 0, NULL);
+	b = clib_mem_realloc_aligned("tag_c", b, 256, 0, &sz);
+	count = clib_mem_tag_stats(stats);
+	if (find_tag(stats, count, "tag_a")->in_use != 72 ||
+	    find_tag(stats, count, "tag_b")->in_use != 0 ||
+	    find_tag(stats, count, "tag_c")->in_use != 264) {
+		printf("tag by name error\n");
+		return (-1);
+	}
+	clib_mem_free(a);
+	clib_mem_free(b);
+
+	/* Virtual memory is not counted as heap memory. */
+	u64 alloc_b, free_b, alloc_b2, free_b2;
+	get_mem_stat(&alloc_b, &free_b);
+	clib_mem_vm_account("hash:test", 1 << 20);
+	get_mem_stat(&alloc_b2, &free_b2);
+	count = clib_mem_tag_stats(stats);
+	s = find_tag(stats, count, "hash:test");
+	if (alloc_b2 != alloc_b || s == NULL || !s->is_vm ||
+	    s->in_use != 1 << 20) {
+		printf("vm account error\n");
+		return (-1);
+	}
+	clib_mem_vm_account("hash:test", -(1 << 20));
+
+	/* Tags beyond the table are counted as 'other'. */
+	for (i = 0; i < CLIB_MEM_TAGS_MAX; i++) {
+		snprintf(name, sizeof(name), "many_%d", i);
+		clib_mem_free(clib_mem_alloc_aligned(name, 8, 0, NULL));
+	}
+	count = clib_mem_tag_stats(stats);
+	s = find_tag(stats, count, "other");
+	if (count != CLIB_MEM_TAGS_MAX || s->alloc_count == 0 ||
+	    s->in_use != 0) {
+		printf("tag table overflow error\n");
+		return (-1);
+	}
+
+	printf("[OK]\n");
+	return 0;
+}
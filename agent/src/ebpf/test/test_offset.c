@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "../user/utils.h"
 #include "../user/offset.h"
 #include <stdio.h>
 
@@ -33,5 +34,21 @@ int main(void)
 
 	printf("[OK]\n");
 
+	struct member_offset_req reqs[] = {
+		{ .structure = "runtime.g", .member = "goid" },
+		{ .structure = "runtime.g", .member = "no_such_member" },
+	};
+
+	// The second call is served from the build ID memo.
+	for (int i = 0; i < 2; i++) {
+		if (struct_member_offsets_analyze(test_go_file, reqs, 2) != 1 ||
+		    reqs[0].offset != 152 || reqs[1].offset != ETR_INVAL) {
+			printf("[FAIL]\n");
+			return -1;
+		}
+	}
+
+	printf("[OK]\n");
+
 	return 0;
 }
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../user/utils.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+#include "../user/types.h"
+#include "../user/vec.h"
+#include "../user/tracer.h"
+#include "../user/reorder.h"
+
+#define MAX_EMITTED 64
+
+static u64 emitted[MAX_EMITTED];
+static int emitted_nr;
+
+static int record_cb(void *ctx, int queue_id, void *cp_data)
+{
+	struct socket_bpf_data *sd = cp_data;
+	if (emitted_nr < MAX_EMITTED)
+		emitted[emitted_nr++] = sd->socket_id << 32 | sd->cap_seq;
+	return 0;
+}
+
+static void submit(struct reorder_buffer *rb, u64 socket_id, u64 seq, u64 now)
+{
+	struct {
+		struct socket_bpf_data sd;
+		char data[8];
+	} d;
+	memset(&d, 0, sizeof(d));
+	d.sd.socket_id = socket_id;
+	d.sd.cap_seq = seq;
+	d.sd.source = DATA_SOURCE_SYSCALL;
+	d.sd.cap_len = 4;
+	d.sd.cap_data = (char *)((void **)&d.sd.cap_data + 1);
+	memcpy(d.sd.cap_data, "abc", 4);
+	reorder_submit(rb, &d.sd, now);
+}
+
+static int check(const char *name, const u64 * expect, int nr)
+{
+	int i;
+	if (emitted_nr != nr)
+		goto failed;
+	for (i = 0; i < nr; i++) {
+		if (emitted[i] != expect[i])
+			goto failed;
+	}
+	emitted_nr = 0;
+	return 0;
+
+failed:
+	printf("%s: unexpected order:", name);
+	for (i = 0; i < emitted_nr; i++)
+		printf(" %lu:%lu", emitted[i] >> 32, emitted[i] & 0xffffffff);
+	printf("\n");
+	return -1;
+}
+
+#define SEQ(s, q) ((u64)(s) << 32 | (q))
+
+int main(void)
+{
+	clib_mem_init();
+	struct bpf_tracer t;
+	struct reorder_buffer rb;
+	const u64 hold_ns = 1000;
+
+	memset(&t, 0, sizeof(t));
+	t.process_fn = record_cb;
+	if (reorder_buffer_init(&rb, &t, 0)) {
+		printf("reorder_buffer_init failed\n");
+		return (-1);
+	}
+
+	/* In order data is emitted immediately. */
+	submit(&rb, 1, 10, 0);
+	submit(&rb, 1, 11, 0);
+	const u64 e1[] = { SEQ(1, 10), SEQ(1, 11) };
+	if (check("in order", e1, 2))
+		return (-1);
+
+	/* 13 and 14 are held until 12 arrives. */
+	submit(&rb, 1, 14, 0);
+	submit(&rb, 1, 13, 0);
+	submit(&rb, 2, 100, 0);
+	submit(&rb, 1, 12, 0);
+	const u64 e2[] = { SEQ(2, 100), SEQ(1, 12), SEQ(1, 13), SEQ(1, 14) };
+	if (check("reorder", e2, 4) || rb.reordered_count != 2)
+		return (-1);
+
+	/* Late data is emitted as is. */
+	submit(&rb, 1, 11, 0);
+	const u64 e3[] = { SEQ(1, 11) };
+	if (check("late", e3, 1) || rb.late_count != 1)
+		return (-1);
+
+	/* 16 waits for 15, which never comes. */
+	submit(&rb, 1, 16, 0);
+	reorder_flush(&rb, hold_ns / 2, hold_ns);
+	if (emitted_nr != 0 || rb.held_count != 1) {
+		printf("data emitted before the hold time\n");
+		return (-1);
+	}
+	reorder_flush(&rb, hold_ns, hold_ns);
+	const u64 e4[] = { SEQ(1, 16) };
+	if (check("gap", e4, 1) || rb.gap_count != 1 || rb.held_count != 0)
+		return (-1);
+
+	submit(&rb, 1, 17, hold_ns);
+	const u64 e5[] = { SEQ(1, 17) };
+	if (check("after gap", e5, 1))
+		return (-1);
+
+	/* Reset emits the held data. */
+	submit(&rb, 3, 5, 0);
+	submit(&rb, 3, 7, 0);
+	reorder_buffer_reset(&rb);
+	const u64 e6[] = { SEQ(3, 5), SEQ(3, 7) };
+	if (check("reset", e6, 2) || rb.hash.hash_elems_count != 0)
+		return (-1);
+
+	reorder_buffer_release(&rb);
+	printf("[OK]\n");
+	return 0;
+}
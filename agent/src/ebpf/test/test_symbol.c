@@ -182,5 +182,48 @@ int main(void)
 
 	printf("[OK]\n");
 
+	printf("Test func resolve_and_gen_uprobe_symbols() : ");
+	struct symbol_uprobe *probe_batch[NELEMS(probe_syms)];
+	struct elf_sym_index_stats stats;
+	int batch_count = 0;
+	for (int round = 0; round < 2; round++) {
+		batch_count =
+		    resolve_and_gen_uprobe_symbols(test_go_file, probe_syms,
+						   NELEMS(probe_syms), 0,
+						   probe_batch);
+		if (batch_count != count) {
+			printf("[FAIL] resolved %d, expected %d\n",
+			       batch_count, count);
+			return -1;
+		}
+
+		for (int i = 0; i < NELEMS(probe_syms); i++) {
+			if (probe_batch[i] == NULL)
+				continue;
+			probe_sym =
+			    resolve_and_gen_uprobe_symbol(test_go_file,
+							  &probe_syms[i], 0, 0);
+			if (probe_sym == NULL ||
+			    probe_sym->entry != probe_batch[i]->entry ||
+			    probe_sym->size != probe_batch[i]->size ||
+			    probe_sym->rets_count !=
+			    probe_batch[i]->rets_count) {
+				printf("[FAIL] %s\n", probe_syms[i].symbol);
+				return -1;
+			}
+			free_uprobe_symbol(probe_sym, NULL);
+			free_uprobe_symbol(probe_batch[i], NULL);
+		}
+	}
+
+	// The second round is served by the index.
+	get_elf_sym_index_stats(&stats);
+	if (stats.builds != 1 || stats.hits != 1) {
+		printf("[FAIL] builds %lu hits %lu\n", stats.builds,
+		       stats.hits);
+		return -1;
+	}
+	printf("[OK] %lu us\n", stats.resolve_time_ns / 1000);
+
 	return 0;
 }
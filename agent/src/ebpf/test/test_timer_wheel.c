@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+#include "../user/utils.h"
+#include "../user/log.h"
+#include "../user/types.h"
+#include "../user/timer.h"
+
+static int fast_runs, slow_runs, long_runs, worker_runs;
+static volatile int worker_block;
+
+static int fast_job(void)
+{
+	fast_runs++;
+	return 0;
+}
+
+static int slow_job(void)
+{
+	slow_runs++;
+	return 0;
+}
+
+static int long_job(void)
+{
+	long_runs++;
+	return 0;
+}
+
+static int worker_job(void)
+{
+	while (worker_block)
+		usleep(1000);
+	__sync_fetch_and_add(&worker_runs, 1);
+	return 0;
+}
+
+static struct timer_job *find_job(struct timer_wheel *w, const char *name)
+{
+	struct timer_job *job;
+	list_for_each_entry(job, &w->jobs, all) {
+		if (strcmp(job->name, name) == 0)
+			return job;
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	struct timer_wheel w;
+	u64 base, t, next;
+
+	/* Large tick, so that the wall clock does not move during the test. */
+	if (timer_wheel_init(&w, 1000000000ULL, 0, NULL) != ETR_OK) {
+		printf("timer_wheel_init failed\n");
+		return (-1);
+	}
+
+	base = w.cur_tick;
+	timer_wheel_add_job(&w, "fast", fast_job, 2, TIMER_JOB_INLINE);
+	timer_wheel_add_job(&w, "slow", slow_job, 5, TIMER_JOB_INLINE);
+	/* Longer than the wheel, the job stays in its slot for rounds. */
+	timer_wheel_add_job(&w, "long", long_job, TIMER_WHEEL_SLOTS + 10,
+			    TIMER_JOB_INLINE);
+
+	next = timer_wheel_expire(&w, base);
+	if (next != base + 2) {
+		printf("next tick error, %lu expected %lu\n", next, base + 2);
+		return (-1);
+	}
+
+	for (t = base + 1; t <= base + 10; t++)
+		timer_wheel_expire(&w, t);
+
+	if (fast_runs != 5 || slow_runs != 2 || long_runs != 0) {
+		printf("runs error, fast %d slow %d long %d\n", fast_runs,
+		       slow_runs, long_runs);
+		return (-1);
+	}
+
+	/* Jump ahead: each missed run is counted as an overrun. */
+	timer_wheel_expire(&w, base + TIMER_WHEEL_SLOTS + 10);
+	struct timer_job *fast = find_job(&w, "fast");
+	if (long_runs != 1 || fast_runs != 6 || fast->overrun_count == 0) {
+		printf("jump error, long %d fast %d overrun %lu\n", long_runs,
+		       fast_runs, fast->overrun_count);
+		return (-1);
+	}
+	if (fast->expire <= base + TIMER_WHEEL_SLOTS + 10) {
+		printf("fast job is not rescheduled in the future\n");
+		return (-1);
+	}
+
+	timer_wheel_set_job_invalid(&w, "slow");
+	int slow_before = slow_runs;
+	for (t = base + TIMER_WHEEL_SLOTS + 11;
+	     t <= base + TIMER_WHEEL_SLOTS + 30; t++)
+		timer_wheel_expire(&w, t);
+	if (slow_runs != slow_before) {
+		printf("invalid job still runs\n");
+		return (-1);
+	}
+
+	/* Worker jobs: a run is skipped while the previous one is busy. */
+	struct timer_wheel ww;
+	if (timer_wheel_init(&ww, 1000000000ULL, 1, NULL) != ETR_OK) {
+		printf("timer_wheel_init with worker failed\n");
+		return (-1);
+	}
+
+	worker_block = 1;
+	base = ww.cur_tick;
+	timer_wheel_add_job(&ww, "worker", worker_job, 1, 0);
+	for (t = base + 1; t <= base + 4; t++)
+		timer_wheel_expire(&ww, t);
+	worker_block = 0;
+
+	int i;
+	for (i = 0; i < 1000 && worker_runs == 0; i++)
+		usleep(1000);
+	usleep(10000);
+
+	struct timer_job *wj = find_job(&ww, "worker");
+	if (worker_runs != 1 || wj->overrun_count != 3) {
+		printf("worker error, runs %d overrun %lu\n", worker_runs,
+		       wj->overrun_count);
+		return (-1);
+	}
+
+	timer_wheel_show_stats(&w);
+	timer_wheel_show_stats(&ww);
+	printf("[OK]\n");
+
+	return 0;
+}
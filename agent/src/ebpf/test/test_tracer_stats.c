@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Per-event cost of the socket data path statistics, shared atomic
+ * counters (as before) against the per reader thread shards, and check
+ * that the shards add up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../user/utils.h"
+#include "../user/tracer.h"
+
+#define THREADS 4
+#define EVENTS (5 * 1000 * 1000)
+
+struct shared_stats {
+	atomic64_t rx_pkts;
+	atomic64_t rx_bytes;
+	atomic64_t enqueue_nr;
+	atomic64_t proto_stats[PROTO_NUM];
+};
+
+static struct shared_stats shared;
+static struct tracer_stats stats;
+static struct tracer_stats_shard shards[2 * THREADS];
+
+static void *shared_worker(void *arg)
+{
+	int i;
+	for (i = 0; i < EVENTS; i++) {
+		atomic64_inc(&shared.rx_pkts);
+		atomic64_add(&shared.rx_bytes, i & 0xff);
+		atomic64_inc(&shared.proto_stats[i & 0x7]);
+		atomic64_inc(&shared.enqueue_nr);
+	}
+	return NULL;
+}
+
+static void *shard_worker(void *arg)
+{
+	struct tracer_stats_shard *st = &stats.shards[(uint64_t) arg];
+	int i;
+	for (i = 0; i < EVENTS; i++) {
+		tracer_stats_add(st, rx_pkts, 1);
+		tracer_stats_add(st, rx_bytes, i & 0xff);
+		tracer_stats_add(st, proto_stats[i & 0x7], 1);
+		tracer_stats_add(st, enqueue_nr, 1);
+	}
+	return NULL;
+}
+
+static double run(void *(*fn) (void *))
+{
+	pthread_t threads[THREADS];
+	uint64_t start, i;
+
+	start = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+	for (i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, fn, (void *)i);
+	for (i = 0; i < THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	return (double)(gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) - start) /
+	    EVENTS;
+}
+
+int main(void)
+{
+	uint64_t bytes = 0;
+	double shared_ns, shard_ns;
+	int i;
+
+	stats.shards = shards;
+	stats.base = shards + THREADS;
+	stats.count = THREADS;
+
+	for (i = 0; i < EVENTS; i++)
+		bytes += i & 0xff;
+	bytes *= THREADS;
+
+	shared_ns = run(shared_worker);
+	shard_ns = run(shard_worker);
+	printf("%d threads, per event: shared atomics %.2f ns, "
+	       "shards %.2f ns\n", THREADS, shared_ns, shard_ns);
+
+	if (atomic64_read(&shared.rx_pkts) != (uint64_t) EVENTS * THREADS ||
+	    tracer_stats_sum(&stats, rx_pkts, false) !=
+	    (uint64_t) EVENTS * THREADS ||
+	    tracer_stats_sum(&stats, rx_bytes, false) != bytes ||
+	    tracer_stats_sum(&stats, proto_stats[3], false) !=
+	    (uint64_t) EVENTS / 8 * THREADS) {
+		printf("[FAIL] sum\n");
+		return -1;
+	}
+
+	// Reset, then only the events after it are counted.
+	if (tracer_stats_sum(&stats, enqueue_nr, true) !=
+	    (uint64_t) EVENTS * THREADS) {
+		printf("[FAIL] reset\n");
+		return -1;
+	}
+	tracer_stats_add(&stats.shards[1], enqueue_nr, 5);
+	if (tracer_stats_sum(&stats, enqueue_nr, false) != 5 ||
+	    tracer_stats_fetch(&stats, 1, enqueue_nr, true) != 5 ||
+	    tracer_stats_sum(&stats, enqueue_nr, false) != 0) {
+		printf("[FAIL] reset\n");
+		return -1;
+	}
+
+	printf("[OK]\n");
+	return 0;
+}
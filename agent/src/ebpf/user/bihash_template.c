@@ -32,14 +32,18 @@
 
 // Bounded-index extensible hash
 
-#ifndef MAP_HUGE_SHIFT
-#define MAP_HUGE_SHIFT 26
-#endif
-
 #ifndef BIIHASH_MIN_ALLOC_LOG2_PAGES
 #define BIIHASH_MIN_ALLOC_LOG2_PAGES 10
 #endif
 
+/* The arena memory is accounted to the tag "hash:<name>". */
+static void BV(clib_bihash_vm_account) (BVT(clib_bihash) * h, i64 bytes) {
+	char tag[CLIB_MEM_TAG_NAME_LEN];
+	snprintf(tag, sizeof(tag), "hash:%s",
+		 h->name ? (char *)h->name : "unnamed");
+	clib_mem_vm_account(tag, bytes);
+}
+
 int BV(clib_bihash_is_initialised) (const BVT(clib_bihash) * h) {
 	return (h->instantiated != 0);
 }
@@ -55,6 +59,7 @@ void BV(clib_bihash_free) (BVT(clib_bihash) * h) {
 	clib_mem_free((void *)h->alloc_lock);
 	vec_free(h->freelists);
 	clib_mem_vm_free((void *)(uword) (alloc_arena(h)), alloc_arena_size(h));
+	BV(clib_bihash_vm_account) (h, -(i64) alloc_arena_mapped(h));
 never_initialized:
 	/* hash-header struct not free */
 	/* if not add to clib_all_bihashes, return */
@@ -82,11 +87,7 @@ static inline void *BV(alloc_aligned) (BVT(clib_bihash) * h, uint64_t nbytes) {
 	if (alloc_arena_next(h) > alloc_arena_mapped(h)) {
 		void *base, *rv;
 		uint64_t alloc = alloc_arena_next(h) - alloc_arena_mapped(h);
-		int mmap_flags = MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS;
-		/* MAP_HUGETLB need CAP_SYS_RESOURCE */
-		int mmap_flags_huge = (mmap_flags | MAP_HUGETLB | MAP_LOCKED |
-				       BIHASH_LOG2_HUGEPAGE_SIZE <<
-				       MAP_HUGE_SHIFT);
+		clib_mem_vm_backing_t backing;
 
 		/* new allocation is 25% of existing one */
 		if (alloc_arena_mapped(h) >> 2 > alloc)
@@ -98,24 +99,26 @@ static inline void *BV(alloc_aligned) (BVT(clib_bihash) * h, uint64_t nbytes) {
 		base =
 		    (void *)(uint64_t) (alloc_arena(h) + alloc_arena_mapped(h));
 
-		rv = mmap(base, alloc, PROT_READ | PROT_WRITE, mmap_flags_huge,
-			  -1, 0);
-
-		/*
-		 * fallback - maybe we are still able to allocate normal pages
-		 * mlock() need root or CAP_IPC_LOCK
-		 */
-		if (rv == MAP_FAILED || mlock(base, alloc) != 0)
-			rv = mmap(base, alloc, PROT_READ | PROT_WRITE,
-				  mmap_flags, -1, 0);
-
+		rv = clib_mem_vm_map_fixed(base, alloc,
+					   BIHASH_LOG2_HUGEPAGE_SIZE, &backing);
 		if (rv == MAP_FAILED) {
 			ebpf_warning("mmap() failed - %s (%d)", strerror(errno),
 				     errno);
 			return NULL;
 		}
 
+		/* Report the first mapping and any change of the backing. */
+		if (alloc_arena_mapped(h) == 0 || backing != h->vm_backing) {
+			if (clib_mem_get_hugepage_mode() !=
+			    CLIB_MEM_HUGEPAGE_DEFAULT)
+				ebpf_info("Hash table '%s' maps %lu bytes on %s\n",
+					  h->name, alloc,
+					  clib_mem_vm_backing_str(backing));
+			h->vm_backing = backing;
+		}
+
 		alloc_arena_mapped(h) += alloc;
+		BV(clib_bihash_vm_account) (h, alloc);
 	}
 
 	return (void *)(uint64_t) (rv + alloc_arena(h));
@@ -986,10 +989,13 @@ void BV(print_bihash) (BVT(clib_bihash) * h) {
 	ebpf_info("    %lu linear search buckets\n", linear_buckets);
 	u64 CLIB_UNUSED(used_bytes) = alloc_arena_next(h);
 	ebpf_info("    arena: base 0x%lx, next %lu\n"
-		  "           used %lu b (%lu Mbytes) of %lu b (%lu Mbytes)\n",
+		  "           used %lu b (%lu Mbytes) of %lu b (%lu Mbytes)\n"
+		  "           mapped %lu b (%lu Mbytes), last on %s\n",
 		  alloc_arena(h), alloc_arena_next(h),
 		  used_bytes, used_bytes >> 20,
-		  alloc_arena_size(h), alloc_arena_size(h) >> 20);
+		  alloc_arena_size(h), alloc_arena_size(h) >> 20,
+		  alloc_arena_mapped(h), alloc_arena_mapped(h) >> 20,
+		  clib_mem_vm_backing_str(h->vm_backing));
 }
 
 int BV(clib_bihash_add_or_overwrite_stale)
@@ -213,6 +213,8 @@ typedef BVS(clib_bihash)
 	 * to the global bihash list(vec: clib_all_bihashes).
 	 */
 	u8 dont_add_to_all_bihash_list;
+	/* clib_mem_vm_backing_t of the last mapped arena memory */
+	u8 vm_backing;
 	u64 alloc_arena;	/* Base of the allocation arena */
 	u64 add_increment_stat;	/* kv pair add */
 	u64 replace_increment_stat;	/* kv pair replace old */
@@ -23,6 +23,8 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <sys/utsname.h>
+#include <pthread.h>
+#include "config.h"
 #include "utils.h"
 #include "log.h"
 #include "elf.h"
@@ -35,6 +37,7 @@
 #include "kernel/include/utils.h"	// ARRAY_SIZE
 #include "hashmap.h"
 #include "relo_core.h"
+#include "mem_governor.h"
 
 extern const char *btf__name_by_offset(const struct btf *btf, __u32 offset);
 extern __s32 btf__find_by_name_kind(const struct btf *btf,
@@ -64,11 +67,6 @@ static bool prog_contains_insn(struct ebpf_prog *prog, size_t insn_idx)
 	    insn_idx < prog->sec_insn_off + prog->sec_insn_cnt;
 }
 
-static void *u32_as_hash_key(__u32 x)
-{
-	return (void *)(uintptr_t) x;
-}
-
 static inline long PTR_ERR(const void *ptr)
 {
 	return (long)ptr;
@@ -79,11 +77,134 @@ static inline void *ERR_PTR(long error_)
 	return (void *)error_;
 }
 
+/*
+ * The vmlinux BTF is parsed once and shared by all the eBPF objects
+ * (reference counted, see vmlinux_btf_get()). The cache itself holds a
+ * reference, so that the objects loaded one after the other (tracers
+ * started later, loader falling back to another build) do not parse it
+ * again, this reference is dropped under memory pressure ("vmlinux-btf"
+ * shedding action).
+ *
+ * The CO-RE candidates of a local type only depend on its kind and its
+ * essential name, they are looked up once for all the programs and
+ * objects, keyed by "<kind>:<essential name>".
+ */
+static struct {
+	pthread_mutex_t lock;
+	struct btf *btf;
+	int refcnt;
+	bool cached;
+	struct hashmap *cands;
+} vmlinux = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static pthread_once_t vmlinux_shed_once = PTHREAD_ONCE_INIT;
+
+static struct btf *ebpf__load_vmlinux_btf(void);
+
+static size_t cand_key_hash_fn(const void *key, void *ctx)
+{
+	return str_hash(key);
+}
+
+static bool cand_key_equal_fn(const void *k1, const void *k2, void *ctx)
+{
+	return strcmp(k1, k2) == 0;
+}
+
+static void vmlinux_cands_free(void)
+{
+	struct hashmap_entry *entry;
+	size_t i;
+
+	if (DF_IS_ERR_OR_NULL(vmlinux.cands))
+		return;
+
+	hashmap__for_each_entry(vmlinux.cands, entry, i) {
+		free((void *)entry->key);
+		bpf_core_free_cands(entry->value);
+	}
+	hashmap__free(vmlinux.cands);
+	vmlinux.cands = NULL;
+}
+
+static void vmlinux_btf_put_locked(void)
+{
+	if (vmlinux.refcnt == 0 || --vmlinux.refcnt > 0)
+		return;
+
+	// The candidates refer to the types of this BTF.
+	vmlinux_cands_free();
+	btf__free(vmlinux.btf);
+	vmlinux.btf = NULL;
+	ebpf_info("vmlinux BTF released.\n");
+}
+
+static void vmlinux_btf_shed(void)
+{
+	pthread_mutex_lock(&vmlinux.lock);
+	if (vmlinux.cached) {
+		vmlinux.cached = false;
+		vmlinux_btf_put_locked();
+	}
+	pthread_mutex_unlock(&vmlinux.lock);
+}
+
+static void vmlinux_btf_shed_register(void)
+{
+	mem_governor_register("vmlinux-btf", MEM_SHED_PRIO_VMLINUX_BTF,
+			      vmlinux_btf_shed, NULL);
+}
+
+struct btf *vmlinux_btf_get(void)
+{
+	struct btf *btf;
+	uint64_t start;
+
+	pthread_once(&vmlinux_shed_once, vmlinux_btf_shed_register);
+
+	pthread_mutex_lock(&vmlinux.lock);
+	if (vmlinux.btf == NULL) {
+		start = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+		vmlinux.btf = ebpf__load_vmlinux_btf();
+		if (vmlinux.btf == NULL) {
+			pthread_mutex_unlock(&vmlinux.lock);
+			return NULL;
+		}
+		vmlinux.refcnt = 1;
+		vmlinux.cached = true;
+		ebpf_info("vmlinux BTF parsed in %lu us.\n",
+			  (gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) -
+			   start) / 1000);
+	}
+	vmlinux.refcnt++;
+	btf = vmlinux.btf;
+	pthread_mutex_unlock(&vmlinux.lock);
+
+	return btf;
+}
+
+void vmlinux_btf_put(struct btf *btf)
+{
+	if (DF_IS_ERR_OR_NULL(btf))
+		return;
+
+	pthread_mutex_lock(&vmlinux.lock);
+	if (btf == vmlinux.btf)
+		vmlinux_btf_put_locked();
+	pthread_mutex_unlock(&vmlinux.lock);
+}
+
 const char *btf_name_by_offset(const struct btf *btf, __u32 offset)
 {
 	return btf__name_by_offset(btf, offset);
 }
 
+/*
+ * Look up the candidates in the shared cache first, vmlinux.lock is held
+ * (see obj_relocate_core()).
+ */
 static struct bpf_core_cand_list *bpf_core_find_cands(struct ebpf_object *obj, const struct btf
 						      *local_btf,
 						      __u32 local_type_id)
@@ -94,6 +215,7 @@ static struct bpf_core_cand_list *bpf_core_find_cands(struct ebpf_object *obj, c
 	const struct btf_type *local_t;
 	const char *local_name;
 	size_t local_essent_len;
+	char *key;
 	int err;
 
 	local_cand.btf = local_btf;
@@ -107,39 +229,63 @@ static struct bpf_core_cand_list *bpf_core_find_cands(struct ebpf_object *obj, c
 		return ERR_PTR(-EINVAL);
 	local_essent_len = bpf_core_essential_name_len(local_name);
 
+	main_btf = obj->btf_vmlinux;
+	if (main_btf == NULL || main_btf != vmlinux.btf)
+		return ERR_PTR(-EINVAL);
+
+	if (vmlinux.cands == NULL) {
+		vmlinux.cands = hashmap__new(cand_key_hash_fn,
+					     cand_key_equal_fn, NULL);
+		if (DF_IS_ERR(vmlinux.cands)) {
+			vmlinux.cands = NULL;
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+
+	key = malloc(local_essent_len + 16);
+	if (key == NULL)
+		return ERR_PTR(-ENOMEM);
+	snprintf(key, local_essent_len + 16, "%u:%.*s",
+		 (local_t->info >> 24) & 0x1f, (int)local_essent_len,
+		 local_name);
+
+	if (hashmap__find(vmlinux.cands, key, (void **)&cands)) {
+		free(key);
+		return cands;
+	}
+
 	cands = calloc(1, sizeof(*cands));
-	if (!cands)
+	if (!cands) {
+		free(key);
 		return ERR_PTR(-ENOMEM);
+	}
 
-	main_btf = obj->btf_vmlinux;
 	err =
 	    bpf_core_add_cands(&local_cand, local_essent_len, main_btf,
 			       "vmlinux", 1, cands);
 	if (err)
 		goto err_out;
 
-	/* if vmlinux BTF has any candidate, don't got for module BTFs */
-	if (cands->len)
-		return cands;
+	err = hashmap__add(vmlinux.cands, key, cands);
+	if (err)
+		goto err_out;
 
 	return cands;
 err_out:
+	free(key);
 	bpf_core_free_cands(cands);
 	return ERR_PTR(err);
 }
 
 static int bpf_core_resolve_relo(struct ebpf_prog *prog,
 				 const struct btf *btf,
-				 struct hashmap *cand_cache,
 				 int relo_idx, const struct bpf_core_relo *rec,
 				 struct bpf_core_relo_res *targ_res)
 {
 	struct bpf_core_spec specs_scratch[3] = {};
 	struct bpf_core_cand_list *cands = NULL;
-	const void *type_key = u32_as_hash_key(rec->type_id);
 	const struct btf_type *local_type;
 	const char *local_name;
-	int err;
 
 	// BTF type ID of the "root" (containing) entity of a relocatable
 	u32 local_id = rec->type_id;
@@ -155,8 +301,7 @@ static int bpf_core_resolve_relo(struct ebpf_prog *prog,
 	     prog->name, relo_idx, local_id, btf_kind_str(local_type),
 	     local_name);
 
-	if (rec->kind != BPF_CORE_TYPE_ID_LOCAL &&
-	    !hashmap__find(cand_cache, type_key, (void **)&cands)) {
+	if (rec->kind != BPF_CORE_TYPE_ID_LOCAL) {
 		cands = bpf_core_find_cands(prog->obj, btf, local_id);
 		if (DF_IS_ERR(cands)) {
 			ebpf_warning
@@ -165,11 +310,6 @@ static int bpf_core_resolve_relo(struct ebpf_prog *prog,
 			     btf_kind_str(local_type), local_name, (long)cands);
 			return (long)cands;
 		}
-		err = hashmap__set(cand_cache, type_key, cands, NULL, NULL);
-		if (err) {
-			bpf_core_free_cands(cands);
-			return err;
-		}
 	}
 	// check_core_relo(btf, rec);
 
@@ -180,16 +320,6 @@ static int bpf_core_resolve_relo(struct ebpf_prog *prog,
 				       specs_scratch, targ_res);
 }
 
-static size_t bpf_core_hash_fn(const void *key, void *ctx)
-{
-	return (size_t) key;
-}
-
-static bool bpf_core_equal_fn(const void *k1, const void *k2, void *ctx)
-{
-	return k1 == k2;
-}
-
 /*
  * Clang has a built-in attribute __attribute__((preserve_access_index))
  * (equivalent to __builtin_preserve_access_index). Uses this attribute to
@@ -208,14 +338,7 @@ int obj_relocate_core(struct ebpf_prog *prog)
 	struct bpf_core_relo_res targ_res;
 	struct bpf_insn *insn;
 
-	struct hashmap_entry *entry;
-	struct hashmap *cand_cache = NULL;
-	cand_cache = hashmap__new(bpf_core_hash_fn, bpf_core_equal_fn, NULL);
-	if (DF_IS_ERR(cand_cache)) {
-		err = PTR_ERR(cand_cache);
-		return -1;
-	}
-
+	pthread_mutex_lock(&vmlinux.lock);
 	seg = &obj->btf_ext->core_relo_info;
 	sec_num = 0;
 	// Traverse the section of BTF extended information.
@@ -224,12 +347,15 @@ int obj_relocate_core(struct ebpf_prog *prog)
 		sec_num++;
 		sec_name = btf__name_by_offset(obj->btf, sec->sec_name_off);
 		if (str_is_empty(sec_name)) {
-			return -1;
+			err = -1;
+			goto out;
 		}
 		// Traverse the CO-RE relocation information.
 		for_each_btf_ext_rec(seg, sec, i, rec) {
-			if (rec->insn_off % BPF_INSN_SZ)
-				return -1;
+			if (rec->insn_off % BPF_INSN_SZ) {
+				err = -1;
+				goto out;
+			}
 			insn_idx = rec->insn_off / BPF_INSN_SZ;
 			// Verify whether this PORG contains BTF relocation information.
 			if (strcmp(sec_name, desc->name) == 0
@@ -246,13 +372,14 @@ int obj_relocate_core(struct ebpf_prog *prog)
 				     desc->shndx, desc->shndx_rel, insn_idx,
 				     prog->insns_cnt);
 
-				if (insn_idx >= prog->insns_cnt)
-					return -1;
+				if (insn_idx >= prog->insns_cnt) {
+					err = -1;
+					goto out;
+				}
 				insn = &prog->insns[insn_idx];
 				err =
 				    bpf_core_resolve_relo(prog, obj->btf,
-							  cand_cache, i, rec,
-							  &targ_res);
+							  i, rec, &targ_res);
 				if (err) {
 					ebpf_warning
 					    ("prog '%s': relo #%d: failed to relocate: %d\n",
@@ -275,12 +402,7 @@ int obj_relocate_core(struct ebpf_prog *prog)
 	}
 
 out:
-	if (!DF_IS_ERR_OR_NULL(cand_cache)) {
-		hashmap__for_each_entry(cand_cache, entry, i) {
-			bpf_core_free_cands(entry->value);
-		}
-		hashmap__free(cand_cache);
-	}
+	pthread_mutex_unlock(&vmlinux.lock);
 	return err;
 }
 
@@ -332,7 +454,7 @@ static struct btf *ebpf__load_vmlinux_btf(void)
 int ebpf_obj__load_vmlinux_btf(struct ebpf_object *obj)
 {
 	obj->btf_vmlinux = NULL;
-	struct btf *btf = ebpf__load_vmlinux_btf();
+	struct btf *btf = vmlinux_btf_get();
 	if (btf == NULL)
 		return ETR_INVAL;
 	obj->btf_vmlinux = btf;
@@ -397,7 +519,8 @@ int kernel_struct_field_offset(struct ebpf_object *obj, const char *struct_name,
 
 int get_kfunc_params_num(const char *func_name)
 {
-	struct btf *btf = ebpf__load_vmlinux_btf();
+	int num = -1;
+	struct btf *btf = vmlinux_btf_get();
 	if (!btf) {
 		ebpf_info("Failed to load vmlinux BTF\n");
 		return -1;
@@ -406,21 +529,22 @@ int get_kfunc_params_num(const char *func_name)
 	int type_id = btf__find_by_name_kind(btf, func_name, BTF_KIND_FUNC);
 	if (type_id < 0) {
 		ebpf_warning("Failed to find BTF type for %s\n", func_name);
-		return -1;
+		goto out;
 	}
 	const struct btf_type *t = btf__type_by_id(btf, type_id);
 	if (!t) {
 		ebpf_warning
 		    ("Invalid BTF type or not a function prototype for %s\n",
 		     func_name);
-		return -1;
+		goto out;
 	}
 	if ((((t->info) >> 24) & 0x1f) != BTF_KIND_FUNC)
-		return -1;
+		goto out;
 	t = btf__type_by_id(btf, t->type);
 	if (!t || (((t->info) >> 24) & 0x1f) != BTF_KIND_FUNC_PROTO)
-		return -1;
-	int num = ((t->info) & 0xffff);
-	btf__free(btf);
+		goto out;
+	num = ((t->info) & 0xffff);
+out:
+	vmlinux_btf_put(btf);
 	return num;
 }
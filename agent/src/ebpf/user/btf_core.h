@@ -89,6 +89,12 @@ struct btf_ext_info_sec {
 #define BTF_INFO_KFLAG(info)    ((info) >> 31)
 #define BTF_MEM_OFFSET(T, O)    (BTF_INFO_KFLAG((T)) ? BTF_MEMBER_BIT_OFFSET((O)) : (O))
 
+/*
+ * Shared vmlinux BTF, parsed on the first call. Each vmlinux_btf_get()
+ * must be paired with a vmlinux_btf_put().
+ */
+struct btf *vmlinux_btf_get(void);
+void vmlinux_btf_put(struct btf *btf);
 int ebpf_obj__load_vmlinux_btf(struct ebpf_object *obj);
 int kernel_struct_field_offset(struct ebpf_object *obj, const char *struct_name,
 			       const char *field_name);
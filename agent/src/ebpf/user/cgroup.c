@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/vfs.h>
+#include "config.h"
+#include "types.h"
+#include "clib.h"
+#include "mem.h"
+#include "vec.h"
+#include "log.h"
+#include "utils.h"
+#include "cgroup.h"
+
+#ifndef CGROUP2_SUPER_MAGIC
+#define CGROUP2_SUPER_MAGIC 0x63677270
+#endif
+
+#define CGROUP_V2_MOUNT "/sys/fs/cgroup"
+
+/*
+ * The cgroup IDs are only usable with the cgroup v2 unified hierarchy,
+ * with cgroup v1 all the tasks share the root cgroup of the default
+ * hierarchy.
+ */
+static bool cgroup_cid_enabled;
+static cgroup_cid_hash_t cgroup_cid_hash;
+// Used by open_by_handle_at() to get the cgroup path from its ID.
+static int cgroup_mount_fd = -1;
+static int cgroup_handle_type = -1;
+
+/*
+ * The entries removed from the hash may still be read by the socket
+ * readers, they are freed on the next cleanup.
+ */
+static struct cgroup_cid **cgroup_cid_unlinked;
+
+static u64 cgroup_cid_hit_count;
+static u64 cgroup_cid_miss_count;
+static u64 cgroup_cid_procfs_count;
+
+int cgroup_cid_cache_init(void)
+{
+	struct statfs st;
+	if (statfs(CGROUP_V2_MOUNT, &st) != 0
+	    || st.f_type != CGROUP2_SUPER_MAGIC) {
+		ebpf_info("cgroup v2 unified hierarchy is not mounted on "
+			  CGROUP_V2_MOUNT ", the container ID is read from "
+			  "procfs.\n");
+		return ETR_NOTSUPP;
+	}
+
+	if (cgroup_cid_hash_init(&cgroup_cid_hash, "cgroup_cid",
+				 CGROUP_CID_HASH_BUCKETS_NUM,
+				 CGROUP_CID_HASH_MEM_SZ)) {
+		ebpf_warning("cgroup_cid_hash_init() failed.\n");
+		return ETR_NOMEM;
+	}
+
+	/*
+	 * Learn the file handle type of the cgroup filesystem, the handle
+	 * of a cgroup is its 8 bytes cgroup ID.
+	 */
+	u64 buf[(sizeof(struct file_handle) + sizeof(u64)) / sizeof(u64) + 1];
+	struct file_handle *fh = (struct file_handle *)buf;
+	int mount_id;
+	fh->handle_bytes = sizeof(u64);
+	if (name_to_handle_at(AT_FDCWD, CGROUP_V2_MOUNT, fh, &mount_id, 0) == 0
+	    && fh->handle_bytes == sizeof(u64)) {
+		cgroup_mount_fd = open(CGROUP_V2_MOUNT,
+				       O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (cgroup_mount_fd >= 0)
+			cgroup_handle_type = fh->handle_type;
+	}
+
+	if (cgroup_handle_type < 0)
+		ebpf_info("cgroup file handles are not supported (errno %d), "
+			  "the container ID of a cgroup is read from procfs.\n",
+			  errno);
+
+	cgroup_cid_enabled = true;
+	return ETR_OK;
+}
+
+static int cgroup_path_from_id(u64 cgroup_id, char *path, int size)
+{
+	u64 buf[(sizeof(struct file_handle) + sizeof(u64)) / sizeof(u64) + 1];
+	struct file_handle *fh = (struct file_handle *)buf;
+	char link[64];
+	int fd, len;
+
+	fh->handle_bytes = sizeof(u64);
+	fh->handle_type = cgroup_handle_type;
+	memcpy(fh->f_handle, &cgroup_id, sizeof(u64));
+	fd = open_by_handle_at(cgroup_mount_fd, fh, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+	len = readlink(link, path, size - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+
+	path[len] = '\0';
+	return 0;
+}
+
+/*
+ * Resolve the container ID of a cgroup.
+ *
+ * @return 0 if the result can be cached, -1 otherwise (the task exited
+ *   before its cgroup was resolved).
+ */
+static int cgroup_cid_resolve(struct cgroup_cid *c, pid_t pid)
+{
+	char path[PATH_MAX];
+
+	if (cgroup_handle_type >= 0 &&
+	    cgroup_path_from_id(c->cgroup_id, path, sizeof(path)) == 0) {
+		fetch_container_id_from_str(path, c->container_id,
+					    sizeof(c->container_id));
+		return 0;
+	}
+
+	__sync_fetch_and_add(&cgroup_cid_procfs_count, 1);
+	if (fetch_container_id_from_proc(pid, c->container_id,
+					 sizeof(c->container_id)) == 0)
+		return 0;
+
+	snprintf(path, sizeof(path), "/proc/%d", pid);
+	return access(path, F_OK) == 0 ? 0 : -1;
+}
+
+static void copy_container_id(struct cgroup_cid *c, char *id, int copy_bytes)
+{
+	memset(id, 0, copy_bytes);
+	memcpy_s_inline((void *)id, copy_bytes, (void *)c->container_id,
+			strlen(c->container_id));
+}
+
+int fetch_container_id_from_cgroup(u64 cgroup_id, pid_t pid, char *id,
+				   int copy_bytes)
+{
+	if (!cgroup_cid_enabled || cgroup_id == 0)
+		return fetch_container_id_from_proc(pid, id, copy_bytes);
+
+	cgroup_cid_hash_kv kv;
+	struct cgroup_cid *c;
+	kv.key = cgroup_id;
+	kv.value = 0;
+	if (cgroup_cid_hash_search(&cgroup_cid_hash, &kv, &kv) == 0) {
+		__sync_fetch_and_add(&cgroup_cid_hit_count, 1);
+		c = (struct cgroup_cid *)kv.value;
+		c->used = 1;
+		if (c->container_id[0] == '\0')
+			return -1;
+		copy_container_id(c, id, copy_bytes);
+		return 0;
+	}
+
+	__sync_fetch_and_add(&cgroup_cid_miss_count, 1);
+	c = clib_mem_alloc_aligned("cgroup_cid", sizeof(*c), 0, NULL);
+	if (c == NULL)
+		return fetch_container_id_from_proc(pid, id, copy_bytes);
+
+	memset(c, 0, sizeof(*c));
+	c->cgroup_id = cgroup_id;
+	c->used = 1;
+	int ret = cgroup_cid_resolve(c, pid);
+	int found = c->container_id[0] != '\0' ? 0 : -1;
+	if (found == 0)
+		copy_container_id(c, id, copy_bytes);
+
+	if (ret != 0 || cgroup_cid_hash.hash_elems_count >= CGROUP_CID_CACHE_MAX) {
+		clib_mem_free(c);
+		return found;
+	}
+
+	kv.key = cgroup_id;
+	kv.value = pointer_to_uword(c);
+	/* Another reader may have added the cgroup, do not overwrite it. */
+	if (cgroup_cid_hash_add_del(&cgroup_cid_hash, &kv, 2 /* add only */ )) {
+		clib_mem_free(c);
+	} else {
+		__sync_fetch_and_add(&cgroup_cid_hash.hash_elems_count, 1);
+	}
+
+	return found;
+}
+
+struct cgroup_cid_walk {
+	struct cgroup_cid **unused;
+};
+
+static int collect_unused_cgroup_cb(cgroup_cid_hash_kv * kv, void *arg)
+{
+	struct cgroup_cid *c = (struct cgroup_cid *)kv->value;
+	struct cgroup_cid_walk *w = arg;
+	int ret = VEC_OK;
+
+	if (c->used) {
+		c->used = 0;
+		return BIHASH_WALK_CONTINUE;
+	}
+
+	vec_add1(w->unused, c, ret);
+	if (ret != VEC_OK)
+		return BIHASH_WALK_STOP;
+
+	return BIHASH_WALK_CONTINUE;
+}
+
+int cgroup_cid_cache_clean(void)
+{
+	struct cgroup_cid **c;
+
+	if (!cgroup_cid_enabled)
+		return 0;
+
+	vec_foreach(c, cgroup_cid_unlinked) {
+		clib_mem_free(*c);
+	}
+	vec_free(cgroup_cid_unlinked);
+
+	struct cgroup_cid_walk w = {.unused = NULL };
+	cgroup_cid_hash_foreach_key_value_pair(&cgroup_cid_hash,
+					       collect_unused_cgroup_cb,
+					       (void *)&w);
+	vec_foreach(c, w.unused) {
+		cgroup_cid_hash_kv kv;
+		kv.key = (*c)->cgroup_id;
+		kv.value = 0;
+		if (cgroup_cid_hash_add_del(&cgroup_cid_hash, &kv,
+					    0 /* delete */ ) == 0)
+			__sync_fetch_and_add(&cgroup_cid_hash.
+					     hash_elems_count, -1);
+	}
+	cgroup_cid_unlinked = w.unused;
+
+	ebpf_debug("cgroup container ID cache: elems %lu removed %d hit %lu "
+		   "miss %lu procfs %lu\n", cgroup_cid_hash.hash_elems_count,
+		   vec_len(w.unused), cgroup_cid_hit_count,
+		   cgroup_cid_miss_count, cgroup_cid_procfs_count);
+	return 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DF_USER_CGROUP_H
+#define DF_USER_CGROUP_H
+
+#include "bihash_8_8.h"
+#include "utils.h"
+
+#define cgroup_cid_hash_t		clib_bihash_8_8_t
+#define cgroup_cid_hash_init		clib_bihash_init_8_8
+#define cgroup_cid_hash_kv		clib_bihash_kv_8_8_t
+#define cgroup_cid_hash_search		clib_bihash_search_8_8
+#define cgroup_cid_hash_add_del		clib_bihash_add_del_8_8
+#define cgroup_cid_hash_free		clib_bihash_free_8_8
+#define cgroup_cid_hash_foreach_key_value_pair	clib_bihash_foreach_key_value_pair_8_8
+
+/*
+ * Container ID of a cgroup v2 cgroup. The kernel stamps the socket data
+ * with the cgroup ID of the current task, the container ID is resolved
+ * once per cgroup.
+ */
+struct cgroup_cid {
+	u64 cgroup_id;
+	// Set on lookup, entries not used between two cleanups are removed.
+	volatile u8 used;
+	// Empty if the cgroup does not belong to a container.
+	char container_id[CONTAINER_ID_SIZE];
+};
+
+int cgroup_cid_cache_init(void);
+/*
+ * Get the container ID by the cgroup ID, falls back to /proc/<pid>/cgroup
+ * if the cgroup ID can not be used (cgroup v1, Linux < 4.18).
+ *
+ * @return 0 if the container ID is found, -1 otherwise.
+ */
+int fetch_container_id_from_cgroup(u64 cgroup_id, pid_t pid, char *id,
+				   int copy_bytes);
+// Periodic event, removes the cgroups that are no longer used.
+int cgroup_cid_cache_clean(void);
+
+#endif /* DF_USER_CGROUP_H */
@@ -38,6 +38,7 @@
 #define MAP_MEMBERS_OFFSET_NAME         "__members_offset"
 #define MAP_SOCKET_INFO_NAME            "__socket_info_map"
 #define MAP_TRACE_NAME                  "__trace_map"
+#define MAP_TRACE_TASK_NAME             "__trace_task_map"
 #define MAP_PERF_SOCKET_DATA_NAME       "__socket_data"
 #define MAP_TRACER_CTX_NAME             "__tracer_ctx_map"
 #define MAP_TRACE_STATS_NAME            "__trace_stats_map"
@@ -47,6 +48,10 @@
 #define MAP_PROTO_PORTS_BITMAPS_NAME	"__proto_ports_bitmap"
 #define MAP_ALLOW_REASM_PROTOS_NAME     "__allow_reasm_protos_map"
 #define MAP_PKTS_STATES_NAME		"__pkts_stats_map"
+#define MAP_IO_HIST_0_NAME		"__io_hist_map_0"
+#define MAP_IO_HIST_1_NAME		"__io_hist_map_1"
+#define MAP_IO_HIST_CTL_NAME		"__io_hist_ctl"
+#define MAP_IO_HIST_DIR_NAME		"__io_hist_dir_map"
 
 //Program jmp tables
 #define MAP_PROGS_JMP_KP_NAME		"__progs_jmp_kp_map"
@@ -154,13 +159,24 @@ enum {
 
 #define PROFILER_CTX_NUM 3
 
+/*
+ * Number of period worker threads. The periodic events that may take a
+ * long time (e.g. process and mount information checks) are executed on
+ * the workers instead of the period timer thread.
+ */
+#define PERIOD_WORKERS_NUM 1
+// Worker used for the process and mount information maintenance.
+#define PERIOD_WORKER_PROC_INFO 0
+
 //thread index for bihash
 enum {
 	THREAD_PROFILER_READER_IDX = 0,
 	THREAD_OFFCPU_READER_IDX = 1,
 	THREAD_MEMORY_READER_IDX = 2,
 	THREAD_PROC_EVENTS_HANDLE_IDX = 3,
-	THREAD_SOCK_READER_IDX_BASE = 4,
+	THREAD_PERIOD_WORKER_IDX_BASE = 4,
+	THREAD_SOCK_READER_IDX_BASE =
+	    THREAD_PERIOD_WORKER_IDX_BASE + PERIOD_WORKERS_NUM,
 };
 
 // index number of feature.
@@ -268,6 +284,37 @@ enum cfg_feature_idx {
 
 #define STRINGIFIER_STACK_STR_HASH_BUCKETS_NUM	8192
 #define STRINGIFIER_STACK_STR_HASH_MEM_SZ	(1ULL << 30)	// 1Gbytes
+/*
+ * Kernel stack strings are cached per stack map across iterations (key:
+ * kernel stack ID), an entry is dropped when its stack map slot is cleared.
+ */
+#define KERN_STACK_STR_HASH_BUCKETS_NUM		8192
+#define KERN_STACK_STR_HASH_MEM_SZ		(1ULL << 28)	// 256Mbytes
+/*
+ * Interpreter frames (Python/PHP/V8) resolved through the extended hook are
+ * cached across iterations. When the number of cached frames reaches
+ * INTERP_FRAME_CACHE_MAX_ELEMS the whole cache is flushed.
+ */
+#define INTERP_FRAME_CACHE_BUCKETS_NUM		8192
+#define INTERP_FRAME_CACHE_MEM_SZ		(1ULL << 27)	// 128Mbytes
+#define INTERP_FRAME_CACHE_MAX_ELEMS		65536
+// Frames that could not be resolved are retried after this many seconds.
+#define INTERP_FRAME_NEGATIVE_TTL		60
+// Block size of the per-iteration arena holding the stack strings.
+#define STRINGIFIER_ARENA_BLOCK_SZ		(1ULL << 20)	// 1Mbytes
+// The folded stack string of one stack trace is built in this buffer.
+#define STRINGIFIER_FOLDED_BUF_SZ		(PERF_MAX_STACK_DEPTH * 1024)
+// Maximum length of a single symbol string.
+#define SYMBOL_STR_MAX				4096
+
+/*
+ * Userspace index of the interpreter '__symbol_table' map (key: symbol id).
+ * An entry that has not been seen in the eBPF map for
+ * 'SYMBOL_INDEX_STALE_SYNCS' consecutive synchronizations is dropped.
+ */
+#define SYMBOL_INDEX_HASH_BUCKETS_NUM		1024
+#define SYMBOL_INDEX_HASH_MEM_SZ		(1ULL << 26)	// 64Mbytes
+#define SYMBOL_INDEX_STALE_SYNCS		2
 
 #define SYMBOLIZER_CACHES_HASH_BUCKETS_NUM	8192
 #define SYMBOLIZER_CACHES_HASH_MEM_SZ		(1ULL << 31)	// 2Gbytes
@@ -373,6 +420,72 @@ enum cfg_feature_idx {
  */
 #define CHECK_KERN_ADAPT_PERIOD 100	// 100 ticks(1 seconds)
 
+
+/*
+ * Period of the process information cache update (process exec/exit
+ * events) and of the datadump timeout check.
+ */
+#define PROC_INFO_CACHE_UPDATE_PERIOD 10	// 10 ticks(100 millisecond)
+#define DATADUMP_TIMEOUT_CHECK_PERIOD 10	// 10 ticks(100 millisecond)
+
+/*
+ * Output the statistics (run count, latency, overrun) of the periodic
+ * events to the log.
+ */
+#define PERIOD_JOBS_STATS_PERIOD 360000	// 360000 ticks(1 hour)
+
+// Period of the memory tag high-watermark update.
+#define MEM_TAG_WATERMARK_PERIOD 100	// 100 ticks(1 second)
+
+/*
+ * cgroup ID to container ID cache. The cgroups not seen between two
+ * cleanups are removed.
+ */
+#define CGROUP_CID_HASH_BUCKETS_NUM 4096
+#define CGROUP_CID_HASH_MEM_SZ (1ULL << 24)
+#define CGROUP_CID_CACHE_MAX 65536
+#define CGROUP_CID_CACHE_CLEAN_PERIOD 6000	// 6000 ticks(1 minute)
+
+/*
+ * Memory governor, the process RSS is checked against the configured
+ * budget. Above MEM_GOVERNOR_HIGH_PCT of the budget the next shedding
+ * action (by priority) is applied, below MEM_GOVERNOR_LOW_PCT the last
+ * applied action is reverted. Consecutive changes are at least
+ * MEM_GOVERNOR_SETTLE_CHECKS checks apart, so that the effect of an action
+ * is seen before the next one.
+ */
+#define MEM_GOVERNOR_CHECK_PERIOD 100	// 100 ticks(1 second)
+#define MEM_GOVERNOR_HIGH_PCT 85
+#define MEM_GOVERNOR_LOW_PCT 70
+#define MEM_GOVERNOR_SETTLE_CHECKS 5
+#define MEM_GOVERNOR_ACTIONS_MAX 16
+
+// Default shedding priorities, lower values are shed first.
+#define MEM_SHED_PRIO_VMLINUX_BTF 5
+#define MEM_SHED_PRIO_SYMBOL_CACHE 10
+#define MEM_SHED_PRIO_STACK_STR 20
+#define MEM_SHED_PRIO_PROFILER_FREQ 30
+#define MEM_SHED_PRIO_SOCKET_DATA 40
+
+// Symbol caches not used for this long are evicted under memory pressure.
+#define SYMBOL_CACHE_COLD_SECS 60
+/*
+ * Under memory pressure, only one in 2^PROFILER_SHED_SAMPLE_SHIFT on-CPU
+ * samples is kept.
+ */
+#define PROFILER_SHED_SAMPLE_SHIFT 2
+/*
+ * Under memory pressure, the socket data is dropped when more than
+ * 1/2^SOCKET_SHED_QUEUE_SHIFT of a dispatch queue is in use.
+ */
+#define SOCKET_SHED_QUEUE_SHIFT 3
+
+/*
+ * File IO latency histograms (see set_io_latency_hist()) are drained from
+ * the kernel map and passed to the callback with this period.
+ */
+#define IO_HIST_DRAIN_PERIOD 1000	// 1000 ticks(10 seconds)
+
 /*
  * The maximum space occupied by the Java symbol files in the target POD.
  * Its valid range is [2, 100], which means it falls within the interval
@@ -442,6 +555,42 @@ enum cfg_feature_idx {
  */
 #define PERIODIC_PUSH_DELAY_THRESHOLD_NS 50000000ULL	// 50 milliseconds
 
+/*
+ * Messages of a socket on the metadata only ports (see
+ * set_metadata_port_bitmap()) pushed with their payload, the later ones
+ * only carry the metadata. Covers the first request and response.
+ */
+#define METADATA_ONLY_PAYLOAD_MSGS 2
+
+/*
+ * Socket data reorder stage (see reorder.h), disabled by default and
+ * enabled by set_socket_data_reorder().
+ *
+ * SOCKET_REORDER_MAX_HOLD_US: default maximum time data is held waiting
+ *   for the missing sequence numbers of its socket.
+ * SOCKET_REORDER_HELD_MAX: maximum data held for one socket.
+ * SOCKET_REORDER_IDLE_NS: the state of a socket without data for this
+ *   long is removed, checked every SOCKET_REORDER_SWEEP_NS.
+ */
+#define SOCKET_REORDER_MAX_HOLD_US 5000	// 5 milliseconds
+#define SOCKET_REORDER_HELD_MAX 64
+#define SOCKET_REORDER_IDLE_NS 60000000000ULL	// 60 seconds
+#define SOCKET_REORDER_SWEEP_NS 1000000000ULL	// 1 second
+#define SOCKET_REORDER_HASH_BUCKETS_NUM 4096
+#define SOCKET_REORDER_HASH_MEM_SZ (1ULL << 26)	// 64Mbytes
+
+/*
+ * Number of binaries whose resolved uprobe symbols are kept, see the ELF
+ * symbol index in symbol.c.
+ */
+#define ELF_SYM_INDEX_CACHE_SIZE 32
+
+/*
+ * Number of binaries (by build ID) whose DWARF struct member offsets are
+ * kept, see struct_member_offsets_analyze().
+ */
+#define MEMBER_OFFSET_MEMO_SIZE 32
+
 /*
  * The update interval for process information is 5 minutes in nanoseconds.
  */
@@ -456,4 +605,10 @@ enum cfg_feature_idx {
  * Output to the log once every hour to prevent the log file from containing too much content.
  */
 #define OUTPUT_LOG_INTERVAL_NS 3600000000000ULL
+
+// Update intervals converted to timer ticks (EVENT_TIMER_TICK_US).
+#define PROCESS_CACHE_UPDATE_PERIOD \
+	(PROCESS_CACHE_UPDATE_INTERVAL_NS / (EVENT_TIMER_TICK_US * 1000ULL))
+#define MOUNT_CACHE_UPDATE_PERIOD \
+	(MOUNT_CACHE_UPDATE_INTERVAL_NS / (EVENT_TIMER_TICK_US * 1000ULL))
 #endif /* DF_EBPF_CONFIG_H */
@@ -23,6 +23,8 @@
 #include <limits.h>
 #include "tracer.h"
 #include "socket.h"
+#include "mem.h"
+#include "mem_governor.h"
 
 #define DF_BPF_NAME           "deepflow-ebpfctl"
 #define DF_BPF_VERSION        "v1.0.0"
@@ -106,6 +108,12 @@ static void socktrace_help(void)
 		DF_BPF_NAME, DF_BPF_NAME);
 }
 
+static void memstat_help(void)
+{
+	fprintf(stderr, "Memory usage per allocation tag\n");
+	fprintf(stderr, "Usage:\n" "    %s memstat show\n", DF_BPF_NAME);
+}
+
 static void match_pids_help(void)
 {
 	fprintf(stderr, "Print match pids to log\n");
@@ -799,6 +807,94 @@ static int socktrace_do_cmd(struct df_bpf_obj *obj, df_bpf_cmd_t cmd,
 	}
 }
 
+static int memgov_show(void)
+{
+	struct mem_governor_stat *stat;
+	size_t size;
+	int err, i;
+
+	err = df_bpf_getsockopt(SOCKOPT_GET_MEMGOV_SHOW, NULL, 0,
+				(void **)&stat, &size);
+	if (err != 0)
+		return err;
+
+	if (size < sizeof(*stat)
+	    || size != sizeof(*stat) +
+	    stat->count * sizeof(struct mem_shed_stat)) {
+		fprintf(stderr, "corrupted response.\n");
+		df_bpf_sockopt_msg_free(stat);
+		return ETR_INVAL;
+	}
+
+	if (stat->budget == 0) {
+		printf("\nmemory governor disabled (no budget)\n");
+		df_bpf_sockopt_msg_free(stat);
+		return ETR_OK;
+	}
+
+	printf("\nmemory governor budget %lu bytes, usage (RSS) %lu bytes\n",
+	       stat->budget, stat->usage);
+	printf("%-16s %8s %-8s %12s %12s %16s\n", "ACTION", "PRIORITY",
+	       "STATE", "ACTIVATIONS", "SHEDS", "LAST-USAGE(bytes)");
+	for (i = 0; i < stat->count; i++) {
+		struct mem_shed_stat *s = &stat->actions[i];
+		printf("%-16s %8d %-8s %12lu %12lu %16lu\n", s->name,
+		       s->priority, s->active ? "active" : "idle",
+		       s->activate_count, s->shed_count, s->last_usage);
+	}
+
+	df_bpf_sockopt_msg_free(stat);
+	return ETR_OK;
+}
+
+static int memstat_do_cmd(struct df_bpf_obj *obj, df_bpf_cmd_t cmd,
+			  struct df_bpf_conf *conf)
+{
+	struct mem_tag_stat_array *array;
+	u64 heap_in_use = 0, vm_in_use = 0;
+	size_t size;
+	int err, i;
+
+	switch (conf->cmd) {
+	case DF_BPF_CMD_SHOW:
+		err = df_bpf_getsockopt(SOCKOPT_GET_MEMSTAT_SHOW, NULL, 0,
+					(void **)&array, &size);
+		if (err != 0)
+			return err;
+
+		if (size < sizeof(*array)
+		    || size != sizeof(*array) +
+		    array->count * sizeof(struct mem_tag_stat)) {
+			fprintf(stderr, "corrupted response.\n");
+			df_bpf_sockopt_msg_free(array);
+			return ETR_INVAL;
+		}
+
+		printf("%-32s %-5s %16s %16s %14s %14s\n", "TAG", "TYPE",
+		       "IN-USE(bytes)", "HIGH-WM(bytes)", "ALLOCS", "FREES");
+		for (i = 0; i < array->count; i++) {
+			struct mem_tag_stat *s = &array->stats[i];
+			if (s->alloc_count == 0)
+				continue;
+			printf("%-32s %-5s %16lu %16lu %14lu %14lu\n", s->name,
+			       s->is_vm ? "vm" : "heap", s->in_use,
+			       s->high_watermark, s->alloc_count,
+			       s->free_count);
+			if (s->is_vm)
+				vm_in_use += s->in_use;
+			else
+				heap_in_use += s->in_use;
+		}
+		printf("\nheap in use %lu bytes, vm arenas mapped %lu bytes\n",
+		       heap_in_use, vm_in_use);
+
+		df_bpf_sockopt_msg_free(array);
+		return memgov_show();
+	default:
+		return ETR_NOTSUPP;
+	}
+}
+
 static int match_pids_do_cmd(struct df_bpf_obj *obj, df_bpf_cmd_t cmd,
 			     struct df_bpf_conf *conf)
 {
@@ -1117,13 +1213,19 @@ struct df_bpf_obj match_pids_obj = {
 	.do_cmd = match_pids_do_cmd,
 };
 
+struct df_bpf_obj memstat_obj = {
+	.name = "memstat",
+	.help = memstat_help,
+	.do_cmd = memstat_do_cmd,
+};
+
 static void usage(void)
 {
 	fprintf(stderr,
 		"Usage:\n"
 		"    " DF_BPF_NAME " [OPTIONS] OBJECT { COMMAND | help }\n"
 		"Parameters:\n"
-		"    OBJECT  := { tracer socktrace datadump cpdbg match_pids}\n"
+		"    OBJECT  := { tracer socktrace datadump cpdbg match_pids memstat}\n"
 		"    COMMAND := { show list set print}\n"
 		"Options:\n"
 		"    -v, --verbose\n"
@@ -1142,6 +1244,8 @@ static struct df_bpf_obj *df_bpf_obj_get(const char *name)
 		return &cpdbg_obj;
 	} else if (strcmp(name, "match_pids") == 0) {
 		return &match_pids_obj;
+	} else if (strcmp(name, "memstat") == 0) {
+		return &memstat_obj;
 	}
 
 	return NULL;
@@ -539,3 +539,120 @@ int elf_info_collect(struct elf_info *elf_info, const void *buf, size_t buf_sz)
 
 	return ret;
 }
+
+/*
+ * Offset of the Go current g pointer from the thread pointer (fsbase on
+ * x86_64). The runtime keeps it in the TLS slot 'runtime.tlsg', with the
+ * local-exec TLS model the slot is addressed from the end of the PT_TLS
+ * block. Internally linked binaries always use -8.
+ */
+int elf_go_g_tls_offset(const char *path, int *offset)
+{
+	Elf *e;
+	Elf_Scn *scn = NULL;
+	Elf_Data *data;
+	GElf_Shdr shdr;
+	GElf_Phdr phdr;
+	GElf_Sym sym;
+	size_t i, n, cnt;
+	uint64_t tls_size = 0, tls_align = 1;
+	bool has_tls = false, found = false;
+	const char *name;
+	int fd;
+
+	*offset = -8;
+	if (openelf(path, &e, &fd) < 0)
+		return ETR_INVAL;
+
+	if (elf_getphdrnum(e, &n) == 0) {
+		for (i = 0; i < n; i++) {
+			if (gelf_getphdr(e, i, &phdr) == NULL ||
+			    phdr.p_type != PT_TLS)
+				continue;
+			tls_size = phdr.p_memsz;
+			tls_align = phdr.p_align ? phdr.p_align : 1;
+			has_tls = true;
+			break;
+		}
+	}
+
+	while (has_tls && !found && (scn = elf_nextscn(e, scn)) != NULL) {
+		if (!gelf_getshdr(scn, &shdr) || shdr.sh_type != SHT_SYMTAB ||
+		    shdr.sh_entsize == 0)
+			continue;
+		if ((data = elf_getdata(scn, NULL)) == NULL)
+			continue;
+		cnt = shdr.sh_size / shdr.sh_entsize;
+		for (i = 0; i < cnt; i++) {
+			if (gelf_getsym(data, i, &sym) == NULL ||
+			    GELF_ST_TYPE(sym.st_info) != STT_TLS)
+				continue;
+			name = elf_strptr(e, shdr.sh_link, sym.st_name);
+			if (name == NULL || strcmp(name, "runtime.tlsg"))
+				continue;
+			tls_size = (tls_size + tls_align - 1) & ~(tls_align - 1);
+			*offset = (int)((int64_t)sym.st_value - (int64_t)tls_size);
+			found = true;
+			break;
+		}
+	}
+
+	elf_end(e);
+	close(fd);
+	return ETR_OK;
+}
+
+/*
+ * Build ID of the binary as a string: the GNU build ID (hex) if present,
+ * otherwise the Go build ID (.note.go.buildid).
+ */
+int elf_build_id(const char *path, char *buf, int len)
+{
+	Elf *e;
+	Elf_Scn *scn = NULL;
+	Elf_Data *data;
+	GElf_Shdr shdr;
+	GElf_Nhdr nhdr;
+	size_t off, name_off, desc_off;
+	const char *name, *desc;
+	bool found = false;
+	int fd, i, n;
+
+	if (len <= 0 || openelf(path, &e, &fd) < 0)
+		return ETR_INVAL;
+
+	buf[0] = '\0';
+	while (!found && (scn = elf_nextscn(e, scn)) != NULL) {
+		if (!gelf_getshdr(scn, &shdr) || shdr.sh_type != SHT_NOTE)
+			continue;
+		if ((data = elf_getdata(scn, NULL)) == NULL)
+			continue;
+		off = 0;
+		while ((off = gelf_getnote(data, off, &nhdr, &name_off,
+					   &desc_off)) > 0) {
+			name = (const char *)data->d_buf + name_off;
+			desc = (const char *)data->d_buf + desc_off;
+			if (nhdr.n_namesz == sizeof("GNU") &&
+			    !strcmp(name, "GNU") &&
+			    nhdr.n_type == NT_GNU_BUILD_ID) {
+				for (i = 0, n = 0; i < nhdr.n_descsz &&
+				     n + 3 <= len; i++)
+					n += snprintf(buf + n, len - n, "%02x",
+						      (uint8_t) desc[i]);
+				found = true;
+				break;
+			}
+			// Go: name "Go", type 4 (ELF_NOTE_GOBUILDID_TAG)
+			if (buf[0] == '\0' && nhdr.n_namesz == sizeof("Go") &&
+			    !strcmp(name, "Go") && nhdr.n_type == 4) {
+				n = nhdr.n_descsz < len ? nhdr.n_descsz : len - 1;
+				memcpy(buf, desc, n);
+				buf[n] = '\0';
+			}
+		}
+	}
+
+	elf_end(e);
+	close(fd);
+	return buf[0] != '\0' ? ETR_OK : ETR_NOTEXIST;
+}
@@ -63,4 +63,9 @@ int elf_info_collect(struct elf_info *elf_info, const void *buf, size_t buf_sz);
 int find_sym_by_idx(Elf * e, Elf_Scn * syms_scn, int sym_idx, GElf_Sym * sym);
 int find_prog_func_sym(Elf * e, Elf_Scn * syms_scn, size_t prog_shndx,
 		       GElf_Sym * sym);
+int elf_go_g_tls_offset(const char *path, int *offset);
+
+// Enough for the Go build ID or the hex GNU build ID.
+#define ELF_BUILD_ID_LEN 128
+int elf_build_id(const char *path, char *buf, int len);
 #endif /*DF_TRACE_ELF_H */
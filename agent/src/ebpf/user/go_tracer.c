@@ -49,6 +49,7 @@
 #include "symbol.h"
 #include "socket.h"
 #include "elf.h"
+#include "trace_utils.h"
 
 /* *INDENT-OFF* */
 // For process execute/exit events.
@@ -69,6 +70,12 @@ static struct list_head proc_info_head;	// For pid-offsets correspondence lists.
 static struct list_head proc_events_head;	// For process execute/exit events list.
 static pthread_mutex_t mutex_proc_events_lock;
 static bool golang_trace_enabled;
+/*
+ * In lazy goroutine ID mode, the goroutine ID is read from the g pointer
+ * in the syscall and TLS probes, the runtime.execute uprobe is not used.
+ */
+static bool go_lazy_goid_enabled;
+static int64_t go_tpbase_offset = -1;
 
 /* *INDENT-OFF* */
 /* ------------- offsets info -------------- */
@@ -496,17 +503,33 @@ static int resolve_bin_file(const char *path, int pid,
 	int ret = ETR_OK;
 	struct symbol *sym;
 	struct symbol_uprobe *probe_sym = NULL;
+	struct symbol_uprobe *probe_syms[NELEMS(syms)];
 	struct data_members *off;
 	char *binary_path = NULL;
 	int syms_count = 0;
+	int i;
+
+	/*
+	 * All the symbols are resolved together, the binary is indexed once
+	 * for all the processes running it.
+	 */
+	resolve_and_gen_uprobe_symbols(path, syms, NELEMS(syms), pid,
+				       probe_syms);
 
-	for (int i = 0; i < NELEMS(syms); i++) {
+	for (i = 0; i < NELEMS(syms); i++) {
 		sym = &syms[i];
-		probe_sym = resolve_and_gen_uprobe_symbol(path, sym, 0, pid);
+		probe_sym = probe_syms[i];
 		if (probe_sym == NULL) {
 			continue;
 		}
 
+		if (go_lazy_goid_enabled &&
+		    !strcmp(sym->symbol, "runtime.execute")) {
+			free_uprobe_symbol(probe_sym, NULL);
+			probe_sym = NULL;
+			continue;
+		}
+
 		if (!binary_path) {
 			binary_path = strdup(probe_sym->binary_path);
 			if (binary_path == NULL) {
@@ -593,20 +616,30 @@ static int resolve_bin_file(const char *path, int pid,
 		if (p_info->path == NULL) {
 			goto offset_failed;
 		}
-		// resolve all offsets.
+		// resolve all offsets, with one walk of the DWARF information.
+		struct member_offset_req reqs[NELEMS(offsets)];
+		for (int k = 0; k < NELEMS(offsets); k++) {
+			reqs[k].structure = offsets[k].structure;
+			reqs[k].member = offsets[k].field_name;
+		}
+		struct_member_offsets_analyze(binary_path, reqs,
+					      NELEMS(offsets));
 		for (int k = 0; k < NELEMS(offsets); k++) {
 			off = &offsets[k];
-			int offset = struct_member_offset_analyze(binary_path,
-								  off->
-								  structure,
-								  off->
-								  field_name);
+			int offset = reqs[k].offset;
 			if (offset == ETR_INVAL)
 				offset = off->default_offset;
 
 			p_info->info.offsets[off->idx] = offset;
 		}
 
+		if (go_lazy_goid_enabled &&
+		    elf_go_g_tls_offset(binary_path,
+					&p_info->info.g_tls_offset) != ETR_OK)
+			ebpf_warning("Get the g TLS offset of %s failed, "
+				     "use default %d\n", binary_path,
+				     p_info->info.g_tls_offset);
+
 		const char *tcp_conn_sym, *tls_conn_sym, *syscall_conn_sym;
 		if (p_info->info.version < GO_VERSION(1, 20, 0)) {
 			tcp_conn_sym = "go.itab.*net.TCPConn,net.Conn";
@@ -658,6 +691,10 @@ failed:
 		free_uprobe_symbol(probe_sym, NULL);
 	}
 
+	// Symbols not added yet.
+	for (i++; i < NELEMS(syms); i++)
+		free_uprobe_symbol(probe_syms[i], NULL);
+
 	if (binary_path) {
 		free(binary_path);
 	}
@@ -1136,3 +1173,33 @@ bool is_golang_trace_enabled(void)
 {
 	return golang_trace_enabled;
 }
+
+void set_go_lazy_goid_enabled(bool enabled)
+{
+#if defined(__x86_64__)
+	if (enabled && (go_tpbase_offset = read_tpbase_offset()) < 0) {
+		ebpf_warning("Get the tpbase offset failed, lazy goroutine ID "
+			     "is disabled.\n");
+		enabled = false;
+	}
+#else
+	/*
+	 * On arm64 the g pointer lives in R28, the user registers would
+	 * have to be fetched from the task's pt_regs, keep the uprobe.
+	 */
+	if (enabled) {
+		ebpf_warning("Lazy goroutine ID is only supported on x86_64.\n");
+		enabled = false;
+	}
+#endif
+	go_lazy_goid_enabled = enabled;
+	ebpf_info("Goroutine ID from %s.\n", enabled ?
+		  "the g pointer (lazy)" : "the runtime.execute uprobe");
+}
+
+void go_lazy_goid_offset_fill(bpf_offset_param_t *offset)
+{
+	offset->go_lazy_goid = go_lazy_goid_enabled;
+	offset->task__tpbase_offset =
+	    go_lazy_goid_enabled ? (__u32) go_tpbase_offset : 0;
+}
@@ -51,4 +51,11 @@ void golang_trace_handle(int pid, enum match_pids_act act);
 void golang_trace_init(void);
 void set_uprobe_golang_enabled(bool enabled);
 bool is_golang_trace_enabled(void);
+/*
+ * Read the goroutine ID from the g pointer when it is needed instead of
+ * tracking it with the runtime.execute uprobe (x86_64 only). Must be set
+ * before the socket tracer is started.
+ */
+void set_go_lazy_goid_enabled(bool enabled);
+void go_lazy_goid_offset_fill(bpf_offset_param_t *offset);
 #endif
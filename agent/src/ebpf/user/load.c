@@ -17,6 +17,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -330,6 +331,27 @@ static bool is_helper_call_insn(struct bpf_insn *insn, int32_t * func_id)
 	return false;
 }
 
+/*
+ * The task argument of bpf_task_storage_{get,delete}() comes from the
+ * nearest bpf_get_current_task_btf() call before it, without any other
+ * helper call in between (see the task_local_storage macros in
+ * bpf_base.h). Only that call is removed, others are left untouched.
+ */
+static void sanitize_task_storage_arg(struct ebpf_prog *prog, int idx)
+{
+	struct bpf_insn *insn;
+	int32_t func_id;
+
+	for (int i = idx - 1; i >= 0; i--) {
+		insn = &prog->insns[i];
+		if (!is_helper_call_insn(insn, &func_id))
+			continue;
+		if (func_id == FN_ID(bpf_get_current_task_btf))
+			*insn = BPF_MOV64_IMM(BPF_REG_0, 0);
+		return;
+	}
+}
+
 static void sanitize_prog_instructions(struct ebpf_object *obj,
 				       struct ebpf_prog *prog)
 {
@@ -347,6 +369,16 @@ static void sanitize_prog_instructions(struct ebpf_object *obj,
 			   || func_id == FN_ID(bpf_probe_read_user_str)) {
 			if (!feat_probe_read_kernel(obj->kern_version))
 				insn->imm = FN_ID(bpf_probe_read_str);
+		} else if (func_id == FN_ID(bpf_task_storage_get)
+			   || func_id == FN_ID(bpf_task_storage_delete)) {
+			/*
+			 * The task local storage map has been replaced by a
+			 * placeholder, the callers take 'r0 = 0' as a miss.
+			 */
+			if (obj->task_storage_unsupported) {
+				*insn = BPF_MOV64_IMM(BPF_REG_0, 0);
+				sanitize_task_storage_arg(prog, i);
+			}
 		}
 	}
 }
@@ -455,6 +487,8 @@ void release_object(struct ebpf_object *obj)
 		btf_ext__free(obj->btf_ext);
 	}
 
+	vmlinux_btf_put(obj->btf_vmlinux);
+
 	/* free obj */
 	zfree(obj);
 
@@ -1302,6 +1336,123 @@ failed:
 	return NULL;
 }
 
+/*
+ * Local storage maps need the BTF of the key and the value, build the
+ * smallest one: [1] int, [2] unsigned char, [3] unsigned char[value_size].
+ */
+static int create_task_storage_map(struct ebpf_map *map)
+{
+	static const char strs[] = "\0int\0unsigned char";
+	struct {
+		struct btf_header hdr;
+		uint32_t types[14];
+		char strs[sizeof(strs)];
+	} __attribute__ ((packed)) btf = {
+		.hdr = {
+			.magic = BTF_MAGIC,
+			.version = BTF_VERSION,
+			.hdr_len = sizeof(struct btf_header),
+			.type_off = 0,
+			.type_len = sizeof(btf.types),
+			.str_off = sizeof(btf.types),
+			.str_len = sizeof(strs),
+		},
+		.types = {
+			/* [1] int */
+			1, BTF_KIND_INT << 24, 4, (BTF_INT_SIGNED << 24) | 32,
+			/* [2] unsigned char */
+			5, BTF_KIND_INT << 24, 1, 8,
+			/* [3] unsigned char[value_size] */
+			0, BTF_KIND_ARRAY << 24, 0, 2, 1, map->def.value_size,
+		},
+	};
+	union bpf_attr attr;
+	int btf_fd, map_fd;
+
+	memcpy(btf.strs, strs, sizeof(strs));
+	memset(&attr, 0, sizeof(attr));
+	attr.btf = (uint64_t) (unsigned long)&btf;
+	attr.btf_size = sizeof(btf);
+	btf_fd = syscall(__NR_bpf, BPF_BTF_LOAD, &attr, sizeof(attr));
+	if (btf_fd < 0)
+		return -1;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_TASK_STORAGE;
+	attr.key_size = sizeof(int);
+	attr.value_size = map->def.value_size;
+	attr.max_entries = 0;
+	attr.map_flags = BPF_F_NO_PREALLOC;
+	attr.btf_fd = btf_fd;
+	attr.btf_key_type_id = 1;
+	attr.btf_value_type_id = 3;
+	snprintf(attr.map_name, sizeof(attr.map_name), "%s", map->name);
+	map_fd = syscall(__NR_bpf, BPF_MAP_CREATE, &attr, sizeof(attr));
+	close(btf_fd);
+
+	return map_fd;
+}
+
+/*
+ * Task local storage is usable by the tracing programs since Linux 5.13
+ * with the kernel BTF, check it with the map just created.
+ */
+static bool feat_task_storage(unsigned kern_version, int map_fd)
+{
+	struct bpf_insn insns[] = {
+		BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 0, 0,
+			     FN_ID(bpf_get_current_task_btf)),
+		BPF_MOV64_REG(BPF_REG_2, BPF_REG_0),	/* r2 = current */
+		BPF_LD_MAP_FD(BPF_REG_1, map_fd),
+		BPF_MOV64_IMM(BPF_REG_3, 0),	/* r3 = NULL */
+		BPF_MOV64_IMM(BPF_REG_4, 0),	/* r4 = 0 */
+		BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 0, 0,
+			     FN_ID(bpf_task_storage_get)),
+		BPF_MOV64_IMM(BPF_REG_0, 0),
+		BPF_EXIT_INSN(),
+	};
+
+	int stderr_fd = suspend_stderr();
+	if (stderr_fd < 0) {
+		ebpf_warning("Failed to suspend stderr\n");
+	}
+	int fd = bcc_prog_load
+	    (BPF_PROG_TYPE_TRACEPOINT, NULL, insns, sizeof(insns), LICENSE_DEF,
+	     kern_version, 0, NULL, 0);
+	resume_stderr(stderr_fd);
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	return true;
+}
+
+/*
+ * Create a task local storage map, or an array placeholder if the kernel
+ * does not support it. In the latter case the helper calls are removed
+ * from the programs, see sanitize_prog_instructions().
+ */
+static int ebpf_obj__create_task_storage(struct ebpf_object *obj,
+					 struct ebpf_map *map)
+{
+	map->fd = create_task_storage_map(map);
+	if (map->fd >= 0 && feat_task_storage(obj->kern_version, map->fd)) {
+		ebpf_info("Map %s created in task local storage.\n", map->name);
+		return map->fd;
+	}
+
+	if (map->fd >= 0)
+		close(map->fd);
+	ebpf_info("Task local storage not supported, map %s is a "
+		  "placeholder.\n", map->name);
+	obj->task_storage_unsupported = true;
+	map->def.type = BPF_MAP_TYPE_ARRAY;
+	map->def.max_entries = 1;
+	map->fd = bcc_create_map(map->def.type, map->name, map->def.key_size,
+				 map->def.value_size, map->def.max_entries, 0);
+	return map->fd;
+}
+
 int ebpf_obj_load(struct ebpf_object *obj)
 {
 	int i;
@@ -1347,10 +1498,14 @@ int ebpf_obj_load(struct ebpf_object *obj)
 
 		extended_map_preprocess(map);
 
-		map->fd =
-		    bcc_create_map(map->def.type, map->name, map->def.key_size,
-				   map->def.value_size, map->def.max_entries,
-				   map_flags);
+		if (map->def.type == BPF_MAP_TYPE_TASK_STORAGE)
+			map->fd = ebpf_obj__create_task_storage(obj, map);
+		else
+			map->fd =
+			    bcc_create_map(map->def.type, map->name,
+					   map->def.key_size,
+					   map->def.value_size,
+					   map->def.max_entries, map_flags);
 		if (map->fd < 0) {
 			ebpf_warning
 			    ("bcc_create_map() failed, map name:%s - %s\n",
@@ -127,6 +127,8 @@ struct ebpf_object {
 	struct btf *btf;
 	struct btf_ext *btf_ext;
 	struct btf *btf_vmlinux;
+	// Task local storage maps replaced by placeholders.
+	bool task_storage_unsupported;
 };
 
 struct ebpf_object *ebpf_open_buffer(const void *buf, size_t buf_sz,
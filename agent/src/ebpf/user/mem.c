@@ -40,7 +40,30 @@
 #define MAP_FIXED_NOREPLACE 0x100000
 #endif
 
-static clib_mem_main_t mem_main;
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+
+static clib_mem_main_t mem_main = {
+	/* Memory may be allocated before clib_mem_init(). */
+	.tag_lock = PTHREAD_MUTEX_INITIALIZER,
+	.tags = {
+		 [CLIB_MEM_TAG_UNKNOWN] = {.name = "unknown"},
+		 [CLIB_MEM_TAG_OTHER] = {.name = "other"},
+		 },
+	.tags_count = CLIB_MEM_TAG_OTHER + 1,
+};
+
+static pthread_once_t mem_thread_key_once = PTHREAD_ONCE_INIT;
+
+static __thread clib_mem_thread_counters_t *mem_thread_counters;
+
+/* Last tags looked up by the thread, indexed by the name address. */
+#define MEM_TAG_CACHE_SZ 64
+static __thread struct {
+	const char *name;
+	u32 tag;
+} mem_tag_cache[MEM_TAG_CACHE_SZ];
 
 static uword mem_get_fd_page_size(int fd)
 {
@@ -143,11 +166,192 @@ void show_mem_list(void)
 }
 #endif
 
+/* Move the counters of an exiting thread to the exited counters. */
+static void mem_thread_counters_release(void *arg)
+{
+	clib_mem_main_t *mm = &mem_main;
+	clib_mem_thread_counters_t *c = arg, **pp;
+	int i;
+
+	pthread_mutex_lock(&mm->tag_lock);
+	for (pp = &mm->thread_counters; *pp; pp = &(*pp)->next) {
+		if (*pp == c) {
+			*pp = c->next;
+			break;
+		}
+	}
+
+	for (i = 0; i < CLIB_MEM_TAGS_MAX; i++) {
+		mm->exited_counters[i].alloc_bytes += c->tags[i].alloc_bytes;
+		mm->exited_counters[i].free_bytes += c->tags[i].free_bytes;
+		mm->exited_counters[i].alloc_count += c->tags[i].alloc_count;
+		mm->exited_counters[i].free_count += c->tags[i].free_count;
+	}
+	pthread_mutex_unlock(&mm->tag_lock);
+	free(c);
+	mem_thread_counters = NULL;
+}
+
+static void mem_thread_key_create(void)
+{
+	pthread_key_create(&mem_main.thread_key, mem_thread_counters_release);
+}
+
+static clib_mem_tag_counter_t *mem_thread_counters_get(void)
+{
+	clib_mem_main_t *mm = &mem_main;
+	static clib_mem_tag_counter_t fallback[CLIB_MEM_TAGS_MAX];
+
+	if (PREDICT_TRUE(mem_thread_counters != NULL))
+		return mem_thread_counters->tags;
+
+	clib_mem_thread_counters_t *c = calloc(1, sizeof(*c));
+	/* No memory, count approximately in the shared counters. */
+	if (c == NULL)
+		return fallback;
+
+	pthread_mutex_lock(&mm->tag_lock);
+	c->next = mm->thread_counters;
+	mm->thread_counters = c;
+	pthread_mutex_unlock(&mm->tag_lock);
+	pthread_once(&mem_thread_key_once, mem_thread_key_create);
+	pthread_setspecific(mm->thread_key, c);
+	mem_thread_counters = c;
+
+	return c->tags;
+}
+
+static u32 mem_tag_register(const char *name, bool is_vm)
+{
+	clib_mem_main_t *mm = &mem_main;
+	u32 i, tag = CLIB_MEM_TAG_OTHER;
+
+	pthread_mutex_lock(&mm->tag_lock);
+	for (i = CLIB_MEM_TAG_OTHER + 1; i < mm->tags_count; i++) {
+		if (mm->tags[i].is_vm == is_vm &&
+		    strncmp(mm->tags[i].name, name,
+			    CLIB_MEM_TAG_NAME_LEN - 1) == 0) {
+			tag = i;
+			goto out;
+		}
+	}
+
+	if (mm->tags_count < CLIB_MEM_TAGS_MAX) {
+		tag = mm->tags_count;
+		snprintf(mm->tags[tag].name, sizeof(mm->tags[tag].name), "%s",
+			 name);
+		mm->tags[tag].is_vm = is_vm;
+		/* The tag is complete before it is visible to readers. */
+		__atomic_store_n(&mm->tags_count, tag + 1, __ATOMIC_RELEASE);
+	}
+out:
+	pthread_mutex_unlock(&mm->tag_lock);
+	return tag;
+}
+
+static inline u32 mem_tag_lookup(const char *name, bool is_vm)
+{
+	if (name == NULL)
+		return CLIB_MEM_TAG_UNKNOWN;
+
+	/*
+	 * The names are usually string literals, the address finds the
+	 * tag, the name is compared in case the buffer has been reused.
+	 */
+	u32 slot = ((uword) name >> 3) & (MEM_TAG_CACHE_SZ - 1);
+	u32 tag = mem_tag_cache[slot].tag;
+	if (PREDICT_TRUE(mem_tag_cache[slot].name == name &&
+			 mem_main.tags[tag].is_vm == is_vm &&
+			 strncmp(mem_main.tags[tag].name, name,
+				 CLIB_MEM_TAG_NAME_LEN - 1) == 0))
+		return tag;
+
+	tag = mem_tag_register(name, is_vm);
+	mem_tag_cache[slot].name = name;
+	mem_tag_cache[slot].tag = tag;
+	return tag;
+}
+
+static inline void mem_tag_account_alloc(u32 tag, u64 size)
+{
+	clib_mem_tag_counter_t *c = &mem_thread_counters_get()[tag];
+	c->alloc_bytes += size;
+	c->alloc_count++;
+}
+
+static inline void mem_tag_account_free(u32 tag, u64 size)
+{
+	clib_mem_tag_counter_t *c = &mem_thread_counters_get()[tag];
+	c->free_bytes += size;
+	c->free_count++;
+}
+
+void clib_mem_vm_account(const char *name, i64 bytes)
+{
+	u32 tag = mem_tag_lookup(name, true);
+	if (bytes >= 0)
+		mem_tag_account_alloc(tag, bytes);
+	else
+		mem_tag_account_free(tag, -bytes);
+}
+
+static void mem_tag_counters_merge(clib_mem_tag_counter_t * sum)
+{
+	clib_mem_main_t *mm = &mem_main;
+	clib_mem_thread_counters_t *c;
+	int i;
+
+	memcpy(sum, mm->exited_counters, sizeof(mm->exited_counters));
+	for (c = mm->thread_counters; c; c = c->next) {
+		for (i = 0; i < CLIB_MEM_TAGS_MAX; i++) {
+			sum[i].alloc_bytes += c->tags[i].alloc_bytes;
+			sum[i].free_bytes += c->tags[i].free_bytes;
+			sum[i].alloc_count += c->tags[i].alloc_count;
+			sum[i].free_count += c->tags[i].free_count;
+		}
+	}
+}
+
+int clib_mem_tag_stats(struct mem_tag_stat *stats)
+{
+	clib_mem_main_t *mm = &mem_main;
+	clib_mem_tag_counter_t sum[CLIB_MEM_TAGS_MAX];
+	int i, count;
+
+	pthread_mutex_lock(&mm->tag_lock);
+	mem_tag_counters_merge(sum);
+	count = mm->tags_count;
+	for (i = 0; i < count; i++) {
+		/*
+		 * The counters of other threads are read without locking,
+		 * a free may be seen before its allocation.
+		 */
+		i64 in_use = sum[i].alloc_bytes - sum[i].free_bytes;
+		if (in_use < 0)
+			in_use = 0;
+		if ((u64) in_use > mm->tags[i].high_watermark)
+			mm->tags[i].high_watermark = in_use;
+
+		if (stats == NULL)
+			continue;
+		memcpy(stats[i].name, mm->tags[i].name, sizeof(stats[i].name));
+		stats[i].is_vm = mm->tags[i].is_vm;
+		stats[i].in_use = in_use;
+		stats[i].high_watermark = mm->tags[i].high_watermark;
+		stats[i].alloc_count = sum[i].alloc_count;
+		stats[i].free_count = sum[i].free_count;
+	}
+	pthread_mutex_unlock(&mm->tag_lock);
+
+	return count;
+}
+
 void clib_mem_free(void *p)
 {
 	void *start = p - sizeof(u64);
 	u64 mem_size = *(u64 *) start;
-	atomic64_add(&mem_main.clib_free_mem_bytes, mem_size);
+	mem_tag_account_free(mem_size >> CLIB_MEM_TAG_SHIFT,
+			     mem_size & CLIB_MEM_SIZE_MASK);
 #ifdef DF_MEM_DEBUG
 	mem_del_list(pointer_to_uword(start));
 #endif
@@ -177,8 +381,9 @@ void *clib_mem_alloc_aligned(const char *name, uword size,
 	if (alloc_sz != NULL)
 		*alloc_sz = size - extra_len;
 
-	*(u64 *) ptr = size;
-	atomic64_add(&mem_main.clib_alloc_mem_bytes, size);
+	u32 tag = mem_tag_lookup(name, false);
+	*(u64 *) ptr = size | (u64) tag << CLIB_MEM_TAG_SHIFT;
+	mem_tag_account_alloc(tag, size);
 
 #ifdef DF_MEM_DEBUG
 	mem_add_list(name, pointer_to_uword(ptr), size);
@@ -193,7 +398,8 @@ void *clib_mem_realloc_aligned(const char *name, void *p, uword size,
 	align = clib_max(CLIB_MEM_MIN_ALIGN, align);
 	int extra_len = sizeof(u64);
 	void *start = p - sizeof(u64);
-	uword old_size = *(u64 *) start;
+	u64 old_hdr = *(u64 *) start;
+	uword old_size = old_hdr & CLIB_MEM_SIZE_MASK;
 
 	if (p == NULL || size == 0 || old_size >= (size + extra_len)
 	    || (align && !is_pow2(align))) {
@@ -211,9 +417,10 @@ void *clib_mem_realloc_aligned(const char *name, void *p, uword size,
 	}
 
 	*alloc_sz = size;
-	*(u64 *) ptr = size + extra_len;
-	atomic64_add(&mem_main.clib_alloc_mem_bytes,
-		     (size + extra_len - old_size));
+	u32 tag = mem_tag_lookup(name, false);
+	*(u64 *) ptr = (size + extra_len) | (u64) tag << CLIB_MEM_TAG_SHIFT;
+	mem_tag_account_free(old_hdr >> CLIB_MEM_TAG_SHIFT, old_size);
+	mem_tag_account_alloc(tag, size + extra_len);
 
 #ifdef DF_MEM_DEBUG
 	mem_del_list(pointer_to_uword(start));
@@ -263,16 +470,214 @@ uword clib_mem_vm_reserve(uword size, clib_mem_page_sz_t log2_page_sz)
 	return (uword) base + sys_page_sz;
 }
 
+void clib_mem_set_hugepage_mode(clib_mem_hugepage_mode_t mode)
+{
+	mem_main.hugepage_mode = mode;
+}
+
+clib_mem_hugepage_mode_t clib_mem_get_hugepage_mode(void)
+{
+	return mem_main.hugepage_mode;
+}
+
+const char *clib_mem_vm_backing_str(clib_mem_vm_backing_t backing)
+{
+	switch (backing) {
+	case CLIB_MEM_VM_THP:
+		return "transparent hugepages";
+	case CLIB_MEM_VM_HUGETLB:
+		return "hugetlb pages";
+	default:
+		return "normal pages";
+	}
+}
+
+/* hugetlb pages of the requested size, from a memfd (Linux 4.14+). */
+static void *vm_map_memfd_hugetlb(void *base, uword size,
+				  clib_mem_page_sz_t log2_huge_sz)
+{
+	void *rv;
+	int fd = syscall(__NR_memfd_create, "clib_mem_vm",
+			 MFD_HUGETLB | (log2_huge_sz << MFD_HUGE_SHIFT));
+	if (fd < 0)
+		return MAP_FAILED;
+
+	if (mem_get_fd_log2_page_size(fd) != log2_huge_sz
+	    || ftruncate(fd, size) != 0) {
+		close(fd);
+		return MAP_FAILED;
+	}
+
+	/*
+	 * The hugetlb pages are reserved by mmap(), it fails instead of
+	 * raising SIGBUS on a later page fault if the pool is exhausted.
+	 */
+	rv = mmap(base, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED,
+		  fd, 0);
+	close(fd);
+	return rv;
+}
+
+void *clib_mem_vm_map_fixed(void *base, uword size,
+			    clib_mem_page_sz_t log2_huge_sz,
+			    clib_mem_vm_backing_t * backing)
+{
+	clib_mem_main_t *mm = &mem_main;
+	int mmap_flags = MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS;
+	bool huge_aligned = !(((uword) base | size) & pow2_mask(log2_huge_sz));
+	void *rv = MAP_FAILED;
+
+	*backing = CLIB_MEM_VM_NORMAL;
+	switch (mm->hugepage_mode) {
+	case CLIB_MEM_HUGEPAGE_EXPLICIT:
+		if (huge_aligned)
+			rv = vm_map_memfd_hugetlb(base, size, log2_huge_sz);
+		if (rv != MAP_FAILED) {
+			*backing = CLIB_MEM_VM_HUGETLB;
+			break;
+		}
+		/* fall through */
+	case CLIB_MEM_HUGEPAGE_TRANSPARENT:
+		rv = mmap(base, size, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
+		if (rv != MAP_FAILED && madvise(rv, size, MADV_HUGEPAGE) == 0)
+			*backing = CLIB_MEM_VM_THP;
+		break;
+	default:
+		/* MAP_HUGETLB need CAP_SYS_RESOURCE */
+		rv = mmap(base, size, PROT_READ | PROT_WRITE,
+			  mmap_flags | MAP_HUGETLB | MAP_LOCKED |
+			  log2_huge_sz << MAP_HUGE_SHIFT, -1, 0);
+		/*
+		 * fallback - maybe we are still able to allocate normal pages
+		 * mlock() need root or CAP_IPC_LOCK
+		 */
+		if (rv == MAP_FAILED || mlock(base, size) != 0)
+			rv = mmap(base, size, PROT_READ | PROT_WRITE,
+				  mmap_flags, -1, 0);
+		else
+			*backing = CLIB_MEM_VM_HUGETLB;
+		break;
+	}
+
+	if (rv != MAP_FAILED)
+		atomic64_add(&mm->vm_mapped_bytes[*backing], size);
+
+	return rv;
+}
+
+void get_mem_vm_stat(u64 * hugetlb_b, u64 * thp_b, u64 * normal_b)
+{
+	clib_mem_main_t *mm = &mem_main;
+	*hugetlb_b = atomic64_read(&mm->vm_mapped_bytes[CLIB_MEM_VM_HUGETLB]);
+	*thp_b = atomic64_read(&mm->vm_mapped_bytes[CLIB_MEM_VM_THP]);
+	*normal_b = atomic64_read(&mm->vm_mapped_bytes[CLIB_MEM_VM_NORMAL]);
+}
+
+void clib_mem_arena_init(clib_mem_arena_t * a, const char *name,
+			 uword block_size)
+{
+	memset(a, 0, sizeof(*a));
+	a->name = name;
+	a->block_size = block_size;
+}
+
+static clib_mem_arena_block_t *arena_block_new(clib_mem_arena_t * a,
+					       uword size)
+{
+	clib_mem_arena_block_t *b;
+	b = clib_mem_alloc_aligned(a->name, sizeof(*b) + size, 0, NULL);
+	if (b == NULL)
+		return NULL;
+
+	b->size = size;
+	b->used = 0;
+	b->next = a->head;
+	a->head = b;
+	a->block_count++;
+
+	return b;
+}
+
+void *clib_mem_arena_alloc(clib_mem_arena_t * a, uword size)
+{
+	clib_mem_arena_block_t *b = a->head;
+
+	size = round_pow2(size, CLIB_MEM_MIN_ALIGN);
+	if (b == NULL || b->size - b->used < size) {
+		/* Oversized requests get a dedicated block. */
+		b = arena_block_new(a, clib_max(size, a->block_size));
+		if (b == NULL) {
+			ebpf_warning("arena '%s' alloc %lu bytes failed.\n",
+				     a->name, size);
+			return NULL;
+		}
+	}
+
+	void *p = b->data + b->used;
+	b->used += size;
+	a->alloc_count++;
+	a->alloc_bytes += size;
+
+	return p;
+}
+
+void clib_mem_arena_reset(clib_mem_arena_t * a)
+{
+	clib_mem_arena_block_t *b, *next, *keep = NULL;
+
+	for (b = a->head; b != NULL; b = next) {
+		next = b->next;
+		if (keep == NULL && b->size == a->block_size) {
+			keep = b;
+			continue;
+		}
+		clib_mem_free(b);
+	}
+
+	if (keep) {
+		keep->next = NULL;
+		keep->used = 0;
+	}
+
+	a->head = keep;
+	a->alloc_count = 0;
+	a->alloc_bytes = 0;
+	a->block_count = 0;
+}
+
+void clib_mem_arena_free(clib_mem_arena_t * a)
+{
+	clib_mem_arena_block_t *b, *next;
+
+	for (b = a->head; b != NULL; b = next) {
+		next = b->next;
+		clib_mem_free(b);
+	}
+
+	a->head = NULL;
+}
+
 void get_mem_stat(u64 * alloc_b, u64 * free_b)
 {
 	clib_mem_main_t *mm = &mem_main;
-	*alloc_b = atomic64_read(&mm->clib_alloc_mem_bytes);
-	*free_b = atomic64_read(&mm->clib_free_mem_bytes);
+	clib_mem_tag_counter_t sum[CLIB_MEM_TAGS_MAX];
+	int i;
+
+	*alloc_b = *free_b = 0;
+	pthread_mutex_lock(&mm->tag_lock);
+	mem_tag_counters_merge(sum);
+	for (i = 0; i < mm->tags_count; i++) {
+		if (mm->tags[i].is_vm)
+			continue;
+		*alloc_b += sum[i].alloc_bytes;
+		*free_b += sum[i].free_bytes;
+	}
+	pthread_mutex_unlock(&mm->tag_lock);
 }
 
 void clib_mem_init(void)
 {
-	int fd;
+	int fd, i;
 	clib_mem_main_t *mm = &mem_main;
 	long sysconf_page_size;
 	uword page_size;
@@ -283,8 +688,8 @@ void clib_mem_init(void)
 
 	page_size = sysconf_page_size;
 	mm->log2_page_sz = min_log2(page_size);
-	atomic64_init(&mm->clib_alloc_mem_bytes);
-	atomic64_init(&mm->clib_free_mem_bytes);
+	for (i = 0; i < CLIB_MEM_VM_BACKING_MAX; i++)
+		atomic64_init(&mm->vm_mapped_bytes[i]);
 
 	/* fetch system hugeppage size */
 	if ((fd = syscall(__NR_memfd_create, "test", MFD_HUGETLB)) != -1) {
@@ -18,6 +18,7 @@
 #define _included_clib_mem_h
 
 #include <malloc.h>
+#include <pthread.h>
 #include <sys/mman.h>
 #include "atomic.h"
 #include "list.h"
@@ -46,6 +47,84 @@ typedef enum {
 	CLIB_MEM_PAGE_SZ_16G = 34,
 } clib_mem_page_sz_t;
 
+/*
+ * Page backing of the large virtual memory arenas (e.g. bihash).
+ */
+typedef enum {
+	/*
+	 * Try locked hugetlb pages (MAP_HUGETLB), fall back to normal
+	 * pages silently.
+	 */
+	CLIB_MEM_HUGEPAGE_DEFAULT = 0,
+	/* Normal pages advised with MADV_HUGEPAGE. */
+	CLIB_MEM_HUGEPAGE_TRANSPARENT = 1,
+	/*
+	 * hugetlb pages from a MFD_HUGETLB memfd, falls back to
+	 * transparent hugepages, then to normal pages.
+	 */
+	CLIB_MEM_HUGEPAGE_EXPLICIT = 2,
+	CLIB_MEM_HUGEPAGE_MODE_MAX,
+} clib_mem_hugepage_mode_t;
+
+typedef enum {
+	CLIB_MEM_VM_NORMAL = 0,
+	CLIB_MEM_VM_THP,	/* advised, the kernel may still use normal pages */
+	CLIB_MEM_VM_HUGETLB,
+	CLIB_MEM_VM_BACKING_MAX,
+} clib_mem_vm_backing_t;
+
+/*
+ * Memory accounting by tag.
+ *
+ * The name given to clib_mem_alloc_aligned() is the tag of the memory.
+ * Each thread counts its allocations and frees in its own counters, the
+ * counters of all the threads are merged on read. The tag index is kept
+ * in the high bits of the size recorded in front of the memory.
+ */
+#define CLIB_MEM_TAGS_MAX	128
+#define CLIB_MEM_TAG_NAME_LEN	32
+#define CLIB_MEM_TAG_SHIFT	48
+#define CLIB_MEM_SIZE_MASK	((1ULL << CLIB_MEM_TAG_SHIFT) - 1)
+// Memory allocated without a name.
+#define CLIB_MEM_TAG_UNKNOWN	0
+// Used by all the names seen after the tag table is full.
+#define CLIB_MEM_TAG_OTHER	1
+
+typedef struct {
+	u64 alloc_bytes;
+	u64 free_bytes;
+	u64 alloc_count;
+	u64 free_count;
+} clib_mem_tag_counter_t;
+
+typedef struct clib_mem_thread_counters {
+	struct clib_mem_thread_counters *next;
+	clib_mem_tag_counter_t tags[CLIB_MEM_TAGS_MAX];
+} clib_mem_thread_counters_t;
+
+typedef struct {
+	char name[CLIB_MEM_TAG_NAME_LEN];
+	/* virtual memory arena (e.g. bihash), not heap memory */
+	bool is_vm;
+	/* highest in-use bytes seen on read */
+	u64 high_watermark;
+} clib_mem_tag_t;
+
+/* Tag statistics, SOCKOPT_GET_MEMSTAT_SHOW response. */
+struct mem_tag_stat {
+	char name[CLIB_MEM_TAG_NAME_LEN];
+	u8 is_vm;
+	u64 in_use;		/* bytes */
+	u64 high_watermark;	/* bytes */
+	u64 alloc_count;
+	u64 free_count;
+};
+
+struct mem_tag_stat_array {
+	int count;
+	struct mem_tag_stat stats[0];
+};
+
 typedef struct {
 	/* log2 system page size */
 	clib_mem_page_sz_t log2_page_sz;
@@ -53,9 +132,19 @@ typedef struct {
 	/* log2 default hugepage size */
 	clib_mem_page_sz_t log2_default_hugepage_sz;
 
-	/* total memory bytes statistics*/
-	atomic64_t clib_alloc_mem_bytes;
-	atomic64_t clib_free_mem_bytes;
+	/* tags, only added (under tag_lock) never removed */
+	clib_mem_tag_t tags[CLIB_MEM_TAGS_MAX];
+	volatile u32 tags_count;
+	pthread_mutex_t tag_lock;
+	/* per-thread counters (protected by tag_lock) */
+	clib_mem_thread_counters_t *thread_counters;
+	/* counters of the exited threads (protected by tag_lock) */
+	clib_mem_tag_counter_t exited_counters[CLIB_MEM_TAGS_MAX];
+	pthread_key_t thread_key;
+
+	clib_mem_hugepage_mode_t hugepage_mode;
+	/* bytes mapped by clib_mem_vm_map_fixed(), per backing */
+	atomic64_t vm_mapped_bytes[CLIB_MEM_VM_BACKING_MAX];
 
 #ifdef DF_MEM_DEBUG
 	volatile uint32_t *list_lock;
@@ -128,12 +217,69 @@ clib_mem_vm_free (void *addr, uword size)
 	munmap (addr, size);
 }
 
+/*
+ * Bump arena for short-lived objects.
+ *
+ * Memory is carved out of chained blocks and is never freed individually,
+ * everything is released at once by clib_mem_arena_reset(). The first
+ * regular block is kept across resets so that a steady-state cycle does
+ * not touch the heap at all.
+ */
+typedef struct clib_mem_arena_block {
+	struct clib_mem_arena_block *next;
+	uword size;		/* usable bytes in data[] */
+	uword used;
+	u8 data[0];
+} clib_mem_arena_block_t;
+
+typedef struct {
+	const char *name;
+	uword block_size;
+	/* current block, followed by the blocks filled before it */
+	clib_mem_arena_block_t *head;
+
+	/* statistics since the last reset */
+	u64 alloc_count;	/* allocations served by the arena */
+	u64 alloc_bytes;
+	u64 block_count;	/* blocks taken from the heap */
+} clib_mem_arena_t;
+
+void clib_mem_arena_init(clib_mem_arena_t *a, const char *name,
+			 uword block_size);
+void *clib_mem_arena_alloc(clib_mem_arena_t *a, uword size);
+void clib_mem_arena_reset(clib_mem_arena_t *a);
+void clib_mem_arena_free(clib_mem_arena_t *a);
+
 void clib_mem_init(void);
 uword clib_mem_vm_reserve(uword size, clib_mem_page_sz_t log2_page_sz);
+/*
+ * Map memory at 'base' (in a range reserved by clib_mem_vm_reserve())
+ * according to the hugepage mode. 'base' and 'size' must be aligned to
+ * 1 << log2_huge_sz to use hugetlb pages.
+ *
+ * @backing: output, the backing actually used
+ * @return MAP_FAILED on failure
+ */
+void *clib_mem_vm_map_fixed(void *base, uword size,
+			    clib_mem_page_sz_t log2_huge_sz,
+			    clib_mem_vm_backing_t *backing);
+void clib_mem_set_hugepage_mode(clib_mem_hugepage_mode_t mode);
+clib_mem_hugepage_mode_t clib_mem_get_hugepage_mode(void);
+const char *clib_mem_vm_backing_str(clib_mem_vm_backing_t backing);
+void get_mem_vm_stat(u64 *hugetlb_b, u64 *thp_b, u64 *normal_b);
 void *clib_mem_realloc_aligned(const char *name, void *p, uword size, u32 align, uword *alloc_sz);
 void *clib_mem_alloc_aligned(const char *name, uword size, u32 align, uword *alloc_sz);
 void clib_mem_free(void *p);
 void get_mem_stat(u64 *alloc_b, u64 *free_b);
+// Account virtual memory arena bytes (negative when unmapped) to a tag.
+void clib_mem_vm_account(const char *name, i64 bytes);
+/*
+ * Merge the counters of all the threads and update the high-watermarks.
+ *
+ * @stats: output, CLIB_MEM_TAGS_MAX entries, may be NULL
+ * @return the number of tags
+ */
+int clib_mem_tag_stats(struct mem_tag_stat *stats);
 #ifdef DF_MEM_DEBUG
 void show_mem_list(void);
 #endif
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "config.h"
+#include "types.h"
+#include "clib.h"
+#include "log.h"
+#include "utils.h"
+#include "mem_governor.h"
+
+struct mem_shed_action {
+	struct mem_shed_stat stat;
+	mem_shed_fn shed;
+	mem_shed_fn restore;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	u64 budget;
+	u64 usage;
+	// Sorted by priority.
+	struct mem_shed_action actions[MEM_GOVERNOR_ACTIONS_MAX];
+	int count;
+	// Checks since the last activation or revert.
+	u32 settle_checks;
+} governor = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.settle_checks = MEM_GOVERNOR_SETTLE_CHECKS,
+};
+
+static void sort_actions(void)
+{
+	struct mem_shed_action a;
+	int i, j;
+
+	for (i = 1; i < governor.count; i++) {
+		a = governor.actions[i];
+		for (j = i; j > 0 &&
+		     governor.actions[j - 1].stat.priority > a.stat.priority; j--)
+			governor.actions[j] = governor.actions[j - 1];
+		governor.actions[j] = a;
+	}
+}
+
+static struct mem_shed_action *find_action(const char *name)
+{
+	int i;
+	for (i = 0; i < governor.count; i++) {
+		if (strcmp(governor.actions[i].stat.name, name) == 0)
+			return &governor.actions[i];
+	}
+
+	return NULL;
+}
+
+static struct mem_shed_action *add_action(const char *name, int priority)
+{
+	struct mem_shed_action *a;
+
+	if (governor.count >= MEM_GOVERNOR_ACTIONS_MAX)
+		return NULL;
+
+	a = &governor.actions[governor.count++];
+	memset(a, 0, sizeof(*a));
+	snprintf(a->stat.name, sizeof(a->stat.name), "%s", name);
+	a->stat.priority = priority;
+	return a;
+}
+
+int mem_governor_register(const char *name, int priority, mem_shed_fn shed,
+			  mem_shed_fn restore)
+{
+	struct mem_shed_action *a;
+	int ret = ETR_OK;
+
+	if (shed == NULL)
+		return ETR_INVAL;
+
+	pthread_mutex_lock(&governor.lock);
+	a = find_action(name);
+	if (a == NULL && (a = add_action(name, priority)) == NULL) {
+		ret = ETR_NOROOM;
+		goto out;
+	}
+	a->shed = shed;
+	a->restore = restore;
+	sort_actions();
+out:
+	pthread_mutex_unlock(&governor.lock);
+	return ret;
+}
+
+void mem_governor_set_budget(u64 bytes)
+{
+	pthread_mutex_lock(&governor.lock);
+	governor.budget = bytes;
+	pthread_mutex_unlock(&governor.lock);
+	ebpf_info("Set memory governor budget to %lu bytes.\n", bytes);
+}
+
+/*
+ * The priority may be set before the action is registered (the subsystem
+ * is started later), it is then kept by the registration.
+ */
+int mem_governor_set_priority(const char *name, int priority)
+{
+	struct mem_shed_action *a;
+	int ret = ETR_OK;
+
+	pthread_mutex_lock(&governor.lock);
+	a = find_action(name);
+	if (a == NULL && (a = add_action(name, priority)) == NULL) {
+		ret = ETR_NOROOM;
+	} else {
+		a->stat.priority = priority;
+		sort_actions();
+	}
+	pthread_mutex_unlock(&governor.lock);
+	return ret;
+}
+
+static void apply_next_action(u64 usage)
+{
+	struct mem_shed_action *a;
+	int i;
+
+	for (i = 0; i < governor.count; i++) {
+		a = &governor.actions[i];
+		if (a->stat.active || a->shed == NULL)
+			continue;
+		a->stat.active = 1;
+		a->stat.activate_count++;
+		a->stat.last_usage = usage;
+		a->stat.shed_count++;
+		a->shed();
+		governor.settle_checks = 0;
+		ebpf_info("Memory usage %lu bytes (budget %lu), shedding "
+			  "action '%s' applied.\n", usage, governor.budget,
+			  a->stat.name);
+		return;
+	}
+}
+
+static void revert_last_action(u64 usage)
+{
+	struct mem_shed_action *a;
+	int i;
+
+	for (i = governor.count - 1; i >= 0; i--) {
+		a = &governor.actions[i];
+		if (!a->stat.active)
+			continue;
+		a->stat.active = 0;
+		if (a->restore)
+			a->restore();
+		governor.settle_checks = 0;
+		ebpf_info("Memory usage %lu bytes (budget %lu), shedding "
+			  "action '%s' reverted.\n", usage, governor.budget,
+			  a->stat.name);
+		return;
+	}
+}
+
+void mem_governor_check_usage(u64 usage)
+{
+	struct mem_shed_action *a;
+	bool all_active = true;
+	int i;
+
+	pthread_mutex_lock(&governor.lock);
+	governor.usage = usage;
+	if (governor.settle_checks < MEM_GOVERNOR_SETTLE_CHECKS)
+		governor.settle_checks++;
+
+	/* Budget removed, revert everything at once. */
+	if (governor.budget == 0) {
+		for (i = 0; i < governor.count; i++)
+			revert_last_action(usage);
+		governor.usage = 0;
+		goto out;
+	}
+
+	if (usage >= governor.budget / 100 * MEM_GOVERNOR_HIGH_PCT) {
+		for (i = 0; i < governor.count; i++) {
+			a = &governor.actions[i];
+			if (a->shed == NULL)
+				continue;
+			if (!a->stat.active) {
+				all_active = false;
+				continue;
+			}
+			a->stat.shed_count++;
+			a->shed();
+		}
+
+		if (!all_active &&
+		    governor.settle_checks >= MEM_GOVERNOR_SETTLE_CHECKS)
+			apply_next_action(usage);
+
+		if (all_active && usage >= governor.budget)
+			ebpf_warning("Memory usage %lu bytes exceeds the "
+				     "budget %lu, all the shedding actions "
+				     "are applied.\n", usage, governor.budget);
+	} else if (usage < governor.budget / 100 * MEM_GOVERNOR_LOW_PCT &&
+		   governor.settle_checks >= MEM_GOVERNOR_SETTLE_CHECKS) {
+		revert_last_action(usage);
+	}
+
+out:
+	pthread_mutex_unlock(&governor.lock);
+}
+
+static u64 get_process_rss(void)
+{
+	unsigned long size, resident;
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (fp == NULL)
+		return 0;
+
+	if (fscanf(fp, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(fp);
+
+	return (u64) resident * sysconf(_SC_PAGESIZE);
+}
+
+int mem_governor_check(void)
+{
+	if (governor.budget == 0 && governor.usage == 0)
+		return 0;
+
+	mem_governor_check_usage(get_process_rss());
+	return 0;
+}
+
+void mem_governor_stats(struct mem_governor_stat *stat)
+{
+	int i;
+
+	pthread_mutex_lock(&governor.lock);
+	stat->budget = governor.budget;
+	stat->usage = governor.usage;
+	stat->count = governor.count;
+	for (i = 0; i < governor.count; i++)
+		stat->actions[i] = governor.actions[i].stat;
+	pthread_mutex_unlock(&governor.lock);
+}
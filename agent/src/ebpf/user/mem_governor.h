@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DF_USER_MEM_GOVERNOR_H
+#define DF_USER_MEM_GOVERNOR_H
+
+#include <stdbool.h>
+#include "types.h"
+
+/*
+ * Memory governor.
+ *
+ * The subsystems register shedding actions with a priority. When the
+ * memory usage gets close to the budget, the actions are applied one at
+ * a time in priority order (lower values first) until the usage is under
+ * control, and reverted in the reverse order once the pressure is gone:
+ *
+ *   vmlinux-btf   : drop the cached vmlinux BTF (parsed again if needed).
+ *   symbol-cache  : evict the symbol caches not used recently.
+ *   stack-str     : flush the stack string caches.
+ *   profiler-freq : keep only a part of the on-CPU samples.
+ *   socket-data   : cap the socket data queued for the dispatch workers.
+ *
+ * While an action is active, its 'shed' callback is called on each check
+ * above the high threshold, so it must be idempotent. The 'restore'
+ * callback is optional.
+ */
+
+typedef void (*mem_shed_fn) (void);
+
+#define MEM_SHED_NAME_LEN 32
+
+struct mem_shed_stat {
+	char name[MEM_SHED_NAME_LEN];
+	int priority;
+	u8 active;
+	// Number of times the action has been activated.
+	u64 activate_count;
+	// Number of times the shed callback has been called.
+	u64 shed_count;
+	// Memory usage when the action was last activated.
+	u64 last_usage;
+} __attribute__ ((packed));
+
+struct mem_governor_stat {
+	u64 budget;
+	u64 usage;
+	int count;
+	struct mem_shed_stat actions[0];
+} __attribute__ ((packed));
+
+/*
+ * Register a shedding action, registering an existing name replaces its
+ * callbacks but keeps its priority.
+ */
+int mem_governor_register(const char *name, int priority, mem_shed_fn shed,
+			  mem_shed_fn restore);
+// Set the memory budget in bytes, 0 disables the governor.
+void mem_governor_set_budget(u64 bytes);
+int mem_governor_set_priority(const char *name, int priority);
+/*
+ * Check the memory usage against the budget and apply or revert the
+ * actions, 'usage' is in bytes.
+ */
+void mem_governor_check_usage(u64 usage);
+// Periodic event, checks the process RSS.
+int mem_governor_check(void);
+// Fill 'stat' with MEM_GOVERNOR_ACTIONS_MAX entries at most.
+void mem_governor_stats(struct mem_governor_stat *stat);
+
+#endif /* DF_USER_MEM_GOVERNOR_H */
@@ -19,13 +19,19 @@
 // https://github.com/davea42/libdwarf-code/blob/master/src/bin/dwarfexample/findfuncbypc.c
 
 #include "offset.h"
+#include "config.h"
 #include "utils.h"
 #include "log.h"
+#include "elf.h"
 #include <fcntl.h>
 #include <libdwarf-0/dwarf.h>
 #include <libdwarf-0/libdwarf.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -33,18 +39,77 @@ static const int FOUND_TARGET = 12;
 static const int LEVEL_MAX = 3;
 
 struct target_data_s {
-	const char *structure;
-	const char *member;
-	unsigned long long int offset;
+	struct member_offset_req *reqs;
+	int count;
+	// Requests not found yet.
+	int pending;
 };
 
+static bool struct_wanted(struct target_data_s *td, const char *structure)
+{
+	int i;
+	for (i = 0; i < td->count; i++) {
+		if (td->reqs[i].offset == ETR_INVAL &&
+		    !strcmp(td->reqs[i].structure, structure))
+			return true;
+	}
+
+	return false;
+}
+
+static int examine_member(Dwarf_Debug dbg, struct target_data_s *td,
+			  const char *structure, Dwarf_Die member)
+{
+	Dwarf_Error err = NULL;
+	Dwarf_Attribute attr = NULL;
+	Dwarf_Unsigned offset = 0;
+	struct member_offset_req *req;
+	char *name = NULL;
+	int i, rc;
+
+	rc = dwarf_die_text(member, DW_AT_name, &name, &err);
+	if (rc == DW_DLV_ERROR) {
+		return DW_DLV_ERROR;
+	}
+	if (name == NULL)
+		return DW_DLV_OK;
+
+	for (i = 0; i < td->count; i++) {
+		req = &td->reqs[i];
+		if (req->offset != ETR_INVAL || strcmp(req->member, name) ||
+		    strcmp(req->structure, structure))
+			continue;
+
+		if (attr == NULL) {
+			rc = dwarf_attr(member, DW_AT_data_member_location,
+					&attr, &err);
+			if (rc == DW_DLV_ERROR) {
+				return DW_DLV_ERROR;
+			}
+
+			rc = dwarf_formudata(attr, &offset, &err);
+			if (rc == DW_DLV_ERROR) {
+				return DW_DLV_ERROR;
+			}
+		}
+
+		req->offset = (int)offset;
+		td->pending--;
+	}
+
+	return DW_DLV_OK;
+}
+
+/*
+ * A structure may be described in several compile units, the members
+ * are taken from the first description they are found in.
+ */
 static int examine_die_data(Dwarf_Debug dbg, struct target_data_s *td,
 			    Dwarf_Die die, int in_level)
 {
 	Dwarf_Error err = NULL;
 	Dwarf_Die child = NULL;
 	Dwarf_Half tag = 0;
-	Dwarf_Attribute attr = NULL;
 	char *name = NULL;
 	int rc = 0;
 
@@ -61,30 +126,20 @@ static int examine_die_data(Dwarf_Debug dbg, struct target_data_s *td,
 		return DW_DLV_ERROR;
 	}
 
-	if (!name || strcmp(name, td->structure))
+	if (!name || !struct_wanted(td, name))
 		return DW_DLV_OK;
 
 	rc = dwarf_child(die, &child, &err);
-	if (rc == DW_DLV_ERROR) {
-		return DW_DLV_ERROR;
+	if (rc != DW_DLV_OK) {
+		return rc;
 	}
 
 	for (;;) {
-		rc = dwarf_die_text(child, DW_AT_name, &name, &err);
+		rc = examine_member(dbg, td, name, child);
 		if (rc == DW_DLV_ERROR) {
 			return DW_DLV_ERROR;
 		}
-		if (!strcmp(name, td->member)) {
-			rc = dwarf_attr(child, DW_AT_data_member_location,
-					&attr, &err);
-			if (rc == DW_DLV_ERROR) {
-				return DW_DLV_ERROR;
-			}
-
-			rc = dwarf_formudata(attr, &td->offset, &err);
-			if (rc == DW_DLV_ERROR) {
-				return DW_DLV_ERROR;
-			}
+		if (td->pending == 0) {
 			return FOUND_TARGET;
 		}
 
@@ -202,20 +257,24 @@ static int look_for_our_target(Dwarf_Debug dbg, struct target_data_s *td,
 	return DW_DLV_NO_ENTRY;
 }
 
-int struct_member_offset_analyze(const char *bin, const char *structure,
-				 const char *member)
+static int member_offsets_analyze(const char *bin,
+				  struct member_offset_req *reqs, int count)
 {
 	Dwarf_Error err = NULL;
 	Dwarf_Debug dbg = NULL;
 	int fd = 0;
 	int rc = 0;
+	int i;
 
 	struct target_data_s td = {
-		.structure = structure,
-		.member = member,
-		.offset = -1,
+		.reqs = reqs,
+		.count = count,
+		.pending = count,
 	};
 
+	for (i = 0; i < count; i++)
+		reqs[i].offset = ETR_INVAL;
+
 	fd = open(bin, O_RDONLY, 0);
 	if (fd < 0)
 		goto out;
@@ -230,5 +289,141 @@ int struct_member_offset_analyze(const char *bin, const char *structure,
 out_file:
 	close(fd);
 out:
-	return (int)td.offset;
+	return count - td.pending;
+}
+
+/*
+ * Offsets already analyzed, by build ID. The pods of a workload run the
+ * same image, its DWARF is only walked for the first process.
+ */
+struct member_offset_memo {
+	char build_id[ELF_BUILD_ID_LEN];
+	int count;
+	struct member_offset_req *reqs;
+	uint64_t last_used;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct member_offset_memo slots[MEMBER_OFFSET_MEMO_SIZE];
+	uint64_t tick;
+} offset_memo = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static int memo_req_lookup(struct member_offset_memo *m,
+			   struct member_offset_req *req)
+{
+	int i;
+	for (i = 0; i < m->count; i++) {
+		if (!strcmp(m->reqs[i].structure, req->structure) &&
+		    !strcmp(m->reqs[i].member, req->member))
+			return i;
+	}
+
+	return -1;
+}
+
+static bool memo_lookup(const char *build_id, struct member_offset_req *reqs,
+			int count, int *found)
+{
+	struct member_offset_memo *m;
+	int i, j, k;
+
+	for (i = 0; i < MEMBER_OFFSET_MEMO_SIZE; i++) {
+		m = &offset_memo.slots[i];
+		if (m->reqs == NULL || strcmp(m->build_id, build_id))
+			continue;
+
+		for (j = 0; j < count; j++) {
+			if (memo_req_lookup(m, &reqs[j]) < 0)
+				return false;
+		}
+
+		*found = 0;
+		for (j = 0; j < count; j++) {
+			k = memo_req_lookup(m, &reqs[j]);
+			reqs[j].offset = m->reqs[k].offset;
+			if (reqs[j].offset != ETR_INVAL)
+				(*found)++;
+		}
+		m->last_used = ++offset_memo.tick;
+		return true;
+	}
+
+	return false;
+}
+
+static void memo_add(const char *build_id, struct member_offset_req *reqs,
+		     int count)
+{
+	struct member_offset_memo *m, *victim = NULL;
+	struct member_offset_req *copy;
+	int i;
+
+	copy = malloc(count * sizeof(*copy));
+	if (copy == NULL)
+		return;
+	memcpy(copy, reqs, count * sizeof(*copy));
+
+	for (i = 0; i < MEMBER_OFFSET_MEMO_SIZE; i++) {
+		m = &offset_memo.slots[i];
+		if (m->reqs && !strcmp(m->build_id, build_id)) {
+			victim = m;
+			break;
+		}
+		if (victim == NULL || victim->last_used > m->last_used)
+			victim = m;
+	}
+
+	free(victim->reqs);
+	snprintf(victim->build_id, sizeof(victim->build_id), "%s", build_id);
+	victim->reqs = copy;
+	victim->count = count;
+	victim->last_used = ++offset_memo.tick;
+}
+
+int struct_member_offsets_analyze(const char *bin,
+				  struct member_offset_req *reqs, int count)
+{
+	char build_id[ELF_BUILD_ID_LEN];
+	bool has_build_id;
+	int found;
+
+	if (bin == NULL || reqs == NULL || count <= 0)
+		return 0;
+
+	has_build_id = elf_build_id(bin, build_id, sizeof(build_id)) == ETR_OK;
+	if (has_build_id) {
+		pthread_mutex_lock(&offset_memo.lock);
+		if (memo_lookup(build_id, reqs, count, &found)) {
+			pthread_mutex_unlock(&offset_memo.lock);
+			return found;
+		}
+		pthread_mutex_unlock(&offset_memo.lock);
+	}
+
+	found = member_offsets_analyze(bin, reqs, count);
+	ebpf_info("Analyzed %d/%d struct member offsets of %s (build ID %s)\n",
+		  found, count, bin, has_build_id ? build_id : "none");
+
+	if (has_build_id) {
+		pthread_mutex_lock(&offset_memo.lock);
+		memo_add(build_id, reqs, count);
+		pthread_mutex_unlock(&offset_memo.lock);
+	}
+
+	return found;
+}
+
+int struct_member_offset_analyze(const char *bin, const char *structure,
+				 const char *member)
+{
+	struct member_offset_req req = {
+		.structure = structure,
+		.member = member,
+	};
+
+	member_offsets_analyze(bin, &req, 1);
+	return req.offset;
 }
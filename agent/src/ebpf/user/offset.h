@@ -21,4 +21,21 @@
 int struct_member_offset_analyze(const char *bin, const char *structure,
 				 const char *member);
 
+struct member_offset_req {
+	const char *structure;	// e.g. "runtime.g"
+	const char *member;	// e.g. "goid"
+	int offset;		// Output, ETR_INVAL if not found
+};
+
+/*
+ * Analyze several struct member offsets with one walk of the DWARF
+ * information, the walk stops once all of them are found. The results
+ * are memoized by the build ID of the binary, 'structure' and 'member'
+ * must be static strings.
+ *
+ * Returns the number of offsets found.
+ */
+int struct_member_offsets_analyze(const char *bin,
+				  struct member_offset_req *reqs, int count);
+
 #endif
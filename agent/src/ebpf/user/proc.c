@@ -682,6 +682,7 @@ void *get_symbol_cache(pid_t pid, bool new_cache)
 		AO_INC(&p->use);
 		symbolizer_proc_lock(p);
 		u64 curr_time = current_sys_time_secs();
+		p->syms_cache_access_time = curr_time;
 		if (p->verified) {
 			/*
 			 * If an unknown frame appears during the process of symbolizing
@@ -974,6 +975,67 @@ void release_symbol_caches(void)
 #endif
 }
 
+struct evict_syms_walk {
+	u64 now;
+	u64 idle_secs;
+	u64 count;
+};
+
+static int evict_cold_syms_cache_cb(symbol_caches_hash_kv * kvp, void *ctx)
+{
+	struct symbolizer_cache_kvp *kv = (struct symbolizer_cache_kvp *)kvp;
+	struct evict_syms_walk *w = ctx;
+	struct symbolizer_proc_info *p;
+
+	p = (struct symbolizer_proc_info *)kv->v.proc_info_p;
+	if (p == NULL || p->syms_cache == 0)
+		return BIHASH_WALK_CONTINUE;
+
+	AO_INC(&p->use);
+	symbolizer_proc_lock(p);
+	/*
+	 * The access time is updated under the lock before the cache is
+	 * handed out, a cache idle for this long is no longer in use. It
+	 * may be newer than 'now' (set during the walk), so no subtraction.
+	 */
+	if (p->syms_cache &&
+	    p->syms_cache_access_time + w->idle_secs <= w->now) {
+		bcc_free_symcache((void *)p->syms_cache, p->pid);
+		free_symcache_count++;
+		p->syms_cache = 0;
+		/*
+		 * Rebuild the cache on the next symbolization, without the
+		 * random startup delay a zero update time would add.
+		 */
+		p->update_syms_table_time = w->now;
+		w->count++;
+	}
+	symbolizer_proc_unlock(p);
+	AO_DEC(&p->use);
+
+	return BIHASH_WALK_CONTINUE;
+}
+
+u64 evict_cold_symbol_caches(u64 idle_secs)
+{
+	struct evict_syms_walk w = {
+		.now = current_sys_time_secs(),
+		.idle_secs = idle_secs,
+	};
+
+	if (!enable_proc_info_cache())
+		return 0;
+
+	symbol_caches_hash_foreach_key_value_pair(&syms_cache_hash,
+						  evict_cold_syms_cache_cb,
+						  (void *)&w);
+	if (w.count > 0)
+		ebpf_info("Evicted %lu symbol caches idle for %lu seconds.\n",
+			  w.count, idle_secs);
+
+	return w.count;
+}
+
 int creat_ksyms_cache(void)
 {
 	errno = 0;
@@ -1220,25 +1282,40 @@ struct bcc_elf_foreach_sym_payload {
 	const char *symbol_name;
 };
 
+// All the symbols are looked up in one pass of the symbol table.
+struct bcc_elf_foreach_syms_payload {
+	struct bcc_elf_foreach_sym_payload *syms;
+	size_t count;
+	size_t pending;
+};
+
+static bool bcc_elf_sym_match(struct bcc_elf_foreach_sym_payload *p,
+			      const char *name)
+{
+	char *pos;
+	if (p->name && (pos = strstr(name, p->name)))
+		return pos[strlen(p->name)] == '\0';
+	else if (p->prefix && (pos = strstr(name, p->prefix)))
+		return name == pos;
+	return false;
+}
+
 static int bcc_elf_foreach_sym_callback(const char *name, uint64_t addr,
 					uint64_t size, void *payload)
 {
-	struct bcc_elf_foreach_sym_payload *p = payload;
-	char *pos;
-	if (p->name && (pos = strstr(name, p->name))) {
-		if (pos[strlen(p->name)] == '\0') {
-			p->addr = addr;
-			p->size = size;
-			p->symbol_name = strdup(name);
-			return -1;
-		}
-	} else if (p->prefix && (pos = strstr(name, p->prefix))) {
-		if (name == pos) {
-			p->addr = addr;
-			p->size = size;
-			p->symbol_name = strdup(name);
+	struct bcc_elf_foreach_syms_payload *ps = payload;
+	struct bcc_elf_foreach_sym_payload *p;
+	size_t i;
+
+	for (i = 0; i < ps->count; i++) {
+		p = &ps->syms[i];
+		if (p->symbol_name || !bcc_elf_sym_match(p, name))
+			continue;
+		p->addr = addr;
+		p->size = size;
+		p->symbol_name = strdup(name);
+		if (--ps->pending == 0)
 			return -1;
-		}
 	}
 	return 0;
 }
@@ -1251,40 +1328,56 @@ int add_probe_sym_to_tracer_probes(int pid, const char *path,
 	ret = idx = count = 0;
 	struct symbol_uprobe *probe_sym = NULL;
 	struct symbol *cur = NULL;
-	struct bcc_elf_foreach_sym_payload payload;
+	struct bcc_elf_foreach_sym_payload *payload;
+	struct bcc_elf_foreach_sym_payload payloads[n_symbols];
+	struct bcc_elf_foreach_syms_payload scan = {
+		.syms = payloads,
+		.count = n_symbols,
+		.pending = n_symbols,
+	};
+	bool is_exe;
+
+	// Use memory on the stack, no need to allocate on the heap
+	memset(payloads, 0, sizeof(payloads));
+	for (idx = 0; idx < n_symbols; ++idx) {
+		payloads[idx].name = symbols[idx].symbol;
+		payloads[idx].prefix = symbols[idx].symbol_prefix;
+	}
+
+	ret = bcc_elf_foreach_sym(path, bcc_elf_foreach_sym_callback,
+				  &bcc_elf_foreach_sym_option, &scan);
+	if (ret && scan.pending == n_symbols)
+		return 0;
+
+	is_exe = bcc_elf_is_exe(path);
 
 	for (idx = 0; idx < n_symbols; ++idx) {
-		memset(&payload, 0, sizeof(payload));
+		payload = &payloads[idx];
 		cur = &symbols[idx];
 
-		// Use memory on the stack, no need to allocate on the heap
-		payload.name = cur->symbol;
-		payload.prefix = cur->symbol_prefix;
-		ret = bcc_elf_foreach_sym(path, bcc_elf_foreach_sym_callback,
-					  &bcc_elf_foreach_sym_option,
-					  &payload);
-		if (ret)
-			break;
-
 		// It has been confirmed earlier that the incoming binary file
 		// must be libssl.so and should not be hit here
-		if (!payload.addr || !payload.size)
+		if (!payload->addr || !payload->size) {
+			free((void *)payload->symbol_name);
 			continue;
+		}
 
 		// This memory will be maintained in conf, no need to release
 		probe_sym = calloc(1, sizeof(struct symbol_uprobe));
-		if (!probe_sym)
+		if (!probe_sym) {
+			free((void *)payload->symbol_name);
 			continue;
+		}
 
 		// Data comes from symbolic information
-		probe_sym->entry = payload.addr;
-		probe_sym->size = payload.size;
+		probe_sym->entry = payload->addr;
+		probe_sym->size = payload->size;
 
 		// Data comes from global variables
 		probe_sym->type = cur->type;
 		probe_sym->isret = cur->is_probe_ret;
 		probe_sym->probe_func = strdup(cur->probe_func);
-		probe_sym->name = payload.symbol_name;
+		probe_sym->name = payload->symbol_name;
 
 		// Data comes from function input parameters
 		probe_sym->binary_path = strdup(path);
@@ -1302,7 +1395,7 @@ int add_probe_sym_to_tracer_probes(int pid, const char *path,
 		 * - Shared libraries are also ET_DYN but usually lack the executable bit.
 		 *   To distinguish between them, check if the file has executable permissions.
 		 */
-		if (bcc_elf_is_exe(probe_sym->binary_path)) {
+		if (is_exe) {
 			struct load_addr_t addr = {
 				.target_addr = probe_sym->entry,
 				.binary_addr = 0x0,
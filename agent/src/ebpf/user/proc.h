@@ -100,6 +100,8 @@ struct symbolizer_proc_info {
 	pthread_mutex_t mutex;
 	/* Recording symbol resolution cache. */
 	volatile uword syms_cache;
+	/* Last time (in seconds) the symbol cache was used. */
+	u64 syms_cache_access_time;
 	/* Used to look up mount information from the mount cache. */
 	u64 mntns_id;
 };
@@ -181,6 +183,13 @@ void clear_proc_exit_event_count(void);
 int creat_ksyms_cache(void);
 void *get_symbol_cache(pid_t pid, bool new_cache);
 void release_symbol_caches(void);
+/*
+ * Free the symbol caches of the processes not symbolized for 'idle_secs',
+ * they are rebuilt on the next use.
+ *
+ * @return the number of evicted caches.
+ */
+u64 evict_cold_symbol_caches(u64 idle_secs);
 u64 get_pid_stime(pid_t pid);
 void set_java_syms_fetch_delay(int delay_secs);
 u64 get_java_syms_fetch_delay(void);
@@ -29,6 +29,7 @@
 #include "../common_utils.h"
 #include "../utils.h"
 #include "../mem.h"
+#include "../mem_governor.h"
 #include "../log.h"
 #include "../types.h"
 #include "../vec.h"
@@ -263,6 +264,9 @@ exit:
 		release_stack_str_hash(&oncpu_ctx.stack_str_hash);
 	}
 
+	release_kern_stack_strs(&oncpu_ctx);
+	release_interp_frame_cache();
+
 	print_hash_stack_trace_msg(&oncpu_ctx.msg_hash);
 	/* free stack_str_hash */
 	if (likely(oncpu_ctx.msg_hash.buckets != NULL)) {
@@ -608,6 +612,12 @@ void output_profiler_status(struct bpf_tracer *t, void *context)
 		   (double)ctx->transfer_count), alloc_b, free_b,
 		  alloc_b - free_b, output_count, sample_drop_cnt,
 		  output_err_cnt, iter_max_cnt, is_rt_kern);
+
+	u64 hugetlb_b, thp_b, normal_b;
+	get_mem_vm_stat(&hugetlb_b, &thp_b, &normal_b);
+	ebpf_info("hash arenas mapped: hugetlb %lu bytes, transparent "
+		  "hugepages %lu bytes, normal pages %lu bytes\n",
+		  hugetlb_b, thp_b, normal_b);
 }
 
 void print_cp_tracer_status(void)
@@ -615,6 +625,7 @@ void print_cp_tracer_status(void)
 	if (profiler_tracer == NULL)
 		return;
 	output_profiler_status(profiler_tracer, (void *)&oncpu_ctx);
+	print_interp_frame_cache_stats();
 	extended_print_cp_tracer_status();
 }
 
@@ -742,6 +753,22 @@ void build_prog_jump_tables(struct bpf_tracer *tracer)
  * @returns 0 on success, < 0 on error
  */
 
+/* Shedding actions of the memory governor. */
+static void profiler_freq_shed(void)
+{
+	set_profiler_sample_shift(PROFILER_SHED_SAMPLE_SHIFT);
+}
+
+static void profiler_freq_restore(void)
+{
+	set_profiler_sample_shift(0);
+}
+
+static void symbol_cache_shed(void)
+{
+	evict_cold_symbol_caches(SYMBOL_CACHE_COLD_SECS);
+}
+
 int start_continuous_profiler(int freq, int java_syms_update_delay,
 			      tracer_callback_t callback,
 			      void *cb_ctx[PROFILER_CTX_NUM])
@@ -881,6 +908,14 @@ int start_continuous_profiler(int freq, int java_syms_update_delay,
 	if (sockopt_register(&cpdbg_sockopts) != ETR_OK)
 		return (-1);
 
+	/* Shedding actions under memory pressure. */
+	mem_governor_register("symbol-cache", MEM_SHED_PRIO_SYMBOL_CACHE,
+			      symbol_cache_shed, NULL);
+	mem_governor_register("stack-str", MEM_SHED_PRIO_STACK_STR,
+			      stack_strs_shrink, NULL);
+	mem_governor_register("profiler-freq", MEM_SHED_PRIO_PROFILER_FREQ,
+			      profiler_freq_shed, profiler_freq_restore);
+
 	tracer->state = TRACER_RUNNING;
 
 	if (write_profiler_running_pid() != ETR_OK)
@@ -976,6 +1011,29 @@ struct bpf_tracer *get_profiler_tracer(void)
 	return profiler_tracer;
 }
 
+/*
+ * Keep only one in 2^shift on-CPU samples, the samples are dropped in
+ * the eBPF program. 0 keeps all the samples.
+ */
+int set_profiler_sample_shift(int shift)
+{
+	u64 val = (u64) shift;
+
+	if (shift < 0 || shift > 7 || profiler_tracer == NULL)
+		return (-1);
+
+	if (!bpf_table_set_value(profiler_tracer, oncpu_ctx.state_map_name,
+				 SAMPLE_SHIFT_IDX, (void *)&val)) {
+		ebpf_warning(LOG_CP_TAG "Set sample shift %d failed.\n",
+			     shift);
+		return (-1);
+	}
+
+	ebpf_info(LOG_CP_TAG "Set sample shift %d, 1/%d samples kept.\n",
+		  shift, 1 << shift);
+	return (0);
+}
+
 /*
  * Configure and enable the debugging functionality for Continuous Profiling.
  *
@@ -1041,6 +1099,7 @@ void profiler_match_pid_handle(int feat, int pid, enum match_pids_act act)
 		} else if (act == MATCH_PID_DEL) {
 			unwind_process_exit(pid);
 		}
+		interp_frame_cache_invalidate(pid);
 	}
 }
 
@@ -1083,6 +1142,11 @@ int set_profiler_cpu_aggregation(int flag)
 	return (-1);
 }
 
+int set_profiler_sample_shift(int shift)
+{
+	return (-1);
+}
+
 struct bpf_tracer *get_profiler_tracer(void)
 {
 	return NULL;
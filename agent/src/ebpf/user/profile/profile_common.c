@@ -361,6 +361,7 @@ do {											   \
 			 */								   \
 			ctx->stackmap_clear_failed_count++;				   \
 		}									   \
+		kern_stack_str_invalidate(&stack_map->kern_stack_strs, id);		   \
 		clear_bitmap(stack_map->ids.bitmap, id);				   \
 	}										   \
 	vec_free(stack_map->clear_ids);							   \
@@ -416,6 +417,7 @@ static void cleanup_stackmap(struct profiler_context *ctx, struct bpf_tracer *t,
 		 */
 		if (*perf_buf_lost_p > 0) {
 			delete_all_stackmap_elems(t, stack_map->name);
+			clean_kern_stack_strs(&stack_map->kern_stack_strs);
 			if (custom_entries) {
 				delete_all_stackmap_elems(t, custom_stack_map->name);
 			}
@@ -438,14 +440,20 @@ print_profiler_status(struct profiler_context *ctx,
 		   "stackmap_clear_failed_count\t%lu\n"
 		   "ransfer_count:\t%lu iter_count:\t%lu\nall"
 		   "oc_b:\t%lu bytes free_b:\t%lu bytes use:\t%lu bytes\n"
-		   "stack_str_hash.hit_count %lu\nstack_trace_msg_hash hit %lu\n",
+		   "stack_str_hash.hit_count %lu\nstack_trace_msg_hash hit %lu\n"
+		   "kern_stack_strs_a hit %lu elems %lu\n"
+		   "kern_stack_strs_b hit %lu elems %lu\n",
 		   ctx->tag, atomic64_read(&t->recv), atomic64_read(&t->lost),
 		   ctx->perf_buf_lost_a_count, ctx->perf_buf_lost_b_count,
 		   ctx->stack_trace_err, ctx->stackmap_clear_failed_count,
 		   ctx->transfer_count, iter_count,
 		   alloc_b, free_b, alloc_b - free_b,
 		   ctx->stack_str_hash.hit_hash_count,
-		   ctx->msg_hash.hit_hash_count);
+		   ctx->msg_hash.hit_hash_count,
+		   ctx->stack_map_a.kern_stack_strs.hit_hash_count,
+		   ctx->stack_map_a.kern_stack_strs.hash_elems_count,
+		   ctx->stack_map_b.kern_stack_strs.hit_hash_count,
+		   ctx->stack_map_b.kern_stack_strs.hash_elems_count);
 }
 
 static int push_and_free_msg_kvp_cb(stack_trace_msg_hash_kv * kv, void *arg)
@@ -1056,7 +1064,10 @@ static void aggregate_stack_traces(struct profiler_context *ctx,
 		char *trace_str =
 		    resolve_and_gen_stack_trace_str(t, v,
 		                    stack_map->name, custom_stack_map->name,
-						    stack_str_hash, matched,
+						    stack_str_hash,
+						    stack_map->kern_stack_strs.buckets ?
+						    &stack_map->kern_stack_strs : NULL,
+						    matched,
 						    process_name, info_p,
 						    ctx->type ==
 						    PROFILER_TYPE_MEMORY);
@@ -1090,7 +1101,6 @@ static void aggregate_stack_traces(struct profiler_context *ctx,
 			int len = sizeof(stack_trace_msg_t) + str_len;
 			stack_trace_msg_t *msg = alloc_stack_trace_msg(len);
 			if (msg == NULL) {
-				clib_mem_free(trace_str);
 				if (__info_p)
 					AO_DEC(&__info_p->use);
 				if (class_name) {
@@ -1135,7 +1145,6 @@ static void aggregate_stack_traces(struct profiler_context *ctx,
 			}
 
 			msg->data_len = strlen((char *)msg->data);
-			clib_mem_free(trace_str);
 			kv.msg_ptr = pointer_to_uword(msg);
 
 			if (stack_trace_msg_hash_add_del(msg_hash,
@@ -1224,6 +1233,14 @@ void process_bpf_stacktraces(struct profiler_context *ctx, struct bpf_tracer *t)
 	 * is a match, we only need to increment the count field in the correspon-
 	 * ding value, thus avoiding duplicate parsing.
 	 */
+	if (unlikely(stack_map->kern_stack_strs.buckets == NULL)) {
+		if (init_kern_stack_str_hash(&stack_map->kern_stack_strs,
+					     "kern_stack_str")) {
+			ebpf_warning("%sinit_kern_stack_str_hash() failed.\n",
+				     ctx->tag);
+		}
+	}
+
 	if (unlikely(ctx->msg_hash.buckets == NULL)) {
 		if (init_stack_trace_msg_hash
 		    (&ctx->msg_hash, "stack_trace_msg")) {
@@ -1284,6 +1301,12 @@ release_iter:
 
 	//print_profiler_status(ctx, t, count);
 
+	/* Flush the kernel stack strings under memory pressure. */
+	if (stack_strs_shrink_pending(&ctx->stack_strs_shrink_gen)) {
+		clean_kern_stack_strs(&ctx->stack_map_a.kern_stack_strs);
+		clean_kern_stack_strs(&ctx->stack_map_b.kern_stack_strs);
+	}
+
 	/* free all elems */
 	clean_stack_strs(&ctx->stack_str_hash);
 
@@ -1291,6 +1314,12 @@ release_iter:
 	push_and_release_stack_trace_msg(ctx, &ctx->msg_hash, false);
 }
 
+void release_kern_stack_strs(struct profiler_context *ctx)
+{
+	release_kern_stack_str_hash(&ctx->stack_map_a.kern_stack_strs);
+	release_kern_stack_str_hash(&ctx->stack_map_b.kern_stack_strs);
+}
+
 bool profiler_is_running(void)
 {
 	for (int i = 0; i < ARRAY_SIZE(g_ctx_array); i++) {
@@ -27,6 +27,8 @@ typedef struct {
 	struct stack_ids_bitmap ids;
 	// This vector table is used to remove a stack from the stack map.
 	int *clear_ids;
+	// Kernel stack ID -> kernel stack string, across iterations.
+	stack_str_hash_t kern_stack_strs;
 } stack_map_t;
 
 struct profiler_context {
@@ -97,6 +99,9 @@ struct profiler_context {
 	 */
 	u64 sample_period;
 
+	// Last stack string shrink request handled.
+	u64 stack_strs_shrink_gen;
+
 	// for stack_trace_msg_hash relese
 	stack_trace_msg_hash_kv *trace_msg_kvps;
 	bool msg_clear_hash;
@@ -153,4 +158,5 @@ void push_and_release_stack_trace_msg(struct profiler_context *ctx,
 // Check if the profiler is currently running.
 bool profiler_is_running(void);
 void set_bpf_rt_kern(struct bpf_tracer *t, struct profiler_context *ctx);
+void release_kern_stack_strs(struct profiler_context *ctx);
 #endif /*DF_USER_PROFILE_COMMON_H */
@@ -56,6 +56,7 @@
 #include "../table.h"
 #include "../bihash_8_8.h"
 #include "../bihash_16_8.h"
+#include "../bihash_32_8.h"
 #include "java/collect_symbol_files.h"
 #include "stringifier.h"
 #include <bcc/bcc_syms.h>
@@ -100,6 +101,328 @@ typedef struct {
  */
 static __thread u64 stack_table_data_miss;
 
+/* The number of characters actually written by snprintf(). */
+static inline int written_len(int len, int size)
+{
+	if (len < 0 || size <= 0)
+		return 0;
+
+	return len >= size ? size - 1 : len;
+}
+
+/*
+ * Write "<tag><src>" into 'dst' ('size' includes the terminating '\0')
+ * and return the number of characters written.
+ */
+static inline int write_symbol_str(char *dst, int size, const char *tag,
+				   const char *src)
+{
+	if (size <= 0)
+		return 0;
+
+	return written_len(snprintf(dst, size, "%s%s", tag, src), size);
+}
+
+/*
+ * Cache of the interpreter frames resolved by extended_resolve_frame().
+ *
+ * key[0]: pid << 8 | frame type
+ * key[1]: frame address
+ * key[2]: extra data A
+ * key[3]: extra data B
+ * value: the symbol string (clib_mem), or if the frame could not be
+ *        resolved, the expiry time in seconds << 1 | INTERP_FRAME_NEGATIVE.
+ *
+ * Processes that exec or exit (the socket tracer's process events) or
+ * leave the profiler's match list are recorded by
+ * interp_frame_cache_invalidate() and their entries are removed at the
+ * end of the profiler iteration.
+ *
+ * The cache is shared by the on-CPU, off-CPU and memory profilers, which
+ * run on different threads. The hash and the cached strings are protected
+ * by 'lock', the strings are copied out under it.
+ */
+#define interp_frame_hash_t	clib_bihash_32_8_t
+#define interp_frame_hash_init	clib_bihash_init_32_8
+#define interp_frame_hash_kv	clib_bihash_kv_32_8_t
+#define interp_frame_hash_search	clib_bihash_search_32_8
+#define interp_frame_hash_add_del	clib_bihash_add_del_32_8
+#define interp_frame_hash_free	clib_bihash_free_32_8
+#define interp_frame_hash_foreach_key_value_pair	clib_bihash_foreach_key_value_pair_32_8
+
+#define INTERP_FRAME_NEGATIVE	1
+#define interp_frame_is_negative(v)	((v) & INTERP_FRAME_NEGATIVE)
+// Statistics index 0 (FRAME_TYPE_NORMAL) counts unknown frame types.
+#define INTERP_FRAME_TYPE_NUM	(FRAME_TYPE_V8 + 1)
+
+static const char *interp_frame_type_names[INTERP_FRAME_TYPE_NUM] = {
+	[FRAME_TYPE_NORMAL] = "other",
+	[FRAME_TYPE_PYTHON] = "python",
+	[FRAME_TYPE_PHP] = "php",
+	[FRAME_TYPE_V8] = "v8",
+};
+
+static struct {
+	interp_frame_hash_t hash;
+	bool init_failed;
+	pthread_mutex_t lock;
+	// Processes whose frames are to be removed.
+	int *invalid_pids;
+	// Last shrink request handled.
+	u64 shrink_gen;
+
+	/* statistics */
+	u64 hit_count[INTERP_FRAME_TYPE_NUM];
+	u64 negative_hit_count[INTERP_FRAME_TYPE_NUM];
+	u64 miss_count[INTERP_FRAME_TYPE_NUM];
+	u64 flush_count;
+} interp_frame_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+
+/* Incremented by the memory governor, handled by the profiler reader. */
+static volatile u64 stack_strs_shrink_gen;
+
+void stack_strs_shrink(void)
+{
+	__sync_fetch_and_add(&stack_strs_shrink_gen, 1);
+}
+
+bool stack_strs_shrink_pending(u64 * seen_gen)
+{
+	u64 gen = stack_strs_shrink_gen;
+	if (*seen_gen == gen)
+		return false;
+
+	*seen_gen = gen;
+	return true;
+}
+
+void interp_frame_cache_invalidate(pid_t pid)
+{
+	int ret = VEC_OK;
+	pthread_mutex_lock(&interp_frame_cache.lock);
+	// Nothing cached yet, and no profiler to drain the list.
+	if (interp_frame_cache.hash.buckets != NULL)
+		vec_add1(interp_frame_cache.invalid_pids, pid, ret);
+	pthread_mutex_unlock(&interp_frame_cache.lock);
+	if (ret != VEC_OK)
+		ebpf_warning("vec add failed\n");
+}
+
+// Called with interp_frame_cache.lock held.
+static int interp_frame_cache_init(void)
+{
+	interp_frame_hash_t *h = &interp_frame_cache.hash;
+	memset(h, 0, sizeof(*h));
+	if (interp_frame_hash_init(h, "interp_frame_cache",
+				   INTERP_FRAME_CACHE_BUCKETS_NUM,
+				   INTERP_FRAME_CACHE_MEM_SZ)) {
+		ebpf_warning("interp_frame_hash_init() failed.\n");
+		interp_frame_cache.init_failed = true;
+		return ETR_NOMEM;
+	}
+
+	return ETR_OK;
+}
+
+/*
+ * Resolve an interpreter frame through the cache and write its name into
+ * 'dst'. On a miss the extended hook is called, outside the lock, and its
+ * result is cached. A failure is cached for INTERP_FRAME_NEGATIVE_TTL
+ * seconds.
+ *
+ * Returns the number of characters written, or -1 if the frame can not be
+ * resolved.
+ */
+static int interp_frame_resolve(pid_t pid, u64 addr, u8 frame_type,
+				u64 extra_a, u64 extra_b, char *dst, int size)
+{
+	int type_idx = frame_type < INTERP_FRAME_TYPE_NUM ? frame_type : 0;
+	interp_frame_hash_t *h = &interp_frame_cache.hash;
+	u64 now = gettime(CLOCK_MONOTONIC, TIME_TYPE_SEC);
+	interp_frame_hash_kv kv, old;
+	bool exists;
+	char *str;
+	int n;
+
+	kv.key[0] = ((u64) pid << 8) | frame_type;
+	kv.key[1] = addr;
+	kv.key[2] = extra_a;
+	kv.key[3] = extra_b;
+
+	pthread_mutex_lock(&interp_frame_cache.lock);
+	if (unlikely(h->buckets == NULL) && !interp_frame_cache.init_failed)
+		interp_frame_cache_init();
+
+	if (h->buckets != NULL && interp_frame_hash_search(h, &kv, &old) == 0) {
+		if (!interp_frame_is_negative(old.value)) {
+			n = write_symbol_str(dst, size, "", (char *)old.value);
+			pthread_mutex_unlock(&interp_frame_cache.lock);
+			__sync_fetch_and_add(&interp_frame_cache.
+					     hit_count[type_idx], 1);
+			return n;
+		}
+
+		if ((old.value >> 1) > now) {
+			pthread_mutex_unlock(&interp_frame_cache.lock);
+			__sync_fetch_and_add(&interp_frame_cache.
+					     negative_hit_count[type_idx], 1);
+			return -1;
+		}
+	}
+	pthread_mutex_unlock(&interp_frame_cache.lock);
+
+	__sync_fetch_and_add(&interp_frame_cache.miss_count[type_idx], 1);
+	str = extended_resolve_frame(pid, addr, frame_type, extra_a, extra_b);
+	n = str ? write_symbol_str(dst, size, "", str) : -1;
+
+	pthread_mutex_lock(&interp_frame_cache.lock);
+	if (h->buckets == NULL)
+		goto unlock;
+
+	/*
+	 * Another profiler may have resolved the same frame meanwhile, keep
+	 * its string.
+	 */
+	exists = (interp_frame_hash_search(h, &kv, &old) == 0);
+	if (exists && !interp_frame_is_negative(old.value))
+		goto unlock;
+
+	kv.value = str ? pointer_to_uword(str) :
+	    ((now + INTERP_FRAME_NEGATIVE_TTL) << 1) | INTERP_FRAME_NEGATIVE;
+	if (interp_frame_hash_add_del(h, &kv, 1 /* is_add */ )) {
+		ebpf_warning("interp_frame_hash_add_del() failed.\n");
+		goto unlock;
+	}
+	if (!exists)
+		h->hash_elems_count++;
+	// The cache owns the string now.
+	str = NULL;
+
+unlock:
+	pthread_mutex_unlock(&interp_frame_cache.lock);
+	if (str)
+		clib_mem_free(str);
+
+	return n;
+}
+
+struct interp_frame_purge_walk {
+	int *pids;
+	bool all;
+	interp_frame_hash_kv *kvs;
+};
+
+static int collect_interp_frame_cb(interp_frame_hash_kv * kv, void *arg)
+{
+	struct interp_frame_purge_walk *w = arg;
+	pid_t pid = (pid_t) (kv->key[0] >> 8);
+	int *p, ret = VEC_OK;
+
+	if (!w->all) {
+		vec_foreach(p, w->pids) {
+			if (*p == pid)
+				break;
+		}
+
+		if (p == vec_end(w->pids))
+			return BIHASH_WALK_CONTINUE;
+	}
+
+	vec_add1(w->kvs, *kv, ret);
+	if (ret != VEC_OK)
+		ebpf_warning("vec add failed\n");
+
+	return BIHASH_WALK_CONTINUE;
+}
+
+/*
+ * Remove the frames of the invalidated processes, or all the frames
+ * if the cache is full. It is called at the end of each iteration.
+ */
+static void interp_frame_cache_purge(void)
+{
+	interp_frame_hash_t *h = &interp_frame_cache.hash;
+	struct interp_frame_purge_walk w = { 0 };
+
+	pthread_mutex_lock(&interp_frame_cache.lock);
+	w.pids = interp_frame_cache.invalid_pids;
+	interp_frame_cache.invalid_pids = NULL;
+
+	if (h->buckets == NULL)
+		goto out;
+
+	w.all = (h->hash_elems_count >= INTERP_FRAME_CACHE_MAX_ELEMS);
+	if (stack_strs_shrink_pending(&interp_frame_cache.shrink_gen))
+		w.all = true;
+	if (!w.all && vec_len(w.pids) == 0)
+		goto out;
+
+	interp_frame_hash_foreach_key_value_pair(h, collect_interp_frame_cb,
+						 (void *)&w);
+	interp_frame_hash_kv *v;
+	vec_foreach(v, w.kvs) {
+		u64 value = v->value;
+		if (interp_frame_hash_add_del(h, v, 0 /* delete */ ) == 0) {
+			if (!interp_frame_is_negative(value))
+				clib_mem_free((void *)value);
+			h->hash_elems_count--;
+		}
+	}
+
+	if (w.all)
+		interp_frame_cache.flush_count++;
+
+	ebpf_debug("interp frame cache: removed %d elems (pids %d flush %d), "
+		   "remain %lu\n", vec_len(w.kvs), vec_len(w.pids), w.all,
+		   h->hash_elems_count);
+	vec_free(w.kvs);
+out:
+	pthread_mutex_unlock(&interp_frame_cache.lock);
+	vec_free(w.pids);
+}
+
+void print_interp_frame_cache_stats(void)
+{
+	int i;
+	ebpf_info("interp frame cache: elems %lu flush %lu\n",
+		  interp_frame_cache.hash.hash_elems_count,
+		  interp_frame_cache.flush_count);
+	for (i = 0; i < INTERP_FRAME_TYPE_NUM; i++) {
+		ebpf_info(" - %s:\thit %lu negative_hit %lu miss %lu\n",
+			  interp_frame_type_names[i],
+			  interp_frame_cache.hit_count[i],
+			  interp_frame_cache.negative_hit_count[i],
+			  interp_frame_cache.miss_count[i]);
+	}
+}
+
+void release_interp_frame_cache(void)
+{
+	interp_frame_hash_t *h = &interp_frame_cache.hash;
+	struct interp_frame_purge_walk w = { .all = true };
+	interp_frame_hash_kv *v;
+
+	pthread_mutex_lock(&interp_frame_cache.lock);
+	vec_free(interp_frame_cache.invalid_pids);
+	if (h->buckets == NULL)
+		goto out;
+
+	interp_frame_hash_foreach_key_value_pair(h, collect_interp_frame_cb,
+						 (void *)&w);
+	vec_foreach(v, w.kvs) {
+		if (!interp_frame_is_negative(v->value))
+			clib_mem_free((void *)v->value);
+	}
+	vec_free(w.kvs);
+	interp_frame_hash_free(h);
+	memset(h, 0, sizeof(*h));
+out:
+	pthread_mutex_unlock(&interp_frame_cache.lock);
+}
+
 u64 get_stack_table_data_miss_count(void)
 {
 	return stack_table_data_miss;
@@ -120,15 +443,101 @@ int init_stack_str_hash(stack_str_hash_t * h, const char *name)
 	struct stack_str_hash_ext_data *ext = h->private;
 	ext->stack_str_kvps = NULL;
 	ext->clear_hash = false;
+	memset(&ext->sym_index, 0, sizeof(ext->sym_index));
+	clib_mem_arena_init(&ext->arena, "stringifier_arena",
+			    STRINGIFIER_ARENA_BLOCK_SZ);
+	ext->folded_buf = clib_mem_alloc_aligned("folded_buf",
+						 STRINGIFIER_FOLDED_BUF_SZ, 0,
+						 NULL);
+	if (ext->folded_buf == NULL) {
+		clib_mem_free(ext);
+		h->private = NULL;
+		return ETR_NOMEM;
+	}
 
 	return stack_str_hash_init(h, (char *)name, nbuckets, hash_memory_size);
 }
 
+struct symbol_index_elem {
+	// The last synchronization in which the symbol was seen.
+	u64 sync_gen;
+	// Raw eBPF map key, 'name' is rendered again only when it changes.
+	symbol_t sym;
+	// "<class_name>::<method_name>" or "<method_name>"
+	char name[CLASS_NAME_LEN + METHOD_NAME_LEN + 3];
+};
+
+/*
+ * The elements removed or replaced by a synchronization are freed at the
+ * end of the iteration, when no stack build can hold them anymore.
+ */
+static void free_retired_symbol_index_elems(struct symbol_table_index *idx)
+{
+	void **e;
+	vec_foreach(e, idx->retired) {
+		clib_mem_free(*e);
+	}
+	vec_free(idx->retired);
+}
+
+static void retire_symbol_index_elem(struct symbol_table_index *idx, void *e)
+{
+	int ret = VEC_OK;
+	vec_add1(idx->retired, e, ret);
+	if (ret != VEC_OK) {
+		ebpf_warning("vec add failed\n");
+		clib_mem_free(e);
+	}
+}
+
+static void render_symbol_index_elem(struct symbol_index_elem *e,
+				     const symbol_t *sym)
+{
+	e->sym = *sym;
+	if (sym->class_name[0] != '\0')
+		snprintf(e->name, sizeof(e->name), "%.*s::%.*s",
+			 (int)sizeof(sym->class_name), sym->class_name,
+			 (int)sizeof(sym->method_name), sym->method_name);
+	else
+		snprintf(e->name, sizeof(e->name), "%.*s",
+			 (int)sizeof(sym->method_name), sym->method_name);
+}
+
+static int free_symbol_index_elem_cb(symbol_index_hash_kv * kv, void *arg)
+{
+	if (kv->value != 0)
+		clib_mem_free((void *)kv->value);
+
+	return BIHASH_WALK_CONTINUE;
+}
+
+static void release_symbol_table_index(struct symbol_table_index *idx)
+{
+	if (idx->hash.buckets != NULL) {
+		symbol_index_hash_foreach_key_value_pair(&idx->hash,
+							 free_symbol_index_elem_cb,
+							 NULL);
+		symbol_index_hash_free(&idx->hash);
+	}
+	free_retired_symbol_index_elems(idx);
+
+	if (idx->keys)
+		clib_mem_free(idx->keys);
+	if (idx->ids)
+		clib_mem_free(idx->ids);
+
+	memset(idx, 0, sizeof(*idx));
+}
+
 void release_stack_str_hash(stack_str_hash_t * h)
 {
 	if (h->private) {
 		struct stack_str_hash_ext_data *ext = h->private;
 		vec_free(ext->stack_str_kvps);
+		release_symbol_table_index(&ext->sym_index);
+		clib_mem_arena_free(&ext->arena);
+		if (ext->folded_buf)
+			clib_mem_free(ext->folded_buf);
 		clib_mem_free(ext);
 	}
 
@@ -146,9 +555,7 @@ void clean_stack_strs(stack_str_hash_t * h)
 	stack_str_hash_kv *v;
 	struct stack_str_hash_ext_data *ext = h->private;
 	vec_foreach(v, ext->stack_str_kvps) {
-		if (v->value != 0)
-			clib_mem_free((void *)v->value);
-
+		/* The stack strings are released along with the arena. */
 		if (stack_str_hash_add_del(h, v, 0 /* delete */ )) {
 			ebpf_warning("stack_str_hash_add_del() failed.\n");
 			ext->clear_hash = true;
@@ -162,6 +569,24 @@ void clean_stack_strs(stack_str_hash_t * h)
 	h->hit_hash_count = 0;
 	h->hash_elems_count = 0;
 
+	/* The symbol table index is synchronized again in the next iteration. */
+	struct symbol_table_index *idx = &ext->sym_index;
+	if (idx->synced) {
+		ebpf_debug("symbol table index: elems %lu sync_gen %lu syscalls "
+			   "%lu hit %lu miss %lu\n", idx->hash.hash_elems_count,
+			   idx->sync_gen, idx->sync_syscalls, idx->hit_count,
+			   idx->miss_count);
+		idx->synced = false;
+	}
+	free_retired_symbol_index_elems(idx);
+
+	ebpf_debug("stringifier arena: allocs %lu bytes %lu heap blocks %lu\n",
+		   ext->arena.alloc_count, ext->arena.alloc_bytes,
+		   ext->arena.block_count);
+	clib_mem_arena_reset(&ext->arena);
+
+	interp_frame_cache_purge();
+
 	if (ext->clear_hash) {
 		release_stack_str_hash(h);
 	}
@@ -169,6 +594,196 @@ void clean_stack_strs(stack_str_hash_t * h)
 	ebpf_debug("clean_stack_strs hashmap clear %lu elems.\n", elems_count);
 }
 
+/*
+ * Read the '__symbol_table' map in batches (Linux 5.6+ for LRU hash maps).
+ * Return the number of elements read, or -1 if batch lookup is not
+ * available.
+ */
+static int symbol_table_batch_read(int map_fd, struct symbol_table_index *idx)
+{
+	u32 in_batch = 0, out_batch = 0, count;
+	int n = 0;
+	bool first = true;
+
+	while (n < MAX_SYMBOL_NUM) {
+		count = MAX_SYMBOL_NUM - n;
+		int ret = bpf_lookup_batch(map_fd, first ? NULL : &in_batch,
+					   &out_batch, idx->keys + n,
+					   idx->ids + n, &count);
+		idx->sync_syscalls++;
+		if (ret != 0 && errno != ENOENT) {
+			if (first)
+				return -1;
+			/* e.g. ENOSPC, keep what has been read. */
+			break;
+		}
+
+		n += count;
+		/* ENOENT: the whole map has been traversed. */
+		if (ret != 0)
+			break;
+
+		in_batch = out_batch;
+		first = false;
+	}
+
+	return n;
+}
+
+static int symbol_table_iter_read(int map_fd, struct symbol_table_index *idx)
+{
+	symbol_t key = {};
+	symbol_t next_key = {};
+	int n = 0;
+
+	while (n < MAX_SYMBOL_NUM &&
+	       bpf_get_next_key(map_fd, &key, &next_key) == 0) {
+		if (bpf_lookup_elem(map_fd, &next_key, &idx->ids[n]) == 0) {
+			idx->keys[n] = next_key;
+			n++;
+		}
+		idx->sync_syscalls += 2;
+		key = next_key;
+	}
+
+	return n;
+}
+
+struct stale_symbols_walk {
+	u64 sync_gen;
+	symbol_index_hash_kv *kvps;
+};
+
+static int collect_stale_symbol_cb(symbol_index_hash_kv * kv, void *arg)
+{
+	struct stale_symbols_walk *w = arg;
+	struct symbol_index_elem *e = (struct symbol_index_elem *)kv->value;
+
+	if (e->sync_gen + SYMBOL_INDEX_STALE_SYNCS <= w->sync_gen) {
+		int ret = VEC_OK;
+		vec_add1(w->kvps, *kv, ret);
+		if (ret != VEC_OK)
+			ebpf_warning("vec add failed\n");
+	}
+
+	return BIHASH_WALK_CONTINUE;
+}
+
+/*
+ * Incrementally synchronize the userspace index with the eBPF
+ * '__symbol_table' map. The raw map keys are compared, only symbols that
+ * are new (or whose id has been reused for another symbol) are rendered,
+ * and symbols evicted from the LRU map are dropped after
+ * SYMBOL_INDEX_STALE_SYNCS synchronizations so that stacks still
+ * referencing them in flight can be resolved.
+ */
+static int sync_symbol_table_index(struct bpf_tracer *t,
+				   struct symbol_table_index *idx)
+{
+	if (idx->synced)
+		return ETR_OK;
+
+	struct ebpf_map *map =
+	    ebpf_obj__get_map_by_name(t->obj, MAP_SYMBOL_TABLE_NAME);
+	if (map == NULL) {
+		ebpf_warning("bpf table %s not found", MAP_SYMBOL_TABLE_NAME);
+		return ETR_NOTEXIST;
+	}
+
+	if (unlikely(idx->hash.buckets == NULL)) {
+		memset(&idx->hash, 0, sizeof(idx->hash));
+		if (symbol_index_hash_init(&idx->hash, "symbol_table_index",
+					   SYMBOL_INDEX_HASH_BUCKETS_NUM,
+					   SYMBOL_INDEX_HASH_MEM_SZ)) {
+			ebpf_warning("symbol_index_hash_init() failed.\n");
+			return ETR_NOMEM;
+		}
+	}
+
+	if (idx->keys == NULL) {
+		idx->keys = clib_mem_alloc_aligned("symbol_index_keys",
+						   sizeof(symbol_t) *
+						   MAX_SYMBOL_NUM, 0, NULL);
+		idx->ids = clib_mem_alloc_aligned("symbol_index_ids",
+						  sizeof(u32) * MAX_SYMBOL_NUM,
+						  0, NULL);
+		if (idx->keys == NULL || idx->ids == NULL) {
+			ebpf_warning("symbol index buffers alloc failed.\n");
+			return ETR_NOMEM;
+		}
+	}
+
+	int i, n = -1;
+	if (!idx->batch_unsupported) {
+		n = symbol_table_batch_read(map->fd, idx);
+		if (n < 0) {
+			idx->batch_unsupported = true;
+			ebpf_info("%s batch lookup not supported (%s), "
+				  "fallback to key iteration.\n",
+				  MAP_SYMBOL_TABLE_NAME, strerror(errno));
+		}
+	}
+
+	if (n < 0)
+		n = symbol_table_iter_read(map->fd, idx);
+
+	idx->sync_gen++;
+	for (i = 0; i < n; i++) {
+		struct symbol_index_elem *e, *old = NULL;
+		symbol_t *sym = &idx->keys[i];
+		symbol_index_hash_kv kv;
+
+		kv.key = (u64) idx->ids[i];
+		kv.value = 0;
+		if (symbol_index_hash_search(&idx->hash, &kv, &kv) == 0) {
+			old = (struct symbol_index_elem *)kv.value;
+			old->sync_gen = idx->sync_gen;
+			if (memcmp(&old->sym, sym, sizeof(*sym)) == 0)
+				continue;
+			/* The id has been reused for another symbol. */
+		}
+
+		e = clib_mem_alloc_aligned("symbol_index_elem", sizeof(*e), 0,
+					   NULL);
+		if (e == NULL) {
+			ebpf_warning("symbol index elem alloc failed.\n");
+			break;
+		}
+		e->sync_gen = idx->sync_gen;
+		render_symbol_index_elem(e, sym);
+		kv.key = (u64) idx->ids[i];
+		kv.value = pointer_to_uword(e);
+		if (symbol_index_hash_add_del(&idx->hash, &kv, 1 /* is_add */ )) {
+			ebpf_warning("symbol_index_hash_add_del() failed.\n");
+			clib_mem_free(e);
+			break;
+		}
+
+		if (old)
+			retire_symbol_index_elem(idx, old);
+		else
+			__sync_fetch_and_add(&idx->hash.hash_elems_count, 1);
+	}
+
+	/* Drop the symbols that have been evicted from the eBPF map. */
+	struct stale_symbols_walk w = {.sync_gen = idx->sync_gen,.kvps = NULL };
+	symbol_index_hash_foreach_key_value_pair(&idx->hash,
+						 collect_stale_symbol_cb,
+						 (void *)&w);
+	symbol_index_hash_kv *v;
+	vec_foreach(v, w.kvps) {
+		void *e = (void *)v->value;
+		if (symbol_index_hash_add_del(&idx->hash, v, 0 /* delete */ ) == 0) {
+			retire_symbol_index_elem(idx, e);
+			__sync_fetch_and_sub(&idx->hash.hash_elems_count, 1);
+		}
+	}
+	vec_free(w.kvps);
+
+	idx->synced = true;
+	return ETR_OK;
+}
+
 static inline char *create_symbol_str(int len, char *src, const char *tag)
 {
 	char *dst = clib_mem_alloc_aligned("symbol_str", len + 1, 0, NULL);
@@ -178,17 +793,12 @@ static inline char *create_symbol_str(int len, char *src, const char *tag)
 	return dst;
 }
 
-static char *kern_symbol_name_fetch(pid_t pid, struct bcc_symbol *sym)
+static int kern_symbol_name_fetch(pid_t pid, struct bcc_symbol *sym,
+				  char *dst, int size)
 {
 	ASSERT(pid >= 0);
 
-	int len = 0;
-	char *ptr = NULL;
-	len = strlen(sym->name) + strlen(k_sym_prefix);
-	ptr = (char *)sym->name;
-	ptr = create_symbol_str(len, ptr, k_sym_prefix);
-
-	return ptr;
+	return write_symbol_str(dst, size, k_sym_prefix, sym->name);
 }
 
 #define RUST_SYM_SUFFIX "::h0123456789abcdef"
@@ -214,44 +824,45 @@ static bool maybe_rust_symbol(const char *name) {
 	return offset > 0 && strncmp(name + offset, "::h", 3) == 0;
 }
 
-static char *proc_symbol_name_fetch(pid_t pid, struct bcc_symbol *sym)
+static int proc_symbol_name_fetch(pid_t pid, struct bcc_symbol *sym,
+				  char *dst, int size)
 {
 	ASSERT(pid >= 0);
 
 	int len = 0;
 	char *ptr = (char *)sym->demangle_name;
+	char rust_name[RUST_SYM_MAX_LEN];
 
 	if (maybe_rust_symbol(sym->demangle_name)) {
 		// likely a rust name
-		char rust_name[RUST_SYM_MAX_LEN];
 		memset(rust_name, 0, sizeof(rust_name));
 		if (rustc_demangle(sym->name, rust_name, RUST_SYM_MAX_LEN) > 0) {
 			ptr = rust_name;
 		}
 	}
 
-	len = strlen(ptr) + strlen(u_sym_prefix);
-	char *u_prefix = (char *)u_sym_prefix;
+	const char *u_prefix = u_sym_prefix;
 	if (sym->module != NULL && strlen(sym->module) > 0) {
 		if (strstr(sym->module, ".so")) {
-			len += strlen(lib_sym_prefix);
-			u_prefix = (char *)lib_sym_prefix;
+			u_prefix = lib_sym_prefix;
 		}
 	}
 
-	ptr = create_symbol_str(len, ptr, (char *)u_prefix);
+	len = write_symbol_str(dst, size, u_prefix, ptr);
 	bcc_symbol_free_demangle_name(sym);
 
-	return ptr;
+	return len;
 }
 
 // Demangle with
 // https://docs.oracle.com/javase/specs/jvms/se7/html/jvms-4.html#jvms-4.3
-char *rewrite_java_symbol(char *sym)
+// 'dst' must not overlap 'sym' and needs room for strlen(sym) + array
+// dimensions + 16 bytes, returns the length written or -1.
+static int rewrite_java_symbol_to(const char *sym, char *dst, int new_len)
 {
 	int len = strlen(sym);
 	if (len == 0) {
-		return NULL;
+		return -1;
 	}
 
 	int i = 0, j = 0;
@@ -259,10 +870,8 @@ char *rewrite_java_symbol(char *sym)
 	int array_dims = i;
 
 	// make room for array ']'s and base type name expension
-	int new_len = len + array_dims + 16;
-	char *dst = clib_mem_alloc_aligned("symbol_str", new_len, 0, NULL);
-	if (dst == NULL) {
-		return dst;
+	if (new_len < len + array_dims + 16) {
+		return -1;
 	}
 	memset(dst, 0, new_len);
 	int offset = 0;
@@ -308,14 +917,14 @@ char *rewrite_java_symbol(char *sym)
 			}
 		}
 		if (j == len) {
-			goto failed;
+			return -1;
 		}
 		memcpy(dst + offset, sym + i + 1, j - (i + 1));
 		offset += j - (i + 1);
 		i = j + 1;
 		break;
 	default:
-		goto failed;
+		return -1;
 	}
 
 	for (j = 0; j < array_dims; j++) {
@@ -323,26 +932,49 @@ char *rewrite_java_symbol(char *sym)
 	}
 
 	// rest
-	snprintf(dst + offset, new_len - offset, sym + i);
+	offset += snprintf(dst + offset, new_len - offset, "%s", sym + i);
 
-	return dst;
+	return written_len(offset, new_len);
+}
 
-failed:
-	clib_mem_free(dst);
-	return NULL;
+char *rewrite_java_symbol(char *sym)
+{
+	int i, len = strlen(sym);
+	if (len == 0) {
+		return NULL;
+	}
+
+	for (i = 0; i < len && sym[i] == '['; i++);
+	int new_len = len + i + 16;
+	char *dst = clib_mem_alloc_aligned("symbol_str", new_len, 0, NULL);
+	if (dst == NULL) {
+		return dst;
+	}
+
+	if (rewrite_java_symbol_to(sym, dst, new_len) < 0) {
+		clib_mem_free(dst);
+		return NULL;
+	}
+
+	return dst;
 }
 
+/*
+ * Resolve 'address' and write the symbol string into 'dst', the length
+ * written is returned through 'sym_len' (0 if nothing is known).
+ */
 static inline int symcache_resolve(pid_t pid, void *resolver, u64 address,
 				   struct bcc_symbol *sym, void *info_p,
-				   char **sym_ptr)
+				   char *dst, int size, int *sym_len)
 {
 	ASSERT(pid >= 0);
 
 	int ret = -1;
+	*sym_len = 0;
 	if (pid == 0) {
 		ret = bcc_symcache_resolve_no_demangle(resolver, address, sym);
 		if (ret == 0)
-			*sym_ptr = kern_symbol_name_fetch(pid, sym);
+			*sym_len = kern_symbol_name_fetch(pid, sym, dst, size);
 	} else {
 		struct symbolizer_proc_info *p = info_p;
 		if (p) {
@@ -352,41 +984,33 @@ static inline int symcache_resolve(pid_t pid, void *resolver, u64 address,
 			pthread_mutex_lock(&p->mutex);
 			ret = bcc_symcache_resolve(resolver, address, sym);
 			if (ret == 0) {
-				*sym_ptr = proc_symbol_name_fetch(pid, sym);
+				*sym_len = proc_symbol_name_fetch(pid, sym, dst, size);
 				if (p->is_java) {
 					// handle java encoded symbols
-					char *new_sym =
-					    rewrite_java_symbol(*sym_ptr);
-					if (new_sym != NULL) {
-						clib_mem_free(*sym_ptr);
-						*sym_ptr = new_sym;
-					}
+					char new_sym[SYMBOL_STR_MAX];
+					if (rewrite_java_symbol_to(dst, new_sym,
+								   sizeof(new_sym)) >= 0)
+						*sym_len = write_symbol_str(dst, size,
+									    "", new_sym);
 				}
 				pthread_mutex_unlock(&p->mutex);
 				return ret;
 			}
-			if (sym->module != NULL && strlen(sym->module) > 0) {
+			if (sym->module != NULL && strlen(sym->module) > 0 &&
+			    size > 0) {
 				/*
 				 * Module is known (from /proc/<pid>/maps), but
 				 * symbol is not known.
 				 * build a string:
 				 * [/lib64/xxx.so]
 				 */
-				char format_str[4096];
-				snprintf(format_str, sizeof(format_str),
-					 "[%s]", sym->module);
-				int len = strlen(format_str);
-				*sym_ptr =
-				    create_symbol_str(len, format_str, "");
-				if (info_p) {
-					struct symbolizer_proc_info *p = info_p;
-					symbolizer_proc_lock(p);
-					if (p->is_java
-					    && strstr(format_str, "perf-")) {
-						p->unknown_syms_found = true;
-					}
-					symbolizer_proc_unlock(p);
+				*sym_len = written_len(snprintf(dst, size, "[%s]",
+								sym->module), size);
+				symbolizer_proc_lock(p);
+				if (p->is_java && strstr(dst, "perf-")) {
+					p->unknown_syms_found = true;
 				}
+				symbolizer_proc_unlock(p);
 			}
 			pthread_mutex_unlock(&p->mutex);
 		}
@@ -396,44 +1020,39 @@ static inline int symcache_resolve(pid_t pid, void *resolver, u64 address,
 }
 
 /*
- * Shared native resolver for both the C stringifier and the Rust Lua decoder.
- * Lua’s logical stack may include TAG_CFUNC frames (Lua→C calls). Rust calls
- * this helper to resolve those native PCs using the same symbol cache.
- * the void *tracer_handle should be struct bpf_tracer *
+ * Resolve 'address' into 'dst' ('size' includes the terminating '\0'),
+ * return the number of characters written.
  */
-char *resolve_addr(void *tracer_handle, uint32_t pid, bool is_start_idx,
-			  u64 address, bool is_create, void *info_p)
+static int resolve_addr_to_buf(pid_t pid, bool is_start_idx, u64 address,
+			       bool is_create, void *info_p, char *dst,
+			       int size)
 {
-	pid_t pid_signed = (pid_t)pid;
-
-	ASSERT(pid_signed >= 0);
+	ASSERT(pid >= 0);
 
-	int len = 0;
-	char *ptr = NULL;
-	char format_str[32];
+	int i, len = 0;
 	struct bcc_symbol sym;
 	memset(&sym, 0, sizeof(sym));
-	void *resolver = get_symbol_cache(pid_signed, is_create);
+	void *resolver = get_symbol_cache(pid, is_create);
 	if (resolver == NULL)
 		goto resolver_err;
 
-	int ret = symcache_resolve(pid_signed, resolver, address, &sym, info_p, &ptr);
-	if (ret == 0 && ptr) {
-		char *p = ptr;
+	int ret = symcache_resolve(pid, resolver, address, &sym, info_p,
+				   dst, size, &len);
+	if (ret == 0) {
 		/*
 		 * If the parsed string contains a semicolon (';'), replace
 		 * it with ':', as the semicolon is a specific delimiter
 		 * we use to separate symbolic strings.
 		 * e.g.: "NioEventLoop;::run" -> "NioEventLoop:::run"
 		 */
-		for (p = ptr; *p != '\0'; p++) {
-			if (*p == ';')
-				*p = ':';
+		for (i = 0; i < len; i++) {
+			if (dst[i] == ';')
+				dst[i] = ':';
 		}
 	}
 
-	if (ptr)
-		goto finish;
+	if (len > 0)
+		return len;
 
 	/*
 	 * If we have reached this point, it means that we have truly obtained
@@ -443,55 +1062,68 @@ char *resolve_addr(void *tracer_handle, uint32_t pid, bool is_start_idx,
 	 * e.g.: '[unknown] 0x0000000000000001'.
 	 */
 resolver_err:
+	if (size <= 0)
+		return 0;
+
 	if (is_start_idx)
-		snprintf(format_str, sizeof(format_str),
-			 "[unknown start_thread?]");
+		len = snprintf(dst, size, "[unknown start_thread?]");
 	else
-		snprintf(format_str, sizeof(format_str), "[unknown] 0x%016lx",
-			 address);
+		len = snprintf(dst, size, "[unknown] 0x%016lx", address);
 
-	len = strlen(format_str);
-	ptr = create_symbol_str(len, format_str, "");
+	return written_len(len, size);
+}
 
-finish:
-	return ptr;
+/*
+ * Shared native resolver for both the C stringifier and the Rust Lua decoder.
+ * Lua’s logical stack may include TAG_CFUNC frames (Lua→C calls). Rust calls
+ * this helper to resolve those native PCs using the same symbol cache.
+ * the void *tracer_handle should be struct bpf_tracer *
+ */
+char *resolve_addr(void *tracer_handle, uint32_t pid, bool is_start_idx,
+			  u64 address, bool is_create, void *info_p)
+{
+	pid_t pid_signed = (pid_t)pid;
+
+	ASSERT(pid_signed >= 0);
+
+	char sym_str[SYMBOL_STR_MAX];
+	int len = resolve_addr_to_buf(pid_signed, is_start_idx, address,
+				      is_create, info_p, sym_str,
+				      sizeof(sym_str));
+
+	return create_symbol_str(len, sym_str, "");
 }
 
-static char *resolve_custom_symbol_addr(symbol_t *symbols, u32 *symbol_ids, int n_symbols, bool is_start_idx, u64 address)
+static int resolve_custom_symbol_addr(struct symbol_table_index *idx,
+				      bool is_start_idx, u64 address,
+				      char *dst, int size)
 {
 	int len = 0;
-	char *ptr = NULL;
-	char format_str[CLASS_NAME_LEN + METHOD_NAME_LEN + 3];
-	memset(format_str, 0, sizeof(format_str));
+
+	if (size <= 0)
+		return 0;
 
 	u32 symbol_id = address & 0xFFFFFFFF;
-	for (int i = 0; i < n_symbols; i++) {
-		if (symbol_ids[i] == symbol_id) {
-			if (strlen(symbols[i].class_name) > 0) {
-				snprintf(format_str, sizeof(format_str), "%s::%s", symbols[i].class_name, symbols[i].method_name);
-			} else {
-				snprintf(format_str, sizeof(format_str), "%s", symbols[i].method_name);
-			}
-			goto finish;
-		}
+	symbol_index_hash_kv kv;
+	kv.key = (u64) symbol_id;
+	kv.value = 0;
+	if (symbol_index_hash_search(&idx->hash, &kv, &kv) == 0) {
+		struct symbol_index_elem *e = (struct symbol_index_elem *)kv.value;
+		idx->hit_count++;
+		return write_symbol_str(dst, size, "", e->name);
 	}
 
 	/*
 	 * Maybe expelled from LRU
 	 */
+	idx->miss_count++;
 	if (is_start_idx) {
-		snprintf(format_str, sizeof(format_str),
-			 "[unknown start_thread?]");
+		len = snprintf(dst, size, "[unknown start_thread?]");
 	} else {
-		snprintf(format_str, sizeof(format_str), "[unknown] 0x%08x",
-			 symbol_id);
+		len = snprintf(dst, size, "[unknown] 0x%08x", symbol_id);
 	}
 
-finish:
-	len = strlen(format_str);
-	ptr = create_symbol_str(len, format_str, "");
-
-	return ptr;
+	return written_len(len, size);
 }
 
 static int get_stack_ips(struct bpf_tracer *t,
@@ -560,28 +1192,12 @@ static char *build_stack_trace_string(struct bpf_tracer *t,
 	stack_t stack;
 	memset(&stack, 0, sizeof(stack));
 
-	symbol_t symbols[MAX_SYMBOL_NUM];
-	memset(symbols, 0, sizeof(symbols));
-	u32 symbol_ids[MAX_SYMBOL_NUM];
-	memset(symbol_ids, 0, sizeof(symbol_ids));
-	int n_symbols = 0;
-
+	struct symbol_table_index *sym_index = NULL;
 	if (use_symbol_table) {
-		struct ebpf_map *map = ebpf_obj__get_map_by_name(t->obj, MAP_SYMBOL_TABLE_NAME);
-		if (map == NULL) {
-			ebpf_warning("bpf table %s not found", MAP_SYMBOL_TABLE_NAME);
+		struct stack_str_hash_ext_data *ext = h->private;
+		sym_index = &ext->sym_index;
+		if (sync_symbol_table_index(t, sym_index) != ETR_OK)
 			return NULL;
-		}
-		symbol_t key = {};
-		symbol_t next_key = {};
-		while (bpf_get_next_key(map->fd, &key, &next_key) == 0 && n_symbols < MAX_SYMBOL_NUM) {
-			int ret = bpf_lookup_elem(map->fd, &next_key, &symbol_ids[n_symbols]);
-			if (ret == 0) {
-				symbols[n_symbols] = next_key;
-				n_symbols++;
-			}
-			key = next_key;
-		}
 	}
 
 	int ret;
@@ -594,14 +1210,16 @@ static char *build_stack_trace_string(struct bpf_tracer *t,
 	// For debugging: stack.len is the number of frames
 	u64 *ips = stack.addrs;
 
-	char *str = NULL;
-	ret = VEC_OK;
-	uword *symbol_array = NULL;
-	vec_validate_init_empty(symbol_array, PERF_MAX_STACK_DEPTH, 0, ret);
-	if (ret != VEC_OK)
-		return NULL;
-
-	int start_idx = -1, folded_size = 0;
+	/*
+	 * The frame strings are written one after another directly into the
+	 * folded buffer, then the result is copied once into the iteration
+	 * arena. No per-frame memory is allocated.
+	 */
+	struct stack_str_hash_ext_data *ext = h->private;
+	char *folded_buf = ext->folded_buf;
+	const int size = STRINGIFIER_FOLDED_BUF_SZ;
+	int start_idx = -1, len = 0, n;
+	char *str, *dst;
 	for (i = PERF_MAX_STACK_DEPTH - 1; i >= 0; i--) {
 		if (ips[i] == 0 || ips[i] == sentinel_addr)
 			continue;
@@ -609,76 +1227,83 @@ static char *build_stack_trace_string(struct bpf_tracer *t,
 		if (start_idx == -1)
 			start_idx = i;
 
+		/* Keep room for a frame, the ';' separator and the '\0'. */
+		if (size - len < 3)
+			break;
+
+		dst = folded_buf + len;
 		/*
 		 * Use extended hook to resolve frame if it's special.
 		 * We pass possible extra data. If the frame type is 0 (normal),
-		 * this call should return NULL.
+		 * this call should return NULL. Interpreter frames repeat a lot
+		 * across stacks, they are resolved through the frame cache.
 		 */
-		str = extended_resolve_frame(pid, ips[i], stack.frame_types[i],
-					     stack.extra_data_a[i],
-					     stack.extra_data_b[i]);
-		if (str == NULL) {
-			/* Normal fallback */
-			if (use_symbol_table) {
-				str = resolve_custom_symbol_addr(symbols, symbol_ids,
-								 n_symbols,
-								 (i == start_idx),
-								 ips[i]);
-			} else {
-				str = resolve_addr(t, pid, (i == start_idx),
-						   ips[i], new_cache, info_p);
-			}
-		}
-		if (str) {
-			// ignore frames in library for memory profiling
-			if (ignore_libs && strlen(str) >= strlen(lib_sym_prefix)
-			    && strncmp(str, lib_sym_prefix,
-				       strlen(lib_sym_prefix)) == 0) {
+		n = -1;
+		if (stack.frame_types[i] != FRAME_TYPE_NORMAL) {
+			n = interp_frame_resolve(pid, ips[i],
+						 stack.frame_types[i],
+						 stack.extra_data_a[i],
+						 stack.extra_data_b[i], dst,
+						 size - len - 1);
+		} else {
+			str = extended_resolve_frame(pid, ips[i],
+						     stack.frame_types[i],
+						     stack.extra_data_a[i],
+						     stack.extra_data_b[i]);
+			if (str != NULL) {
+				n = write_symbol_str(dst, size - len - 1, "",
+						     str);
 				clib_mem_free(str);
-				continue;
 			}
-			symbol_array[i] = pointer_to_uword(str);
-			folded_size += strlen(str);
 		}
-	}
 
-	/* Ensure that there is sufficient memory for the ';' following it. */
-	folded_size += PERF_MAX_STACK_DEPTH;
-
-	char *fold_stack_trace_str =
-	    clib_mem_alloc_aligned("folded_str", folded_size, 0, NULL);
-	if (fold_stack_trace_str == NULL)
-		goto failed;
+		if (n < 0 && use_symbol_table) {
+			/* Normal fallback */
+			n = resolve_custom_symbol_addr(sym_index,
+						       (i == start_idx),
+						       ips[i], dst,
+						       size - len - 1);
+		} else if (n < 0) {
+			n = resolve_addr_to_buf(pid, (i == start_idx), ips[i],
+						new_cache, info_p, dst,
+						size - len - 1);
+		}
 
-	int len = 0;
-	for (i = PERF_MAX_STACK_DEPTH - 1; i >= 0; i--) {
-		if (symbol_array[i]) {
-			len += snprintf(fold_stack_trace_str + len,
-					folded_size - len,
-					"%s;", (char *)symbol_array[i]);
-			clib_mem_free((void *)symbol_array[i]);
+		// ignore frames in library for memory profiling
+		if (ignore_libs && n >= strlen(lib_sym_prefix)
+		    && strncmp(dst, lib_sym_prefix,
+			       strlen(lib_sym_prefix)) == 0) {
+			continue;
 		}
-	}
 
-	/* Remove the semicolon at the end of the string. */
-	if (len - 1 >= 0) {
-		fold_stack_trace_str[len - 1] = '\0';
+		len += n;
+		folded_buf[len++] = ';';
 	}
-	vec_free(symbol_array);
-	return fold_stack_trace_str;
 
-failed:
-	for (i = PERF_MAX_STACK_DEPTH - 1; i >= 0; i--) {
-		if (symbol_array[i])
-			clib_mem_free((void *)symbol_array[i]);
-	}
+	/* Remove the semicolon at the end of the string. */
+	if (len > 0)
+		len--;
+	folded_buf[len] = '\0';
 
-	vec_free(symbol_array);
+	char *fold_stack_trace_str = clib_mem_arena_alloc(&ext->arena, len + 1);
+	if (fold_stack_trace_str == NULL)
+		return NULL;
 
-	return NULL;
+	memcpy(fold_stack_trace_str, folded_buf, len + 1);
+	return fold_stack_trace_str;
 }
 
+static char *arena_str_dup(stack_str_hash_t * h, const char *src)
+{
+	struct stack_str_hash_ext_data *ext = h->private;
+	int len = strlen(src);
+	char *dst = clib_mem_arena_alloc(&ext->arena, len + 1);
+	if (dst == NULL)
+		return NULL;
 
+	memcpy(dst, src, len + 1);
+	return dst;
+}
 
 static char *folded_stack_trace_string(struct bpf_tracer *t,
 				       int stack_id,
@@ -702,7 +1327,7 @@ static char *folded_stack_trace_string(struct bpf_tracer *t,
 		return (char *)kv.value;
 	}
 
-	char *str = NULL;
+	char *str = NULL, *lua_str;
 	int ret_val = 0;
 
 	/*
@@ -710,14 +1335,19 @@ static char *folded_stack_trace_string(struct bpf_tracer *t,
 	 * Lua uses its own stack format with encoded tag + pointer values.
 	 */
 	if (use_symbol_table) {
-		str = extended_format_lua_stack(t, pid, stack_id, stack_map_name,
-						h, new_cache, info_p);
-		if (str != NULL) {
+		lua_str = extended_format_lua_stack(t, pid, stack_id,
+						    stack_map_name, h, new_cache,
+						    info_p);
+		if (lua_str != NULL) {
+			str = arena_str_dup(h, lua_str);
+			clib_mem_free(lua_str);
+			if (str == NULL)
+				return NULL;
+
 			/* Cache the result */
 			kv.key = (u64) stack_id;
 			kv.value = pointer_to_uword(str);
 			if (stack_str_hash_add_del(h, &kv, 1)) {
-				clib_mem_free((void *)str);
 				return NULL;
 			}
 			int ret = VEC_OK;
@@ -746,7 +1376,6 @@ static char *folded_stack_trace_string(struct bpf_tracer *t,
 	   are not stable across profiler iterations. */
 	if (stack_str_hash_add_del(h, &kv, 1 /* is_add */ )) {
 		ebpf_warning("stack_str_hash_add_del() failed.\n");
-		clib_mem_free((void *)str);
 		str = NULL;
 	} else {
 		/*
@@ -765,10 +1394,120 @@ static char *folded_stack_trace_string(struct bpf_tracer *t,
 	return str;
 }
 
-static inline char *alloc_stack_trace_str(int len)
+int init_kern_stack_str_hash(stack_str_hash_t * h, const char *name)
+{
+	memset(h, 0, sizeof(*h));
+	return stack_str_hash_init(h, (char *)name,
+				   KERN_STACK_STR_HASH_BUCKETS_NUM,
+				   KERN_STACK_STR_HASH_MEM_SZ);
+}
+
+/*
+ * Called when the kernel stack ID is removed from the stack map, the slot
+ * may then be reused by another stack trace.
+ */
+void kern_stack_str_invalidate(stack_str_hash_t * h, int stack_id)
+{
+	if (h->buckets == NULL)
+		return;
+
+	stack_str_hash_kv kv;
+	kv.key = (u64) stack_id;
+	kv.value = 0;
+	if (stack_str_hash_search(h, &kv, &kv) != 0)
+		return;
+
+	if (stack_str_hash_add_del(h, &kv, 0 /* delete */ ) == 0) {
+		clib_mem_free((void *)kv.value);
+		__sync_fetch_and_sub(&h->hash_elems_count, 1);
+	}
+}
+
+static int collect_kern_stack_str_cb(stack_str_hash_kv * kv, void *arg)
+{
+	stack_str_hash_kv **kvps = arg;
+	int ret = VEC_OK;
+	vec_add1(*kvps, *kv, ret);
+	if (ret != VEC_OK)
+		ebpf_warning("vec add failed\n");
+
+	return BIHASH_WALK_CONTINUE;
+}
+
+/* All the stack map slots have been cleared. */
+void clean_kern_stack_strs(stack_str_hash_t * h)
 {
+	if (h->buckets == NULL)
+		return;
+
+	stack_str_hash_kv *kvps = NULL, *v;
+	stack_str_hash_foreach_key_value_pair(h, collect_kern_stack_str_cb,
+					      (void *)&kvps);
+	vec_foreach(v, kvps) {
+		void *str = (void *)v->value;
+		if (stack_str_hash_add_del(h, v, 0 /* delete */ ) == 0)
+			clib_mem_free(str);
+	}
+	vec_free(kvps);
+
+	h->hash_elems_count = 0;
+}
+
+void release_kern_stack_str_hash(stack_str_hash_t * h)
+{
+	if (h->buckets == NULL)
+		return;
+
+	clean_kern_stack_strs(h);
+	stack_str_hash_free(h);
+}
+
+static char *kern_stack_trace_string(struct bpf_tracer *t, int stack_id,
+				     const char *stack_map_name,
+				     stack_str_hash_t * h,
+				     stack_str_hash_t * kern_h, void *info_p,
+				     u64 ts)
+{
+	stack_str_hash_kv kv;
+	kv.key = (u64) stack_id;
+	kv.value = 0;
+	if (stack_str_hash_search(kern_h, &kv, &kv) == 0) {
+		__sync_fetch_and_add(&kern_h->hit_hash_count, 1);
+		return (char *)kv.value;
+	}
+
+	int ret_val = 0;
+	char *str = build_stack_trace_string(t, stack_map_name, 0, stack_id,
+					     h, true, &ret_val, info_p, ts,
+					     false, false);
+	if (str == NULL)
+		return NULL;
+
+	/* The arena is reset every iteration, keep a copy on the heap. */
+	int len = strlen(str);
+	char *kern_str = clib_mem_alloc_aligned("kern_stack_str", len + 1, 0,
+						NULL);
+	if (kern_str == NULL)
+		return str;
+
+	memcpy(kern_str, str, len + 1);
+	kv.key = (u64) stack_id;
+	kv.value = pointer_to_uword(kern_str);
+	if (stack_str_hash_add_del(kern_h, &kv, 1 /* is_add */ )) {
+		ebpf_warning("kern stack_str_hash_add_del() failed.\n");
+		clib_mem_free(kern_str);
+		return str;
+	}
+	__sync_fetch_and_add(&kern_h->hash_elems_count, 1);
+
+	return kern_str;
+}
+
+static inline char *alloc_stack_trace_str(stack_str_hash_t * h, int len)
+{
+	struct stack_str_hash_ext_data *ext = h->private;
 	void *trace_str;
-	trace_str = clib_mem_alloc_aligned("stack_str", len, 0, NULL);
+	trace_str = clib_mem_arena_alloc(&ext->arena, len);
 	if (trace_str == NULL) {
 		ebpf_warning("stack trace str alloc memory failed.\n");
 	}
@@ -781,6 +1520,7 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 				      const char *stack_map_name,
 				      const char *custom_stack_map_name,
 				      stack_str_hash_t * h,
+				      stack_str_hash_t * kern_h,
 				      bool new_cache,
 				      char *process_name, void *info_p,
 				      bool ignore_libs)
@@ -804,13 +1544,14 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 	int len = 2;
 	char *k_trace_str, *u_trace_str, *trace_str, *uprobe_str, *i_trace_str;
 	k_trace_str = u_trace_str = trace_str = uprobe_str = i_trace_str = NULL;
+	char uprobe_buf[SYMBOL_STR_MAX];
 
 	/* For processes without configuration, the stack string is in the format
 	   'process name;thread name'. */
 	if (!new_cache) {
 		/* add string "[p/t] " */
 		len += (TASK_COMM_LEN * 2) + 10;
-		trace_str = alloc_stack_trace_str(len);
+		trace_str = alloc_stack_trace_str(h, len);
 		if (trace_str == NULL) {
 			ebpf_warning("No available memory space.\n");
 			return NULL;
@@ -835,12 +1576,23 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 		return trace_str;
 	}
 
+	/*
+	 * Kernel frames are identical for every process, so the kernel stack
+	 * string is cached by stack ID only, and is combined with the user
+	 * stack string below.
+	 */
 	if (v->kernstack >= 0) {
-		k_trace_str = folded_stack_trace_string(t, v->kernstack,
-							0, stack_map_name,
-							h, new_cache, info_p,
-							v->timestamp,
-							ignore_libs, false);
+		if (kern_h != NULL)
+			k_trace_str = kern_stack_trace_string(t, v->kernstack,
+							      stack_map_name,
+							      h, kern_h, info_p,
+							      v->timestamp);
+		else
+			k_trace_str = folded_stack_trace_string(t, v->kernstack,
+								0, stack_map_name,
+								h, new_cache, info_p,
+								v->timestamp,
+								ignore_libs, false);
 		if (k_trace_str == NULL)
 			return NULL;
 		len += strlen(k_trace_str);
@@ -862,13 +1614,10 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 	}
 
 	if (v->flags & STACK_TRACE_FLAGS_URETPROBE && v->uprobe_addr != 0) {
-		uprobe_str =
-		    resolve_addr(t, v->tgid, false, v->uprobe_addr, new_cache,
-				 info_p);
-		if (uprobe_str == NULL) {
-			return NULL;
-		}
-		len += strlen(uprobe_str) + 1;
+		uprobe_str = uprobe_buf;
+		len += resolve_addr_to_buf(v->tgid, false, v->uprobe_addr,
+					   new_cache, info_p, uprobe_buf,
+					   sizeof(uprobe_buf)) + 1;
 	}
 
 	bool has_intpstack = v->intpstack > 0;
@@ -885,10 +1634,10 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 		}
 	}
 
-	trace_str = alloc_stack_trace_str(len);
+	trace_str = alloc_stack_trace_str(h, len);
 	if (trace_str == NULL) {
 		ebpf_warning("No available memory space.\n");
-		goto error;
+		return NULL;
 	}
 
 	/* trace_str combines user/interpreter/kstack strings in call-order (root -> leaf). */
@@ -938,26 +1687,15 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 		 */
 
 		len += strlen(lost_tag);
-		trace_str = alloc_stack_trace_str(len);
+		trace_str = alloc_stack_trace_str(h, len);
 		if (trace_str == NULL) {
 			ebpf_warning("No available memory space.\n");
-			goto error;
+			return NULL;
 		}
 
 		snprintf(trace_str, len, "%s", lost_tag);
 	}
 
-	if (uprobe_str) {
-		clib_mem_free(uprobe_str);
-	}
-
 	return trace_str;
-
-error:
-	if (uprobe_str) {
-		clib_mem_free(uprobe_str);
-	}
-
-	return NULL;
 }
 #endif /* AARCH64_MUSL */
@@ -18,6 +18,8 @@
 #define DF_USER_STRINGIFIER_H
 
 #include "../bihash_8_8.h"
+#include "../mem.h"
+#include "../../kernel/include/perf_profiler.h"
 
 #define stack_str_hash_t	clib_bihash_8_8_t
 #define stack_str_hash_init	clib_bihash_init_8_8
@@ -29,25 +31,98 @@
 #define stack_str_hash_key_value_pair_cb	clib_bihash_foreach_key_value_pair_cb_8_8
 #define stack_str_hash_foreach_key_value_pair	clib_bihash_foreach_key_value_pair_8_8
 
+#define symbol_index_hash_t	clib_bihash_8_8_t
+#define symbol_index_hash_init	clib_bihash_init_8_8
+#define symbol_index_hash_kv	clib_bihash_kv_8_8_t
+#define symbol_index_hash_search	clib_bihash_search_8_8
+#define symbol_index_hash_add_del	clib_bihash_add_del_8_8
+#define symbol_index_hash_free	clib_bihash_free_8_8
+#define symbol_index_hash_foreach_key_value_pair	clib_bihash_foreach_key_value_pair_8_8
+
+/*
+ * Userspace mirror of the interpreter '__symbol_table' map.
+ *
+ * The eBPF map is keyed by symbol (class name + method name) and its
+ * value is the symbol id carried in interpreter stacks. The mirror is
+ * keyed by symbol id and is synchronized at most once per profiler
+ * iteration (on the first interpreter stack), then shared by all the
+ * stack builds of that iteration.
+ */
+struct symbol_table_index {
+	// key: symbol id, value: struct symbol_index_elem address
+	symbol_index_hash_t hash;
+	// Buffers used to read the eBPF map in batches.
+	symbol_t *keys;
+	u32 *ids;
+	// Elements removed from 'hash', freed at the end of the iteration.
+	void **retired;
+	// Number of synchronizations completed.
+	u64 sync_gen;
+	// Whether it has been synchronized in the current iteration.
+	bool synced;
+	// The kernel does not support batch lookup on the map.
+	bool batch_unsupported;
+
+	/* statistics */
+	u64 sync_syscalls;
+	u64 hit_count;
+	u64 miss_count;
+};
+
 struct stack_str_hash_ext_data {
 	/*
 	 * It is used for quickly releasing the stack_str_hash resource.
 	 */
 	stack_str_hash_kv *stack_str_kvps;
 	bool clear_hash;
+	struct symbol_table_index sym_index;
+	/*
+	 * Holds all the stack strings built in an iteration, it is reset
+	 * by clean_stack_strs() at the end of each iteration.
+	 */
+	clib_mem_arena_t arena;
+	// Scratch buffer the frame strings are written into.
+	char *folded_buf;
 };
 
 #ifndef AARCH64_MUSL
 
+/*
+ * Drop the cached interpreter frames of a process, it is called when the
+ * process exits or execs.
+ */
+void interp_frame_cache_invalidate(pid_t pid);
+void print_interp_frame_cache_stats(void);
+void release_interp_frame_cache(void);
 u64 get_stack_table_data_miss_count(void);
 int init_stack_str_hash(stack_str_hash_t *h, const char *name);
 void clean_stack_strs(stack_str_hash_t *h);
 void release_stack_str_hash(stack_str_hash_t *h);
+int init_kern_stack_str_hash(stack_str_hash_t *h, const char *name);
+void kern_stack_str_invalidate(stack_str_hash_t *h, int stack_id);
+void clean_kern_stack_strs(stack_str_hash_t *h);
+void release_kern_stack_str_hash(stack_str_hash_t *h);
+/*
+ * Request the stack string caches that survive across iterations to be
+ * flushed, the flush is done by the profiler reader at the end of its
+ * iteration.
+ */
+void stack_strs_shrink(void);
+// Returns true once for each shrink request after '*seen_gen'.
+bool stack_strs_shrink_pending(u64 *seen_gen);
+/*
+ * The returned string is allocated from the stringifier arena of 'h', it
+ * remains valid until clean_stack_strs() and must not be freed.
+ *
+ * Kernel stack strings are looked up in (and added to) 'kern_h', which is
+ * not tied to any process and survives across iterations.
+ */
 char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 				      struct stack_trace_key_t *v,
 				      const char *stack_map_name,
 				      const char *custom_stack_map_name,
 				      stack_str_hash_t *h,
+				      stack_str_hash_t *kern_h,
 				      bool new_cache,
 				      char *process_name, void *info_p, bool ignore_libs);
 char *rewrite_java_symbol(char *sym);
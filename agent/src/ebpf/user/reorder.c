@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "types.h"
+#include "clib.h"
+#include "mem.h"
+#include "vec.h"
+#include "log.h"
+#include "utils.h"
+#include "tracer.h"
+#include "reorder.h"
+
+int reorder_buffer_init(struct reorder_buffer *rb, struct bpf_tracer *t,
+			int queue_id)
+{
+	memset(rb, 0, sizeof(*rb));
+	rb->t = t;
+	rb->queue_id = queue_id;
+	snprintf(rb->hash_name, sizeof(rb->hash_name), "reorder-%d", queue_id);
+	return reorder_hash_init(&rb->hash, rb->hash_name,
+				 SOCKET_REORDER_HASH_BUCKETS_NUM,
+				 SOCKET_REORDER_HASH_MEM_SZ);
+}
+
+static inline void reorder_emit(struct reorder_buffer *rb,
+				struct socket_bpf_data *sd)
+{
+	process_socket_data(rb->t, rb->queue_id, sd);
+}
+
+static void pending_add(struct reorder_buffer *rb, struct reorder_sock *s)
+{
+	int ret = VEC_OK;
+	vec_add1(rb->pending, s, ret);
+	if (ret != VEC_OK) {
+		ebpf_warning("vec add failed\n");
+		return;
+	}
+	s->pending_idx = vec_len(rb->pending) - 1;
+}
+
+static void pending_del(struct reorder_buffer *rb, struct reorder_sock *s)
+{
+	int idx = s->pending_idx, last = vec_len(rb->pending) - 1;
+	if (idx < 0)
+		return;
+
+	rb->pending[idx] = rb->pending[last];
+	rb->pending[idx]->pending_idx = idx;
+	vec_set_len(rb->pending, last);
+	s->pending_idx = -1;
+}
+
+/* Emit the held data that is in order. */
+static void reorder_drain(struct reorder_buffer *rb, struct reorder_sock *s)
+{
+	int n = 0, i, nr = vec_len(s->held);
+
+	while (n < nr && s->held[n].sd->cap_seq <= s->expect_seq) {
+		struct socket_bpf_data *sd = s->held[n].sd;
+		if (sd->cap_seq == s->expect_seq) {
+			s->expect_seq++;
+			__sync_fetch_and_add(&rb->reordered_count, 1);
+		} else {
+			/* Duplicated sequence number */
+			__sync_fetch_and_add(&rb->late_count, 1);
+		}
+		reorder_emit(rb, sd);
+		clib_mem_free(sd);
+		n++;
+	}
+
+	if (n == 0)
+		return;
+
+	rb->held_count -= n;
+	if (n == nr) {
+		vec_set_len(s->held, 0);
+		pending_del(rb, s);
+	} else {
+		for (i = n; i < nr; i++)
+			s->held[i - n] = s->held[i];
+		vec_set_len(s->held, nr - n);
+	}
+}
+
+/* Give up the missing sequence numbers before the first held data. */
+static void reorder_skip_gap(struct reorder_buffer *rb, struct reorder_sock *s)
+{
+	u64 seq = s->held[0].sd->cap_seq;
+	__sync_fetch_and_add(&rb->gap_count, seq - s->expect_seq);
+	s->expect_seq = seq;
+	reorder_drain(rb, s);
+}
+
+static int reorder_hold(struct reorder_buffer *rb, struct reorder_sock *s,
+			struct socket_bpf_data *sd, u64 now)
+{
+	/* The original data is released with its memory block, keep a copy. */
+	int len = sizeof(*sd) + sd->cap_len + 1;
+	struct socket_bpf_data *copy =
+	    clib_mem_alloc_aligned("socket_reorder", len, 0, NULL);
+	if (copy == NULL)
+		return ETR_NOMEM;
+
+	memcpy(copy, sd, len);
+	copy->cap_data = (char *)((void **)&copy->cap_data + 1);
+
+	struct reorder_entry e = {.sd = copy,.hold_ns = now };
+	int ret = VEC_OK, i;
+	vec_add1(s->held, e, ret);
+	if (ret != VEC_OK) {
+		clib_mem_free(copy);
+		return ETR_NOMEM;
+	}
+
+	/* Keep the held data sorted by cap_seq. */
+	for (i = vec_len(s->held) - 1;
+	     i > 0 && s->held[i - 1].sd->cap_seq > copy->cap_seq; i--)
+		s->held[i] = s->held[i - 1];
+	s->held[i] = e;
+
+	if (vec_len(s->held) == 1)
+		pending_add(rb, s);
+	rb->held_count++;
+
+	return ETR_OK;
+}
+
+static void reorder_sock_free(struct reorder_buffer *rb, struct reorder_sock *s)
+{
+	reorder_hash_kv kv;
+	kv.key = s->socket_id;
+	kv.value = 0;
+	if (reorder_hash_add_del(&rb->hash, &kv, 0 /* delete */ ) == 0)
+		rb->hash.hash_elems_count--;
+	while (vec_len(s->held) > 0)
+		reorder_skip_gap(rb, s);
+	vec_free(s->held);
+	clib_mem_free(s);
+}
+
+void reorder_submit(struct reorder_buffer *rb, struct socket_bpf_data *sd,
+		    u64 now)
+{
+	struct reorder_sock *s;
+	reorder_hash_kv kv;
+
+	kv.key = sd->socket_id;
+	kv.value = 0;
+	if (reorder_hash_search(&rb->hash, &kv, &kv) == 0) {
+		s = (struct reorder_sock *)kv.value;
+	} else {
+		/* Nothing to wait for on the first data of the socket. */
+		s = clib_mem_alloc_aligned("reorder_sock", sizeof(*s), 0, NULL);
+		if (s == NULL) {
+			reorder_emit(rb, sd);
+			return;
+		}
+
+		memset(s, 0, sizeof(*s));
+		s->socket_id = sd->socket_id;
+		s->expect_seq = sd->cap_seq;
+		s->pending_idx = -1;
+		kv.key = sd->socket_id;
+		kv.value = pointer_to_uword(s);
+		if (reorder_hash_add_del(&rb->hash, &kv, 1 /* is_add */ )) {
+			clib_mem_free(s);
+			reorder_emit(rb, sd);
+			return;
+		}
+		rb->hash.hash_elems_count++;
+	}
+
+	s->last_ns = now;
+	/* Too much data is held for the socket, stop waiting. */
+	if (sd->cap_seq > s->expect_seq
+	    && vec_len(s->held) >= SOCKET_REORDER_HELD_MAX)
+		reorder_skip_gap(rb, s);
+
+	if (sd->cap_seq < s->expect_seq) {
+		__sync_fetch_and_add(&rb->late_count, 1);
+		reorder_emit(rb, sd);
+	} else if (sd->cap_seq == s->expect_seq) {
+		s->expect_seq++;
+		reorder_emit(rb, sd);
+		if (vec_len(s->held) > 0)
+			reorder_drain(rb, s);
+	} else if (reorder_hold(rb, s, sd, now) != ETR_OK) {
+		/* Can not hold it, give up the gap. */
+		__sync_fetch_and_add(&rb->gap_count,
+				     sd->cap_seq - s->expect_seq);
+		s->expect_seq = sd->cap_seq + 1;
+		reorder_emit(rb, sd);
+		if (vec_len(s->held) > 0)
+			reorder_drain(rb, s);
+	}
+
+	/* The close event is the last data of the socket. */
+	if (sd->msg_type == MSG_CLOSE && vec_len(s->held) == 0)
+		reorder_sock_free(rb, s);
+}
+
+struct idle_sock_walk {
+	u64 now;
+	struct reorder_sock **idle;
+};
+
+static int collect_idle_sock_cb(reorder_hash_kv * kv, void *arg)
+{
+	struct reorder_sock *s = (struct reorder_sock *)kv->value;
+	struct idle_sock_walk *w = arg;
+	int ret = VEC_OK;
+
+	if (s->pending_idx < 0 && w->now - s->last_ns > SOCKET_REORDER_IDLE_NS) {
+		vec_add1(w->idle, s, ret);
+		if (ret != VEC_OK)
+			return BIHASH_WALK_STOP;
+	}
+
+	return BIHASH_WALK_CONTINUE;
+}
+
+void reorder_flush(struct reorder_buffer *rb, u64 now, u64 max_hold_ns)
+{
+	int i;
+
+	for (i = 0; i < vec_len(rb->pending);) {
+		struct reorder_sock *s = rb->pending[i];
+		if (max_hold_ns > 0 && now - s->held[0].hold_ns < max_hold_ns) {
+			i++;
+			continue;
+		}
+
+		/*
+		 * At least one held data is emitted. The index is checked
+		 * again, the socket may still have expired data, or another
+		 * socket may have been moved to this index.
+		 */
+		reorder_skip_gap(rb, s);
+	}
+
+	if (now - rb->last_sweep_ns < SOCKET_REORDER_SWEEP_NS)
+		return;
+	rb->last_sweep_ns = now;
+
+	struct idle_sock_walk w = {.now = now,.idle = NULL };
+	struct reorder_sock **s;
+	reorder_hash_foreach_key_value_pair(&rb->hash, collect_idle_sock_cb,
+					    (void *)&w);
+	vec_foreach(s, w.idle) {
+		reorder_sock_free(rb, *s);
+	}
+
+	if (vec_len(w.idle) > 0)
+		ebpf_debug("reorder queue %d: %d idle sockets removed\n",
+			   rb->queue_id, vec_len(w.idle));
+	vec_free(w.idle);
+}
+
+void reorder_buffer_reset(struct reorder_buffer *rb)
+{
+	/* Emit everything still held, then drop all the sockets. */
+	rb->last_sweep_ns = 0;
+	reorder_flush(rb, ~0ULL, 0);
+}
+
+void reorder_buffer_release(struct reorder_buffer *rb)
+{
+	if (rb->hash.buckets == NULL)
+		return;
+
+	reorder_buffer_reset(rb);
+	vec_free(rb->pending);
+	reorder_hash_free(&rb->hash);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DF_USER_REORDER_H
+#define DF_USER_REORDER_H
+
+#include "bihash_8_8.h"
+#include "socket.h"
+
+/*
+ * Socket data reorder stage.
+ *
+ * The perf buffer of each CPU is read independently, so the data of a
+ * socket whose threads migrate between CPUs may be dequeued out of order.
+ * The reorder stage runs in the dispatch worker of each queue and emits
+ * the socket data in per-socket 'cap_seq' order:
+ *
+ * - The data with the expected sequence number is emitted immediately,
+ *   followed by the held data that became in order.
+ * - Data ahead of the expected sequence number is copied and held for at
+ *   most 'max_hold_ns'. When it expires (or too much data is held for the
+ *   socket), the missing sequence numbers are given up (a gap).
+ * - Data behind the expected sequence number (late) is emitted as is.
+ */
+
+#define reorder_hash_t		clib_bihash_8_8_t
+#define reorder_hash_init	clib_bihash_init_8_8
+#define reorder_hash_kv		clib_bihash_kv_8_8_t
+#define reorder_hash_search	clib_bihash_search_8_8
+#define reorder_hash_add_del	clib_bihash_add_del_8_8
+#define reorder_hash_free	clib_bihash_free_8_8
+#define reorder_hash_foreach_key_value_pair	clib_bihash_foreach_key_value_pair_8_8
+
+struct reorder_entry {
+	struct socket_bpf_data *sd;
+	// Monotonic time at which the data was held.
+	u64 hold_ns;
+};
+
+struct reorder_sock {
+	u64 socket_id;
+	// Sequence number of the next data to be emitted.
+	u64 expect_seq;
+	// Monotonic time of the last data.
+	u64 last_ns;
+	// Held data sorted by cap_seq (vec)
+	struct reorder_entry *held;
+	// Index in reorder_buffer->pending, -1 if nothing is held.
+	int pending_idx;
+};
+
+struct reorder_buffer {
+	struct bpf_tracer *t;
+	int queue_id;
+	// key: socket_id, value: struct reorder_sock address
+	reorder_hash_t hash;
+	// The hash table keeps a reference to its name.
+	char hash_name[NAME_LEN];
+	// Sockets with held data (vec)
+	struct reorder_sock **pending;
+	u64 held_count;
+	u64 last_sweep_ns;
+
+	/* statistics, read and cleared by socket_tracer_stats() */
+	// Data emitted after being held back.
+	u64 reordered_count;
+	// Data arriving after a later sequence number was emitted.
+	u64 late_count;
+	// Missing sequence numbers given up.
+	u64 gap_count;
+};
+
+int reorder_buffer_init(struct reorder_buffer *rb, struct bpf_tracer *t,
+			int queue_id);
+// Emit all the held data and forget all the sockets.
+void reorder_buffer_reset(struct reorder_buffer *rb);
+void reorder_buffer_release(struct reorder_buffer *rb);
+void reorder_submit(struct reorder_buffer *rb, struct socket_bpf_data *sd,
+		    u64 now);
+/*
+ * Emit the held data older than 'max_hold_ns' (all the held data if
+ * 'max_hold_ns' is 0), and drop the idle sockets.
+ */
+void reorder_flush(struct reorder_buffer *rb, u64 now, u64 max_hold_ns);
+
+static inline bool socket_data_reorderable(struct socket_bpf_data *sd)
+{
+	if (sd->socket_id == 0)
+		return false;
+
+	return (sd->source == DATA_SOURCE_SYSCALL ||
+		sd->source == DATA_SOURCE_GO_TLS_UPROBE ||
+		sd->source == DATA_SOURCE_OPENSSL_UPROBE ||
+		sd->source == DATA_SOURCE_UNIX_SOCKET);
+}
+
+#endif /* DF_USER_REORDER_H */
@@ -28,11 +28,15 @@
 #include "config.h"
 #include "symbol.h"
 #include "proc.h"
+#include "cgroup.h"
+#include "mount.h"
+#include "mem_governor.h"
 #include "tracer.h"
 #include "probe.h"
 #include "table.h"
 #include "utils.h"
 #include "socket.h"
+#include "reorder.h"
 #include "log.h"
 #include "go_tracer.h"
 #include "ssl_tracer.h"
@@ -43,6 +47,7 @@
 #include "perf_reader.h"
 #include "common_utils.h"
 #include "extended/extended.h"
+#include "profile/stringifier.h"
 #include "trace_utils.h"
 
 #include "socket_trace_bpf_common.c"
@@ -66,6 +71,18 @@ static bool virtual_file_collect_enable; // Whether to enable virtual file colle
  * The default is 'false'.
  */
 static bool g_disable_syscall_tracing;
+/*
+ * Key socket_info_map by the sk pointer instead of {tgid + fd}, see
+ * set_socket_key_by_sk(). Only effective with the Linux 5.2+ programs.
+ */
+static bool socket_key_sk_enable;
+/*
+ * HTTP/1.x header index, see set_http1_header_extract(). The names are
+ * kept as the FNV-1a hashes of their lowercase form.
+ */
+static bool http1_hdr_extract;
+static bool http1_hdr_only;
+static uint32_t http1_hdr_hash[HTTP1_HDR_NAMES_MAX];
 
 /*
  * tracer_hooks_detach() and tracer_hooks_attach() will become terrible
@@ -123,6 +140,29 @@ static uint32_t go_tracing_timeout = GO_TRACING_TIMEOUT_DEFAULT;
 // 0: disable 1: during request 2: all
 static uint32_t io_event_collect_mode = 1;
 static uint64_t io_event_minimal_duration = 1000000;
+/*
+ * File IO latency histograms, set by set_io_latency_hist(). When enabled
+ * only the IO slower than io_event_outlier_duration is sent as events.
+ */
+static bool io_hist_enabled;
+static uint64_t io_event_outlier_duration = 100000000;
+static io_latency_hist_cb_t io_hist_callback;
+
+/*
+ * Socket data reorder stage, set by set_socket_data_reorder(). Each
+ * dispatch worker creates its reorder buffer when it is first enabled.
+ */
+static volatile bool socket_reorder_enabled;
+static volatile u64 socket_reorder_max_hold_ns =
+    SOCKET_REORDER_MAX_HOLD_US * 1000ULL;
+static struct reorder_buffer *reorder_bufs[MAX_CPU_NR];
+
+/*
+ * Set by the memory governor, the socket data queued for the dispatch
+ * workers is capped while it is set.
+ */
+static volatile bool socket_data_shed;
+static u64 socket_data_shed_lost;
 
 /*
  * The maximum threshold for socket map reclamation, with map
@@ -477,6 +517,12 @@ static void config_probes_for_kprobe(struct tracer_probes_conf *tps)
 	probes_set_enter_symbol(tps, "__sys_connect");
 }
 
+static inline bool socket_key_by_sk(void)
+{
+	return socket_key_sk_enable && (g_k_type == K_TYPE_KFUNC ||
+					 g_k_type == K_TYPE_VER_5_2_PLUS);
+}
+
 static void socket_tracer_set_probes(struct tracer_probes_conf *tps)
 {
 	if (g_k_type == K_TYPE_KFUNC)
@@ -487,6 +533,47 @@ static void socket_tracer_set_probes(struct tracer_probes_conf *tps)
 		config_probes_for_kprobe_and_tracepoint(tps);
 }
 
+/*
+ * security_sk_free() frees the sk keyed socket_info_map entries. It is
+ * missing or not probeable on some kernels (e.g. CONFIG_SECURITY=n), so
+ * it is attached on its own before the other probes: if that fails the
+ * socket key falls back to {tgid + fd} instead of counting an attach
+ * failure, which would keep the tracer from reaching TRACER_RUNNING.
+ */
+static void socket_key_sk_probe_attach(struct bpf_tracer *t)
+{
+	struct probe *p;
+
+	if (!socket_key_by_sk())
+		return;
+
+	if (!kallsyms_lookup_name("security_sk_free")) {
+		ebpf_warning("security_sk_free() not found, the socket key "
+			     "falls back to {tgid + fd}.\n");
+		socket_key_sk_enable = false;
+		return;
+	}
+
+	p = create_probe(t, "kprobe/security_sk_free", false, KPROBE, NULL,
+			 true);
+	if (p == NULL) {
+		socket_key_sk_enable = false;
+		return;
+	}
+
+	if (probe_attach(p) != ETR_OK) {
+		// Not a tracer attach failure, the key falls back instead.
+		__sync_fetch_and_sub(&attach_failed_count, 1);
+		free_probe_from_tracer(p);
+		ebpf_warning("Attach security_sk_free() failed, the socket "
+			     "key falls back to {tgid + fd}.\n");
+		socket_key_sk_enable = false;
+		return;
+	}
+
+	ebpf_info("attach enter kprobe: 'kprobe/security_sk_free', success!");
+}
+
 /* ==========================================================
  * 内核结构成员偏移推断，模拟一个TCP通信tick内核，使其完成推断
  * ==========================================================
@@ -718,6 +805,7 @@ static int socktrace_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
 			     " is %d.\n", size, sizeof(*msg));
 		return -1;
 	}
+	// Entries keyed by the sk pointer are not found this way.
 	uint64_t conn_key = (uint64_t)msg->pid << 32 | msg->fd;
 	struct socket_info_s info;
 	if (bpf_lookup_elem(map_fd, &conn_key, &info) == 0) {
@@ -977,11 +1065,17 @@ static void process_event(struct process_event_t *e)
 
 		update_proc_info_cache(e->pid, PROC_EXEC);
 		extended_process_exec(e->pid);
+#ifndef AARCH64_MUSL
+		interp_frame_cache_invalidate(e->pid);
+#endif
 	} else if (e->meta.event_type == EVENT_TYPE_PROC_EXIT) {
 		/* Cache for updating process information used in
 		 * symbol resolution. */
 		update_proc_info_cache(e->pid, PROC_EXIT);
 		extended_process_exit(e->pid);
+#ifndef AARCH64_MUSL
+		interp_frame_cache_invalidate(e->pid);
+#endif
 	}
 }
 
@@ -1022,7 +1116,9 @@ static int register_events_handle(struct reader_forward_info *fwd_info,
 
 	q_idx = fwd_info->queue_id;
 	q = &tracer->queues[q_idx];
-	block_head = malloc(sizeof(struct mem_block_head) + size);
+	block_head = clib_mem_alloc_aligned("socket_event",
+					    sizeof(struct mem_block_head) +
+					    size, 0, NULL);
 	if (block_head == NULL) {
 		ebpf_warning("block_head alloc memory failed\n");
 		return ETR_NOMEM;
@@ -1032,8 +1128,8 @@ static int register_events_handle(struct reader_forward_info *fwd_info,
 	memcpy(data, meta, size);
 	nr = ring_sp_enqueue_burst(q->r, (void **)&data, 1, NULL);
 	if (nr < 1) {
-		atomic64_add(&q->enqueue_lost, 1);
-		free(block_head);
+		tracer_stats_add(&tracer->stats.shards[q_idx], enqueue_lost, 1);
+		clib_mem_free(block_head);
 		ebpf_warning("Add ring(q:%d) failed\n", q_idx);
 		return ETR_NOROOM;
 	}
@@ -1046,7 +1142,7 @@ static int register_events_handle(struct reader_forward_info *fwd_info,
 	pthread_cond_signal(&q->cond);
 	pthread_mutex_unlock(&q->mutex);
 
-	atomic64_add(&q->enqueue_nr, nr);
+	tracer_stats_add(&tracer->stats.shards[q_idx], enqueue_nr, nr);
 
 	return ETR_OK;
 }
@@ -1058,6 +1154,16 @@ static int register_events_handle(struct reader_forward_info *fwd_info,
  * are not stored in the kernel structures, so additional
  * memory must be reserved to hold them.
  */
+// Size of a socket data in the buffer, including the HTTP/1.x index.
+static inline int socket_data_size(struct __socket_data *sd)
+{
+	int size = offsetof(typeof(struct __socket_data), data) + sd->data_len;
+	if (sd->data_type == PROTO_HTTP1 &&
+	    sd->l7_index_len == sizeof(struct http1_hdr_index))
+		size += sd->l7_index_len;
+	return size;
+}
+
 static inline int get_additional_memory_size(struct __socket_data_buffer *buf)
 {
 	int i, start = 0, extra_size = 0;
@@ -1067,9 +1173,7 @@ static inline int get_additional_memory_size(struct __socket_data_buffer *buf)
 		if (sd->source == DATA_SOURCE_IO_EVENT) {
 			extra_size += (sizeof(struct user_io_event_buffer) - sd->data_len);
 		}
-		start +=
-		    (offsetof(typeof(struct __socket_data), data) +
-		     sd->data_len);
+		start += socket_data_size(sd);
 	}
 
 	return extra_size;
@@ -1142,6 +1246,7 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 
 	uint64_t q_idx;
 	struct queue *q;
+	struct tracer_stats_shard *st;
 	int nr;
 	struct mem_block_head *block_head;	// 申请内存块的指针
 
@@ -1188,6 +1293,7 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 	/* Determine which queue to distribute to based on the first socket_data. */
 	q_idx = fwd_info->queue_id;
 	q = &tracer->queues[q_idx];
+	st = &tracer->stats.shards[q_idx];
 
 	if (buf->events_num > MAX_EVENTS_BURST) {
 		ebpf_info
@@ -1231,9 +1337,18 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 	alloc_len += get_additional_memory_size(buf);
 	alloc_len = CACHE_LINE_ROUNDUP(alloc_len);	// 保持cache line对齐
 
-	void *socket_data_buff = malloc(alloc_len);
+	/* Under memory pressure, drop the data instead of queuing more. */
+	if (unlikely(socket_data_shed) &&
+	    ring_count(q->r) >= (q->ring_size >> SOCKET_SHED_QUEUE_SHIFT)) {
+		tracer_stats_add(st, enqueue_lost, buf->events_num);
+		__sync_fetch_and_add(&socket_data_shed_lost, buf->events_num);
+		return;
+	}
+
+	void *socket_data_buff =
+	    clib_mem_alloc_aligned("socket_data", alloc_len, 0, NULL);
 	if (socket_data_buff == NULL) {
-		ebpf_warning("malloc() error.\n");
+		ebpf_warning("clib_mem_alloc_aligned() error.\n");
 		atomic64_inc(&q->heap_get_failed);
 		return;
 	}
@@ -1313,11 +1428,11 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 						       s_dev, mount_point, mount_source,
 						       root, sizeof(mount_point), &file_type);
 
-			// Not found in the process cache, attempting to retrieve from procfs.
+			// Not found in the process cache, look up the cgroup of the task.
 			if (ret) {
-				fetch_container_id_from_proc(sd->tgid,
-							     (char *)submit_data->container_id,
-							     sizeof(submit_data->container_id));
+				fetch_container_id_from_cgroup(sd->cgroup_id, sd->tgid,
+							       (char *)submit_data->container_id,
+							       sizeof(submit_data->container_id));
 			}
 
 			if (submit_data->process_kname[0] == '\0') {
@@ -1343,11 +1458,11 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 			submit_data->process_kname[sizeof(submit_data->process_kname) -
 						   1] = '\0';
 			if (sd->direction == T_EGRESS) {
-				atomic64_inc(&tracer->tx_pkts);
-				atomic64_add(&tracer->tx_bytes, sd->syscall_len);
+				tracer_stats_add(st, tx_pkts, 1);
+				tracer_stats_add(st, tx_bytes, sd->syscall_len);
 			} else {
-				atomic64_inc(&tracer->rx_pkts);
-				atomic64_add(&tracer->rx_bytes, sd->syscall_len);
+				tracer_stats_add(st, rx_pkts, 1);
+				tracer_stats_add(st, rx_bytes, sd->syscall_len);
 			}
 		}
 
@@ -1355,8 +1470,8 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 		if (submit_data->l7_protocal_hint >= PROTO_NUM)
 			submit_data->l7_protocal_hint = PROTO_UNKNOWN;
 
-		atomic64_inc(&tracer->proto_stats
-			     [submit_data->l7_protocal_hint]);
+		tracer_stats_add(st, proto_stats[submit_data->l7_protocal_hint],
+				 1);
 		int offset = 0;
 		if (len > 0) {
 			if (sd->extra_data_count > 0) {
@@ -1382,11 +1497,14 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 		}
 		submit_data->syscall_len += offset;
 		submit_data->cap_len = len + offset;
+		// The index offsets do not account for the extra data.
+		if (sd->data_type == PROTO_HTTP1 && offset == 0 &&
+		    sd->l7_index_len == sizeof(submit_data->l7_index))
+			memcpy(&submit_data->l7_index, sd->data + sd->data_len,
+			       sizeof(submit_data->l7_index));
 		burst_data[i] = submit_data;
 
-		start +=
-		    (offsetof(typeof(struct __socket_data), data) +
-		     sd->data_len);
+		start += socket_data_size(sd);
 
 		data_buf_ptr += sizeof(*submit_data) + submit_data->cap_len;
 	}
@@ -1396,15 +1514,15 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 
 	if (nr < buf->events_num) {
 		int lost = buf->events_num - nr;
-		atomic64_add(&q->enqueue_lost, lost);
+		tracer_stats_add(st, enqueue_lost, lost);
 		if (lost == buf->events_num) {
-			free(socket_data_buff);
+			clib_mem_free(socket_data_buff);
 			return;
 		}
 		int i;
 		for (i = nr; i < buf->events_num; i++) {
 			if (burst_data[i]->source == DATA_SOURCE_DPDK)
-				atomic64_inc(&tracer->dropped_pkts);
+				tracer_stats_add(st, dropped_pkts, 1);
 		}
 	}
 
@@ -1420,14 +1538,15 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 	pthread_cond_signal(&q->cond);
 	pthread_mutex_unlock(&q->mutex);
 
-	atomic64_add(&q->enqueue_nr, nr);
+	tracer_stats_add(st, enqueue_nr, nr);
 }
 
 static void reader_lost_cb(void *cookie, uint64_t lost)
 {
 	struct reader_forward_info *fwd_info = cookie;
 	struct bpf_tracer *tracer = fwd_info->tracer;
-	atomic64_add(&tracer->lost, lost);
+	tracer_stats_add(&tracer->stats.shards[fwd_info->queue_id], lost,
+			 lost);
 }
 
 static void reclaim_trace_map(struct bpf_tracer *tracer, uint32_t timeout)
@@ -1667,29 +1786,54 @@ static void check_datadump_timeout(void)
 	pthread_mutex_unlock(&datadump_mutex);
 }
 
-static inline u64 monotonic_ns()
+static int datadump_timeout_check(void)
 {
-	struct timespec ts;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	check_datadump_timeout();
+	return ETR_OK;
+}
+
+static int proc_info_cache_update(void)
+{
+	/* check and clean symbol cache */
+	exec_proc_info_cache_update();
+	return ETR_OK;
+}
+
+static int proc_info_check(void)
+{
+	static u64 count;
+	const u32 log_intv =
+	    OUTPUT_LOG_INTERVAL_NS / PROCESS_CACHE_UPDATE_INTERVAL_NS;
+	bool output_log = (++count % log_intv == 0);
+
+	check_and_update_proc_info(output_log);
+	collect_mount_info_stats(output_log);
+	return ETR_OK;
 }
 
-// Manage process start or exit events.
+static int mount_info_check(void)
+{
+	static u64 count;
+	const u32 log_intv =
+	    OUTPUT_LOG_INTERVAL_NS / MOUNT_CACHE_UPDATE_INTERVAL_NS;
+
+	check_root_mount_info(++count % log_intv == 0);
+	return ETR_OK;
+}
+
+/*
+ * Manage process start or exit events.
+ *
+ * The process/mount information maintenance and the datadump timeout
+ * check are periodic events (see socket_tracer_start()).
+ */
 static void process_events_handle_main(__unused void *arg)
 {
 	prctl(PR_SET_NAME, "proc-events");
 	thread_index = THREAD_PROC_EVENTS_HANDLE_IDX;
 	struct bpf_tracer *t = arg;
-	u64 proc_last_ts, mnt_last_ts, now_ts;
-	proc_last_ts = mnt_last_ts = monotonic_ns();
-	const u64 proc_intv_ns = PROCESS_CACHE_UPDATE_INTERVAL_NS;
-	const u64 mnt_intv_ns = MOUNT_CACHE_UPDATE_INTERVAL_NS;
-	const u32 log_intv = OUTPUT_LOG_INTERVAL_NS / PROCESS_CACHE_UPDATE_INTERVAL_NS;
-	u64 count = 0;
-	bool output_log;
 
 	for (;;) {
-		output_log = false;
 		/*
 		 * Will attach/detach all probes in the following cases:
 		 *
@@ -1708,23 +1852,7 @@ static void process_events_handle_main(__unused void *arg)
 		ssl_events_handle();
 		extended_events_handle();
 		unwind_events_handle();
-		check_datadump_timeout();
-		/* check and clean symbol cache */
-		exec_proc_info_cache_update();
-		now_ts = monotonic_ns();
-		if (now_ts - proc_last_ts >= proc_intv_ns) {
-			proc_last_ts = now_ts;
-			if (++count % log_intv == 0)
-				output_log = true;
-			check_and_update_proc_info(output_log);
-			collect_mount_info_stats(output_log);
-		}
 
-		if (now_ts - mnt_last_ts >= mnt_intv_ns) {
-			mnt_last_ts = now_ts;
-			check_root_mount_info(output_log);
-		}
-		
 		usleep(LOOP_DELAY_US);
 	}
 }
@@ -2081,6 +2209,7 @@ static void display_kern_offsets(bpf_offset_param_t * offset)
 	ebpf_info("\tkprobe_invalid: 0x%x\n", offset->kprobe_invalid);
 	ebpf_info("\tenable_unix_socket: 0x%x\n", offset->enable_unix_socket);
 	ebpf_info("\tfiles_infer_done: 0x%x\n", offset->files_infer_done);
+	ebpf_info("\tgo_lazy_goid: 0x%x\n", offset->go_lazy_goid);
 	ebpf_info("\treserved: 0x%x\n", offset->reserved);
 
 	ebpf_info("\tstruct_dentry_d_parent_offset: 0x%x\n",
@@ -2147,6 +2276,8 @@ static void display_kern_offsets(bpf_offset_param_t * offset)
 		  offset->struct_ns_common_inum_offset);
 	ebpf_info("\tstruct_mount_mnt_id_offset: 0x%x\n",
 		  offset->struct_mount_mnt_id_offset);
+	ebpf_info("\ttask__tpbase_offset: 0x%x\n",
+		  offset->task__tpbase_offset);
 }
 
 static void save_kern_offsets(struct bpf_tracer *t)
@@ -2252,6 +2383,9 @@ static void update_kprobe_port_bitmap(struct bpf_tracer *tracer)
 	bpf_table_set_value(tracer, MAP_KPROBE_PORT_BITMAP_NAME, 1,
 			    &bypass_port_bitmap);
 	print_ports_bitmap(&bypass_port_bitmap, "Blacklist");
+	bpf_table_set_value(tracer, MAP_KPROBE_PORT_BITMAP_NAME, 2,
+			    &metadata_port_bitmap);
+	print_ports_bitmap(&metadata_port_bitmap, "Metadata only");
 }
 
 static void config_proto_ports_bitmap(struct bpf_tracer *tracer)
@@ -2453,6 +2587,207 @@ int set_io_event_minimal_duration(uint64_t duration)
 	return 0;
 }
 
+int set_io_latency_hist(bool enabled, uint64_t outlier_duration,
+			io_latency_hist_cb_t callback)
+{
+	if (enabled && callback == NULL)
+		return ETR_INVAL;
+
+	io_hist_callback = callback;
+	io_event_outlier_duration = outlier_duration;
+	io_hist_enabled = enabled;
+
+	ebpf_info("Set io_latency_hist %s, outlier duration %lu ns\n",
+		  enabled ? "enabled" : "disabled", outlier_duration);
+
+	struct bpf_tracer *tracer = find_bpf_tracer(SK_TRACER_NAME);
+	if (tracer == NULL) {
+		return 0;
+	}
+
+	int cpu;
+	int nr_cpus = get_num_possible_cpus();
+	struct tracer_ctx_s values[nr_cpus];
+	memset(values, 0, sizeof(values));
+
+	if (!bpf_table_get_value(tracer, MAP_TRACER_CTX_NAME, 0, values)) {
+		ebpf_warning("Get map '%s' failed.\n", MAP_TRACER_CTX_NAME);
+		return ETR_NOTEXIST;
+	}
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		values[cpu].io_hist_enabled = io_hist_enabled;
+		values[cpu].io_event_outlier_duration =
+		    io_event_outlier_duration;
+	}
+
+	if (!bpf_table_set_value
+	    (tracer, MAP_TRACER_CTX_NAME, 0, (void *)&values)) {
+		ebpf_warning("Set '%s' failed\n", MAP_TRACER_CTX_NAME);
+		return ETR_UPDATE_MAP_FAILD;
+	}
+
+	return 0;
+}
+
+/*
+ * The kernel writes the histograms into one of the two io_hist_map, the
+ * other one has not been written for a whole period. It is drained: the
+ * per-CPU histograms are summed, passed to the callback and deleted. Then
+ * the two maps are switched, so no update can land between the lookup
+ * and the delete. The histograms are reported one period late.
+ */
+static u32 io_hist_idx;
+static int io_latency_hist_drain(void)
+{
+	struct bpf_tracer *t = find_bpf_tracer(SK_TRACER_NAME);
+	io_latency_hist_cb_t callback = io_hist_callback;
+	if (t == NULL || !io_hist_enabled || callback == NULL)
+		return 0;
+
+	u32 drain_idx = io_hist_idx ^ 1;
+	struct ebpf_map *map = ebpf_obj__get_map_by_name(t->obj,
+							 drain_idx ?
+							 MAP_IO_HIST_1_NAME :
+							 MAP_IO_HIST_0_NAME);
+	struct ebpf_map *dir_map = ebpf_obj__get_map_by_name(t->obj,
+							     MAP_IO_HIST_DIR_NAME);
+	if (map == NULL || dir_map == NULL)
+		return 0;
+
+	int cpu, i;
+	int nr_cpus = get_num_possible_cpus();
+	struct io_hist_value values[nr_cpus];
+	struct io_hist_key key = {}, next_key;
+	struct io_hist_dir dir;
+	struct io_latency_hist hist;
+	struct list_head clear_keys;
+	fs_type_t file_type;
+	char mount_source[MOUNT_SOURCE_SZ], root[MOUNT_POINT_SZ];
+	init_list_head(&clear_keys);
+
+	while (bpf_get_next_key(map->fd, &key, &next_key) == 0) {
+		key = next_key;
+		if (bpf_lookup_elem(map->fd, &key, values) != 0)
+			continue;
+		insert_list(&key, sizeof(key), &clear_keys);
+
+		memset(&hist, 0, sizeof(hist));
+		for (cpu = 0; cpu < nr_cpus; cpu++) {
+			hist.count += values[cpu].count;
+			hist.bytes += values[cpu].bytes;
+			hist.latency_sum += values[cpu].latency_sum;
+			for (i = 0; i < IO_HIST_SLOTS; i++)
+				hist.slots[i] += values[cpu].slots[i];
+		}
+		if (hist.count == 0)
+			continue;
+
+		hist.pid = key.tgid;
+		hist.mnt_id = key.mnt_id;
+		hist.mntns_id = key.mntns_id;
+		hist.operation = key.operation;
+		/*
+		 * The names are shared by the two maps and left to the LRU,
+		 * they are written again when a histogram is created.
+		 */
+		if (bpf_lookup_elem(dir_map->fd, &key.dir_id, &dir) == 0) {
+			safe_buf_copy(hist.dir_name, sizeof(hist.dir_name),
+				      dir.name, sizeof(dir.name));
+			hist.dir_name[sizeof(hist.dir_name) - 1] = '\0';
+		}
+		get_mount_info(key.tgid, key.mnt_id, key.mntns_id, 0,
+			       hist.mount_point, mount_source, root,
+			       sizeof(hist.mount_point), &file_type);
+		callback(&hist);
+	}
+
+	__reclaim_map(map->fd, &clear_keys);
+
+	if (!bpf_table_set_value(t, MAP_IO_HIST_CTL_NAME, 0, &drain_idx)) {
+		ebpf_warning("Set '%s' failed\n", MAP_IO_HIST_CTL_NAME);
+		return 0;
+	}
+	io_hist_idx = drain_idx;
+	return 0;
+}
+
+static uint32_t http1_hdr_name_hash(const char *name, int len)
+{
+	uint32_t hash = HTTP1_HDR_HASH_INIT;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t) tolower((unsigned char)name[i]);
+		hash *= HTTP1_HDR_HASH_PRIME;
+	}
+
+	return hash;
+}
+
+int set_http1_header_extract(const char *names, bool headers_only)
+{
+	uint32_t hashes[HTTP1_HDR_NAMES_MAX] = { 0 };
+	const char *p = names, *end;
+	int count = 0, len;
+
+	while (p && *p) {
+		while (*p == ' ' || *p == ',')
+			p++;
+		end = p;
+		while (*end && *end != ',')
+			end++;
+		len = end - p;
+		while (len > 0 && p[len - 1] == ' ')
+			len--;
+		if (len > 0) {
+			if (count == HTTP1_HDR_NAMES_MAX) {
+				ebpf_warning("At most %d HTTP/1.x header names "
+					     "can be indexed, '%s'.\n",
+					     HTTP1_HDR_NAMES_MAX, names);
+				return ETR_INVAL;
+			}
+			hashes[count++] = http1_hdr_name_hash(p, len);
+		}
+		p = end;
+	}
+
+	http1_hdr_extract = names != NULL;
+	http1_hdr_only = http1_hdr_extract && headers_only;
+	memcpy(http1_hdr_hash, hashes, sizeof(http1_hdr_hash));
+	ebpf_info("Set HTTP/1.x header index: names '%s', headers only %d\n",
+		  names ? names : "", http1_hdr_only);
+
+	struct bpf_tracer *tracer = find_bpf_tracer(SK_TRACER_NAME);
+	if (tracer == NULL)
+		return 0;
+
+	int cpu;
+	int nr_cpus = get_num_possible_cpus();
+	struct tracer_ctx_s values[nr_cpus];
+	memset(values, 0, sizeof(values));
+
+	if (!bpf_table_get_value(tracer, MAP_TRACER_CTX_NAME, 0, values)) {
+		ebpf_warning("Get map '%s' failed.\n", MAP_TRACER_CTX_NAME);
+		return ETR_NOTEXIST;
+	}
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		values[cpu].http1_hdr_extract = http1_hdr_extract;
+		values[cpu].http1_hdr_only = http1_hdr_only;
+		memcpy(values[cpu].http1_hdr_hash, http1_hdr_hash,
+		       sizeof(http1_hdr_hash));
+	}
+
+	if (!bpf_table_set_value
+	    (tracer, MAP_TRACER_CTX_NAME, 0, (void *)&values)) {
+		ebpf_warning("Set '%s' failed\n", MAP_TRACER_CTX_NAME);
+		return ETR_UPDATE_MAP_FAILD;
+	}
+
+	return 0;
+}
+
 int set_virtual_file_collect(bool enabled)
 {
 	virtual_file_collect_enable = enabled;
@@ -2539,6 +2874,99 @@ static void insert_output_prog_to_map(struct bpf_tracer *tracer)
 				   PROG_IO_EVENT_KP_IDX);
 }
 
+int set_socket_data_reorder(bool enable, uint32_t max_hold_us)
+{
+	if (max_hold_us == 0)
+		max_hold_us = SOCKET_REORDER_MAX_HOLD_US;
+	socket_reorder_max_hold_ns = max_hold_us * 1000ULL;
+	socket_reorder_enabled = enable;
+	ebpf_info("Set socket data reorder %s, max hold time %u us\n",
+		  enable ? "enable" : "disable", max_hold_us);
+	return ETR_OK;
+}
+
+static void socket_data_shed_start(void)
+{
+	socket_data_shed = true;
+}
+
+static void socket_data_shed_stop(void)
+{
+	socket_data_shed = false;
+	ebpf_info("Socket data shedding stopped, %lu events dropped.\n",
+		  socket_data_shed_lost);
+	socket_data_shed_lost = 0;
+}
+
+static struct reorder_buffer *reorder_buffer_create(struct queue *q)
+{
+	struct reorder_buffer *rb = calloc(1, sizeof(*rb));
+	if (rb == NULL) {
+		ebpf_warning("calloc() failed, no memory.\n");
+		return NULL;
+	}
+
+	if (reorder_buffer_init(rb, q->t, q->id)) {
+		ebpf_warning("reorder_buffer_init() failed.\n");
+		free(rb);
+		return NULL;
+	}
+
+	reorder_bufs[q->id] = rb;
+	return rb;
+}
+
+static void reorder_and_process_data(struct queue *q, struct reorder_buffer *rb,
+				     int nb_rx, void **datas_burst)
+{
+	struct socket_bpf_data *sd;
+	struct mem_block_head *block_head;
+	u64 now = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+	int j;
+
+	for (j = 0; j < nb_rx; j++) {
+		sd = (struct socket_bpf_data *)datas_burst[j];
+		block_head = (struct mem_block_head *)sd - 1;
+		if (block_head->fn != NULL)
+			block_head->fn(sd);
+		else if (socket_data_reorderable(sd))
+			reorder_submit(rb, sd, now);
+		else
+			process_socket_data(q->t, q->id, sd);
+
+		if (block_head->is_last == 1)
+			clib_mem_free(block_head->free_ptr);
+	}
+
+	reorder_flush(rb, now, socket_reorder_max_hold_ns);
+}
+
+/*
+ * Wait for the producer while data is held in the reorder buffer, the
+ * held data must be emitted when its maximum hold time is reached.
+ */
+static void reorder_wait(struct queue *q, struct reorder_buffer *rb)
+{
+	u64 max_hold_ns = socket_reorder_max_hold_ns;
+	struct timespec ts;
+
+	reorder_flush(rb, gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN), max_hold_ns);
+	if (rb->held_count == 0) {
+		pthread_mutex_lock(&q->mutex);
+		pthread_cond_wait(&q->cond, &q->mutex);
+		pthread_mutex_unlock(&q->mutex);
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	u64 deadline = ts.tv_sec * NS_IN_SEC + ts.tv_nsec + max_hold_ns;
+	ts.tv_sec = deadline / NS_IN_SEC;
+	ts.tv_nsec = deadline % NS_IN_SEC;
+	pthread_mutex_lock(&q->mutex);
+	pthread_cond_timedwait(&q->cond, &q->mutex, &ts);
+	pthread_mutex_unlock(&q->mutex);
+}
+
 /*
  * The work thread retrieves data from the queue and processes it.
  */
@@ -2549,9 +2977,25 @@ static void process_data(void *queue)
 	struct queue *q = (struct queue *)queue;
 	struct ring *r = q->r;
 	void *rx_burst[MAX_EVENTS_BURST];
+	struct reorder_buffer *rb = NULL;
+	bool reorder;
 	for (;;) {
+		reorder = socket_reorder_enabled;
+		if (reorder && rb == NULL) {
+			rb = reorder_buffer_create(q);
+			if (rb == NULL)
+				socket_reorder_enabled = reorder = false;
+		} else if (!reorder && rb != NULL && rb->hash.hash_elems_count > 0) {
+			/* Disabled, emit the held data and forget the sockets. */
+			reorder_buffer_reset(rb);
+		}
+
 		nr = ring_sc_dequeue_burst(r, rx_burst, MAX_EVENTS_BURST, NULL);
 		if (nr == 0) {
+			if (reorder) {
+				reorder_wait(q, rb);
+				continue;
+			}
 			/*
 			 * 等着生产者唤醒
 			 */
@@ -2560,7 +3004,11 @@ static void process_data(void *queue)
 			pthread_mutex_unlock(&q->mutex);
 		} else {
 			atomic64_add(&q->dequeue_nr, nr);
-			prefetch_and_process_data(q->t, q->id, nr, rx_burst);
+			if (reorder)
+				reorder_and_process_data(q, rb, nr, rx_burst);
+			else
+				prefetch_and_process_data(q->t, q->id, nr,
+							  rx_burst);
 			if (nr == MAX_EVENTS_BURST)
 				atomic64_inc(&q->burst_count);
 		}
@@ -2638,12 +3086,15 @@ static void perf_buffer_read(void *arg)
 			printf("%s, ring_sp_enqueue failed.\n", __func__);
 			ebpf_info("%s, ring_sp_enqueue failed.\n", __func__);
 			free(prep_data);
-			atomic64_inc(&q->enqueue_lost);
+			// Any thread may feed this queue in this test.
+			__atomic_fetch_add(&tracer->stats.shards[ring_idx].
+					   enqueue_lost, 1, __ATOMIC_RELAXED);
 		} else {
 			pthread_mutex_lock(&q->mutex);
 			pthread_cond_signal(&q->cond);
 			pthread_mutex_unlock(&q->mutex);
-			atomic64_inc(&q->enqueue_nr);
+			__atomic_fetch_add(&tracer->stats.shards[ring_idx].
+					   enqueue_nr, 1, __ATOMIC_RELAXED);
 		}
 #endif
 	}
@@ -2695,8 +3146,6 @@ static int dispatch_workers_setup(struct bpf_tracer *tracer,
 		tracer->queues[i].nr = 0;
 		tracer->queues[i].ring_size = queue_size;
 
-		atomic64_init(&tracer->queues[i].enqueue_lost);
-		atomic64_init(&tracer->queues[i].enqueue_nr);
 		atomic64_init(&tracer->queues[i].dequeue_nr);
 		atomic64_init(&tracer->queues[i].burst_count);
 		atomic64_init(&tracer->queues[i].heap_get_failed);
@@ -3021,6 +3470,9 @@ int running_socket_tracer(tracer_callback_t handle,
 	if (tracer_probes_init(tracer))
 		return -EINVAL;
 
+	// Before tracer_ctx is set, it may turn socket_key_sk off.
+	socket_key_sk_probe_attach(tracer);
+
 	// Update kernel offsets map from btf vmlinux file.
 	if (update_offset_map_from_btf_vmlinux(tracer) != ETR_OK) {
 		ebpf_info
@@ -3045,6 +3497,12 @@ int running_socket_tracer(tracer_callback_t handle,
 	if (uid_base == 0)
 		return -EINVAL;
 
+	// Loaded as a placeholder when the kernel lacks task local storage.
+	struct ebpf_map *task_map =
+	    ebpf_obj__get_map_by_name(tracer->obj, MAP_TRACE_TASK_NAME);
+	bool trace_task_storage = task_map != NULL &&
+	    task_map->def.type == BPF_MAP_TYPE_TASK_STORAGE;
+
 	uint16_t cpu;
 	struct tracer_ctx_s t_conf[MAX_CPU_NR];
 	memset(&t_conf, 0, sizeof(t_conf));
@@ -3056,8 +3514,17 @@ int running_socket_tracer(tracer_callback_t handle,
 		t_conf[cpu].io_event_collect_mode = io_event_collect_mode;
 		t_conf[cpu].io_event_minimal_duration =
 		    io_event_minimal_duration;
+		t_conf[cpu].io_hist_enabled = io_hist_enabled;
+		t_conf[cpu].io_event_outlier_duration =
+		    io_event_outlier_duration;
 		t_conf[cpu].virtual_file_collect_enabled = virtual_file_collect_enable;
 		t_conf[cpu].disable_tracing = g_disable_syscall_tracing;
+		t_conf[cpu].trace_task_storage = trace_task_storage;
+		t_conf[cpu].socket_key_sk = socket_key_by_sk();
+		t_conf[cpu].http1_hdr_extract = http1_hdr_extract;
+		t_conf[cpu].http1_hdr_only = http1_hdr_only;
+		memcpy(t_conf[cpu].http1_hdr_hash, http1_hdr_hash,
+		       sizeof(http1_hdr_hash));
 		if (!g_disable_syscall_tracing)
 			t_conf[cpu].go_tracing_timeout = go_tracing_timeout;
 	}
@@ -3072,6 +3539,10 @@ int running_socket_tracer(tracer_callback_t handle,
 	ebpf_info("Config virtual_file_collect_enable: %d\n", virtual_file_collect_enable);
 	ebpf_info("Config g_disable_syscall_tracing: %d\n", g_disable_syscall_tracing);
 	ebpf_info("Config go_tracing_timeout: %d\n", go_tracing_timeout);
+	ebpf_info("Config trace_task_storage: %d\n", trace_task_storage);
+	ebpf_info("Config socket_key_sk: %d\n", socket_key_by_sk());
+	ebpf_info("Config http1_hdr_extract: %d (headers only %d)\n",
+		  http1_hdr_extract && g_k_type == K_TYPE_KFUNC, http1_hdr_only);
 
 	tracer->data_limit_max = socket_data_limit_max;
 
@@ -3138,6 +3609,53 @@ int running_socket_tracer(tracer_callback_t handle,
 				      CHECK_KERN_ADAPT_PERIOD)))
 		return ret;
 
+	if ((ret =
+	     register_period_event_op("io-hist-drain",
+				      io_latency_hist_drain,
+				      IO_HIST_DRAIN_PERIOD)))
+		return ret;
+
+	if ((ret =
+	     register_period_event_op("datadump-timeout",
+				      datadump_timeout_check,
+				      DATADUMP_TIMEOUT_CHECK_PERIOD)))
+		return ret;
+
+	/*
+	 * The process information cache is only modified by these events,
+	 * they are bound to the same worker so that they never run
+	 * concurrently.
+	 */
+	if ((ret =
+	     register_period_worker_op("proc-info-cache-update",
+				       proc_info_cache_update,
+				       PROC_INFO_CACHE_UPDATE_PERIOD,
+				       PERIOD_WORKER_PROC_INFO)))
+		return ret;
+
+	if ((ret =
+	     register_period_worker_op("proc-info-check", proc_info_check,
+				       PROCESS_CACHE_UPDATE_PERIOD,
+				       PERIOD_WORKER_PROC_INFO)))
+		return ret;
+
+	if ((ret =
+	     register_period_worker_op("mount-info-check", mount_info_check,
+				       MOUNT_CACHE_UPDATE_PERIOD,
+				       PERIOD_WORKER_PROC_INFO)))
+		return ret;
+
+	mem_governor_register("socket-data", MEM_SHED_PRIO_SOCKET_DATA,
+			      socket_data_shed_start, socket_data_shed_stop);
+
+	/* Falls back to procfs lookups if cgroup v2 is not available. */
+	if (cgroup_cid_cache_init() == ETR_OK &&
+	    (ret = register_period_worker_op("cgroup-cid-cache-clean",
+					     cgroup_cid_cache_clean,
+					     CGROUP_CID_CACHE_CLEAN_PERIOD,
+					     PERIOD_WORKER_PROC_INFO)))
+		return ret;
+
 	if ((ret = sockopt_register(&socktrace_sockopts)) != ETR_OK)
 		return ret;
 
@@ -3278,6 +3796,7 @@ static int update_offsets_table(struct bpf_tracer *t,
 	bpf_offset_param_t offs[nr_cpus];
 	int i;
 	memset(&offs, 0, sizeof(offs));
+	go_lazy_goid_offset_fill(offset);
 	for (i = 0; i < nr_cpus; i++) {
 		offs[i] = *offset;
 	}
@@ -3362,19 +3881,97 @@ static void pkts_stats(struct bpf_tracer *t, struct socket_trace_stats *stats)
 		return;
 	}
 
-	stats->rx_packets = atomic64_read(&t->rx_pkts);
-	stats->tx_packets = atomic64_read(&t->tx_pkts);
-	stats->rx_bytes = atomic64_read(&t->rx_bytes);
-	stats->tx_bytes = atomic64_read(&t->tx_bytes);
-	stats->dropped_packets = atomic64_read(&t->dropped_pkts);
+	stats->rx_packets = tracer_stats_sum(&t->stats, rx_pkts, true);
+	stats->tx_packets = tracer_stats_sum(&t->stats, tx_pkts, true);
+	stats->rx_bytes = tracer_stats_sum(&t->stats, rx_bytes, true);
+	stats->tx_bytes = tracer_stats_sum(&t->stats, tx_bytes, true);
+	stats->dropped_packets = tracer_stats_sum(&t->stats, dropped_pkts, true);
 	stats->kern_missed_packets = update_pkts_stats(t, STATS_MISS_PKTS);
 	stats->invalid_packets = update_pkts_stats(t, STATS_INVAL_PKTS);
+}
 
-	atomic64_init(&t->rx_pkts);
-	atomic64_init(&t->tx_pkts);
-	atomic64_init(&t->rx_bytes);
-	atomic64_init(&t->tx_bytes);
-	atomic64_init(&t->dropped_pkts);
+/*
+ * Per-CPU counters of tracer_ctx_map, summed over CPUs. The previous
+ * sums are kept to report the increment since the last collection.
+ */
+struct tracer_ctx_counters {
+	u64 trace_lookup_count;
+	u64 trace_map_ops;
+	u64 trace_task_ops;
+	u64 args_hash_ops_avoided;
+	u64 sk_free_reclaim_count;
+	u64 metadata_only_count;
+	u64 http1_hdr_index_count;
+	u64 io_hist_overflow_count;
+	u64 go_lazy_goid_count;
+	u64 go_ancestor_truncated_count;
+};
+
+static struct tracer_ctx_counters prev_ctx_counters;
+
+static inline u64 counter_delta(u64 curr, u64 *prev)
+{
+	// The map is rewritten by the config setters, never go backwards.
+	u64 diff = curr >= *prev ? curr - *prev : 0;
+	*prev = curr;
+	return diff;
+}
+
+static void tracer_ctx_stats_collect(struct bpf_tracer *t,
+				     struct socket_trace_stats *stats)
+{
+	int cpu;
+	int nr_cpus = get_num_possible_cpus();
+	struct tracer_ctx_s values[nr_cpus];
+	struct tracer_ctx_counters curr;
+	struct tracer_ctx_counters *prev = &prev_ctx_counters;
+	memset(values, 0, sizeof(values));
+	memset(&curr, 0, sizeof(curr));
+
+	if (!bpf_table_get_value(t, MAP_TRACER_CTX_NAME, 0, values))
+		return;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		curr.trace_lookup_count += values[cpu].trace_lookup_count;
+		curr.trace_map_ops += values[cpu].trace_map_ops;
+		curr.trace_task_ops += values[cpu].trace_task_ops;
+		curr.args_hash_ops_avoided += values[cpu].args_hash_ops_avoided;
+		curr.sk_free_reclaim_count += values[cpu].sk_free_reclaim_count;
+		curr.metadata_only_count += values[cpu].metadata_only_count;
+		curr.http1_hdr_index_count += values[cpu].http1_hdr_index_count;
+		curr.io_hist_overflow_count +=
+		    values[cpu].io_hist_overflow_count;
+		curr.go_lazy_goid_count += values[cpu].go_lazy_goid_count;
+		curr.go_ancestor_truncated_count +=
+		    values[cpu].go_ancestor_truncated_count;
+	}
+
+	stats->trace_task_storage = values[0].trace_task_storage;
+	stats->socket_key_sk = values[0].socket_key_sk;
+	stats->trace_events = counter_delta(curr.trace_lookup_count,
+					    &prev->trace_lookup_count);
+	stats->trace_map_ops = counter_delta(curr.trace_map_ops,
+					     &prev->trace_map_ops);
+	stats->trace_task_ops = counter_delta(curr.trace_task_ops,
+					      &prev->trace_task_ops);
+	stats->args_hash_ops_avoided =
+	    counter_delta(curr.args_hash_ops_avoided,
+			  &prev->args_hash_ops_avoided);
+	stats->sk_free_reclaims = counter_delta(curr.sk_free_reclaim_count,
+						&prev->sk_free_reclaim_count);
+	stats->metadata_only_events =
+	    counter_delta(curr.metadata_only_count,
+			  &prev->metadata_only_count);
+	stats->http1_hdr_indexed = counter_delta(curr.http1_hdr_index_count,
+						 &prev->http1_hdr_index_count);
+	stats->io_hist_overflows =
+	    counter_delta(curr.io_hist_overflow_count,
+			  &prev->io_hist_overflow_count);
+	stats->go_lazy_goid_lookups = counter_delta(curr.go_lazy_goid_count,
+						    &prev->go_lazy_goid_count);
+	stats->go_ancestor_truncations =
+	    counter_delta(curr.go_ancestor_truncated_count,
+			  &prev->go_ancestor_truncated_count);
 }
 
 struct socket_trace_stats socket_tracer_stats(void)
@@ -3386,8 +3983,7 @@ struct socket_trace_stats socket_tracer_stats(void)
 	if (t == NULL)
 		return stats;
 
-	stats.kern_lost = atomic64_read(&t->lost);
-	atomic64_init(&t->lost);
+	stats.kern_lost = tracer_stats_sum(&t->stats, lost, true);
 	stats.worker_num = t->dispatch_workers_nr;
 	stats.perf_pages_cnt = t->readers[0].perf_pages_cnt;
 	stats.queue_capacity = t->queues[0].ring_size;
@@ -3434,9 +4030,9 @@ struct socket_trace_stats socket_tracer_stats(void)
 	int i;
 	for (i = 0; i < t->dispatch_workers_nr; i++) {
 		stats.user_enqueue_lost +=
-		    atomic64_read(&t->queues[i].enqueue_lost);
+		    tracer_stats_fetch(&t->stats, i, enqueue_lost, true);
 		stats.user_enqueue_count +=
-		    atomic64_read(&t->queues[i].enqueue_nr);
+		    tracer_stats_fetch(&t->stats, i, enqueue_nr, true);
 		stats.user_dequeue_count +=
 		    atomic64_read(&t->queues[i].dequeue_nr);
 		stats.queue_burst_count +=
@@ -3444,12 +4040,22 @@ struct socket_trace_stats socket_tracer_stats(void)
 		stats.mem_alloc_fail_count +=
 		    atomic64_read(&t->queues[i].heap_get_failed);
 
-		atomic64_init(&t->queues[i].enqueue_lost);
-		atomic64_init(&t->queues[i].enqueue_nr);
 		atomic64_init(&t->queues[i].dequeue_nr);
 		atomic64_init(&t->queues[i].heap_get_failed);
+
+		struct reorder_buffer *rb = reorder_bufs[i];
+		if (rb == NULL)
+			continue;
+		stats.reorder_reordered_count +=
+		    __sync_lock_test_and_set(&rb->reordered_count, 0);
+		stats.reorder_late_count +=
+		    __sync_lock_test_and_set(&rb->late_count, 0);
+		stats.reorder_gap_count +=
+		    __sync_lock_test_and_set(&rb->gap_count, 0);
 	}
 
+	tracer_ctx_stats_collect(t, &stats);
+
 	stats.is_adapt_success = t->adapt_success;
 	stats.tracer_state = t->state;
 
@@ -3505,6 +4111,24 @@ int register_event_handle(uint32_t type, void (*fn) (void *))
 // 协议测试
 // -------------------------------------
 
+static int print_uprobe_http2_header(const char *key_data, int key_len,
+				     const char *value_data, int value_len,
+				     char *buf, int buf_len)
+{
+	char key[1024] = { 0 };
+	char value[1024] = { 0 };
+
+	memcpy(&key, key_data, key_len < 1024 ? key_len : 1023);
+	memcpy(&value, value_data, value_len < 1024 ? value_len : 1023);
+
+	if (datadump_enable)
+		return snprintf(buf, buf_len, "header=[%s:%s]\n", key, value);
+
+	fprintf(stdout, "header=[%s:%s]\n", key, value);
+	fflush(stdout);
+	return 0;
+}
+
 int print_uprobe_http2_info(const char *data, int len, char *buf, int buf_len)
 {
 	struct {
@@ -3515,8 +4139,6 @@ int print_uprobe_http2_info(const char *data, int len, char *buf, int buf_len)
 	} __attribute__ ((packed)) header;
 
 	int bytes = 0;
-	char key[1024] = { 0 };
-	char value[1024] = { 0 };
 	memcpy(&header, data, sizeof(header));
 	if (datadump_enable) {
 		bytes +=
@@ -3529,23 +4151,36 @@ int print_uprobe_http2_info(const char *data, int len, char *buf, int buf_len)
 			header.stream_id);
 	}
 
+	if (header.header_len & HTTP2_HEADERS_PACKED) {
+		int count = header.header_len & 0xffff;
+		int off = sizeof(header);
+		__u16 key_len, value_len;
+		while (count-- > 0 && bytes < buf_len &&
+		       off + HTTP2_PACKED_FIELD_HDR <= len) {
+			memcpy(&key_len, data + off, sizeof(key_len));
+			memcpy(&value_len, data + off + 2, sizeof(value_len));
+			off += HTTP2_PACKED_FIELD_HDR;
+			if (off + key_len + value_len > len)
+				break;
+			bytes += print_uprobe_http2_header(data + off, key_len,
+							   data + off + key_len,
+							   value_len,
+							   buf + bytes,
+							   buf_len - bytes);
+			off += key_len + value_len;
+		}
+		return bytes;
+	}
+
 	const int value_start = sizeof(header) + header.header_len;
 
 	header.header_len = header.header_len < 1024 ? header.header_len : 1023;
 	header.value_len = header.value_len < 1024 ? header.value_len : 1023;
 
-	memcpy(&key, data + sizeof(header), header.header_len);
-	memcpy(&value, data + value_start, header.value_len);
-
-	if (datadump_enable) {
-		bytes +=
-		    snprintf(buf + bytes, buf_len - bytes, "header=[%s:%s]\n",
-			     key, value);
-	} else {
-		fprintf(stdout, "header=[%s:%s]\n", key, value);
-		fflush(stdout);
-	}
-
+	bytes += print_uprobe_http2_header(data + sizeof(header),
+					   header.header_len,
+					   data + value_start, header.value_len,
+					   buf + bytes, buf_len - bytes);
 	return bytes;
 }
 
@@ -4007,6 +4642,20 @@ int disable_syscall_trace_id(void)
 	return 0;
 }
 
+int set_socket_key_by_sk(bool enabled)
+{
+	// The existing entries would be orphaned by a key change.
+	if (find_bpf_tracer(SK_TRACER_NAME) != NULL) {
+		ebpf_warning("The socket tracer is running, the socket key "
+			     "can only be set before it starts.\n");
+		return ETR_INVAL;
+	}
+
+	socket_key_sk_enable = enabled;
+	ebpf_info("Set socket key by sk: %d\n", enabled);
+	return 0;
+}
+
 void uprobe_match_pid_handle(int feat, int pid, enum match_pids_act act)
 {
 	if (feat == FEATURE_UPROBE_GOLANG)
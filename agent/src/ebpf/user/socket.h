@@ -96,6 +96,11 @@ struct socket_bpf_data {
 	uint64_t cap_seq;	// cap_data在Socket中的相对顺序号，从启动时的时钟开始自增1，用于数据乱序排序
 	uint8_t socket_role;	// this message is created by: 0:unkonwn 1:client(connect) 2:server(accept)
 	uint32_t fd;		// File descriptor for an open file or socket.
+	/*
+	 * HTTP/1.x start line and header offsets in cap_data, all zero if
+	 * not indexed (see set_http1_header_extract()).
+	 */
+	struct http1_hdr_index l7_index;
 	char *cap_data;		// 返回的应用数据
 };
 
@@ -199,8 +204,69 @@ struct socket_trace_stats {
 	uint64_t dropped_packets;
 	uint64_t kern_missed_packets;
 	uint64_t invalid_packets;
+
+	/*
+	 * Socket data reorder stage
+	 */
+	uint64_t reorder_reordered_count;
+	uint64_t reorder_late_count;
+	uint64_t reorder_gap_count;
+
+	// Goroutine IDs read from the g pointer in lazy mode.
+	uint64_t go_lazy_goid_lookups;
+	// Ancestor resolutions given up at the depth limit.
+	uint64_t go_ancestor_truncations;
+
+	/*
+	 * Trace information accesses, 'trace_events' is the number of
+	 * lookups (one per traced event). With the task local storage the
+	 * thread keyed accesses are counted in 'trace_task_ops' instead of
+	 * 'trace_map_ops'. Only counted on the Linux 5.2+ programs.
+	 */
+	bool trace_task_storage;
+	uint64_t trace_events;
+	uint64_t trace_map_ops;
+	uint64_t trace_task_ops;
+	/*
+	 * Updates and deletes of the syscall arguments hash maps avoided,
+	 * by the task local storage or by not stashing the arguments of
+	 * the non-socket fds.
+	 */
+	uint64_t args_hash_ops_avoided;
+	/*
+	 * socket_info_map keyed by the sk pointer, the entries are then
+	 * freed along with the socket ('sk_free_reclaims').
+	 */
+	bool socket_key_sk;
+	uint64_t sk_free_reclaims;
+	// Socket data pushed without the payload (metadata only ports).
+	uint64_t metadata_only_events;
+	// HTTP/1.x data pushed with the header index.
+	uint64_t http1_hdr_indexed;
+	// File IO left out of the latency histograms, the map was full.
+	uint64_t io_hist_overflows;
 };
 
+/*
+ * File IO latency histogram of a (process, mount, directory, operation)
+ * over a drain period. slots[i] counts the latencies in [2^i, 2^(i+1))
+ * microseconds, the last slot everything above.
+ */
+struct io_latency_hist {
+	uint32_t pid;
+	int mnt_id;
+	uint32_t mntns_id;
+	uint32_t operation;	// 0: write, 1: read
+	char mount_point[MOUNT_POINT_SZ];
+	char dir_name[IO_HIST_DIR_NAME_SZ];	// Last component, may be empty
+	uint64_t count;
+	uint64_t bytes;
+	uint64_t latency_sum;	// nanosecond
+	uint64_t slots[IO_HIST_SLOTS];
+} __attribute__ ((packed));
+
+typedef void (*io_latency_hist_cb_t) (struct io_latency_hist * hist);
+
 struct bpf_offset_param_array {
 	int count;
 	bpf_offset_param_t offsets[0];
@@ -367,6 +433,22 @@ do {						\
 } while (0)
 /* *INDENT-ON* */
 
+static inline void
+process_socket_data(struct bpf_tracer *t, int id, struct socket_bpf_data *sd)
+{
+	tracer_callback_t callback = (tracer_callback_t) t->process_fn;
+	int64_t boot_time = get_sysboot_time_ns();
+	if (t->datadump)
+		t->datadump((void *)sd, boot_time);
+	/*
+	 * Modify socket data time to real time,
+	 * time precision is in nanosecond.
+	 */
+	sd->timestamp = sd->timestamp + boot_time;
+	sd->cap_timestamp = sd->cap_timestamp + boot_time;
+	callback(NULL, id, sd);
+}
+
 static inline void
 prefetch_and_process_data(struct bpf_tracer *t, int id, int nb_rx, void **datas_burst)
 {
@@ -375,7 +457,6 @@ prefetch_and_process_data(struct bpf_tracer *t, int id, int nb_rx, void **datas_
 	int32_t j;
 	struct socket_bpf_data *sd;
 	struct mem_block_head *block_head;
-	tracer_callback_t callback = (tracer_callback_t) t->process_fn;
 
 	/* Prefetch first packets */
 	for (j = 0; j < PREFETCH_OFFSET && j < nb_rx; j++)
@@ -394,27 +475,21 @@ prefetch_and_process_data(struct bpf_tracer *t, int id, int nb_rx, void **datas_
 		if (block_head->fn != NULL) {
 			block_head->fn(sd);
 		} else {
-			int64_t boot_time = get_sysboot_time_ns();
-			if (t->datadump)
-				t->datadump((void *)sd, boot_time);
-			/*
-			 * Modify socket data time to real time,
-			 * time precision is in nanosecond.
-			 */
-			sd->timestamp = sd->timestamp + boot_time;
-			sd->cap_timestamp = sd->cap_timestamp + boot_time;
-			callback(NULL, id, sd);
+			process_socket_data(t, id, sd);
 		}
 
 		if (block_head->is_last == 1)
-			free(block_head->free_ptr);
+			clib_mem_free(block_head->free_ptr);
 	}
 }
 
 int set_data_limit_max(int limit_size);
+int set_socket_data_reorder(bool enable, uint32_t max_hold_us);
 int set_go_tracing_timeout(int timeout);
 int set_io_event_collect_mode(uint32_t mode);
 int set_io_event_minimal_duration(uint64_t duration);
+int set_io_latency_hist(bool enabled, uint64_t outlier_duration,
+			io_latency_hist_cb_t callback);
 struct socket_trace_stats socket_tracer_stats(void);
 int running_socket_tracer(tracer_callback_t handle,
 			  int thread_nr,
@@ -430,6 +505,39 @@ enum tracer_state get_socket_tracer_state(void);
 int set_protocol_ports_bitmap(int proto_type, const char *ports);
 int disable_syscall_trace_id(void);
 
+/**
+ * @brief Key the socket information by the kernel socket (sk pointer)
+ * instead of {tgid + fd}.
+ *
+ * The dup()ed and inherited fds then share the socket state and the
+ * entries are freed in the kernel along with the socket, the userspace
+ * reclaim of socket_info_map is only a fallback. Only effective with the
+ * Linux 5.2+ eBPF programs, must be called before running_socket_tracer().
+ * Falls back to {tgid + fd} if security_sk_free() cannot be attached.
+ *
+ * @param enabled true to key by the sk pointer
+ * @return 0 on success, ETR_INVAL if the tracer is already running.
+ */
+int set_socket_key_by_sk(bool enabled);
+
+/**
+ * @brief Index the HTTP/1.x start line and headers in the kernel.
+ *
+ * The start line and the values of up to HTTP1_HDR_NAMES_MAX headers are
+ * located in the first HTTP1_HDR_SCAN_MAX bytes of the HTTP/1.x data and
+ * passed as offsets in 'struct socket_bpf_data.l7_index'. Only effective
+ * with the fentry/fexit (kfunc) eBPF programs.
+ *
+ * @param names Comma separated header names (case insensitive), e.g.
+ *              "traceparent,x-request-id,content-length". An empty
+ *              string indexes the start line and the header block
+ *              only, NULL disables the index.
+ * @param headers_only true to push the header block only, the body is
+ *                     dropped when the end of the headers is found.
+ * @return 0 on success, a negative value on failure.
+ */
+int set_http1_header_extract(const char *names, bool headers_only);
+
 /**
  * eBPF Probe Point Configuration
  *
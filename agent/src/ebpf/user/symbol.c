@@ -35,6 +35,7 @@
 #include <bcc/bcc_elf.h>
 #include <bcc/bcc_syms.h>
 #include <dirent.h>		// for opendir()
+#include <pthread.h>
 #include "config.h"
 #include "elf.h"
 #include "log.h"
@@ -158,29 +159,21 @@ int find_load(uint64_t v_addr, uint64_t mem_sz, uint64_t file_offset,
 }
 
 #if defined __x86_64__
-static void resolve_func_ret_addr(struct symbol_uprobe *uprobe_sym)
+static void resolve_func_ret_addr(int fd, struct symbol_uprobe *uprobe_sym)
 {
 	NDSTATUS status;
 	INSTRUX ix;
-	int fd;
 	size_t pc;
 	int remian;
 	int cnt = 0;
 	size_t offset = 0;
 	char *buffer = NULL;
 
-	fd = open(uprobe_sym->binary_path, O_RDONLY);
-	if (fd == -1)
-		goto out;
-
-	if (lseek(fd, uprobe_sym->entry, SEEK_SET) == -1)
-		goto close_file;
-
 	buffer = malloc(uprobe_sym->size);
 	if (!buffer)
-		goto close_file;
+		goto out;
 
-	if (read(fd, buffer, uprobe_sym->size) == -1)
+	if (pread(fd, buffer, uprobe_sym->size, uprobe_sym->entry) == -1)
 		goto free_buffer;
 
 	memset(uprobe_sym->rets, 0, sizeof(uprobe_sym->rets));
@@ -202,8 +195,6 @@ static void resolve_func_ret_addr(struct symbol_uprobe *uprobe_sym)
 
 free_buffer:
 	free(buffer);
-close_file:
-	close(fd);
 out:
 	uprobe_sym->rets_count = cnt;
 }
@@ -216,27 +207,19 @@ static int is_a64_ret_ins(unsigned int code)
 	return (code & 0xfffffc1f) == 0xd65f0000;
 }
 
-static void resolve_func_ret_addr(struct symbol_uprobe *uprobe_sym)
+static void resolve_func_ret_addr(int fd, struct symbol_uprobe *uprobe_sym)
 {
 	static const int ARM64_INS_LEN = 4;
-	int fd = 0;
 	int cnt = 0;
 	size_t offset = 0;
 	char *buffer = NULL;
 	uint32_t code = 0;
 
-	fd = open(uprobe_sym->binary_path, O_RDONLY);
-	if (fd == -1)
-		goto out;
-
-	if (lseek(fd, uprobe_sym->entry, SEEK_SET) == -1)
-		goto close_file;
-
 	buffer = malloc(uprobe_sym->size);
 	if (!buffer)
-		goto close_file;
+		goto out;
 
-	if (read(fd, buffer, uprobe_sym->size) == -1)
+	if (pread(fd, buffer, uprobe_sym->size, uprobe_sym->entry) == -1)
 		goto free_buffer;
 
 	memset(uprobe_sym->rets, 0, sizeof(uprobe_sym->rets));
@@ -250,8 +233,6 @@ static void resolve_func_ret_addr(struct symbol_uprobe *uprobe_sym)
 
 free_buffer:
 	free(buffer);
-close_file:
-	close(fd);
 out:
 	uprobe_sym->rets_count = cnt;
 }
@@ -382,7 +363,11 @@ struct symbol_uprobe *resolve_and_gen_uprobe_symbol(const char *bin_file,
 	}
 
 	if (uprobe_sym->isret && uprobe_sym->type == GO_UPROBE) {
-		resolve_func_ret_addr(uprobe_sym);
+		int fd = open(uprobe_sym->binary_path, O_RDONLY);
+		if (fd != -1) {
+			resolve_func_ret_addr(fd, uprobe_sym);
+			close(fd);
+		}
 	}
 
 	return uprobe_sym;
@@ -392,6 +377,362 @@ invalid:
 	return NULL;
 }
 
+/*
+ * ELF symbol index
+ *
+ * The Go tracer probes dozens of symbols in each binary, and the same
+ * binary is usually run by many processes. Resolving the symbols one at
+ * a time scans the symbol table and parses the ELF headers once per
+ * symbol and per process. Instead the whole request set is resolved in a
+ * single symbol table pass, with the ELF type, load segments and return
+ * instructions read once, and the result is kept per binary (identified
+ * by device, inode, size and mtime, not by path since the path goes
+ * through /proc/<pid>/root).
+ */
+
+#define ELF_LOAD_SEGS_MAX 16
+
+struct elf_load_seg {
+	uint64_t v_addr;
+	uint64_t mem_sz;
+	uint64_t file_offset;
+};
+
+struct elf_sym_entry {
+	size_t entry;
+	uint64_t size;
+	size_t rets[FUNC_RET_MAX];
+	int rets_count;
+	// Found by GoReSym, only used if the feature matches the process.
+	bool from_goresym;
+};
+
+struct elf_sym_index {
+	dev_t dev;
+	ino_t ino;
+	off_t file_size;
+	time_t mtime;
+	// Request set, the index is only valid for the same symbol table.
+	const struct symbol *syms;
+	int count;
+	int elf_type;
+	bool goresym_done;
+	struct elf_sym_entry *entries;
+	int load_segs_count;
+	struct elf_load_seg load_segs[ELF_LOAD_SEGS_MAX];
+	uint64_t last_used;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct elf_sym_index slots[ELF_SYM_INDEX_CACHE_SIZE];
+	uint64_t tick;
+	struct elf_sym_index_stats stats;
+} elf_sym_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+struct elf_sym_scan {
+	const struct symbol *syms;
+	struct elf_sym_entry *entries;
+	int *name_lens;
+	int count;
+	int pending;
+};
+
+// Same match as find_sym(), in one pass for all the requested names.
+static int elf_sym_scan_cb(const char *symname, uint64_t addr, uint64_t size,
+			   void *payload)
+{
+	struct elf_sym_scan *scan = payload;
+	int i, len = strlen(symname);
+	char *pos;
+
+	for (i = 0; i < scan->count; i++) {
+		if (scan->entries[i].entry != 0 || len < scan->name_lens[i])
+			continue;
+		if (symname[len - 1] !=
+		    scan->syms[i].symbol[scan->name_lens[i] - 1])
+			continue;
+		pos = strstr(symname, scan->syms[i].symbol);
+		if (pos == NULL || pos[scan->name_lens[i]] != '\0')
+			continue;
+		scan->entries[i].entry = addr;
+		scan->entries[i].size = size;
+		if (--scan->pending == 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int elf_load_seg_cb(uint64_t v_addr, uint64_t mem_sz,
+			   uint64_t file_offset, void *payload)
+{
+	struct elf_sym_index *idx = payload;
+
+	if (idx->load_segs_count >= ELF_LOAD_SEGS_MAX)
+		return -1;
+
+	idx->load_segs[idx->load_segs_count++] = (struct elf_load_seg) {
+		.v_addr = v_addr,
+		.mem_sz = mem_sz,
+		.file_offset = file_offset,
+	};
+
+	return 0;
+}
+
+/*
+ * Convert a virtual address to the file offset for the executable binary
+ * files (ET_EXEC), see resolve_and_gen_uprobe_symbol(). Returns 0 if the
+ * address is not in a load segment.
+ */
+static size_t elf_sym_index_file_addr(struct elf_sym_index *idx, int i)
+{
+	size_t addr = idx->entries[i].entry;
+	struct elf_load_seg *seg;
+	int j;
+
+	if (idx->elf_type != ET_EXEC || strstr(idx->syms[i].symbol, "go.itab.*"))
+		return addr;
+
+	for (j = 0; j < idx->load_segs_count; j++) {
+		seg = &idx->load_segs[j];
+		if (addr >= seg->v_addr && addr < seg->v_addr + seg->mem_sz)
+			return addr - seg->v_addr + seg->file_offset;
+	}
+
+	return 0;
+}
+
+/*
+ * Resolve the entries found by the last lookup (symbol table or GoReSym):
+ * file offsets and return instructions.
+ */
+static void elf_sym_index_finish(struct elf_sym_index *idx, const char *path,
+				 bool goresym)
+{
+	struct symbol_uprobe tmp;
+	struct elf_sym_entry *e;
+	int i, fd;
+
+	fd = open(path, O_RDONLY);
+	for (i = 0; i < idx->count; i++) {
+		e = &idx->entries[i];
+		if (e->entry == 0 || e->from_goresym != goresym)
+			continue;
+		e->entry = elf_sym_index_file_addr(idx, i);
+		if (e->entry == 0 || fd == -1 || !idx->syms[i].is_probe_ret ||
+		    idx->syms[i].type != GO_UPROBE)
+			continue;
+		memset(&tmp, 0, sizeof(tmp));
+		tmp.entry = e->entry;
+		tmp.size = e->size;
+		resolve_func_ret_addr(fd, &tmp);
+		memcpy(e->rets, tmp.rets, sizeof(e->rets));
+		e->rets_count = tmp.rets_count;
+	}
+
+	if (fd != -1)
+		close(fd);
+}
+
+static void elf_sym_index_build(struct elf_sym_index *idx, const char *path)
+{
+	int name_lens[idx->count];
+	struct elf_sym_scan scan = {
+		.syms = idx->syms,
+		.entries = idx->entries,
+		.name_lens = name_lens,
+		.count = idx->count,
+		.pending = idx->count,
+	};
+	int i;
+
+	for (i = 0; i < idx->count; i++)
+		name_lens[i] = strlen(idx->syms[i].symbol);
+
+	/*
+	 * A binary without symbol table is still indexed, the symbols may
+	 * be found by GoReSym.
+	 */
+	bcc_elf_foreach_sym(path, elf_sym_scan_cb, &default_option, &scan);
+
+	idx->elf_type = bcc_elf_get_type(path);
+	if (idx->elf_type == ET_EXEC &&
+	    bcc_elf_foreach_load_section(path, elf_load_seg_cb, idx) < 0)
+		idx->load_segs_count = 0;
+
+	elf_sym_index_finish(idx, path, false);
+}
+
+static void elf_sym_index_goresym(struct elf_sym_index *idx, const char *path)
+{
+	struct function_address_return func;
+	struct elf_sym_entry *e;
+	int i;
+
+	for (i = 0; i < idx->count; i++) {
+		e = &idx->entries[i];
+		if (e->entry != 0)
+			continue;
+		func = function_address((char *)path,
+					(char *)idx->syms[i].symbol);
+		e->entry = func.r0;
+		e->size = func.r1;
+		e->from_goresym = true;
+	}
+
+	elf_sym_index_finish(idx, path, true);
+	idx->goresym_done = true;
+}
+
+static struct elf_sym_index *elf_sym_index_get(const char *path,
+					       struct stat *st,
+					       const struct symbol *syms,
+					       int count)
+{
+	struct elf_sym_index *idx, *victim = NULL;
+	int i;
+
+	for (i = 0; i < ELF_SYM_INDEX_CACHE_SIZE; i++) {
+		idx = &elf_sym_cache.slots[i];
+		if (idx->entries && idx->dev == st->st_dev &&
+		    idx->ino == st->st_ino && idx->file_size == st->st_size &&
+		    idx->mtime == st->st_mtime && idx->syms == syms &&
+		    idx->count == count) {
+			idx->last_used = ++elf_sym_cache.tick;
+			elf_sym_cache.stats.hits++;
+			return idx;
+		}
+
+		if (victim == NULL || victim->last_used > idx->last_used)
+			victim = idx;
+	}
+
+	idx = victim;
+	free(idx->entries);
+	memset(idx, 0, sizeof(*idx));
+	idx->entries = calloc(count, sizeof(struct elf_sym_entry));
+	if (idx->entries == NULL)
+		return NULL;
+
+	idx->syms = syms;
+	idx->count = count;
+	elf_sym_index_build(idx, path);
+	idx->dev = st->st_dev;
+	idx->ino = st->st_ino;
+	idx->file_size = st->st_size;
+	idx->mtime = st->st_mtime;
+	idx->last_used = ++elf_sym_cache.tick;
+	elf_sym_cache.stats.builds++;
+	return idx;
+}
+
+static struct symbol_uprobe *gen_uprobe_symbol(const char *path,
+					       const struct symbol *sym,
+					       struct elf_sym_entry *e, int pid)
+{
+	struct symbol_uprobe *uprobe_sym =
+	    calloc(1, sizeof(struct symbol_uprobe));
+	if (uprobe_sym == NULL) {
+		ebpf_warning("uprobe_sym = calloc() failed.\n");
+		return NULL;
+	}
+
+	uprobe_sym->type = sym->type;
+	uprobe_sym->isret = sym->is_probe_ret;
+	uprobe_sym->pid = pid;
+	uprobe_sym->entry = e->entry;
+	uprobe_sym->size = e->size;
+	memcpy(uprobe_sym->rets, e->rets, sizeof(uprobe_sym->rets));
+	uprobe_sym->rets_count = e->rets_count;
+	uprobe_sym->probe_func = strdup(sym->probe_func);
+	uprobe_sym->binary_path = strdup(path);
+	uprobe_sym->name = strdup(sym->symbol);
+	if (uprobe_sym->probe_func == NULL || uprobe_sym->binary_path == NULL ||
+	    uprobe_sym->name == NULL) {
+		ebpf_warning("strdup() failed.\n");
+		free_uprobe_symbol(uprobe_sym, NULL);
+		return NULL;
+	}
+
+	return uprobe_sym;
+}
+
+int resolve_and_gen_uprobe_symbols(const char *bin_file,
+				   const struct symbol *syms, int count,
+				   int pid, struct symbol_uprobe **u_syms)
+{
+	struct elf_sym_index *idx;
+	struct elf_sym_entry *e;
+	struct stat st;
+	char *path;
+	bool goresym;
+	uint64_t start, cost;
+	int i, resolved = 0;
+
+	if (bin_file == NULL || syms == NULL || count <= 0)
+		return 0;
+
+	memset(u_syms, 0, count * sizeof(*u_syms));
+	start = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+
+	if (strchr(bin_file, '/'))
+		path = strdup(bin_file);
+	else
+		path = bcc_procutils_which_so(bin_file, pid);
+
+	if (path == NULL) {
+		ebpf_warning("Binary %s of pid %d not found.\n", bin_file, pid);
+		return 0;
+	}
+
+	if (stat(path, &st) != 0) {
+		ebpf_warning("stat(%s) failed, %s\n", path, strerror(errno));
+		free(path);
+		return 0;
+	}
+
+	goresym = is_feature_matched(FEATURE_UPROBE_GOLANG_SYMBOL, pid, path);
+
+	pthread_mutex_lock(&elf_sym_cache.lock);
+	idx = elf_sym_index_get(path, &st, syms, count);
+	if (idx == NULL)
+		goto unlock;
+
+	if (goresym && !idx->goresym_done)
+		elf_sym_index_goresym(idx, path);
+
+	for (i = 0; i < count; i++) {
+		e = &idx->entries[i];
+		if (e->entry == 0 || (e->from_goresym && !goresym))
+			continue;
+		u_syms[i] = gen_uprobe_symbol(path, &syms[i], e, pid);
+		if (u_syms[i])
+			resolved++;
+	}
+
+unlock:
+	cost = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) - start;
+	elf_sym_cache.stats.resolve_time_ns += cost;
+	elf_sym_cache.stats.requests++;
+	pthread_mutex_unlock(&elf_sym_cache.lock);
+
+	ebpf_info("Resolved %d/%d symbols of %s (pid %d) in %lu us.\n",
+		  resolved, count, path, pid, cost / 1000);
+	free(path);
+	return resolved;
+}
+
+void get_elf_sym_index_stats(struct elf_sym_index_stats *stats)
+{
+	pthread_mutex_lock(&elf_sym_cache.lock);
+	*stats = elf_sym_cache.stats;
+	pthread_mutex_unlock(&elf_sym_cache.lock);
+}
+
 char *get_elf_path_by_pid(int pid)
 {
 #define PROC_PREFIX_LEN 32
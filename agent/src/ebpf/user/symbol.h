@@ -102,6 +102,26 @@ struct symbol_uprobe *resolve_and_gen_uprobe_symbol(const char *bin_file,
 						    struct symbol *sym,
 						    const uint64_t addr,
 						    int pid);
+/*
+ * Resolve a set of symbols of one binary at once, the ELF symbol table is
+ * scanned once and the result is kept per binary (see ELF symbol index in
+ * symbol.c), 'syms' must be a static table.
+ *
+ * u_syms[i] is set to the symbol_uprobe of syms[i], or NULL if it is not
+ * found. Returns the number of symbols resolved.
+ */
+int resolve_and_gen_uprobe_symbols(const char *bin_file,
+				   const struct symbol *syms, int count,
+				   int pid, struct symbol_uprobe **u_syms);
+
+struct elf_sym_index_stats {
+	uint64_t requests;	// resolve_and_gen_uprobe_symbols() calls
+	uint64_t builds;	// binaries indexed
+	uint64_t hits;		// binaries found in the index
+	uint64_t resolve_time_ns;	// total time spent resolving
+};
+
+void get_elf_sym_index_stats(struct elf_sym_index_stats *stats);
 uint64_t get_symbol_addr_from_binary(int pid, const char *bin,
 				     const char *symname);
 int find_load(uint64_t v_addr, uint64_t mem_sz, uint64_t file_offset,
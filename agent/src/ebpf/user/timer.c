@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include "types.h"
+#include "utils.h"
+#include "log.h"
+#include "timer.h"
+
+#define TIMER_WHEEL_SLOTS_MASK	(TIMER_WHEEL_SLOTS - 1)
+
+static inline u64 timer_monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * NS_IN_SEC + ts.tv_nsec;
+}
+
+u64 timer_wheel_now_tick(struct timer_wheel *w)
+{
+	return (timer_monotonic_ns() - w->start_ns) / w->tick_ns;
+}
+
+static void timer_job_run(struct timer_job *job)
+{
+	u64 start = timer_monotonic_ns();
+	u64 latency_us = start > job->due_ns ? (start - job->due_ns) / 1000 : 0;
+
+	job->f();
+
+	u64 exec_us = (timer_monotonic_ns() - start) / 1000;
+	job->run_count++;
+	job->latency_sum_us += latency_us;
+	if (latency_us > job->latency_max_us)
+		job->latency_max_us = latency_us;
+	job->exec_sum_us += exec_us;
+	if (exec_us > job->exec_max_us)
+		job->exec_max_us = exec_us;
+}
+
+static void *timer_worker_main(void *arg)
+{
+	struct timer_worker *wk = arg;
+	struct timer_job *job;
+	char name[16];
+
+	snprintf(name, sizeof(name), "timer-worker-%d", wk->index);
+	prctl(PR_SET_NAME, name);
+	if (wk->wheel->worker_init)
+		wk->wheel->worker_init(wk->index);
+
+	for (;;) {
+		pthread_mutex_lock(&wk->lock);
+		while (list_empty(&wk->queue))
+			pthread_cond_wait(&wk->cond, &wk->lock);
+		job = list_first_entry(&wk->queue, struct timer_job, queue);
+		list_head_del(&job->queue);
+		pthread_mutex_unlock(&wk->lock);
+
+		timer_job_run(job);
+
+		pthread_mutex_lock(&wk->lock);
+		job->busy = false;
+		pthread_mutex_unlock(&wk->lock);
+	}
+
+	return NULL;
+}
+
+int timer_wheel_init(struct timer_wheel *w, u64 tick_us, int nr_workers,
+		     timer_worker_init_fun_t worker_init)
+{
+	int i;
+
+	memset(w, 0, sizeof(*w));
+	for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		init_list_head(&w->slots[i]);
+	init_list_head(&w->jobs);
+	pthread_mutex_init(&w->lock, NULL);
+	w->tick_ns = tick_us * 1000;
+	w->start_ns = timer_monotonic_ns();
+	w->worker_init = worker_init;
+
+	w->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (w->timerfd < 0) {
+		ebpf_warning("timerfd_create() failed, errno %d, fall back "
+			     "to sleeping every tick.\n", errno);
+	}
+
+	if (nr_workers <= 0)
+		return ETR_OK;
+
+	w->workers = calloc(nr_workers, sizeof(struct timer_worker));
+	if (w->workers == NULL) {
+		ebpf_warning("calloc() failed, no memory.\n");
+		return ETR_NOMEM;
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		struct timer_worker *wk = &w->workers[i];
+		pthread_mutex_init(&wk->lock, NULL);
+		pthread_cond_init(&wk->cond, NULL);
+		init_list_head(&wk->queue);
+		wk->wheel = w;
+		wk->index = i;
+		if (pthread_create(&wk->thread, NULL, timer_worker_main, wk)) {
+			ebpf_warning("pthread_create() failed, errno %d\n",
+				     errno);
+			break;
+		}
+		w->nr_workers++;
+	}
+
+	return w->nr_workers == nr_workers ? ETR_OK : ETR_INVAL;
+}
+
+// Wake up the timer thread so that it recomputes the next expiration.
+static inline void timer_wheel_kick(struct timer_wheel *w)
+{
+	if (w->timerfd < 0)
+		return;
+
+	struct itimerspec its = { 0 };
+	its.it_value.tv_nsec = 1;
+	timerfd_settime(w->timerfd, 0, &its, NULL);
+}
+
+int timer_wheel_add_job(struct timer_wheel *w, const char *name,
+			timer_job_fun_t f, u64 period, int worker)
+{
+	struct timer_job *job = calloc(1, sizeof(struct timer_job));
+	if (job == NULL) {
+		ebpf_warning("calloc() failed, no memory.\n");
+		return ETR_NOMEM;
+	}
+
+	snprintf(job->name, sizeof(job->name), "%s", name);
+	job->f = f;
+	job->period = period > 0 ? period : 1;
+	job->is_valid = true;
+	init_list_head(&job->queue);
+	if (worker < 0 || w->nr_workers == 0)
+		job->worker = TIMER_JOB_INLINE;
+	else
+		job->worker = worker % w->nr_workers;
+
+	pthread_mutex_lock(&w->lock);
+	job->expire = timer_wheel_now_tick(w) + job->period;
+	if (job->expire <= w->cur_tick)
+		job->expire = w->cur_tick + 1;
+	list_add_tail(&job->list,
+		      &w->slots[job->expire & TIMER_WHEEL_SLOTS_MASK]);
+	list_add_tail(&job->all, &w->jobs);
+	timer_wheel_kick(w);
+	pthread_mutex_unlock(&w->lock);
+
+	return ETR_OK;
+}
+
+int timer_wheel_set_job_invalid(struct timer_wheel *w, const char *name)
+{
+	struct timer_job *job;
+	int ret = ETR_INVAL;
+
+	pthread_mutex_lock(&w->lock);
+	list_for_each_entry(job, &w->jobs, all) {
+		if (strcmp(job->name, name) == 0) {
+			job->is_valid = false;
+			ret = ETR_OK;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return ret;
+}
+
+/*
+ * Hand the expired job over to its worker. If the previous run has not
+ * finished yet, this run is skipped and counted as an overrun.
+ */
+static void timer_job_dispatch(struct timer_wheel *w, struct timer_job *job,
+			       struct list_head *inline_jobs)
+{
+	u64 due_ns = w->start_ns + job->expire * w->tick_ns;
+
+	if (job->worker == TIMER_JOB_INLINE) {
+		job->due_ns = due_ns;
+		list_add_tail(&job->queue, inline_jobs);
+		return;
+	}
+
+	struct timer_worker *wk = &w->workers[job->worker];
+	pthread_mutex_lock(&wk->lock);
+	if (job->busy) {
+		job->overrun_count++;
+	} else {
+		job->busy = true;
+		job->due_ns = due_ns;
+		list_add_tail(&job->queue, &wk->queue);
+		pthread_cond_signal(&wk->cond);
+	}
+	pthread_mutex_unlock(&wk->lock);
+}
+
+static void timer_job_reschedule(struct timer_wheel *w, struct timer_job *job,
+				 u64 now)
+{
+	u64 next = job->expire + job->period;
+
+	/* The timer thread fell behind, skip the runs that were missed. */
+	if (next <= now) {
+		u64 missed = (now - job->expire) / job->period;
+		job->overrun_count += missed;
+		next = job->expire + (missed + 1) * job->period;
+	}
+
+	job->expire = next;
+	list_add_tail(&job->list, &w->slots[next & TIMER_WHEEL_SLOTS_MASK]);
+}
+
+static u64 __timer_wheel_next_tick(struct timer_wheel *w)
+{
+	struct timer_job *job;
+	u64 next = w->cur_tick + TIMER_WHEEL_SLOTS;
+
+	list_for_each_entry(job, &w->jobs, all) {
+		if (job->expire < next)
+			next = job->expire;
+	}
+
+	return next;
+}
+
+u64 timer_wheel_expire(struct timer_wheel *w, u64 now)
+{
+	struct list_head inline_jobs;
+	struct timer_job *job, *n;
+	u64 t, next;
+
+	init_list_head(&inline_jobs);
+	pthread_mutex_lock(&w->lock);
+	if (now > w->cur_tick) {
+		t = w->cur_tick + 1;
+		/* Each slot needs to be visited only once. */
+		if (now - w->cur_tick > TIMER_WHEEL_SLOTS)
+			t = now - TIMER_WHEEL_SLOTS + 1;
+
+		for (; t <= now; t++) {
+			struct list_head *slot;
+			slot = &w->slots[t & TIMER_WHEEL_SLOTS_MASK];
+			list_for_each_entry_safe(job, n, slot, list) {
+				if (job->expire > now)
+					continue;
+
+				list_head_del(&job->list);
+				if (job->is_valid)
+					timer_job_dispatch(w, job,
+							   &inline_jobs);
+				timer_job_reschedule(w, job, now);
+			}
+		}
+		w->cur_tick = now;
+	}
+	next = __timer_wheel_next_tick(w);
+	pthread_mutex_unlock(&w->lock);
+
+	/*
+	 * Inline jobs run without holding the wheel lock, so that jobs
+	 * can be registered from the job functions.
+	 */
+	list_for_each_entry_safe(job, n, &inline_jobs, queue) {
+		list_head_del(&job->queue);
+		timer_job_run(job);
+	}
+
+	return next;
+}
+
+static void timer_wheel_wait(struct timer_wheel *w)
+{
+	u64 next, expirations;
+
+	if (w->timerfd < 0) {
+		usleep(w->tick_ns / 1000);
+		return;
+	}
+
+	/*
+	 * Arm the timer with the lock held, a job registered afterwards
+	 * kicks the timer and is taken into account on the next wakeup.
+	 */
+	pthread_mutex_lock(&w->lock);
+	next = __timer_wheel_next_tick(w);
+	u64 deadline = w->start_ns + next * w->tick_ns;
+	struct itimerspec its = { 0 };
+	its.it_value.tv_sec = deadline / NS_IN_SEC;
+	its.it_value.tv_nsec = deadline % NS_IN_SEC;
+	if (timerfd_settime(w->timerfd, TFD_TIMER_ABSTIME, &its, NULL)) {
+		pthread_mutex_unlock(&w->lock);
+		usleep(w->tick_ns / 1000);
+		return;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	if (read(w->timerfd, &expirations, sizeof(expirations)) < 0
+	    && errno != EINTR) {
+		usleep(w->tick_ns / 1000);
+	}
+}
+
+void timer_wheel_run(struct timer_wheel *w)
+{
+	for (;;) {
+		timer_wheel_expire(w, timer_wheel_now_tick(w));
+		timer_wheel_wait(w);
+		w->wakeup_count++;
+	}
+}
+
+void timer_wheel_show_stats(struct timer_wheel *w)
+{
+	struct timer_job *job;
+
+	pthread_mutex_lock(&w->lock);
+	ebpf_info("timer wheel: tick %lu wakeups %lu workers %d\n",
+		  w->cur_tick, w->wakeup_count, w->nr_workers);
+	list_for_each_entry(job, &w->jobs, all) {
+		u64 runs = job->run_count > 0 ? job->run_count : 1;
+		ebpf_info(" - %-24s period %lu worker %d valid %d runs %lu "
+			  "overruns %lu latency(us) avg %lu max %lu "
+			  "exec(us) avg %lu max %lu\n", job->name, job->period,
+			  job->worker, job->is_valid, job->run_count,
+			  job->overrun_count, job->latency_sum_us / runs,
+			  job->latency_max_us, job->exec_sum_us / runs,
+			  job->exec_max_us);
+	}
+	pthread_mutex_unlock(&w->lock);
+}
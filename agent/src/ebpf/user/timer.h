@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DF_USER_TIMER_H
+#define DF_USER_TIMER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "types.h"
+#include "list.h"
+
+/*
+ * Timer wheel used to run the periodic jobs.
+ *
+ * Jobs are hashed into TIMER_WHEEL_SLOTS slots by their expiration tick,
+ * a job whose period is longer than the wheel simply stays in its slot
+ * until the expiration tick is reached. The timer thread sleeps on a
+ * timerfd until the earliest expiration, instead of waking up every tick.
+ *
+ * A job runs either on the timer thread (worker < 0), or on one of the
+ * timer workers. Jobs bound to the same worker never run concurrently.
+ */
+
+#define TIMER_WHEEL_SLOTS	256	// Must be a power of 2
+#define TIMER_JOB_NAME_LEN	64
+#define TIMER_JOB_INLINE	(-1)
+
+typedef int (*timer_job_fun_t) (void);
+
+struct timer_wheel;
+
+struct timer_job {
+	// Linked into a wheel slot
+	struct list_head list;
+	// Linked into timer_wheel->jobs
+	struct list_head all;
+	// Linked into a worker queue
+	struct list_head queue;
+	char name[TIMER_JOB_NAME_LEN];
+	timer_job_fun_t f;
+	// Period in ticks
+	u64 period;
+	// The tick at which the job expires next time
+	u64 expire;
+	// Worker index, or TIMER_JOB_INLINE
+	int worker;
+	bool is_valid;
+	// Queued or running on a worker, protected by the worker lock.
+	bool busy;
+	// Monotonic time (ns) at which the current run was due.
+	u64 due_ns;
+
+	/* statistics */
+	u64 run_count;
+	// Runs skipped because the previous run was still in progress or
+	// the timer thread fell behind.
+	u64 overrun_count;
+	// Delay between the due time and the start of the run.
+	u64 latency_max_us;
+	u64 latency_sum_us;
+	// Execution time of the job function.
+	u64 exec_max_us;
+	u64 exec_sum_us;
+};
+
+struct timer_worker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct list_head queue;
+	struct timer_wheel *wheel;
+	int index;
+};
+
+// Called at the start of each worker thread.
+typedef void (*timer_worker_init_fun_t) (int index);
+
+struct timer_wheel {
+	struct list_head slots[TIMER_WHEEL_SLOTS];
+	// All the registered jobs
+	struct list_head jobs;
+	// Protects the slots and the job list.
+	pthread_mutex_t lock;
+	u64 tick_ns;
+	// Monotonic time of tick 0
+	u64 start_ns;
+	// Last tick processed
+	u64 cur_tick;
+	int timerfd;
+	int nr_workers;
+	struct timer_worker *workers;
+	timer_worker_init_fun_t worker_init;
+
+	/* statistics */
+	u64 wakeup_count;
+};
+
+int timer_wheel_init(struct timer_wheel *w, u64 tick_us, int nr_workers,
+		     timer_worker_init_fun_t worker_init);
+/*
+ * Register a job which runs every 'period' ticks, the first run is one
+ * period after the registration.
+ */
+int timer_wheel_add_job(struct timer_wheel *w, const char *name,
+			timer_job_fun_t f, u64 period, int worker);
+int timer_wheel_set_job_invalid(struct timer_wheel *w, const char *name);
+u64 timer_wheel_now_tick(struct timer_wheel *w);
+/*
+ * Run the jobs expired up to tick 'now', returns the next expiration
+ * tick (or 'now' + TIMER_WHEEL_SLOTS when there are no jobs).
+ */
+u64 timer_wheel_expire(struct timer_wheel *w, u64 now);
+// Timer thread main loop, never returns.
+void timer_wheel_run(struct timer_wheel *w);
+void timer_wheel_show_stats(struct timer_wheel *w);
+
+#endif /* DF_USER_TIMER_H */
@@ -39,9 +39,11 @@
 #include "symbol.h"
 #include "bihash_8_8.h"
 #include "tracer.h"
+#include "timer.h"
 #include "elf.h"
 #include "load.h"
 #include "mem.h"
+#include "mem_governor.h"
 #include "socket.h"
 #include "unwind_tracer.h"
 #include "extended/extended.h"
@@ -89,6 +91,8 @@ bool allow_seg_reasm_protos[PROTO_NUM];
 
 struct kprobe_port_bitmap allow_port_bitmap;
 struct kprobe_port_bitmap bypass_port_bitmap;
+// Sockets on these ports push only the metadata after their first messages.
+struct kprobe_port_bitmap metadata_port_bitmap;
 
 uint64_t adapt_kern_uid;	// Indicates the identifier of the adaptation kernel
 
@@ -114,7 +118,7 @@ static volatile int ready_flag_cpus[MAX_CPU_NR];
 /* Registration of additional transactions 额外事务处理的注册 */
 static struct list_head extra_waiting_head;
 /* Registration for periodic event handling 周期性事件处理的注册 */
-static struct list_head period_events_head;
+static struct timer_wheel period_timer;
 
 int sys_cpus_count;
 bool *cpu_online;		// 用于判断CPU是否是online
@@ -128,9 +132,6 @@ struct thread_index_array thread_ids;
 // Record the current maximum thread index value.
 u64 thread_index_max;
 
-// Number of period timer ticks.
-static uint64_t period_event_ticks;
-
 // Store the data of the last matched process ID list.
 struct match_pid_s {
 	int *pids;
@@ -247,6 +248,8 @@ static void free_bpf_tracer(struct bpf_tracer *t)
 {
 	ASSERT(tracers_lock[0]);
 
+	if (t->stats.shards)
+		clib_mem_free(t->stats.shards);
 	memset((void *)t, 0, sizeof(*t));
 	tracers_count--;
 }
@@ -283,6 +286,30 @@ int release_bpf_tracer(const char *name)
 	return ETR_OK;
 }
 
+int tracer_stats_init(struct bpf_tracer *t, int count)
+{
+	struct tracer_stats_shard *shards;
+	uword size = 2 * count * sizeof(*shards);
+
+	if (t->stats.shards)
+		return ETR_OK;
+
+	// The shards and their bases.
+	shards = clib_mem_alloc_aligned("tracer_stats", size,
+					CLIB_CACHE_LINE_BYTES, NULL);
+	if (shards == NULL) {
+		ebpf_warning("Tracer '%s' statistics alloc failed.\n",
+			     t->name);
+		return ETR_NOMEM;
+	}
+
+	memset(shards, 0, size);
+	t->stats.base = shards + count;
+	t->stats.count = count;
+	t->stats.shards = shards;
+	return ETR_OK;
+}
+
 /**
  * @brief Activate a tracer reader to start working.
  *
@@ -378,14 +405,6 @@ struct bpf_tracer *setup_bpf_tracer(const char *name,
 	bt->name[sizeof(bt->name) - 1] = '\0';
 	atomic64_init(&bt->recv);
 	atomic64_init(&bt->lost);
-	atomic64_init(&bt->rx_pkts);
-	atomic64_init(&bt->tx_pkts);
-	atomic64_init(&bt->rx_bytes);
-	atomic64_init(&bt->tx_bytes);
-	atomic64_init(&bt->dropped_pkts);
-	int i;
-	for (i = 0; i < PROTO_NUM; i++)
-		atomic64_init(&bt->proto_stats[i]);
 
 	snprintf(bt->bpf_load_name, sizeof(bt->bpf_load_name), "%s", load_name);
 	bt->bpf_load_name[sizeof(bt->bpf_load_name) - 1] = '\0';
@@ -420,6 +439,12 @@ struct bpf_tracer *setup_bpf_tracer(const char *name,
 	}
 	bt->lock[0] = 0;
 
+	if (workers_nr > 0 && tracer_stats_init(bt, workers_nr) != ETR_OK) {
+		free_bpf_tracer(bt);
+		tracers_ctl_unlock();
+		return NULL;
+	}
+
 	/*
 	 * Execute the create tracer callback function.
 	 */
@@ -1534,54 +1559,51 @@ static void ctrl_main(__unused void *arg)
 	/* return NULL; */
 }
 
-// Periodic event handling
-static void period_events_process(void)
+// Each timer worker has its own thread index (used by bihash).
+static void period_worker_init(int index)
 {
-	period_event_ticks++;
-	struct period_event_op *peo;
-	list_for_each_entry(peo, &period_events_head, list) {
-		if (peo->is_valid) {
-			if ((period_event_ticks % peo->times) == 0) {
-				peo->f();
-			}
-		}
-	}
+	thread_index = THREAD_PERIOD_WORKER_IDX_BASE + index;
+	ebpf_info("period worker %d thread index %ld\n", index, thread_index);
 }
 
-static struct period_event_op *find_period_event(const char *name)
+static int period_jobs_stats_show(void)
 {
-	struct period_event_op *peo = NULL;
-	list_for_each_entry(peo, &period_events_head, list) {
-		if (strcmp(peo->name, name) == 0)
-			return peo;
-	}
-
-	return NULL;
+	timer_wheel_show_stats(&period_timer);
+	return ETR_OK;
 }
 
 /*
  * Register for periodic execution events.
  * @name event name
  * @f Event execution callback interface
- * @period_time The event execution cycle time, unit is milliseconds
+ * @period_time The event execution cycle time, unit is ticks
+ *   (EVENT_TIMER_TICK_US)
  * 
+ * The event is executed on the period timer thread, it must not block.
+ *
  * @return
  *    ETR_OK(0) on success, < 0 on error 
  */
 int register_period_event_op(const char *name,
 			     period_event_fun_t f, uint32_t period_time)
 {
-	struct period_event_op *peo = malloc(sizeof(struct period_event_op));
-	if (!peo) {
-		ebpf_warning("malloc() failed, no memory.\n");
-		return -ENOMEM;
-	}
+	return register_period_worker_op(name, f, period_time,
+					 TIMER_JOB_INLINE);
+}
 
-	peo->f = f;
-	peo->is_valid = true;
-	peo->times = period_time;
-	snprintf(peo->name, sizeof(peo->name), "%s", name);
-	list_add_tail(&peo->list, &period_events_head);
+/*
+ * Same as register_period_event_op(), but the event is executed on the
+ * period worker 'worker' (0 ~ PERIOD_WORKERS_NUM - 1). Events bound to
+ * the same worker never run concurrently, and an event is skipped if its
+ * previous run is still in progress.
+ */
+int register_period_worker_op(const char *name, period_event_fun_t f,
+			      uint32_t period_time, int worker)
+{
+	int ret = timer_wheel_add_job(&period_timer, name, f, period_time,
+				      worker);
+	if (ret != ETR_OK)
+		return ret;
 
 	ebpf_info("%s '%s' succeed.\n", __func__, name);
 
@@ -1590,12 +1612,9 @@ int register_period_event_op(const char *name,
 
 int set_period_event_invalid(const char *name)
 {
-	struct period_event_op *peo = find_period_event(name);
-	if (peo == NULL)
+	if (timer_wheel_set_job_invalid(&period_timer, name) != ETR_OK)
 		return ETR_INVAL;
 
-	peo->is_valid = false;
-
 	ebpf_info("%s '%s' set invalid succeed.\n", __func__, name);
 
 	return ETR_OK;
@@ -1658,6 +1677,48 @@ int set_kick_kern_nice(int32_t nice)
 	return 0;
 }
 
+/*
+ * Page backing of the hash table arenas created afterwards, see
+ * clib_mem_hugepage_mode_t. Call it before bpf_tracer_init() so that
+ * all the arenas use it.
+ */
+int set_bpf_hugepage_mode(int mode)
+{
+	static const char *mode_str[] = { "default", "transparent", "explicit" };
+
+	if (mode < 0 || mode >= CLIB_MEM_HUGEPAGE_MODE_MAX)
+		return ETR_INVAL;
+
+	clib_mem_set_hugepage_mode(mode);
+	ebpf_info("Set hugepage mode to %s.\n", mode_str[mode]);
+	return 0;
+}
+
+/*
+ * Set the memory budget of the process (RSS) in bytes, 0 disables the
+ * memory governor. The registered shedding actions are applied in
+ * priority order as the usage gets close to the budget.
+ */
+int set_bpf_memory_budget(uint64_t bytes)
+{
+	mem_governor_set_budget(bytes);
+	return 0;
+}
+
+/*
+ * Change the priority of a shedding action, lower values are shed first.
+ * The action names are "symbol-cache", "stack-str", "profiler-freq" and
+ * "socket-data".
+ */
+int set_bpf_memory_shed_priority(const char *name, int priority)
+{
+	int ret = mem_governor_set_priority(name, priority);
+	if (ret == ETR_OK)
+		ebpf_info("Set memory shedding action '%s' priority %d.\n",
+			  name, priority);
+	return ret;
+}
+
 static void *kick_kern_push_data(void *arg)
 {
 	int cpu_id = (int)((uintptr_t) arg);	// Extract CPU ID from the argument
@@ -1821,10 +1882,8 @@ static void period_process_main(__unused void *arg)
 
 	memset((void *)ready_flag_cpus, 1, sizeof(ready_flag_cpus));
 
-	for (;;) {
-		period_events_process();
-		usleep(EVENT_TIMER_TICK_US);
-	}
+	/* Sleep until the next event is due, then run the expired events. */
+	timer_wheel_run(&period_timer);
 }
 
 int maps_config(struct bpf_tracer *tracer, const char *map_name, int entries)
@@ -1882,22 +1941,28 @@ static int tracer_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
 		 * tracer, and readers[0]'s page count can be reported here.
 		 */
 		btp->perf_pg_cnt = t->readers[0].perf_pages_cnt;
-		btp->lost = atomic64_read(&t->lost);
+		btp->lost = atomic64_read(&t->lost) +
+		    tracer_stats_sum(&t->stats, lost, false);
 		btp->probes_count = t->probes_count;
 		btp->state = t->state;
 		btp->adapt_success = t->adapt_success;
 		btp->data_limit_max = t->data_limit_max;
 
 		for (j = 0; j < PROTO_NUM; j++) {
-			btp->proto_stats[j] = atomic64_read(&t->proto_stats[j]);
+			btp->proto_stats[j] =
+			    tracer_stats_sum(&t->stats, proto_stats[j], false);
 		}
 
 		for (j = 0; j < btp->dispatch_workers_nr; j++) {
 			rx_q = (struct rx_queue_info *)&btp->rx_queues[j];
-			rx_q->enqueue_lost =
-			    atomic64_read(&t->queues[j].enqueue_lost);
-			rx_q->enqueue_nr =
-			    atomic64_read(&t->queues[j].enqueue_nr);
+			if (j < t->stats.count) {
+				rx_q->enqueue_lost =
+				    tracer_stats_fetch(&t->stats, j,
+						       enqueue_lost, false);
+				rx_q->enqueue_nr =
+				    tracer_stats_fetch(&t->stats, j,
+						       enqueue_nr, false);
+			}
 			rx_q->burst_count =
 			    atomic64_read(&t->queues[j].burst_count);
 			rx_q->dequeue_nr =
@@ -1939,6 +2004,63 @@ static struct tracer_sockopts match_pids_sockopts = {
 	.set = match_pids_sockopt_set,
 };
 
+static int memstat_sockopt_get(sockoptid_t opt, const void *conf,
+			       size_t size, void **out, size_t * outsize)
+{
+	struct mem_tag_stat_array *array;
+
+	if (opt == SOCKOPT_GET_MEMGOV_SHOW) {
+		struct mem_governor_stat *stat;
+		*outsize = sizeof(*stat) +
+		    sizeof(struct mem_shed_stat) * MEM_GOVERNOR_ACTIONS_MAX;
+		*out = calloc(1, *outsize);
+		if (*out == NULL) {
+			ebpf_info("%s calloc, error:%s\n", __func__,
+				  strerror(errno));
+			return ETR_INVAL;
+		}
+
+		stat = *out;
+		mem_governor_stats(stat);
+		*outsize = sizeof(*stat) +
+		    sizeof(struct mem_shed_stat) * stat->count;
+		return ETR_OK;
+	}
+	*outsize = sizeof(*array) +
+	    sizeof(struct mem_tag_stat) * CLIB_MEM_TAGS_MAX;
+
+	*out = calloc(1, *outsize);
+	if (*out == NULL) {
+		ebpf_info("%s calloc, error:%s\n", __func__, strerror(errno));
+		return ETR_INVAL;
+	}
+
+	array = *out;
+	array->count = clib_mem_tag_stats(array->stats);
+	*outsize = sizeof(*array) +
+	    sizeof(struct mem_tag_stat) * array->count;
+
+	return ETR_OK;
+}
+
+static struct tracer_sockopts memstat_sockopts = {
+	.version = SOCKOPT_VERSION,
+	.set = NULL,
+	.get_opt_min = SOCKOPT_GET_MEMSTAT_SHOW,
+	.get_opt_max = SOCKOPT_GET_MEMGOV_SHOW,
+	.get = memstat_sockopt_get,
+};
+
+/*
+ * The high-watermarks are updated when the counters are merged, merge
+ * them periodically so that short peaks are not missed.
+ */
+static int mem_tag_watermark_update(void)
+{
+	clib_mem_tag_stats(NULL);
+	return 0;
+}
+
 int enable_ebpf_protocol(int protocol)
 {
 	if (protocol < PROTO_NUM) {
@@ -1969,6 +2091,12 @@ int set_bypass_port_bitmap(void *bitmap)
 	return 0;
 }
 
+int set_metadata_port_bitmap(void *bitmap)
+{
+	memcpy(&metadata_port_bitmap, bitmap, sizeof(metadata_port_bitmap));
+	return 0;
+}
+
 int set_feature_regex(int feature, const char *pattern)
 {
 	if (feature < 0 || feature >= FEATURE_MAX) {
@@ -2304,7 +2432,9 @@ static int ebpf_tools_install(void)
 int bpf_tracer_init(const char *log_file, bool is_stdout)
 {
 	init_list_head(&extra_waiting_head);
-	init_list_head(&period_events_head);
+	if (timer_wheel_init(&period_timer, EVENT_TIMER_TICK_US,
+			     PERIOD_WORKERS_NUM, period_worker_init))
+		return ETR_INVAL;
 
 	log_to_stdout = is_stdout;
 	if (log_file) {
@@ -2403,6 +2533,9 @@ int bpf_tracer_init(const char *log_file, bool is_stdout)
 	if ((err = sockopt_register(&match_pids_sockopts)) != ETR_OK)
 		return err;
 
+	if ((err = sockopt_register(&memstat_sockopts)) != ETR_OK)
+		return err;
+
 	err = pthread_create(&ctrl_pthread, NULL, (void *)&ctrl_main, NULL);
 	if (err) {
 		ebpf_info("<%s> ctrl_pthread, pthread_create is error:%s\n",
@@ -2439,6 +2572,20 @@ int bpf_tracer_init(const char *log_file, bool is_stdout)
 				     SYS_TIME_UPDATE_PERIOD))
 		return ETR_INVAL;
 
+	if (register_period_event_op("period-jobs-stats",
+				     period_jobs_stats_show,
+				     PERIOD_JOBS_STATS_PERIOD))
+		return ETR_INVAL;
+
+	if (register_period_event_op("mem-tag-watermark",
+				     mem_tag_watermark_update,
+				     MEM_TAG_WATERMARK_PERIOD))
+		return ETR_INVAL;
+
+	if (register_period_event_op("mem-governor", mem_governor_check,
+				     MEM_GOVERNOR_CHECK_PERIOD))
+		return ETR_INVAL;
+
 	err =
 	    pthread_create(&cpus_kick_pthread, NULL,
 			   (void *)&period_process_main, NULL);
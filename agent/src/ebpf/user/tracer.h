@@ -34,6 +34,7 @@
 #include <pthread.h>
 #include <time.h>
 #include <string.h>
+#include <stddef.h>
 #include "ring.h"
 #include "ctrl.h"
 #include "atomic.h"
@@ -156,6 +157,7 @@ extern struct cfg_feature_regex cfg_feature_regex_array[FEATURE_MAX];
 extern int ebpf_config_protocol_filter[PROTO_NUM];
 extern struct kprobe_port_bitmap allow_port_bitmap;
 extern struct kprobe_port_bitmap bypass_port_bitmap;
+extern struct kprobe_port_bitmap metadata_port_bitmap;
 extern bool allow_seg_reasm_protos[PROTO_NUM];
 
 /* *INDENT-OFF* */
@@ -275,6 +277,10 @@ enum {
 	SOCKOPT_GET_CPDBG_SHOW,
 
 	SOCKOPT_PRINT_MATCH_PIDS = 800,
+
+	/* get */
+	SOCKOPT_GET_MEMSTAT_SHOW = 900,
+	SOCKOPT_GET_MEMGOV_SHOW,
 };
 
 struct mem_block_head {
@@ -343,10 +349,9 @@ struct queue {
 	pthread_cond_t cond;
 
 	/*
-	 * 各种统计
+	 * 各种统计, the enqueue counters are in the statistics shard of the
+	 * queue (see struct tracer_stats).
 	 */
-	atomic64_t enqueue_lost;
-	atomic64_t enqueue_nr;
 	atomic64_t burst_count;
 	atomic64_t dequeue_nr;
 	atomic64_t heap_get_failed;	// 从heap上获取内存失败的次数统计
@@ -361,6 +366,70 @@ struct map_config {
 	int max_entries;
 };
 
+/*
+ * Socket data path statistics, sharded by reader thread. Reader thread i
+ * is the only producer of queue i and the only writer of shard i, so the
+ * hot path updates its counters without atomic operations and without
+ * sharing cache lines with the other threads. The shards are only added
+ * up when the statistics are read.
+ *
+ * A shard is never written by the statistics readers, a reset records
+ * the current values in 'base' and the following reads subtract them.
+ */
+struct tracer_stats_shard {
+	uint64_t rx_pkts;
+	uint64_t tx_pkts;
+	uint64_t rx_bytes;
+	uint64_t tx_bytes;
+	uint64_t dropped_pkts;
+	uint64_t lost;		// Lost in the kernel, perf buffer full.
+	uint64_t enqueue_nr;
+	uint64_t enqueue_lost;
+	uint64_t proto_stats[PROTO_NUM];	// By l7 protocol.
+} __attribute__ ((aligned(64)));	// cache line
+
+struct tracer_stats {
+	struct tracer_stats_shard *shards;
+	struct tracer_stats_shard *base;	// Values at the last reset.
+	int count;
+};
+
+// Only called by the thread owning the shard.
+#define tracer_stats_add(shard, field, n) \
+	__atomic_store_n(&(shard)->field, (shard)->field + (n), __ATOMIC_RELAXED)
+
+static inline uint64_t __tracer_stats_fetch(uint64_t *cnt, uint64_t *base,
+					    bool reset)
+{
+	uint64_t curr = __atomic_load_n(cnt, __ATOMIC_RELAXED);
+	uint64_t val = curr - *base;
+
+	if (reset)
+		*base = curr;
+	return val;
+}
+
+// Counter of shard 'i' since the last reset.
+#define tracer_stats_fetch(st, i, field, reset) \
+	__tracer_stats_fetch(&(st)->shards[i].field, &(st)->base[i].field, reset)
+
+static inline uint64_t __tracer_stats_sum(struct tracer_stats *st,
+					  size_t off, bool reset)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < st->count; i++)
+		sum += __tracer_stats_fetch((uint64_t *)((char *)&st->shards[i] + off),
+					    (uint64_t *)((char *)&st->base[i] + off),
+					    reset);
+	return sum;
+}
+
+// Counter summed over all the shards.
+#define tracer_stats_sum(st, field, reset) \
+	__tracer_stats_sum(st, offsetof(struct tracer_stats_shard, field), reset)
+
 struct ebpf_object;
 struct perf_reader;
 struct bpf_tracer;
@@ -452,13 +521,11 @@ struct bpf_tracer {
 	 */
 	atomic64_t recv;	// User-level program event reception statistics. 
 	atomic64_t lost;	// User-level programs not receiving data in time can cause data loss in the kernel.
-	atomic64_t proto_stats[PROTO_NUM];	// Statistical analysis based on different l7 protocols.
-	// Packet Statistics Obtained from DPDK
-	atomic64_t rx_pkts;
-	atomic64_t tx_pkts;
-	atomic64_t rx_bytes;
-	atomic64_t tx_bytes;
-	atomic64_t dropped_pkts;
+	/*
+	 * Per reader thread: lost, protocols, packets obtained from DPDK,
+	 * enqueue counters.
+	 */
+	struct tracer_stats stats;
 
 	/*
 	 * maps re-config
@@ -500,15 +567,6 @@ struct extra_waiting_op {
 
 typedef int (*period_event_fun_t) ();
 
-struct period_event_op {
-	struct list_head list;
-	char name[NAME_LEN];
-	bool is_valid;
-	/* The cycle time of event triggering (unit is microseconds) */
-	uint32_t times;
-	period_event_fun_t f;
-};
-
 /* =================================
  * 控制面数据传递
  * =================================
@@ -621,6 +679,13 @@ static int inline __reclaim_map(int map_fd, struct list_head *h)
 
 int set_allow_port_bitmap(void *bitmap);
 int set_bypass_port_bitmap(void *bitmap);
+/*
+ * Sockets on the ports set in 'bitmap' (65536 bits) push their first
+ * METADATA_ONLY_PAYLOAD_MSGS messages with the payload, then only the
+ * metadata (tuple, direction, syscall_len, seqs, timestamps, trace id).
+ * Linux 5.2+ only, set before the socket tracer starts.
+ */
+int set_metadata_port_bitmap(void *bitmap);
 int enable_ebpf_protocol(int protocol);
 int set_feature_regex(int feature, const char *pattern);
 bool is_feature_enabled(int feature);
@@ -631,6 +696,9 @@ bool v8_profiler_enabled(void);
 bool python_profiler_enabled(void);
 int bpf_tracer_init(const char *log_file, bool is_stdout);
 int set_kick_kern_nice(int32_t nice);
+int set_bpf_hugepage_mode(int mode);
+int set_bpf_memory_budget(uint64_t bytes);
+int set_bpf_memory_shed_priority(const char *name, int priority);
 int tracer_bpf_load(struct bpf_tracer *tracer);
 int tracer_probes_init(struct bpf_tracer *tracer);
 int tracer_hooks_attach(struct bpf_tracer *tracer);
@@ -655,6 +723,8 @@ int maps_config(struct bpf_tracer *tracer, const char *map_name, int entries);
 struct bpf_tracer *find_bpf_tracer(const char *name);
 int register_period_event_op(const char *name,
 			     period_event_fun_t f, uint32_t period_time);
+int register_period_worker_op(const char *name, period_event_fun_t f,
+			      uint32_t period_time, int worker);
 int set_period_event_invalid(const char *name);
 
 /**
@@ -704,6 +774,8 @@ int release_bpf_tracer(const char *name);
 void free_all_readers(struct bpf_tracer *t);
 int enable_tracer_reader_work(const char *name, int idx,
 			      struct bpf_tracer *tracer, void *fn);
+// Allocate 'count' statistics shards, one per reader thread.
+int tracer_stats_init(struct bpf_tracer *t, int count);
 bool is_rt_kernel(void);
 /**
  * @brief Enable eBPF segmentation reassembly for the specified protocol.
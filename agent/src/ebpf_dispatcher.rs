@@ -50,7 +50,7 @@ use std::time::Duration;
 
 use ahash::HashSet;
 use arc_swap::access::Access;
-use libc::{c_int, c_ulonglong, c_void};
+use libc::{c_int, c_uint, c_ulonglong, c_void};
 use log::{debug, error, info, warn};
 use thiserror::Error;
 use zstd::bulk::compress;
@@ -578,7 +578,24 @@ pub unsafe fn string_from_null_terminated_c_str(ptr: *const u8) -> String {
         .into_owned()
 }
 
+// IO_HIST_DRAIN_PERIOD in ebpf/user/config.h
+const IO_HIST_DRAIN_PERIOD: Duration = Duration::from_secs(10);
+
 impl EbpfCollector {
+    extern "C" fn ebpf_io_latency_hist_callback(hist: *mut ebpf::IO_LATENCY_HIST) {
+        #[allow(static_mut_refs)]
+        unsafe {
+            if !SWITCH || PROC_EVENT_SENDER.is_none() {
+                return;
+            }
+            let hist = hist.read_unaligned();
+            let event = ProcEvent::from_io_latency_hist(&hist, IO_HIST_DRAIN_PERIOD);
+            if let Err(e) = PROC_EVENT_SENDER.as_mut().unwrap().send(event) {
+                warn!("io latency histogram send ebpf error: {:?}", e);
+            }
+        }
+    }
+
     extern "C" fn ebpf_l7_callback(
         _: *mut c_void,
         #[allow(unused)] queue_id: c_int,
@@ -798,6 +815,7 @@ impl EbpfCollector {
         ebpf::set_uprobe_golang_enabled(
             !is_uprobe_meltdown && config.ebpf.socket.uprobe.golang.enabled,
         );
+        ebpf::set_go_lazy_goid_enabled(config.ebpf.socket.uprobe.golang.lazy_goid);
         if !is_uprobe_meltdown && config.ebpf.socket.uprobe.golang.enabled {
             let feature = "ebpf.socket.uprobe.golang";
             process_listener.register(feature, set_feature_uprobe_golang);
@@ -943,6 +961,25 @@ impl EbpfCollector {
             }
         }
 
+        let http1_index = &config.ebpf.socket.preprocess.http1_header_index;
+        if http1_index.enabled {
+            let names = CString::new(http1_index.header_names.join(",").as_bytes()).unwrap();
+            if ebpf::set_http1_header_extract(names.as_ptr(), http1_index.headers_only) != 0 {
+                warn!("ebpf set http1 header index {:?} failed.", http1_index.header_names);
+            }
+        }
+
+        let metadata_only = &config.ebpf.socket.kprobe.metadata_only;
+        if !metadata_only.ports.is_empty() {
+            if let Some(b) = parse_u16_range_list_to_bitmap(&metadata_only.ports, false) {
+                ebpf::set_metadata_port_bitmap(b.get_raw_ptr());
+            }
+        }
+
+        if ebpf::set_bpf_hugepage_mode(config.ebpf.tunning.hugepage_mode) != 0 {
+            warn!("ebpf set_bpf_hugepage_mode error: {}", config.ebpf.tunning.hugepage_mode);
+        }
+
         if ebpf::bpf_tracer_init(null_mut(), true) != 0 {
             info!("ebpf bpf_tracer_init error.");
             return Err(Error::EbpfInitError);
@@ -984,6 +1021,33 @@ impl EbpfCollector {
             return Err(Error::EbpfInitError);
         }
 
+        let preprocess = &config.ebpf.socket.preprocess;
+        if preprocess.socket_data_reorder_enabled
+            && ebpf::set_socket_data_reorder(
+                true,
+                preprocess.socket_data_reorder_max_hold.as_micros() as c_uint,
+            ) != 0
+        {
+            warn!(
+                "ebpf set_socket_data_reorder error, max hold time: {:?}",
+                preprocess.socket_data_reorder_max_hold
+            );
+        }
+
+        let io_event = &config.ebpf.file.io_event;
+        if io_event.latency_histogram_enabled
+            && ebpf::set_io_latency_hist(
+                true,
+                io_event.outlier_duration.as_nanos() as c_ulonglong,
+                Self::ebpf_io_latency_hist_callback,
+            ) != 0
+        {
+            warn!(
+                "ebpf set_io_latency_hist error, outlier duration: {:?}",
+                io_event.outlier_duration
+            );
+        }
+
         let mut all_proto_map = get_all_protocol()
             .iter()
             .map(|p| p.as_str().to_lowercase())
@@ -1019,6 +1083,10 @@ impl EbpfCollector {
 
         ebpf::set_bpf_map_prealloc(!config.ebpf.socket.tunning.map_prealloc_disabled);
 
+        if ebpf::set_socket_key_by_sk(config.ebpf.socket.tunning.socket_key_by_sk) != 0 {
+            warn!("ebpf set_socket_key_by_sk error.");
+        }
+
         if let Err(e) = config.ebpf.tunning.validate() {
             warn!(
                 "skip setting kick thread nice value to {}: {}",
@@ -1031,6 +1099,23 @@ impl EbpfCollector {
             );
         }
 
+        let tunning = &config.ebpf.tunning;
+        if tunning.memory_budget > 0 {
+            let priority = &tunning.memory_shed_priority;
+            for (name, prio) in [
+                ("symbol-cache", priority.symbol_cache),
+                ("stack-str", priority.stack_str),
+                ("profiler-freq", priority.profiler_freq),
+                ("socket-data", priority.socket_data),
+            ] {
+                let c_name = CString::new(name).unwrap();
+                if ebpf::set_bpf_memory_shed_priority(c_name.as_ptr(), prio) != 0 {
+                    warn!("failed to set memory shedding action {} priority {}", name, prio);
+                }
+            }
+            ebpf::set_bpf_memory_budget(tunning.memory_budget << 20);
+        }
+
         if config.ebpf.socket.tunning.fentry_enabled {
             ebpf::enable_fentry();
         } else {
@@ -1713,6 +1713,21 @@ impl FlowMap {
             let ip_protocol = meta_packet.lookup_key.proto;
 
             for packet in meta_packet {
+                if packet.is_metadata_only {
+                    if Self::l7_metrics_enabled(
+                        flow_config,
+                        &node.tagged_flow.flow.signal_source,
+                    ) {
+                        if let Some(l7_stat) = log.metadata_only_perf(packet) {
+                            if let Some(perf_stats) = node.tagged_flow.flow.flow_perf_stats.as_mut()
+                            {
+                                perf_stats.l7.sequential_merge(&l7_stat);
+                            }
+                        }
+                    }
+                    continue;
+                }
+
                 let ret = if ip_protocol == IpProtocol::UDP || ip_protocol == IpProtocol::TCP {
                     log.parse(
                         flow_config,
@@ -237,6 +237,9 @@ pub struct FlowLog {
 
     ntp_diff: Arc<AtomicI64>,
     obfuscate_cache: Option<ObfuscateCache>,
+
+    // Timestamp (us) of the pending request of the metadata only socket data, 0 for none
+    metadata_only_req_time: u64,
 }
 
 impl FlowLog {
@@ -589,6 +592,7 @@ impl FlowLog {
             l7_protocol_inference_ttl,
             ntp_diff,
             obfuscate_cache,
+            metadata_only_req_time: 0,
         })
     }
 
@@ -682,6 +686,37 @@ impl FlowLog {
         }
     }
 
+    // The eBPF socket data of the metadata only ports carries no payload and can not be parsed,
+    // count it as requests and responses by the direction and keep the response time instead.
+    // The direction is known only after the first request with the payload has been checked.
+    pub fn metadata_only_perf(&mut self, packet: &MetaPacket) -> Option<L7PerfStats> {
+        if self.server_port == 0 {
+            return None;
+        }
+
+        let timestamp = packet.lookup_key.timestamp.as_micros();
+        let mut perf_stats = L7PerfStats::default();
+        if self.server_port == packet.lookup_key.dst_port {
+            // A request written by several syscalls is counted once
+            if self.metadata_only_req_time != 0 {
+                return None;
+            }
+            self.metadata_only_req_time = timestamp;
+            perf_stats.inc_req();
+        } else {
+            if self.metadata_only_req_time == 0 {
+                return None;
+            }
+            let rrt = timestamp.saturating_sub(self.metadata_only_req_time);
+            self.metadata_only_req_time = 0;
+            perf_stats.inc_resp();
+            if rrt <= self.rrt_timeout as u64 {
+                perf_stats.update_rrt(rrt);
+            }
+        }
+        Some(perf_stats)
+    }
+
     pub fn copy_and_reset_l7_perf_data(&mut self) -> (Vec<L7PerfStats>, L7Protocol) {
         let l7_perf = self
             .l7_protocol_log_parser
@@ -39,6 +39,9 @@ pub const HTTP_HOST_OFFSET: usize = 6;
 pub const HTTP_CONTENT_LENGTH_OFFSET: usize = 16;
 
 pub const HTTPV2_CUSTOM_DATA_MIN_LENGTH: usize = 16;
+// keyLength flag of the go uprobe payload with all the header fields of a frame packed
+pub const HTTPV2_CUSTOM_DATA_PACKED: u32 = 0x8000_0000;
+pub const HTTPV2_CUSTOM_FIELD_HEADER_LENGTH: usize = 4;
 
 pub const HTTPV2_FRAME_HEADER_LENGTH: usize = 9;
 pub const HTTPV2_MAGIC_LENGTH: usize = 24;
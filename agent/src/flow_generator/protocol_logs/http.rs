@@ -40,7 +40,7 @@ use super::{
 };
 
 #[cfg(feature = "libtrace")]
-use crate::utils::bytes::read_u32_le;
+use crate::utils::bytes::{read_u16_le, read_u32_le};
 use crate::{
     common::{
         ebpf::EbpfType,
@@ -1405,6 +1405,18 @@ impl HttpLog {
     // +---------------------------------------------------------------+
     // |                          value (valueLength,变长)           ...|
     // +---------------------------------------------------------------+
+    //
+    // When the highest bit of keyLength is set (HTTPV2_CUSTOM_DATA_PACKED),
+    // all the header fields of a frame are packed in one payload, the low
+    // 16 bits of keyLength are the number of fields and valueLength is the
+    // size of the fields area:
+    // +---------------------------------------------------------------+
+    // |      keyLength (16)           |       valueLength (16)        |
+    // +---------------------------------------------------------------+
+    // |                          key, value (变长)                  ...|
+    // +---------------------------------------------------------------+
+    // |                          ... (count times)                    |
+    // +---------------------------------------------------------------+
     #[cfg(feature = "libtrace")]
     pub fn check_http2_go_uprobe(
         &mut self,
@@ -1424,9 +1436,11 @@ impl HttpLog {
         (info.is_req_end, info.is_resp_end) = (p.is_req_end, p.is_resp_end);
         let direction = param.direction;
         let stream_id = read_u32_le(&payload[4..8]);
-        let key_len = read_u32_le(&payload[8..12]) as usize;
+        let key_len = read_u32_le(&payload[8..12]);
         let val_len = read_u32_le(&payload[12..16]) as usize;
-        if key_len + val_len + HTTPV2_CUSTOM_DATA_MIN_LENGTH != payload.len() {
+        let packed = key_len & HTTPV2_CUSTOM_DATA_PACKED != 0;
+        let fields_len = if packed { 0 } else { key_len as usize };
+        if fields_len + val_len + HTTPV2_CUSTOM_DATA_MIN_LENGTH != payload.len() {
             // 长度不够
             return Err(Error::HttpHeaderParseFailed);
         }
@@ -1436,35 +1450,49 @@ impl HttpLog {
         // adjuest msg type
         info.msg_type = LogMessageType::from(direction);
 
-        let val_offset = HTTPV2_CUSTOM_DATA_MIN_LENGTH + key_len;
-        let key = &payload[HTTPV2_CUSTOM_DATA_MIN_LENGTH..val_offset];
-        let val = &payload[val_offset..val_offset + val_len];
-        self.on_header(config, key, val, direction, info)?;
-        #[cfg(feature = "enterprise")]
-        if let Some(policies) = custom_policies {
-            if let Some((key, val)) = str::from_utf8(key).ok().zip(str::from_utf8(val).ok()) {
-                policies.apply(
-                    &mut self.custom_field_store,
+        let mut content_length = None;
+        if packed {
+            let count = (key_len & 0xffff) as usize;
+            let mut fields = &payload[HTTPV2_CUSTOM_DATA_MIN_LENGTH..];
+            for _ in 0..count {
+                if fields.len() < HTTPV2_CUSTOM_FIELD_HEADER_LENGTH {
+                    return Err(Error::HttpHeaderParseFailed);
+                }
+                let key_len = read_u16_le(&fields[0..2]) as usize;
+                let val_len = read_u16_le(&fields[2..4]) as usize;
+                let val_offset = HTTPV2_CUSTOM_FIELD_HEADER_LENGTH + key_len;
+                if val_offset + val_len > fields.len() {
+                    return Err(Error::HttpHeaderParseFailed);
+                }
+                let key = &fields[HTTPV2_CUSTOM_FIELD_HEADER_LENGTH..val_offset];
+                let val = &fields[val_offset..val_offset + val_len];
+                if let Some(len) = self.on_go_uprobe_header(
+                    config,
+                    key,
+                    val,
+                    direction,
                     info,
-                    direction.into(),
-                    Source::Header(key, val),
-                );
-                if key == ":path" {
-                    policies.apply(
-                        &mut self.custom_field_store,
-                        info,
-                        direction.into(),
-                        Source::Url(&info.path),
-                    );
+                    #[cfg(feature = "enterprise")]
+                    custom_policies,
+                )? {
+                    content_length = Some(len);
                 }
+                fields = &fields[val_offset + val_len..];
             }
-        }
-
-        let content_length = if key == b"content-length" {
-            Some(val.parse_to().unwrap_or_default())
         } else {
-            None
-        };
+            let val_offset = HTTPV2_CUSTOM_DATA_MIN_LENGTH + fields_len;
+            let key = &payload[HTTPV2_CUSTOM_DATA_MIN_LENGTH..val_offset];
+            let val = &payload[val_offset..val_offset + val_len];
+            content_length = self.on_go_uprobe_header(
+                config,
+                key,
+                val,
+                direction,
+                info,
+                #[cfg(feature = "enterprise")]
+                custom_policies,
+            )?;
+        }
 
         if self.proto == L7Protocol::Grpc {
             info.method = Method::from_ebpf_type(param.ebpf_type, param.direction);
@@ -1487,6 +1515,46 @@ impl HttpLog {
         }
     }
 
+    // Handle one header field reported by the go uprobe, returns the content length if the
+    // field is content-length.
+    #[cfg(feature = "libtrace")]
+    fn on_go_uprobe_header(
+        &mut self,
+        config: &L7LogDynamicConfig,
+        key: &[u8],
+        val: &[u8],
+        direction: PacketDirection,
+        info: &mut HttpInfo,
+        #[cfg(feature = "enterprise")] custom_policies: Option<PolicySlice>,
+    ) -> Result<Option<u32>> {
+        self.on_header(config, key, val, direction, info)?;
+        #[cfg(feature = "enterprise")]
+        if let Some(policies) = custom_policies {
+            if let Some((key, val)) = str::from_utf8(key).ok().zip(str::from_utf8(val).ok()) {
+                policies.apply(
+                    &mut self.custom_field_store,
+                    info,
+                    direction.into(),
+                    Source::Header(key, val),
+                );
+                if key == ":path" {
+                    policies.apply(
+                        &mut self.custom_field_store,
+                        info,
+                        direction.into(),
+                        Source::Url(&info.path),
+                    );
+                }
+            }
+        }
+
+        if key == b"content-length" {
+            Ok(Some(val.parse_to().unwrap_or_default()))
+        } else {
+            Ok(None)
+        }
+    }
+
     #[cfg(feature = "libtrace")]
     pub fn parse_http2_go_uprobe(
         &mut self,
@@ -1540,8 +1608,28 @@ impl HttpLog {
             return Err(Error::HttpHeaderParseFailed);
         }
 
-        let mut headers = parse_v1_headers(payload);
-        let Some(first_line) = headers.next() else {
+        // The start line and the header block located by eBPF save searching the payload
+        #[cfg(feature = "libtrace")]
+        let indexed = param
+            .ebpf_param
+            .as_ref()
+            .and_then(|p| p.http1_index.as_ref())
+            .and_then(|index| V1Structure::from_index(payload, index));
+        #[cfg(not(feature = "libtrace"))]
+        let indexed: Option<V1Structure> = None;
+
+        let (mut headers, first_line) = match indexed.as_ref() {
+            Some(v1) => (
+                parse_v1_headers(v1.headers),
+                str::from_utf8(v1.first_line).ok(),
+            ),
+            None => {
+                let mut headers = parse_v1_headers(payload);
+                let first_line = headers.next();
+                (headers, first_line)
+            }
+        };
+        let Some(first_line) = first_line else {
             return Err(Error::HttpHeaderParseFailed);
         };
 
@@ -1624,7 +1712,10 @@ impl HttpLog {
             }
         }
 
-        let l7_payload = V1Structure::new(payload).body;
+        let l7_payload = match indexed {
+            Some(v1) => v1.body,
+            None => V1Structure::new(payload).body,
+        };
 
         set_captured_byte!(info, param);
         // 当解析完所有Header仍未找到Content-Length，则认为该字段值为0
@@ -2461,6 +2552,30 @@ impl<'a> V1Structure<'a> {
             },
         }
     }
+
+    // The index is only used when the whole header block is in the payload and its lines end
+    // with "\r\n", otherwise the payload is searched as usual.
+    #[cfg(feature = "libtrace")]
+    fn from_index(
+        payload: &'a [u8],
+        index: &crate::common::l7_protocol_log::Http1Index,
+    ) -> Option<Self> {
+        let start = index.start_line_off as usize;
+        let line_end = start + index.start_line_len as usize;
+        let header_len = index.header_len as usize;
+        if header_len == 0 || line_end + 4 > header_len || header_len > payload.len() {
+            return None;
+        }
+        let headers = payload[line_end..header_len].strip_prefix(b"\r\n")?;
+        if !headers.ends_with(b"\r\n") {
+            return None;
+        }
+        Some(Self {
+            first_line: &payload[start..line_end],
+            headers,
+            body: &payload[header_len..],
+        })
+    }
 }
 
 pub fn handle_endpoint(config: &LogParserConfig, path: &String) -> String {
@@ -2797,6 +2912,7 @@ mod tests {
                 is_req_end: false,
                 is_resp_end: false,
                 process_kname: "",
+                http1_index: None,
             }),
             packet_start_seq: 0,
             packet_end_seq: 0,
@@ -2884,6 +3000,67 @@ mod tests {
             assert_eq!(res.is_ok(), true);
             println!("{:#?}", info);
         }
+
+        // 一个 payload 带多个头
+        {
+            let fields = [
+                (":method", "GET"),
+                (":path", "/asd"),
+                ("host", "a.com"),
+                ("content-length", "55"),
+            ];
+            let mut packed = vec![];
+            for (key, val) in fields {
+                packed.extend_from_slice(&(key.len() as u16).to_le_bytes());
+                packed.extend_from_slice(&(val.len() as u16).to_le_bytes());
+                packed.extend_from_slice(key.as_bytes());
+                packed.extend_from_slice(val.as_bytes());
+            }
+            let hdr = H2CustomHdr {
+                fd: 1,
+                stream_id: 1,
+                k_len: HTTPV2_CUSTOM_DATA_PACKED | fields.len() as u32,
+                v_len: packed.len() as u32,
+            };
+            let packed = String::from_utf8(packed).unwrap();
+            let payload = hdr.to_bytes(&packed, "");
+
+            let mut h = HttpLog::new_v2(false);
+            let mut info = HttpInfo::default();
+            info.raw_data_type = L7ProtoRawDataType::GoHttp2Uprobe;
+            let res = h.parse_http2_go_uprobe(
+                &L7LogDynamicConfig::default(),
+                &payload,
+                param,
+                &mut info,
+                #[cfg(feature = "enterprise")]
+                None,
+            );
+            assert_eq!(res.is_ok(), true);
+            assert_eq!(info.method, Method::Get);
+            assert_eq!(info.path, "/asd");
+            assert_eq!(info.host, "a.com");
+
+            // 字段越界
+            let mut h = HttpLog::new_v2(false);
+            let mut info = HttpInfo::default();
+            let hdr = H2CustomHdr {
+                fd: 1,
+                stream_id: 1,
+                k_len: HTTPV2_CUSTOM_DATA_PACKED | (fields.len() as u32 + 1),
+                v_len: packed.len() as u32,
+            };
+            let payload = hdr.to_bytes(&packed, "");
+            let res = h.parse_http2_go_uprobe(
+                &L7LogDynamicConfig::default(),
+                &payload,
+                param,
+                &mut info,
+                #[cfg(feature = "enterprise")]
+                None,
+            );
+            assert_eq!(res.is_ok(), false);
+        }
     }
 
     #[test]
@@ -2916,6 +3093,39 @@ mod tests {
         }
     }
 
+    #[cfg(feature = "libtrace")]
+    #[test]
+    fn test_v1_structure_from_index() {
+        use crate::common::l7_protocol_log::Http1Index;
+
+        let payload = b"GET /a HTTP/1.1\r\nHost: a.com\r\nContent-Length: 2\r\n\r\nok";
+        let index = Http1Index {
+            start_line_off: 0,
+            start_line_len: 15,
+            header_len: 51,
+        };
+        let expected = V1Structure::new(payload);
+        let v1 = V1Structure::from_index(payload, &index).unwrap();
+        assert_eq!(expected.first_line, v1.first_line);
+        assert_eq!(expected.body, v1.body);
+        assert_eq!(
+            parse_v1_headers(expected.headers).collect::<Vec<_>>(),
+            parse_v1_headers(v1.headers).collect::<Vec<_>>()
+        );
+
+        // The header block is not all in the payload
+        assert!(V1Structure::from_index(&payload[..40], &index).is_none());
+
+        // The lines end with "\n"
+        let payload = b"GET /a HTTP/1.1\nHost: a.com\n\nok";
+        let index = Http1Index {
+            start_line_off: 0,
+            start_line_len: 15,
+            header_len: 29,
+        };
+        assert!(V1Structure::from_index(payload, &index).is_none());
+    }
+
     #[test]
     fn get_http_v1_header_from_payload() {
         let testcases = vec![
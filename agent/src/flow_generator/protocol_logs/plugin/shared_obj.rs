@@ -19,6 +19,7 @@ use std::{
     time::{SystemTime, UNIX_EPOCH},
 };
 
+use libc::c_void;
 use log::error;
 use public::l7_protocol::{CustomProtocol, L7Protocol, LogMessageType};
 
@@ -30,18 +31,82 @@ use crate::{
     },
     flow_generator::{protocol_logs::set_captured_byte, Error, Result},
     plugin::{
-        c_ffi::{c_str_to_string, ParseCtx, ParseInfo, ACTION_CONTINUE, ACTION_ERROR, ACTION_OK},
+        c_ffi::{
+            c_str_to_string, CheckResult, FreeStateCFunc, ParseArena, ParseCtx, ParseCtxV2,
+            ParseInfo, ParseInfoV2, ParseResult, SoPluginAbi, ACTION_CONTINUE, ACTION_ERROR,
+            ACTION_OK,
+        },
         CustomInfo,
     },
 };
 
 const RESULT_LEN: i32 = 8;
+// the arena for the strings returned by ABI v2 plugins in one call
+const ARENA_SIZE: usize = 16384;
+
+// the per connection state of an ABI v2 plugin
+struct SoState {
+    hash: String,
+    state: *mut c_void,
+    free_state: Option<FreeStateCFunc>,
+}
+
+// the state is only used by the thread owning the parser
+unsafe impl Send for SoState {}
+
+impl Drop for SoState {
+    fn drop(&mut self) {
+        if let Some(free_state) = self.free_state {
+            // correctness depends on plugin implementation
+            unsafe { free_state(self.state) };
+        }
+    }
+}
 
 #[derive(Default)]
 pub struct SoLog {
     proto_num: Option<u8>,
     proto_str: String,
     perf_stats: Vec<L7PerfStats>,
+    states: Vec<SoState>,
+    // allocated once, only the entries returned by the previous call are reset
+    infos: Vec<ParseInfo>,
+    infos_used: usize,
+    infos_v2: Vec<ParseInfoV2>,
+    infos_v2_used: usize,
+    arena: Vec<u8>,
+}
+
+// make the first `used` results of the previous call zeroed again, as the plugin expects
+fn reset_results<T: Clone + Default>(buf: &mut Vec<T>, used: &mut usize) {
+    if buf.len() != RESULT_LEN as usize {
+        buf.clear();
+        buf.resize(RESULT_LEN as usize, T::default());
+    } else {
+        buf[..*used].fill(T::default());
+    }
+    *used = 0;
+}
+
+impl SoLog {
+    fn state(&self, hash: &str) -> *mut c_void {
+        self.states
+            .iter()
+            .find(|s| s.hash == hash)
+            .map_or(std::ptr::null_mut(), |s| s.state)
+    }
+
+    fn set_state(&mut self, hash: &str, free_state: Option<FreeStateCFunc>, state: *mut c_void) {
+        match self.states.iter_mut().find(|s| s.hash == hash) {
+            Some(s) => s.state = state,
+            None if !state.is_null() => self.states.push(SoState {
+                hash: hash.to_owned(),
+                state,
+                free_state,
+            }),
+            _ => (),
+        }
+    }
 }
 
 impl L7ProtocolParserInterface for SoLog {
@@ -50,7 +115,10 @@ impl L7ProtocolParserInterface for SoLog {
         let Some(c_funcs) = &*so_func_ref else {
             return None;
         };
-        let ctx = &ParseCtx::from((param, payload));
+        let mut ctx = ParseCtxV2 {
+            ctx: ParseCtx::from((param, payload)),
+            state: std::ptr::null_mut(),
+        };
 
         for c in c_funcs.iter() {
             let counter = &c.check_payload_counter;
@@ -67,7 +135,22 @@ impl L7ProtocolParserInterface for SoLog {
 
                 the plugin correctness depend on the implementation of the developer
             */
-            let res = unsafe { (c.check_payload)(ctx as *const ParseCtx) };
+            let res = match c.abi {
+                SoPluginAbi::V1 { check_payload, .. } => unsafe {
+                    check_payload(&ctx.ctx as *const ParseCtx)
+                },
+                SoPluginAbi::V2 {
+                    check_payload_batch,
+                    free_state,
+                    ..
+                } => {
+                    let mut res = CheckResult::default();
+                    ctx.state = self.state(&c.hash);
+                    unsafe { check_payload_batch(&mut ctx as *mut ParseCtxV2, 1, &mut res) };
+                    self.set_state(&c.hash, free_state, ctx.state);
+                    res
+                }
+            };
 
             counter.exe_duration.swap(
                 {
@@ -110,9 +193,11 @@ impl L7ProtocolParserInterface for SoLog {
             return Err(Error::NoParseConfig);
         };
 
-        let ctx = &mut ParseCtx::from((param, payload));
-        ctx.proto = self.proto_num.unwrap();
-        let mut resp = [ParseInfo::default(); RESULT_LEN as usize];
+        let mut ctx = ParseCtxV2 {
+            ctx: ParseCtx::from((param, payload)),
+            state: std::ptr::null_mut(),
+        };
+        ctx.ctx.proto = self.proto_num.unwrap();
         self.perf_stats.clear();
         for c in c_funcs.iter() {
             let counter = &c.parse_payload_counter;
@@ -128,14 +213,56 @@ impl L7ProtocolParserInterface for SoLog {
 
                 the plugin correctness depend on the implementation of the developer
             */
-            let res = unsafe {
-                (c.parse_payload)(
-                    ctx as *const ParseCtx,
-                    &mut resp as *mut ParseInfo,
-                    RESULT_LEN,
-                )
+            let mut arena_used = 0;
+            let res = match c.abi {
+                SoPluginAbi::V1 { parse_payload, .. } => {
+                    reset_results(&mut self.infos, &mut self.infos_used);
+                    unsafe {
+                        parse_payload(
+                            &ctx.ctx as *const ParseCtx,
+                            self.infos.as_mut_ptr(),
+                            RESULT_LEN,
+                        )
+                    }
+                }
+                SoPluginAbi::V2 {
+                    parse_payload_batch,
+                    free_state,
+                    ..
+                } => {
+                    // the payloads are parsed one at a time, the batch only has one context
+                    reset_results(&mut self.infos_v2, &mut self.infos_v2_used);
+                    self.arena.resize(ARENA_SIZE, 0);
+                    let mut arena = ParseArena {
+                        buf: self.arena.as_mut_ptr(),
+                        cap: self.arena.len() as u32,
+                        used: 0,
+                    };
+                    let mut res = ParseResult::default();
+                    ctx.state = self.state(&c.hash);
+                    unsafe {
+                        parse_payload_batch(
+                            &mut ctx as *mut ParseCtxV2,
+                            1,
+                            &mut res,
+                            self.infos_v2.as_mut_ptr(),
+                            RESULT_LEN,
+                            &mut arena,
+                        )
+                    };
+                    self.set_state(&c.hash, free_state, ctx.state);
+                    arena_used = arena.used.min(arena.cap) as usize;
+                    res
+                }
             };
 
+            // an invalid length resets all the results on the next call
+            let used = (if res.len < 0 { RESULT_LEN } else { res.len.min(RESULT_LEN) }) as usize;
+            match c.abi {
+                SoPluginAbi::V1 { .. } => self.infos_used = used,
+                SoPluginAbi::V2 { .. } => self.infos_v2_used = used,
+            }
+
             counter.exe_duration.swap(
                 {
                     let end_time = SystemTime::now();
@@ -155,7 +282,7 @@ impl L7ProtocolParserInterface for SoLog {
                     if res.len == 0 {
                         return Ok(L7ParseResult::None);
                     }
-                    if res.len > RESULT_LEN {
+                    if res.len < 0 || res.len > RESULT_LEN {
                         error!(
                             "so plugin {} return large result length {}",
                             c.name, res.len
@@ -165,7 +292,13 @@ impl L7ProtocolParserInterface for SoLog {
                     }
                     let mut v = vec![];
                     for i in 0..res.len as usize {
-                        match CustomInfo::try_from(resp[i]) {
+                        let info = match c.abi {
+                            SoPluginAbi::V1 { .. } => CustomInfo::try_from(self.infos[i]),
+                            SoPluginAbi::V2 { .. } => {
+                                self.infos_v2[i].to_custom_info(&self.arena[..arena_used])
+                            }
+                        };
+                        match info {
                             Ok(mut info) => {
                                 info.proto_str = self.proto_str.clone();
                                 info.proto = self.proto_num.unwrap();
@@ -238,6 +371,6 @@ pub fn get_so_parser(p: u8, s: String) -> SoLog {
     SoLog {
         proto_num: Some(p),
         proto_str: s,
-        perf_stats: vec![],
+        ..Default::default()
     }
 }
@@ -17,6 +17,7 @@
 use std::net::IpAddr;
 use std::sync::{Arc, Weak};
 
+use libc::c_void;
 use public::enums::IpProtocol;
 
 use crate::flow_generator::protocol_logs::pb_adapter::KeyVal;
@@ -32,6 +33,11 @@ use public::l7_protocol::LogMessageType;
 pub const INIT_FUNC_SYM: &'static str = "init";
 pub const CHECK_PAYLOAD_FUNC_SYM: &'static str = "on_check_payload";
 pub const PARSE_PAYLOAD_FUNC_SYM: &'static str = "on_parse_payload";
+pub const CHECK_PAYLOAD_BATCH_FUNC_SYM: &'static str = "on_check_payload_batch";
+pub const PARSE_PAYLOAD_BATCH_FUNC_SYM: &'static str = "on_parse_payload_batch";
+pub const FREE_STATE_FUNC_SYM: &'static str = "on_free_state";
+
+pub const RESP_CODE_NULL: i32 = -32768;
 
 #[repr(C)]
 pub struct ParseCtx {
@@ -326,6 +332,136 @@ impl TryFrom<ParseInfo> for CustomInfo {
     }
 }
 
+#[repr(C)]
+pub struct ParseCtxV2 {
+    pub ctx: ParseCtx,
+    // opaque per connection state owned by the plugin, null on the first call
+    pub state: *mut c_void,
+}
+
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ArenaStr {
+    pub(super) off: u32,
+    pub(super) len: u32,
+}
+
+impl ArenaStr {
+    fn read<'a>(&self, arena: &'a [u8]) -> Option<&'a [u8]> {
+        if self.len == 0 {
+            return None;
+        }
+        let start = self.off as usize;
+        arena.get(start..start.checked_add(self.len as usize)?)
+    }
+
+    fn to_string(&self, arena: &[u8]) -> Option<String> {
+        self.read(arena)
+            .map(|b| String::from_utf8_lossy(b).to_string())
+    }
+}
+
+#[repr(C)]
+pub struct ParseArena {
+    pub buf: *mut u8,
+    pub cap: u32,
+    // bytes written by the plugin, never beyond cap
+    pub used: u32,
+}
+
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ParseInfoV2 {
+    pub(super) msg_type: u8,
+    pub(super) status: u8,
+    pub(super) has_request_id: i8,
+    pub(super) request_id: u32,
+    pub(super) req_len: i32,
+    pub(super) resp_len: i32,
+    // RESP_CODE_NULL if the response has no code
+    pub(super) code: i32,
+    pub(super) trace_id: ArenaStr,
+    pub(super) span_id: ArenaStr,
+    pub(super) parent_span_id: ArenaStr,
+    pub(super) req_type: ArenaStr,
+    pub(super) domain: ArenaStr,
+    pub(super) resource: ArenaStr,
+    pub(super) endpoint: ArenaStr,
+    pub(super) exception: ArenaStr,
+    pub(super) result: ArenaStr,
+    pub(super) attr_len: u32,
+    // format: repeated (${key bytes}\0${val bytes}\0)
+    pub(super) attributes: ArenaStr,
+}
+
+impl ParseInfoV2 {
+    // the strings are read from `arena`, the part of the arena written by the plugin
+    pub fn to_custom_info(&self, arena: &[u8]) -> Result<CustomInfo, String> {
+        let msg_type = LogMessageType::try_from(self.msg_type).map_err(|e| e.to_string())?;
+        let (req, resp) = match msg_type {
+            LogMessageType::Request => (
+                CustomInfoRequest {
+                    req_type: self.req_type.to_string(arena).unwrap_or_default(),
+                    domain: self.domain.to_string(arena).unwrap_or_default(),
+                    resource: self.resource.to_string(arena).unwrap_or_default(),
+                    endpoint: self.endpoint.to_string(arena).unwrap_or_default(),
+                    ..Default::default()
+                },
+                CustomInfoResp::default(),
+            ),
+            LogMessageType::Response => (
+                CustomInfoRequest::default(),
+                CustomInfoResp {
+                    status: L7ResponseStatus::try_from(self.status).map_err(|e| e.to_string())?,
+                    code: if self.code == RESP_CODE_NULL {
+                        None
+                    } else {
+                        Some(self.code)
+                    },
+                    exception: self.exception.to_string(arena).unwrap_or_default(),
+                    result: self.result.to_string(arena).unwrap_or_default(),
+                    req_type: self.req_type.to_string(arena).unwrap_or_default(),
+                    endpoint: self.endpoint.to_string(arena).unwrap_or_default(),
+                },
+            ),
+            _ => return Err(format!("msg type {} invalid", self.msg_type)),
+        };
+
+        Ok(CustomInfo {
+            msg_type,
+            req_len: if self.req_len > 0 {
+                Some(self.req_len as u32)
+            } else {
+                None
+            },
+            resp_len: if self.resp_len > 0 {
+                Some(self.resp_len as u32)
+            } else {
+                None
+            },
+            request_id: if self.has_request_id > 0 {
+                Some(self.request_id)
+            } else {
+                None
+            },
+            req,
+            resp,
+            trace: CustomInfoTrace {
+                trace_ids: self.trace_id.to_string(arena).into_iter().collect(),
+                span_id: self.span_id.to_string(arena),
+                parent_span_id: self.parent_span_id.to_string(arena),
+                ..Default::default()
+            },
+            attributes: self
+                .attributes
+                .read(arena)
+                .map(|b| read_attr(b, self.attr_len))
+                .unwrap_or_default(),
+            ..Default::default()
+        })
+    }
+}
+
 #[repr(C)]
 pub struct CheckResult {
     pub proto: u8,
@@ -333,11 +469,22 @@ pub struct CheckResult {
     pub direction: u8,
 }
 
+impl Default for CheckResult {
+    fn default() -> Self {
+        Self {
+            proto: 0,
+            proto_name: [0; 16],
+            direction: 0,
+        }
+    }
+}
+
 pub const ACTION_ERROR: u8 = 0;
 pub const ACTION_CONTINUE: u8 = 1;
 pub const ACTION_OK: u8 = 2;
 
 #[repr(C)]
+#[derive(Default)]
 pub struct ParseResult {
     pub action: u8,
     pub len: i32,
@@ -349,16 +496,42 @@ pub type CheckPayloadCFunc = unsafe extern "C" fn(*const ParseCtx) -> CheckResul
 pub type ParsePayloadCFunc =
     unsafe extern "C" fn(*const ParseCtx, *mut ParseInfo, info_max_len: i32) -> ParseResult;
 
+pub type CheckPayloadBatchCFunc =
+    unsafe extern "C" fn(ctxs: *mut ParseCtxV2, n: i32, results: *mut CheckResult);
+
+pub type ParsePayloadBatchCFunc = unsafe extern "C" fn(
+    ctxs: *mut ParseCtxV2,
+    n: i32,
+    results: *mut ParseResult,
+    infos: *mut ParseInfoV2,
+    infos_len: i32,
+    arena: *mut ParseArena,
+);
+
+pub type FreeStateCFunc = unsafe extern "C" fn(state: *mut c_void);
+
+#[derive(Clone, Copy)]
+pub enum SoPluginAbi {
+    V1 {
+        check_payload: CheckPayloadCFunc,
+        // due to C can not return variable length data, use the consistent length `result_max_len` as length of ParseResult array
+        // return < 0 indicate fail, >=0 assume success
+        parse_payload: ParsePayloadCFunc,
+    },
+    V2 {
+        check_payload_batch: CheckPayloadBatchCFunc,
+        parse_payload_batch: ParsePayloadBatchCFunc,
+        free_state: Option<FreeStateCFunc>,
+    },
+}
+
 #[derive(Clone)]
 pub struct SoPluginFunc {
     pub hash: String,
     pub name: String,
     pub check_payload_counter: Arc<SoPluginCounter>,
     pub parse_payload_counter: Arc<SoPluginCounter>,
-    pub check_payload: CheckPayloadCFunc,
-    // due to C can not return variable length data, use the consistent length `result_max_len` as length of ParseResult array
-    // return < 0 indicate fail, >=0 assume success
-    pub parse_payload: ParsePayloadCFunc,
+    pub abi: SoPluginAbi,
 }
 
 impl PartialEq for SoPluginFunc {
@@ -371,10 +544,14 @@ impl Eq for SoPluginFunc {}
 
 impl SoPluginFunc {
     pub fn counters_in<'a>(&'a self, counters: &mut Vec<PluginCounterInfo<'a>>) {
+        let (check_sym, parse_sym) = match self.abi {
+            SoPluginAbi::V1 { .. } => (CHECK_PAYLOAD_FUNC_SYM, PARSE_PAYLOAD_FUNC_SYM),
+            SoPluginAbi::V2 { .. } => (CHECK_PAYLOAD_BATCH_FUNC_SYM, PARSE_PAYLOAD_BATCH_FUNC_SYM),
+        };
         counters.push(PluginCounterInfo {
             plugin_name: self.name.as_str(),
             plugin_type: "so",
-            function_name: CHECK_PAYLOAD_FUNC_SYM,
+            function_name: check_sym,
             counter: Countable::Ref(
                 Arc::downgrade(&self.check_payload_counter) as Weak<dyn RefCountable>
             ),
@@ -382,7 +559,7 @@ impl SoPluginFunc {
         counters.push(PluginCounterInfo {
             plugin_name: self.name.as_str(),
             plugin_type: "so",
-            function_name: PARSE_PAYLOAD_FUNC_SYM,
+            function_name: parse_sym,
             counter: Countable::Ref(
                 Arc::downgrade(&self.parse_payload_counter) as Weak<dyn RefCountable>
             ),
@@ -25,8 +25,11 @@ use libc::c_void;
 use md5::{Digest, Md5};
 use public::counter::{CounterType, CounterValue, RefCountable};
 
-use super::c_ffi::SoPluginFunc;
-use super::c_ffi::{CHECK_PAYLOAD_FUNC_SYM, INIT_FUNC_SYM, PARSE_PAYLOAD_FUNC_SYM};
+use super::c_ffi::{SoPluginAbi, SoPluginFunc};
+use super::c_ffi::{
+    CHECK_PAYLOAD_BATCH_FUNC_SYM, CHECK_PAYLOAD_FUNC_SYM, FREE_STATE_FUNC_SYM, INIT_FUNC_SYM,
+    PARSE_PAYLOAD_BATCH_FUNC_SYM, PARSE_PAYLOAD_FUNC_SYM,
+};
 
 pub fn load_plugin(plugin: &[u8], name: &String) -> Result<SoPluginFunc, String> {
     let file_name = CString::new(name.as_bytes()).unwrap();
@@ -40,7 +43,7 @@ pub fn load_plugin(plugin: &[u8], name: &String) -> Result<SoPluginFunc, String>
 
         there is impossible to verify the function signature correctness, export the function sym with wrong param and return type is UB
     */
-    let (check_func, parse_func) = unsafe {
+    let abi = unsafe {
         if libc::write(fd, plugin.as_ptr() as *const c_void, plugin.len()) != plugin.len() as isize
         {
             libc::close(fd);
@@ -70,19 +73,33 @@ pub fn load_plugin(plugin: &[u8], name: &String) -> Result<SoPluginFunc, String>
             }
         };
 
-        let (init_func, check_func, parse_func) = (
-            get_func(INIT_FUNC_SYM)?,
-            get_func(CHECK_PAYLOAD_FUNC_SYM)?,
-            get_func(PARSE_PAYLOAD_FUNC_SYM)?,
-        );
+        // optional symbols, absent is not an error
+        let find_func = |sym: &str| {
+            let func_sym = CString::new(sym).unwrap();
+            let func = libc::dlsym(handle, func_sym.as_ptr());
+            (!func.is_null()).then_some(func)
+        };
+
+        let init_func = get_func(INIT_FUNC_SYM)?;
+        // the plugin exporting on_parse_payload_batch uses ABI v2
+        let abi = match find_func(PARSE_PAYLOAD_BATCH_FUNC_SYM) {
+            Some(parse_func) => SoPluginAbi::V2 {
+                check_payload_batch: std::mem::transmute(get_func(
+                    CHECK_PAYLOAD_BATCH_FUNC_SYM,
+                )?),
+                parse_payload_batch: std::mem::transmute(parse_func),
+                free_state: find_func(FREE_STATE_FUNC_SYM).map(|f| std::mem::transmute(f)),
+            },
+            None => SoPluginAbi::V1 {
+                check_payload: std::mem::transmute(get_func(CHECK_PAYLOAD_FUNC_SYM)?),
+                parse_payload: std::mem::transmute(get_func(PARSE_PAYLOAD_FUNC_SYM)?),
+            },
+        };
         libc::close(fd);
         let init: extern "C" fn() = std::mem::transmute(init_func);
         init();
 
-        (
-            std::mem::transmute(check_func),
-            std::mem::transmute(parse_func),
-        )
+        abi
     };
     Ok(SoPluginFunc {
         hash: Md5::digest(plugin)
@@ -91,8 +108,7 @@ pub fn load_plugin(plugin: &[u8], name: &String) -> Result<SoPluginFunc, String>
         name: name.clone(),
         check_payload_counter: Default::default(),
         parse_payload_counter: Default::default(),
-        check_payload: check_func,
-        parse_payload: parse_func,
+        abi,
     })
 }
 
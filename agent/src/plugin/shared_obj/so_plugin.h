@@ -110,6 +110,8 @@ struct parse_info {
 struct check_result {
     unsigned char proto;
     unsigned char proto_name[16];
+    // 1 is request, 2 is response, other value is unknown
+    unsigned char direction;
 };
 
 // reference src/plugin/c_ffi.rs struct ParseResult 
@@ -132,4 +134,81 @@ struct parse_result on_parse_payload(struct parse_ctx *ctx,
 // invoke after dlopen, only call once
 void init();
 
+/*
+    ABI v2
+
+    The plugin exports on_check_payload_batch and on_parse_payload_batch
+    instead of on_check_payload and on_parse_payload, when both are
+    exported the v2 functions are used.
+
+    - the functions take an array of `n` contexts, results are written to the
+      arrays of the same index, so the agent can hand several payloads over
+      in one call.
+    - the strings of parse_info_v2 are written to the arena provided by the
+      agent and referenced by offset and length, instead of the fixed size
+      arrays of parse_info, the plugin only writes the bytes it needs.
+    - every context carries `state`, an opaque pointer owned by the plugin
+      and kept by the agent per connection, it is NULL on the first call. The
+      agent calls on_free_state (if exported) when the connection is gone.
+*/
+
+// reference src/plugin/c_ffi.rs struct ParseCtxV2
+struct parse_ctx_v2 {
+    struct parse_ctx ctx;
+    void *state;
+};
+
+// reference src/plugin/c_ffi.rs struct ArenaStr
+// the string is arena->buf[off, off + len), len 0 is empty
+struct arena_str {
+    unsigned int off;
+    unsigned int len;
+};
+
+// reference src/plugin/c_ffi.rs struct ParseArena
+struct parse_arena {
+    unsigned char *buf;
+    unsigned int cap;
+    // the plugin appends at buf[used] and updates used, never beyond cap
+    unsigned int used;
+};
+
+// reference src/plugin/c_ffi.rs struct ParseInfoV2
+struct parse_info_v2 {
+    unsigned char msg_type;
+    unsigned char status;
+    char has_request_id;
+    unsigned int request_id;
+    int req_len;
+    int resp_len;
+    // RESP_CODE_NULL if the response has no code
+    int code;
+    struct arena_str trace_id;
+    struct arena_str span_id;
+    struct arena_str parent_span_id;
+    struct arena_str req_type;
+    struct arena_str domain;
+    struct arena_str resource;
+    struct arena_str endpoint;
+    struct arena_str exception;
+    struct arena_str result;
+    unsigned int attr_len;
+    // format: repeated (${key bytes}\0${val bytes}\0)
+    struct arena_str attributes;
+};
+
+/*
+    the results of ctxs[i] are written to results[i], the infos of all the
+    contexts share `infos` and the arena, results[i].len is the number of
+    infos used by ctxs[i], they are consecutive and in the order of ctxs.
+*/
+void on_check_payload_batch(struct parse_ctx_v2 *ctxs, int n,
+                            struct check_result *results);
+void on_parse_payload_batch(struct parse_ctx_v2 *ctxs, int n,
+                            struct parse_result *results,
+                            struct parse_info_v2 *infos, int infos_len,
+                            struct parse_arena *arena);
+// optional, release the state of a connection
+void on_free_state(void *state);
+
 #endif
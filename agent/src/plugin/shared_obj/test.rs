@@ -45,6 +45,7 @@ use crate::{
 };
 
 use super::{load_plugin, SoPluginFunc};
+use crate::plugin::c_ffi::SoPluginAbi;
 
 fn get_plugin() -> SoPluginFunc {
     // the so source code lcoate in resources/test/plugins/so_plugin_test.c
@@ -55,6 +56,15 @@ fn get_plugin() -> SoPluginFunc {
     load_plugin(b.as_slice(), &"test".into()).unwrap()
 }
 
+fn get_plugin_v2() -> SoPluginFunc {
+    // the so source code lcoate in resources/test/plugins/so_plugin_v2_test.c
+    let mut f = fs::File::open("resources/test/plugins/so_plugin_v2_test").unwrap();
+    let mut b = vec![];
+    f.read_to_end(&mut b).unwrap();
+
+    load_plugin(b.as_slice(), &"test_v2".into()).unwrap()
+}
+
 fn get_req_param<'a>(
     rrt_cache: Rc<RefCell<L7PerfCache>>,
     plugin: Rc<RefCell<Option<Vec<SoPluginFunc>>>>,
@@ -74,6 +84,7 @@ fn get_req_param<'a>(
             is_req_end: false,
             is_resp_end: false,
             process_kname: "test_wasm",
+            http1_index: None,
         }),
         packet_start_seq: 9999999,
         packet_end_seq: 9999999,
@@ -115,6 +126,7 @@ fn get_resp_param<'a>(
             is_req_end: false,
             is_resp_end: false,
             process_kname: "test_wasm",
+            http1_index: None,
         }),
         packet_start_seq: 9999999,
         packet_end_seq: 9999999,
@@ -243,3 +255,66 @@ fn test_parse() {
     assert_eq!(stat.rrt_max, 1);
     assert_eq!(stat.rrt_sum, 1);
 }
+
+#[test]
+fn test_parse_v2() {
+    let plugin = get_plugin_v2();
+    assert!(matches!(plugin.abi, SoPluginAbi::V2 { free_state: Some(_), .. }));
+    let plugin = Rc::new(RefCell::new(Some(vec![plugin])));
+
+    let rrt_cache = Rc::new(RefCell::new(L7PerfCache::new(100)));
+    let param = get_req_param(rrt_cache.clone(), plugin.clone());
+    let mut p = SoLog::default();
+    assert!(p.check_payload(&REQ_PAYLOAD, &param) == Some(LogMessageType::Request));
+
+    let mut p = get_so_parser(1, "dns".into());
+    let infos = p.parse_payload(&REQ_PAYLOAD, &param).unwrap();
+    let info = infos.unwrap_single();
+
+    if let L7ProtocolInfo::CustomInfo(info) = info {
+        assert_eq!(info.msg_type, LogMessageType::Request);
+        assert_eq!(info.request_id.unwrap(), 15014);
+        assert_eq!(info.req.req_type, "A");
+        assert_eq!(info.req.domain.as_str(), "baidu.com.");
+        assert_eq!(
+            info.trace.trace_ids.first().unwrap().as_str(),
+            "this is trace id"
+        );
+        assert_eq!(
+            info.trace.parent_span_id.as_ref().unwrap().as_str(),
+            "this is parent span id"
+        );
+        assert_eq!(
+            info.attributes.last().unwrap(),
+            &KeyVal {
+                key: "calls".into(),
+                val: "1".into(),
+            }
+        );
+    } else {
+        unreachable!()
+    }
+
+    // the state of the connection is kept by the parser
+    let param = get_resp_param(rrt_cache, plugin.clone());
+    let infos = p.parse_payload(&RESP_PAYLOAD, &param).unwrap();
+    let info = infos.unwrap_single();
+
+    if let L7ProtocolInfo::CustomInfo(info) = info {
+        assert_eq!(info.msg_type, LogMessageType::Response);
+        assert_eq!(info.request_id.unwrap(), 15014);
+        assert_eq!(info.resp.code.unwrap(), 0);
+        assert_eq!(info.resp.result.as_str(), "110.242.68.66");
+        assert_eq!(info.resp.status, L7ResponseStatus::Ok);
+        assert_eq!(info.attributes.len(), 3);
+        assert_eq!(
+            info.attributes.last().unwrap(),
+            &KeyVal {
+                key: "calls".into(),
+                val: "2".into(),
+            }
+        );
+    } else {
+        unreachable!()
+    }
+}
@@ -65,6 +65,7 @@ fn get_req_param<'a>(
             is_req_end: false,
             is_resp_end: false,
             process_kname: "test_wasm",
+            http1_index: None,
         }),
         packet_start_seq: 9999999,
         packet_end_seq: 9999999,
@@ -107,6 +108,7 @@ fn get_resq_param<'a>(
             is_req_end: false,
             is_resp_end: false,
             process_kname: "test_wasm",
+            http1_index: None,
         }),
         packet_start_seq: 9999999,
         packet_end_seq: 9999999,
@@ -230,6 +230,7 @@ func (x *XDPPacket) readMultiPackets() {
 	if x.rxN < 1 {
 		x.RxEmpty++
 		x.rxErr = ErrRxQueueEmpty
+		x.busyPollIfEnabled()
 		return
 	}
 	x.rxErr = nil
@@ -241,6 +242,15 @@ func (x *XDPPacket) readMultiPackets() {
 	}
 }
 
+// 忙轮询模式下，rx队列为空时由收包线程驱动网卡收包，
+// 网卡中断被推迟，不调用则不会有新包到达
+func (x *XDPPacket) busyPollIfEnabled() {
+	if x.busyPoll {
+		x.kickBusyPoll()
+		x.Polls++
+	}
+}
+
 // 非阻塞模式的收包函数
 func (x *XDPPacket) nonblockMultiRead() {
 	x.rxErr = x.poll(x.rxFds)
@@ -291,13 +301,17 @@ func (x *XDPPacket) releaseMultiPackets() error {
 // 收包接口，零拷贝, 每次尽最大努力收包，最多一次收16个包
 // 函数返回后，请使用len([]CaptureInfo)获取读到的包数
 func (x *XDPPacket) ZeroCopyReadMultiPackets() ([][]byte, []CaptureInfo, error) {
+	return x.zeroCopyReadMultiPackets(x.multiRead)
+}
+
+func (x *XDPPacket) zeroCopyReadMultiPackets(read multiReadFunc) ([][]byte, []CaptureInfo, error) {
 	if x.CheckIfXDPSocketClosed() {
 		return nil, nil, ErrSocketClosed
 	}
 
 	x.releaseMultiPackets()
 
-	x.multiRead()
+	read()
 	if x.rxErr == nil {
 		totalBytes := uint32(0)
 		x.ci.Timestamp = time.Now()
@@ -337,6 +351,7 @@ func (x *XDPPacket) readOnePacket() {
 	if x.rx.dequeueOne(&x.rxDesc) < 1 {
 		x.RxEmpty++
 		x.rxErr = ErrRxQueueEmpty
+		x.busyPollIfEnabled()
 		return
 	}
 
@@ -733,6 +748,14 @@ func NewXDPPacket(name string, opts ...interface{}) (*XDPPacket, error) {
 		return nil, err
 	}
 
+	if loadProg {
+		err = xdp.SetFilter(options.filter)
+		if err != nil {
+			xdp.Close()
+			return nil, err
+		}
+	}
+
 	if config == nil || config.UsedQueueCount < xdp.options.queueCount {
 		err = xdp.setInterfaceRecvQueues()
 		if err != nil {
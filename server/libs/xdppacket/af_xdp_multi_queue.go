@@ -70,6 +70,12 @@ func (m *XDPMultiQueue) initSockets() error {
 		atomic.AddInt32(&m.progRefCount, 1)
 	}
 
+	err := combined.SetFilter(m.options.filter)
+	if err != nil {
+		m.Close()
+		return err
+	}
+
 	return m.xsks[0].setInterfaceRecvQueues()
 }
 
@@ -172,6 +178,10 @@ func (m *XDPMultiQueue) ZeroCopyReadMultiPackets() ([][]byte, []CaptureInfo, err
 	var pkts [][]byte
 	var cis []CaptureInfo
 
+	if m.busyPollEnabled() {
+		return m.busyPollReadMultiPackets()
+	}
+
 	m.ReleaseReadPacket()
 	for idx, s := range m.xsks {
 		pkts, cis, err = s.ZeroCopyReadMultiPackets()
@@ -186,6 +196,48 @@ func (m *XDPMultiQueue) ZeroCopyReadMultiPackets() ([][]byte, []CaptureInfo, err
 	return m.batch, m.cis, err
 }
 
+// setBusyPoll在内核5.11以下失败时socket不使用忙轮询
+func (m *XDPMultiQueue) busyPollEnabled() bool {
+	for _, s := range m.xsks {
+		if s.busyPoll {
+			return true
+		}
+	}
+	return false
+}
+
+// 忙轮询模式下，依次非阻塞地读取各队列，空队列驱动网卡收包后跳过，
+// 不阻塞其它队列; 未开启忙轮询的socket仍阻塞读取, 避免空转;
+// 所有队列均为空时返回ErrRxQueueEmpty
+func (m *XDPMultiQueue) busyPollReadMultiPackets() ([][]byte, []CaptureInfo, error) {
+	var pkts [][]byte
+	var cis []CaptureInfo
+	var err error
+
+	m.ReleaseReadPacket()
+	for idx, s := range m.xsks {
+		if s.busyPoll {
+			pkts, cis, err = s.zeroCopyReadMultiPackets(s.readMultiPackets)
+		} else {
+			pkts, cis, err = s.ZeroCopyReadMultiPackets()
+		}
+		if err == ErrRxQueueEmpty {
+			continue
+		}
+		if err != nil {
+			log.Debugf("queue %v ZeroCopyReadPacket failed as %v", s.queueId, err)
+			return m.batch, m.cis, err
+		}
+		m.batch = append(m.batch, pkts...)
+		m.cis = append(m.cis, cis...)
+		m.socketIdx = append(m.socketIdx, idx)
+	}
+	if len(m.batch) == 0 {
+		return m.batch, m.cis, ErrRxQueueEmpty
+	}
+	return m.batch, m.cis, nil
+}
+
 func (m *XDPMultiQueue) ReleaseReadPacket() error {
 	m.batch = m.batch[:0]
 	m.socketIdx = m.socketIdx[:0]
@@ -261,6 +313,25 @@ func (m *XDPMultiQueue) GetStatsDetail() *XDPMultiQueueStats {
 	}
 }
 
+// 更新网卡上ebpf程序的过滤条件，对所有队列生效，nil表示清除
+func (m *XDPMultiQueue) SetFilter(filter *XDPFilter) error {
+	return m.xsks[0].SetFilter(filter)
+}
+
+// 各队列在ebpf程序中的统计(收包、重定向、过滤、采样、无socket)
+func (m *XDPMultiQueue) GetQueueKernelStats() ([]XDPQueueKernelStats, error) {
+	stats := make([]XDPQueueKernelStats, 0, len(m.xsks))
+	for _, s := range m.xsks {
+		// 共享同一个ebpf程序，使用第一个socket的map
+		st, err := m.xsks[0].getQueueKernelStats(s.queueId)
+		if err != nil {
+			return nil, err
+		}
+		stats = append(stats, st)
+	}
+	return stats, nil
+}
+
 func (x *XDPMultiQueue) ClearEbpfProg() {
 	if x == nil {
 		return
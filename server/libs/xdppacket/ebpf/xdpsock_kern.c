@@ -1,18 +1,217 @@
 // SPDX-License-Identifier: GPL-2.0
 #include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
 #include "bpf_helpers.h"
 
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define bpf_htons(x) __builtin_bswap16(x)
+#else
+#define bpf_htons(x) (x)
+#endif
+#define bpf_ntohs(x) bpf_htons(x)
+
+#ifndef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#endif
+
+// 与xdp_options.go中的MAX_QUEUE_COUNT保持一致
+#define MAX_QUEUES 256
+
+#define FILTER_F_VLAN   (1 << 0)
+#define FILTER_F_PROTO  (1 << 1)
+#define FILTER_F_SRC_IP (1 << 2)
+#define FILTER_F_DST_IP (1 << 3)
+#define FILTER_F_PORT   (1 << 4)
+// 未命中过滤条件或被采样丢弃的包XDP_DROP, 否则XDP_PASS交给协议栈
+#define FILTER_F_DROP   (1 << 5)
+
+#define FILTER_F_L3 (FILTER_F_PROTO | FILTER_F_SRC_IP | FILTER_F_DST_IP | FILTER_F_PORT)
+
+// 与xdp_socket.go中的struct xdp_filter保持一致
+struct xdp_filter {
+	__u32 flags;
+	// 每sample_ratio个包重定向1个到用户态, 0和1表示不采样
+	__u32 sample_ratio;
+	// 网络字节序, 仅匹配IPv4
+	__u32 src_ip;
+	__u32 src_mask;
+	__u32 dst_ip;
+	__u32 dst_mask;
+	__u16 vlan;
+	// 源端口或目的端口在[port_min, port_max]内即命中
+	__u16 port_min;
+	__u16 port_max;
+	__u8 proto;
+	// 队列上没有socket时bpf_redirect_map的返回值, 由用户态按内核版本设置:
+	// 内核5.3之前flags非0时直接返回XDP_ABORTED, 只能为0
+	__u8 redirect_flags;
+};
+
+// 与xdp_socket.go中的struct xdp_queue_stats保持一致
+struct xdp_queue_stats {
+	__u64 rx;
+	__u64 redirected;
+	__u64 filtered;
+	__u64 sampled;
+	__u64 no_socket;
+};
+
+struct vlan_hdr {
+	__be16 h_vlan_TCI;
+	__be16 h_vlan_encapsulated_proto;
+};
+
 struct bpf_map_def SEC("maps") xsks_map = {
 	.type = BPF_MAP_TYPE_XSKMAP,
 	.key_size = sizeof(int),
 	.value_size = sizeof(int),
-	.max_entries = 64,
+	.max_entries = MAX_QUEUES,
+};
+
+struct bpf_map_def SEC("maps") filter_map = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(int),
+	.value_size = sizeof(struct xdp_filter),
+	.max_entries = 1,
 };
 
+struct bpf_map_def SEC("maps") queue_stats_map = {
+	.type = BPF_MAP_TYPE_PERCPU_ARRAY,
+	.key_size = sizeof(int),
+	.value_size = sizeof(struct xdp_queue_stats),
+	.max_entries = MAX_QUEUES,
+};
+
+static __always_inline int port_match(struct xdp_filter *f, __u16 port)
+{
+	return port >= f->port_min && port <= f->port_max;
+}
+
+// 返回1表示命中过滤条件
+static __always_inline int filter_match(struct xdp_md *ctx, struct xdp_filter *f)
+{
+	void *data = (void *)(long)ctx->data;
+	void *data_end = (void *)(long)ctx->data_end;
+	struct ethhdr *eth = data;
+	struct udphdr *l4 = 0;
+	__u16 vlan = 0;
+	__u8 proto = 0;
+	__be16 eth_proto;
+	void *l3;
+
+	if ((void *)(eth + 1) > data_end)
+		return 0;
+	eth_proto = eth->h_proto;
+	l3 = eth + 1;
+
+	if (eth_proto == bpf_htons(ETH_P_8021Q) ||
+	    eth_proto == bpf_htons(ETH_P_8021AD)) {
+		struct vlan_hdr *vh = l3;
+		if ((void *)(vh + 1) > data_end)
+			return 0;
+		vlan = bpf_ntohs(vh->h_vlan_TCI) & 0x0fff;
+		eth_proto = vh->h_vlan_encapsulated_proto;
+		l3 = vh + 1;
+	}
+
+	if ((f->flags & FILTER_F_VLAN) && vlan != f->vlan)
+		return 0;
+	if (!(f->flags & FILTER_F_L3))
+		return 1;
+
+	if (eth_proto == bpf_htons(ETH_P_IP)) {
+		struct iphdr *ip = l3;
+		if ((void *)(ip + 1) > data_end)
+			return 0;
+		if ((f->flags & FILTER_F_SRC_IP) &&
+		    (ip->saddr & f->src_mask) != f->src_ip)
+			return 0;
+		if ((f->flags & FILTER_F_DST_IP) &&
+		    (ip->daddr & f->dst_mask) != f->dst_ip)
+			return 0;
+		if (ip->ihl < 5)
+			return 0;
+		proto = ip->protocol;
+		// 非首分片没有L4头
+		if (!(ip->frag_off & bpf_htons(0x1fff)))
+			l4 = (void *)ip + ip->ihl * 4;
+	} else if (eth_proto == bpf_htons(ETH_P_IPV6)) {
+		struct ipv6hdr *ip6 = l3;
+		if (f->flags & (FILTER_F_SRC_IP | FILTER_F_DST_IP))
+			return 0;
+		if ((void *)(ip6 + 1) > data_end)
+			return 0;
+		// 不解析扩展头
+		proto = ip6->nexthdr;
+		l4 = (void *)(ip6 + 1);
+	} else {
+		return 0;
+	}
+
+	if ((f->flags & FILTER_F_PROTO) && proto != f->proto)
+		return 0;
+
+	if (f->flags & FILTER_F_PORT) {
+		// TCP和UDP头的前4个字节均为源端口和目的端口
+		if (!l4 || (proto != IPPROTO_TCP && proto != IPPROTO_UDP))
+			return 0;
+		if ((void *)l4 + 4 > data_end)
+			return 0;
+		if (!port_match(f, bpf_ntohs(l4->source)) &&
+		    !port_match(f, bpf_ntohs(l4->dest)))
+			return 0;
+	}
+
+	return 1;
+}
+
 SEC("xdp_sock")
 int xdp_sock_prog(struct xdp_md *ctx)
 {
-    return bpf_redirect_map(&xsks_map, ctx->rx_queue_index, 0);
+	int qid = ctx->rx_queue_index, key = 0;
+	struct xdp_queue_stats *stats;
+	struct xdp_filter *f;
+	int miss_action = XDP_PASS;
+	__u64 redirect_flags = 0;
+	int ret;
+
+	stats = bpf_map_lookup_elem(&queue_stats_map, &qid);
+	if (stats)
+		stats->rx++;
+
+	f = bpf_map_lookup_elem(&filter_map, &key);
+	if (f) {
+		redirect_flags = f->redirect_flags;
+		if (f->flags & FILTER_F_DROP)
+			miss_action = XDP_DROP;
+
+		if (f->flags && !filter_match(ctx, f)) {
+			if (stats)
+				stats->filtered++;
+			return miss_action;
+		}
+
+		if (f->sample_ratio > 1 &&
+		    bpf_get_prandom_u32() % f->sample_ratio != 0) {
+			if (stats)
+				stats->sampled++;
+			return miss_action;
+		}
+	}
+
+	// 内核5.3起, 队列上没有socket时返回flags的低位, 用户态设置为XDP_PASS
+	ret = bpf_redirect_map(&xsks_map, qid, redirect_flags);
+	if (stats) {
+		if (ret == XDP_REDIRECT)
+			stats->redirected++;
+		else
+			stats->no_socket++;
+	}
+	return ret;
 }
 
 char _license[] SEC("license") = "GPL";
@@ -21,6 +21,7 @@ package xdppacket
 
 import (
 	"fmt"
+	"net"
 	"time"
 
 	"golang.org/x/sys/unix"
@@ -35,6 +36,9 @@ type OptQueueID uint32
 type OptPollTimeout time.Duration
 type OptIoMode uint32
 
+// 忙轮询每次处理的包数量, 0表示不使用忙轮询
+type OptBusyPoll uint32
+
 type XDPOptions struct {
 	// rx,tx,fill,complete queues have same queue size and must be power of 2
 	ringSize uint32
@@ -61,6 +65,10 @@ type XDPOptions struct {
 	frameHeadroom uint32
 	// 批量发送时，每次发送的包数量
 	batchSize uint32
+	// 忙轮询budget, 0表示关闭
+	busyPollBudget uint32
+	// 内核态预过滤条件, 加载ebpf程序时设置
+	filter *XDPFilter
 }
 
 const (
@@ -71,7 +79,7 @@ const (
 	XDP_MODE_DRV OptXDPMode = unix.XDP_FLAGS_DRV_MODE
 	XDP_MODE_SKB OptXDPMode = unix.XDP_FLAGS_SKB_MODE
 
-	MAX_QUEUE_COUNT = 64
+	MAX_QUEUE_COUNT = 256
 )
 
 const (
@@ -102,6 +110,8 @@ const (
 	DFLT_FRAME_HEADROOM = 0
 	// 默认批量发送包数量：16
 	DFLT_BATCH_SIZE = 16
+	// 忙轮询时, 每次系统调用busy poll的时长(us)
+	DFLT_BUSY_POLL_USECS = 20
 )
 
 var defaultOpt = XDPOptions{
@@ -121,6 +131,56 @@ var defaultOpt = XDPOptions{
 	batchSize:     DFLT_BATCH_SIZE,
 }
 
+const (
+	FILTER_F_VLAN = 1 << iota
+	FILTER_F_PROTO
+	FILTER_F_SRC_IP
+	FILTER_F_DST_IP
+	FILTER_F_PORT
+	FILTER_F_DROP
+)
+
+// 内核态预过滤条件, 未命中或被采样丢弃的包不会送到用户态
+type XDPFilter struct {
+	VlanID      uint16     // 0表示不过滤
+	Protocol    uint8      // L4协议号, 0表示不过滤
+	SrcNet      *net.IPNet // 仅支持IPv4, 设置后IPv6包不命中
+	DstNet      *net.IPNet
+	PortMin     uint16 // 源端口或目的端口在[PortMin, PortMax]内即命中, 均为0表示不过滤
+	PortMax     uint16
+	SampleRatio uint32 // 每SampleRatio个包送1个到用户态, 0和1表示不采样
+	// 未命中的包默认交给协议栈(XDP_PASS), 设置后直接丢弃(XDP_DROP)
+	DropUnmatched bool
+}
+
+// ebpf程序的队列统计
+type XDPQueueKernelStats struct {
+	QueueID    int
+	Rx         uint64 // 队列收到的包
+	Redirected uint64 // 送到XDP socket的包
+	Filtered   uint64 // 未命中过滤条件的包
+	Sampled    uint64 // 被采样丢弃的包
+	NoSocket   uint64 // 队列上没有XDP socket, 交给协议栈的包
+}
+
+func (f *XDPFilter) validate() error {
+	if f.SrcNet != nil && (f.SrcNet.IP.To4() == nil || len(f.SrcNet.Mask) != net.IPv4len) {
+		return fmt.Errorf("source net(%v) is not IPv4", f.SrcNet)
+	}
+	if f.DstNet != nil && (f.DstNet.IP.To4() == nil || len(f.DstNet.Mask) != net.IPv4len) {
+		return fmt.Errorf("destination net(%v) is not IPv4", f.DstNet)
+	}
+	if f.PortMin > f.PortMax {
+		return fmt.Errorf("port range [%v, %v] is invalid", f.PortMin, f.PortMax)
+	}
+	return nil
+}
+
+func (f XDPFilter) String() string {
+	return fmt.Sprintf("XDPFilter: vlan:%v, protocol:%v, src:%v, dst:%v, port:[%v, %v], sampleRatio:%v, dropUnmatched:%v",
+		f.VlanID, f.Protocol, f.SrcNet, f.DstNet, f.PortMin, f.PortMax, f.SampleRatio, f.DropUnmatched)
+}
+
 func isPowerOfTwo(n uint32) bool {
 	return (n != 0 && (n&(n-1)) == 0)
 }
@@ -158,6 +218,13 @@ func parseOptions(options ...interface{}) (*XDPOptions, error) {
 			option.ioMode = v
 		case OptQueueID:
 			option.queueID = uint32(v)
+		case OptBusyPoll:
+			option.busyPollBudget = uint32(v)
+		case XDPFilter:
+			filter := v
+			option.filter = &filter
+		case *XDPFilter:
+			option.filter = v
 		default:
 			return nil, fmt.Errorf("unknown option(%v)", opt)
 		}
@@ -192,6 +259,12 @@ func (o *XDPOptions) check() error {
 		return fmt.Errorf("queueID(%d) must be less than queueCount(%d)", o.queueID, o.queueCount)
 	}
 
+	if o.filter != nil {
+		if err := o.filter.validate(); err != nil {
+			return err
+		}
+	}
+
 	if o.ringSize > o.numFrames {
 		return fmt.Errorf("ring size(%v) must not greater than number of frames(%v)",
 			o.ringSize, o.numFrames)
@@ -227,6 +300,6 @@ func (m OptIoMode) String() string {
 func (o XDPOptions) String() string {
 	return fmt.Sprintf("XDPOptions:\n\tringSize:%v, numFrames:%v, frameSize:%v, "+
 		"xdpMode:%v, queueCount:%v, queueID:%v, pollTimeout:%v, ioMode:%v, frameMask:%v, frameHeadroom:%v, "+
-		"batchSize:%v", o.ringSize, o.numFrames, o.frameSize, o.xdpMode, o.queueCount, o.queueID,
-		o.pollTimeout, o.ioMode, o.frameMask, o.frameHeadroom, o.batchSize)
+		"batchSize:%v, busyPollBudget:%v, filter:%v", o.ringSize, o.numFrames, o.frameSize, o.xdpMode, o.queueCount, o.queueID,
+		o.pollTimeout, o.ioMode, o.frameMask, o.frameHeadroom, o.batchSize, o.busyPollBudget, o.filter)
 }
@@ -38,6 +38,7 @@ package xdppacket
 #include <unistd.h>
 #include <sys/resource.h>
 #include <bpf/libbpf.h>
+#include <bpf/bpf.h>
 #include <sys/socket.h>
 #include <net/if.h>
 
@@ -198,6 +199,101 @@ int del_ebpf_map(int xsks_map_fd, int queue_id) {
 
 	return 0;
 }
+
+// 与ebpf/xdpsock_kern.c中的定义保持一致
+struct xdp_filter {
+	__u32 flags;
+	__u32 sample_ratio;
+	__u32 src_ip;
+	__u32 src_mask;
+	__u32 dst_ip;
+	__u32 dst_mask;
+	__u16 vlan;
+	__u16 port_min;
+	__u16 port_max;
+	__u8 proto;
+	__u8 redirect_flags;
+};
+
+struct xdp_queue_stats {
+	__u64 rx;
+	__u64 redirected;
+	__u64 filtered;
+	__u64 sampled;
+	__u64 no_socket;
+};
+
+// 6. 根据名称查找ebpf程序使用的map, 返回map fd, 调用者负责关闭
+int get_prog_map_fd(int prog_fd, const char *name) {
+	struct bpf_prog_info prog_info = {};
+	struct bpf_map_info map_info = {};
+	__u32 info_len = sizeof(prog_info);
+	__u32 map_ids[16];
+	int i, fd;
+
+	prog_info.nr_map_ids = sizeof(map_ids) / sizeof(map_ids[0]);
+	prog_info.map_ids = (__u64)(unsigned long)map_ids;
+	if (bpf_obj_get_info_by_fd(prog_fd, &prog_info, &info_len)) {
+		fprintf(stderr, "ERROR: get prog(fd:%d) info failed as %s\n",
+			prog_fd, strerror(errno));
+		return -1;
+	}
+
+	for (i = 0; i < prog_info.nr_map_ids && i < sizeof(map_ids) / sizeof(map_ids[0]); i++) {
+		fd = bpf_map_get_fd_by_id(map_ids[i]);
+		if (fd < 0)
+			continue;
+		info_len = sizeof(map_info);
+		memset(&map_info, 0, sizeof(map_info));
+		if (bpf_obj_get_info_by_fd(fd, &map_info, &info_len) == 0 &&
+		    strcmp(map_info.name, name) == 0)
+			return fd;
+		close(fd);
+	}
+
+	fprintf(stderr, "ERROR: map %s not found in prog(fd:%d)\n", name, prog_fd);
+	return -1;
+}
+
+// 7. 更新内核过滤条件
+int set_xdp_filter(int filter_map_fd, struct xdp_filter *filter) {
+	int key = 0;
+	if (bpf_map_update_elem(filter_map_fd, &key, filter, 0)) {
+		fprintf(stderr, "ERROR: update filter_map(fd:%d) failed as %s\n",
+			filter_map_fd, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// 8. 读取队列的内核统计, 累加各CPU的值
+int get_queue_stats(int stats_map_fd, int queue_id, struct xdp_queue_stats *stats) {
+	int i, ncpus = libbpf_num_possible_cpus();
+	struct xdp_queue_stats *values;
+
+	if (ncpus <= 0)
+		return -1;
+	values = calloc(ncpus, sizeof(*values));
+	if (values == NULL)
+		return -1;
+	if (bpf_map_lookup_elem(stats_map_fd, &queue_id, values)) {
+		fprintf(stderr, "ERROR: lookup queue_stats_map(fd:%d, queueId:%d) failed as %s\n",
+			stats_map_fd, queue_id, strerror(errno));
+		free(values);
+		return -1;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < ncpus; i++) {
+		stats->rx += values[i].rx;
+		stats->redirected += values[i].redirected;
+		stats->filtered += values[i].filtered;
+		stats->sampled += values[i].sampled;
+		stats->no_socket += values[i].no_socket;
+	}
+	free(values);
+	return 0;
+}
 */
 import "C"
 
@@ -219,6 +315,69 @@ import (
 
 const ERROR_FD = -1
 
+// 内核5.3起bpf_redirect_map在队列没有socket时返回flags中的XDP action,
+// 之前的内核flags非0时返回XDP_ABORTED, 因此仅在5.3及以上使用XDP_PASS
+var xdpRedirectFlags = getRedirectFlags()
+
+func getRedirectFlags() C.__u8 {
+	var uts unix.Utsname
+	var major, minor int
+	if err := unix.Uname(&uts); err != nil {
+		return 0
+	}
+	release := strings.TrimRight(string(uts.Release[:]), "\x00")
+	if _, err := fmt.Sscanf(release, "%d.%d", &major, &minor); err != nil {
+		return 0
+	}
+	if major > 5 || (major == 5 && minor >= 3) {
+		return C.__u8(C.XDP_PASS)
+	}
+	return 0
+}
+
+func ipv4ToC(ip net.IP) C.__u32 {
+	ip4 := ip.To4()
+	if ip4 == nil {
+		return 0
+	}
+	// 网络字节序
+	return C.__u32(*(*uint32)(unsafe.Pointer(&ip4[0])))
+}
+
+func (f *XDPFilter) toC() (*C.struct_xdp_filter, error) {
+	if err := f.validate(); err != nil {
+		return nil, err
+	}
+	cf := &C.struct_xdp_filter{sample_ratio: C.__u32(f.SampleRatio)}
+	if f.VlanID > 0 {
+		cf.flags |= FILTER_F_VLAN
+		cf.vlan = C.__u16(f.VlanID)
+	}
+	if f.Protocol > 0 {
+		cf.flags |= FILTER_F_PROTO
+		cf.proto = C.__u8(f.Protocol)
+	}
+	if f.SrcNet != nil {
+		cf.flags |= FILTER_F_SRC_IP
+		cf.src_ip = ipv4ToC(f.SrcNet.IP.Mask(f.SrcNet.Mask))
+		cf.src_mask = ipv4ToC(net.IP(f.SrcNet.Mask))
+	}
+	if f.DstNet != nil {
+		cf.flags |= FILTER_F_DST_IP
+		cf.dst_ip = ipv4ToC(f.DstNet.IP.Mask(f.DstNet.Mask))
+		cf.dst_mask = ipv4ToC(net.IP(f.DstNet.Mask))
+	}
+	if f.PortMin > 0 || f.PortMax > 0 {
+		cf.flags |= FILTER_F_PORT
+		cf.port_min = C.__u16(f.PortMin)
+		cf.port_max = C.__u16(f.PortMax)
+	}
+	if f.DropUnmatched {
+		cf.flags |= FILTER_F_DROP
+	}
+	return cf, nil
+}
+
 // XDP socket结构
 type XDPSocket struct {
 	sockFd  int
@@ -230,6 +389,10 @@ type XDPSocket struct {
 	progFd    int
 	xsksMapFd int
 	xdpMode   OptXDPMode
+	// 按需打开, 多队列时各socket共享
+	filterMapFd int
+	statsMapFd  int
+	busyPoll    bool
 
 	rx XDPDescQueue
 	tx XDPDescQueue
@@ -483,6 +646,95 @@ func delXDPSocketFdFromMap(xsksMapFd, queueId int) error {
 	return nil
 }
 
+func getProgMapFd(progFd int, name string) (int, error) {
+	cName := C.CString(name)
+	defer C.free(unsafe.Pointer(cName))
+	fd := int(C.get_prog_map_fd(C.int(progFd), cName))
+	if fd < 0 {
+		return ERROR_FD, fmt.Errorf("get map %v of prog(fd:%v) failed", name, progFd)
+	}
+	return fd, nil
+}
+
+// 更新网卡上ebpf程序的过滤条件, 对网卡的所有队列生效, nil表示清除
+// 加载ebpf程序后须调用一次, 以设置队列没有socket时的动作
+func (s *XDPSocket) SetFilter(filter *XDPFilter) error {
+	var err error
+	if s.progFd == ERROR_FD {
+		return ErrSocketClosed
+	}
+	cf := &C.struct_xdp_filter{}
+	if filter != nil {
+		if cf, err = filter.toC(); err != nil {
+			return err
+		}
+	}
+	cf.redirect_flags = xdpRedirectFlags
+	if s.filterMapFd == ERROR_FD {
+		if s.filterMapFd, err = getProgMapFd(s.progFd, "filter_map"); err != nil {
+			return err
+		}
+	}
+	if C.set_xdp_filter(C.int(s.filterMapFd), cf) != 0 {
+		return errors.New("update filter_map failed")
+	}
+	log.Infof("set interface(%v) xdp filter: %v", s.ifIndex, filter)
+	return nil
+}
+
+// 读取ebpf程序中队列queueId的统计
+func (s *XDPSocket) getQueueKernelStats(queueId int) (XDPQueueKernelStats, error) {
+	var err error
+	stats := XDPQueueKernelStats{QueueID: queueId}
+	if s.progFd == ERROR_FD {
+		return stats, ErrSocketClosed
+	}
+	if s.statsMapFd == ERROR_FD {
+		if s.statsMapFd, err = getProgMapFd(s.progFd, "queue_stats_map"); err != nil {
+			return stats, err
+		}
+	}
+	var cs C.struct_xdp_queue_stats
+	if C.get_queue_stats(C.int(s.statsMapFd), C.int(queueId), &cs) != 0 {
+		return stats, errors.New("lookup queue_stats_map failed")
+	}
+	stats.Rx = uint64(cs.rx)
+	stats.Redirected = uint64(cs.redirected)
+	stats.Filtered = uint64(cs.filtered)
+	stats.Sampled = uint64(cs.sampled)
+	stats.NoSocket = uint64(cs.no_socket)
+	return stats, nil
+}
+
+func (s *XDPSocket) GetQueueKernelStats() (XDPQueueKernelStats, error) {
+	return s.getQueueKernelStats(s.queueId)
+}
+
+// 设置忙轮询, 队列为空时由收包线程驱动网卡NAPI, 需内核5.11及以上
+func (s *XDPSocket) setBusyPoll(budget uint32) error {
+	opts := []struct {
+		name  string
+		opt   int
+		value int
+	}{
+		{"SO_PREFER_BUSY_POLL", unix.SO_PREFER_BUSY_POLL, 1},
+		{"SO_BUSY_POLL", unix.SO_BUSY_POLL, DFLT_BUSY_POLL_USECS},
+		{"SO_BUSY_POLL_BUDGET", unix.SO_BUSY_POLL_BUDGET, int(budget)},
+	}
+	for _, o := range opts {
+		if err := unix.SetsockoptInt(s.sockFd, unix.SOL_SOCKET, o.opt, o.value); err != nil {
+			return fmt.Errorf("set %v(%v) failed as %v", o.name, o.value, err)
+		}
+	}
+	s.busyPoll = true
+	return nil
+}
+
+// 忙轮询模式下, 通过非阻塞的recvfrom驱动网卡收包
+func (s *XDPSocket) kickBusyPoll() {
+	unix.Recvfrom(s.sockFd, nil, unix.MSG_DONTWAIT)
+}
+
 // 因内核不支持，故不可用
 func checkXsksMapIsEmpty(xsksMapFd int) (bool, error) {
 	var ret C.int
@@ -692,12 +944,14 @@ func newXDPSocket(ifIndex int, options *XDPOptions, queueId int) (*XDPSocket, er
 	}
 
 	s := XDPSocket{
-		sockFd:    -1,
-		ifIndex:   ifIndex,
-		progFd:    -1,
-		xsksMapFd: -1,
-		queueId:   queueId,
-		xdpMode:   options.xdpMode,
+		sockFd:      -1,
+		ifIndex:     ifIndex,
+		progFd:      -1,
+		xsksMapFd:   -1,
+		filterMapFd: -1,
+		statsMapFd:  -1,
+		queueId:     queueId,
+		xdpMode:     options.xdpMode,
 	}
 	// goto之后不能定义变量，否则编译报错
 	addr := &unix.SockaddrXDP{}
@@ -731,6 +985,13 @@ func newXDPSocket(ifIndex int, options *XDPOptions, queueId int) (*XDPSocket, er
 		goto failed
 	}
 
+	if options.busyPollBudget > 0 {
+		if err = s.setBusyPoll(options.busyPollBudget); err != nil {
+			// 低版本内核不支持, 退化为普通模式
+			log.Warningf("socket(%v) on queue %v busy poll disabled: %v", s.sockFd, s.queueId, err)
+		}
+	}
+
 	return &s, nil
 
 failed:
@@ -834,6 +1095,13 @@ func (s *XDPSocket) close() {
 
 	s.clearXsksMap()
 
+	for _, fd := range []*int{&s.filterMapFd, &s.statsMapFd} {
+		if *fd != ERROR_FD {
+			unix.Close(*fd)
+			*fd = ERROR_FD
+		}
+	}
+
 	unix.Munmap(s.framesBulk)
 
 	// 关闭socket